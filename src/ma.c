@@ -6,6 +6,8 @@
 // aktualizacje i usuwanie automatow Moore’a oraz obsluge ich stanow i polaczen.
 
 #include "ma.h"
+#include "ma_internal.h"
+#include "ma_probes.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -16,69 +18,126 @@
 #include <malloc.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <pthread.h>
 
-#define ILE_UINT(x) ((x) / 64 + ((x) % 64 != 0)) // Oblicza liczbe 64-bitowych slow potrzebnych na x bitow
+_Atomic uint64_t epoka = 0;
+static _Atomic uint64_t cykl = 0; // Numer kroku ma_step przekazywany punktom sledzenia
 
+// Tyle wezlow kombinacyjnych krok i ustawianie wejść porzadkuja bez alokacji
+#define KOMB_NA_STOSIE 64
 
-// Reprezentuje polaczenie bitowe miedzy dwoma automatami
-typedef struct polaczenie {
-    size_t bit_biore; // Ktory bit z automatu nadrzednego jest pobierany
-    moore_t *a_z_kad; // Automat, z ktorego pobierany jest bit
-    moore_t *ja; // Automat, ktory pobiera bit
-} polaczenie_t;
+static moore_t **uloz_zalezne(moore_t *a, moore_t *bufor[], size_t *ile);
+static void przelicz_kombinacyjne(moore_t *komb[], size_t ile, bool zatwierdz);
 
+// Rejestr wszystkich zywych typow; instancje o tym samym ksztalcie dziela jeden wpis
+static ma_type_t *rejestr_typow = NULL;
+// Chroni rejestr i liczniki odwolan typow; automaty moga byc tworzone w wielu watkach
+static pthread_mutex_t blokada_typow = PTHREAD_MUTEX_INITIALIZER;
 
-// Lista jednokierunkowa dla automatow
-typedef struct Lista {
-    moore_t *automat_moore; // Wskaznik na potomka
-    struct Lista *nxt; // Kolejny element listy
-} list_ma;
+/** Dolacza typ do rejestru; wywolujacy trzyma blokada_typow. */
+static void dolacz_typ(ma_type_t *typ) {
+    typ->klasa = klasa_rozmiaru(typ);
+    typ->nxt = rejestr_typow;
+    rejestr_typow = typ;
+}
 
-// Reprezentacja automatu Moore'a
-struct moore {
-    size_t n, m, s; // n: liczba wejśc, m: liczba wyjśc, s: liczba bitow stanu
-    transition_function_t t; // Funkcja przejścia
-    output_function_t y; // Funkcja wyjściowa
+/** Zwraca (i w razie potrzeby rejestruje) typ o podanym ksztalcie, zwiekszajac licznik odwolan. */
+static ma_type_t *pobierz_typ(size_t n, size_t m, size_t s, transition_function_t t,
+                              output_function_t y, unsigned flagi) {
+    pthread_mutex_lock(&blokada_typow);
+    for (ma_type_t *typ = rejestr_typow; typ; typ = typ->nxt) {
+        if (typ->n == n && typ->m == m && typ->s == s && typ->t == t &&
+            typ->y == y && typ->flagi == flagi) {
+            typ->licznik++;
+            pthread_mutex_unlock(&blokada_typow);
+            return typ;
+        }
+    }
+    ma_type_t *typ = calloc(1, sizeof(ma_type_t));
+    if (!typ) {
+        pthread_mutex_unlock(&blokada_typow);
+        MA_PROBE1(alloc__failure, sizeof(ma_type_t));
+        errno = ENOMEM;
+        return NULL;
+    }
+    typ->n = n;
+    typ->m = m;
+    typ->s = s;
+    typ->t = t;
+    typ->y = y;
+    typ->flagi = flagi;
+    typ->licznik = 1;
+    dolacz_typ(typ);
+    pthread_mutex_unlock(&blokada_typow);
+    return typ;
+}
 
-    uint64_t *input; // Bufor wejśc
-    uint64_t *state; // Bufor stanu
-    uint64_t *output; // Bufor wyjśc
-    uint64_t *next_state; // Bufor na przyszly stan
+/** Dolacza typ do rejestru; typy tablicowe nie sa wspoldzielone, ale tez trafiaja do rejestru. */
+void zarejestruj_typ(ma_type_t *typ) {
+    pthread_mutex_lock(&blokada_typow);
+    dolacz_typ(typ);
+    pthread_mutex_unlock(&blokada_typow);
+}
 
-    list_ma *rodzice; // Lista rodzicow
-    list_ma *dzieci; // Lista dzieci
-    polaczenie_t *podlaczenia_do_a; // Polaczenia wejśc
-};
+/** Zwalnia jedno odwolanie do typu; ostatnie usuwa go z rejestru. */
+void ma_type_release(ma_type_t *type) {
+    if (!type) return;
+    pthread_mutex_lock(&blokada_typow);
+    if (--type->licznik > 0) {
+        pthread_mutex_unlock(&blokada_typow);
+        return;
+    }
+    ma_type_t **miejsce = &rejestr_typow;
+    while (*miejsce != type) {
+        miejsce = &(*miejsce)->nxt;
+    }
+    *miejsce = type->nxt;
+    pthread_mutex_unlock(&blokada_typow);
+    tabela_zwolnij(type->tabela);
+    free(type);
+}
 
-// Tworzy nowy, kompletny automat Moore’a
-moore_t *ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
-                        output_function_t y, uint64_t const *q) {
-    if (!t || !y || !q || m == 0 || s == 0) {
+/** Rejestruje ksztalt automatu wspoldzielony przez instancje tworzone przez ma_create_from_type. */
+ma_type_t *ma_type_register(size_t n, size_t m, size_t s, transition_function_t t,
+                            output_function_t y, unsigned flags) {
+    bool tozsamosc = flags & MA_TYPE_IDENTITY_OUTPUT;
+    if (!t || (!y && !tozsamosc) || m == 0 || s == 0 || (tozsamosc && m > s) ||
+        (flags & ~(MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT))) {
         errno = EINVAL;
         return NULL;
     }
+    if (tozsamosc) {
+        y = identycznosc;
+    }
+    return pobierz_typ(n, m, s, t, y, flags);
+}
+
+/** Tworzy instancje typu `typ`, przejmujac jedno odwolanie do niego (zwalniane przy bledzie). */
+static moore_t *utworz_instancje(ma_type_t *typ, uint64_t const *q) {
+    size_t n = typ->n, m = typ->m, s = typ->s;
     moore_t *a = calloc(1, sizeof(moore_t));
 
     if (!a) {
+        MA_PROBE1(alloc__failure, sizeof(moore_t));
+        ma_type_release(typ);
         errno = ENOMEM;
         return NULL;
     }
 
-    a->n = n;
-    a->m = m;
-    a->s = s;
-    a->t = t;
-    a->y = y;
+    a->typ = typ;
 
     // Alokacja buforow
     a->input = calloc(ILE_UINT(n), sizeof(uint64_t));
-    a->state = calloc(ILE_UINT(s), sizeof(uint64_t));
+    // Wezel kombinacyjny (s == 0) tez dostaje slowo stanu, zeby bufor nie byl pusty
+    a->state = calloc(ILE_UINT(s) + (s == 0), sizeof(uint64_t));
     // next_state nie jest alokowany, gdyz alokujemy go i zarowno zwalniamy zawsze w ma_step
     //dlatego tez ostatecznie nie trzeba w delete go free'owac.
     a->output = calloc(ILE_UINT(m), sizeof(uint64_t));
     a->podlaczenia_do_a = calloc(n, sizeof(polaczenie_t));
 
     if (!a->podlaczenia_do_a || !a->input || !a->state || !a->output) {
+        MA_PROBE1(alloc__failure, (ILE_UINT(n) + ILE_UINT(s) + (s == 0) + ILE_UINT(m)) *
+                                      sizeof(uint64_t) + n * sizeof(polaczenie_t));
         free(a->podlaczenia_do_a);
         a->podlaczenia_do_a = NULL;
         free(a->input);
@@ -89,6 +148,7 @@ moore_t *ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
         a->output = NULL;
         free(a);
         a = NULL;
+        ma_type_release(typ);
         errno = ENOMEM;
         return NULL;
     }
@@ -97,6 +157,7 @@ moore_t *ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
     list_ma *malist2 = calloc(1, sizeof(list_ma));
 
     if (!malist || !malist2) {
+        MA_PROBE1(alloc__failure, 2 * sizeof(list_ma));
 
         free(malist);
         malist = NULL;
@@ -112,15 +173,18 @@ moore_t *ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
         a->output = NULL;
         free(a);
         a = NULL;
+        ma_type_release(typ);
         errno = ENOMEM;
         return NULL;
     }
 
     a->rodzice = malist;
     a->dzieci = malist2;
+    a->zmiana_wyjscia = epoka;
+    a->brudny = true;
 
-    memcpy(a->state, q, ILE_UINT(a->s) * sizeof(uint64_t));
-    a->y(a->output, a->state, a->m, a->s);
+    memcpy(a->state, q, ILE_UINT(s) * sizeof(uint64_t));
+    oblicz_wyjscie(a);
 
     // Inicjalizacja polaczen wejśc
     for (size_t i = 0; i < n; i++) {
@@ -132,17 +196,73 @@ moore_t *ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
     return a;
 }
 
-/** Ustawia stan automatu i aktualizuje wyjście */
-int ma_set_state(moore_t *a, uint64_t const *state) {
+// Tworzy nowy, kompletny automat Moore’a
+moore_t *ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
+                        output_function_t y, uint64_t const *q) {
+    MA_PROBE3(create__entry, n, m, s);
+    moore_t *a = NULL;
+    if (!t || !y || !q || m == 0 || s == 0) {
+        errno = EINVAL;
+    } else {
+        ma_type_t *typ = pobierz_typ(n, m, s, t, y, 0);
+        a = typ ? utworz_instancje(typ, q) : NULL;
+    }
+    if (slad_wlaczony) slad_utworz_full(a, n, m, s, t, y, q);
+    MA_PROBE4(create__return, a, n, m, s);
+    return a;
+}
+
+/** Tworzy automat o wczesniej zarejestrowanym typie. */
+moore_t *ma_create_from_type(ma_type_t *type, uint64_t const *q) {
+    size_t n = type ? type->n : 0, m = type ? type->m : 0, s = type ? type->s : 0;
+    MA_PROBE3(create__entry, n, m, s);
+    moore_t *a = NULL;
+    if (!type || !q) {
+        errno = EINVAL;
+    } else {
+        pthread_mutex_lock(&blokada_typow);
+        type->licznik++;
+        pthread_mutex_unlock(&blokada_typow);
+        a = utworz_instancje(type, q);
+    }
+    if (slad_wlaczony) slad_utworz_z_typu(a, type, q);
+    MA_PROBE4(create__return, a, n, m, s);
+    return a;
+}
+
+static int ustaw_stan(moore_t *a, uint64_t const *state) {
     if (!a || !state) {
         errno = EINVAL;
         return -1;
     }
-    memcpy(a->state, state, ILE_UINT(a->s) * sizeof(uint64_t));
-    a->y(a->output, a->state, a->m, a->s);
+    if (a->wyrzut && przywroc_wyrzucony(a) != 0) {
+        return -1;
+    }
+    // Wezly kombinacyjne za automatem widza nowe wyjście od razu, bez czekania na krok
+    moore_t *bufor[KOMB_NA_STOSIE];
+    size_t ile;
+    moore_t **komb = uloz_zalezne(a, bufor, &ile);
+    if (!komb) {
+        return -1;
+    }
+    memcpy(a->state, state, ILE_UINT(a->typ->s) * sizeof(uint64_t));
+    oblicz_wyjscie(a);
+    a->zmiana_wyjscia = epoka;
+    a->brudny = true;
+    przelicz_kombinacyjne(komb, ile, false);
+    if (komb != bufor) free(komb);
     return 0;
 }
 
+/** Ustawia stan automatu i aktualizuje wyjście */
+int ma_set_state(moore_t *a, uint64_t const *state) {
+    MA_PROBE1(set_state__entry, a);
+    int wynik = ustaw_stan(a, state);
+    if (slad_wlaczony) slad_stan(a, state, wynik);
+    MA_PROBE2(set_state__return, a, wynik);
+    return wynik;
+}
+
 
 
 /** Zwalnia cala liste jednokierunkowa `list_ma`. */
@@ -165,54 +285,111 @@ void identycznosc(uint64_t *output, uint64_t const *state,
 
 // Tworzy prosty automat z y = state
 moore_t *ma_create_simple(size_t n, size_t s, transition_function_t t) {
+    MA_PROBE3(create__entry, n, s, s);
+    moore_t *a = NULL;
+    uint64_t *q = NULL;
     if (s == 0 || !t) {
         errno = EINVAL;
-        return NULL;
-    }
-    uint64_t *q = calloc(ILE_UINT(s), sizeof(uint64_t));
-    if (!q) {
+    } else if (!(q = calloc(ILE_UINT(s), sizeof(uint64_t)))) {
+        MA_PROBE1(alloc__failure, ILE_UINT(s) * sizeof(uint64_t));
         errno = ENOMEM;
-        return NULL;
+    } else {
+        // Wyjście jest kopia stanu, wiec commit moze pominac wywolanie y
+        ma_type_t *typ = pobierz_typ(n, s, s, t, identycznosc, MA_TYPE_IDENTITY_OUTPUT);
+        a = typ ? utworz_instancje(typ, q) : NULL;
+        free(q);
+        q = NULL;
     }
-    moore_t *a = ma_create_full(n, s, s, t, identycznosc, q);
-    free(q);
-    q = NULL;
+    if (slad_wlaczony) slad_utworz_simple(a, n, s, t);
+    MA_PROBE4(create__return, a, n, s, s);
     return a;
 }
 
+/** Przejście wezla kombinacyjnego: brak stanu. */
+static void bez_przejscia(uint64_t *, uint64_t const *, uint64_t const *, size_t, size_t) {
+}
 
-/** Ustawia wejścia dla automatu - podpiete nie maja znaczenia bo i tak w ma_step sie zaktualizuja */
-int ma_set_input(moore_t *a, uint64_t const *input) {
-    if (a == NULL || input == NULL || a->n == 0) {
+/** Tworzy wezel kombinacyjny, ktorego wyjście jest funkcja `f` biezacego wejścia. */
+moore_t *ma_create_comb(size_t n, size_t m, comb_function_t f) {
+    MA_PROBE3(create__entry, n, m, 0);
+    moore_t *a = NULL;
+    if (!f || m == 0) {
+        errno = EINVAL;
+    } else {
+        uint64_t q = 0;
+        ma_type_t *typ = pobierz_typ(n, m, 0, bez_przejscia, f, TYP_KOMBINACYJNY);
+        a = typ ? utworz_instancje(typ, &q) : NULL;
+    }
+    if (slad_wlaczony) slad_utworz_komb(a, n, m, f);
+    MA_PROBE4(create__return, a, n, m, 0);
+    return a;
+}
+
+static int ustaw_wejscie(moore_t *a, uint64_t const *input) {
+    if (a == NULL || input == NULL || a->typ->n == 0) {
         errno = EINVAL;
         return -1;
     }
-    size_t slowa = ILE_UINT(a->n);
+    if (a->wyrzut && przywroc_wyrzucony(a) != 0) {
+        return -1;
+    }
+    // Wyjście wezla kombinacyjnego i jego potomkow zalezy od wejścia bez opoznienia
+    moore_t *bufor[KOMB_NA_STOSIE];
+    size_t ile = 0;
+    moore_t **komb = kombinacyjny(a) ? uloz_zalezne(a, bufor, &ile) : bufor;
+    if (!komb) {
+        return -1;
+    }
+    size_t slowa = ILE_UINT(a->typ->n);
     memcpy(a->input, input, sizeof(uint64_t) * slowa);
-
+    a->brudny = true;
+    przelicz_kombinacyjne(komb, ile, false);
+    if (komb != bufor) free(komb);
     return 0;
 }
 
+/** Ustawia wejścia dla automatu - podpiete nie maja znaczenia bo i tak w ma_step sie zaktualizuja */
+int ma_set_input(moore_t *a, uint64_t const *input) {
+    MA_PROBE1(set_input__entry, a);
+    int wynik = ustaw_wejscie(a, input);
+    if (slad_wlaczony) slad_wejscie(a, input, wynik);
+    MA_PROBE2(set_input__return, a, wynik);
+    return wynik;
+}
+
 
 /** Zwraca wskaznik na dane wyjściowe automatu. */
 uint64_t const *ma_get_output(moore_t const *a) {
+    MA_PROBE1(get_output__entry, a);
     if (a == NULL) {
         errno = EINVAL;
+        MA_PROBE2(get_output__return, a, NULL);
         return NULL;
     }
+    MA_PROBE2(get_output__return, a, a->output);
     return a->output;
 }
 
 /** Zwalnia caly automat Moore'a i wszystkie zasoby. */
 void ma_delete(moore_t *a) {
 
-    if (!a) return;
+    MA_PROBE1(delete__entry, a);
+    if (!a) {
+        MA_PROBE1(delete__return, a);
+        return;
+    }
+    uintptr_t adres = (uintptr_t)a; // Do punktu delete__return, po zwolnieniu
 
-    free(a->state);
+    if (slad_wlaczony) slad_usun(a);
+    ma_disable_history(a);
+    // Bufory automatu w pliku ma_persist naleza do odwzorowania
+    if (!a->trwaly) {
+        free(a->state);
+        free(a->input);
+        free(a->output);
+    }
     a->state = NULL;
-    free(a->input);
     a->input = NULL;
-    free(a->output);
     a->output = NULL;
     // next_state jest juz free
 
@@ -221,11 +398,12 @@ void ma_delete(moore_t *a) {
 
     while (dzieci) {
         moore_t *dziecko = dzieci->automat_moore;
-        for (size_t i=0; i<dziecko->n; i++) {
+        for (size_t i=0; i<dziecko->typ->n; i++) {
             if (dziecko->podlaczenia_do_a[i].a_z_kad==a) {
                 dziecko->podlaczenia_do_a[i].a_z_kad = NULL;
             }
         }
+        dziecko->widok_aktualny = false;
         // mosze dzeiciom powiedzeic ze nie jestem juz ich rodzicem
         list_ma *rodzice = dziecko->rodzice->nxt;
         list_ma *poprzedni = dziecko->rodzice;
@@ -267,9 +445,70 @@ void ma_delete(moore_t *a) {
     a->podlaczenia_do_a = NULL;
     free_list_ma(a->rodzice);
     free_list_ma(a->dzieci);
+    ma_toggle_disable(a);
+    ma_type_release(a->typ);
     free(a);
     a = NULL;
+    MA_PROBE1(delete__return, adres);
 }
+
+// Licznik przeszukiwan petli kombinacyjnych (pole `przeglad` wezlow)
+static _Atomic uint64_t przeglady = 0;
+
+/** Czy wezel `a` zalezy (przez wezly kombinacyjne) od wyjścia `cel`; stos w polach wezlow. */
+static bool zalezy_od(moore_t *a, moore_t const *cel, uint64_t przeglad) {
+    a->przeglad = przeglad;
+    a->stos = NULL;
+    for (moore_t *w = a; w;) {
+        if (w == cel) return true;
+        moore_t *nastepny = w->stos;
+        for (size_t j = 0; j < w->typ->n; j++) {
+            moore_t *r = w->podlaczenia_do_a[j].a_z_kad;
+            if (r && kombinacyjny(r) && r->przeglad != przeglad) {
+                r->przeglad = przeglad;
+                r->stos = nastepny;
+                nastepny = r;
+            }
+        }
+        w = nastepny;
+    }
+    return false;
+}
+
+/** Czy `dziecko` nadal pobiera bity z `a` (lista dzieci moze zawierac odlaczone automaty). */
+static bool pobiera_z(moore_t const *dziecko, moore_t const *a) {
+    for (size_t j = 0; j < dziecko->typ->n; j++) {
+        if (dziecko->podlaczenia_do_a[j].a_z_kad == a) return true;
+    }
+    return false;
+}
+
+/** Podnosi poziom wezla kombinacyjnego co najmniej do `poziom` i poprawia jego potomkow. */
+static void podnies_poziom(moore_t *a, size_t poziom) {
+    if (a->poziom >= poziom) return;
+    a->poziom = poziom;
+    a->stos = NULL;
+    a->na_stosie = true;
+    // Wezel zdjety ze stosu przekazuje dzieciom swoj biezacy poziom; siec jest acykliczna
+    for (moore_t *w = a; w;) {
+        moore_t *nastepny = w->stos;
+        w->na_stosie = false;
+        for (list_ma *d = w->dzieci->nxt; d; d = d->nxt) {
+            moore_t *dziecko = d->automat_moore;
+            if (!kombinacyjny(dziecko) || dziecko->poziom > w->poziom || !pobiera_z(dziecko, w)) {
+                continue;
+            }
+            dziecko->poziom = w->poziom + 1;
+            if (!dziecko->na_stosie) {
+                dziecko->na_stosie = true;
+                dziecko->stos = nastepny;
+                nastepny = dziecko;
+            }
+        }
+        w = nastepny;
+    }
+}
+
 int dodaj_do_listy(list_ma *head, moore_t *a) {
     if (a == NULL || head == NULL) {
         errno = EINVAL;
@@ -277,6 +516,7 @@ int dodaj_do_listy(list_ma *head, moore_t *a) {
     }
     list_ma *new_node = calloc(1, sizeof(list_ma));
     if (!new_node) {
+        MA_PROBE1(alloc__failure, sizeof(list_ma));
         errno = ENOMEM;
         return -1;
     }
@@ -287,10 +527,17 @@ int dodaj_do_listy(list_ma *head, moore_t *a) {
 }
 
 /** Tworzy polaczenia miedzy automatami i aktualizuje struktury. */
-int ma_connect(moore_t *a_in, size_t in, moore_t *a_out, size_t out, size_t num) {
+static int polacz(moore_t *a_in, size_t in, moore_t *a_out, size_t out, size_t num) {
     //sprawdz poprawnosc danych
     size_t check = SIZE_MAX - num;
-    if (a_in == NULL || a_out == NULL || num == 0 || check < in || check < out || in + num > a_in->n || out + num > a_out->m) {
+    if (a_in == NULL || a_out == NULL || num == 0 || check < in || check < out || in + num > a_in->typ->n || out + num > a_out->typ->m) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Wezel kombinacyjny nie moze pobierac bitow z wezla, ktory od niego zalezy
+    bool kombinacyjne = kombinacyjny(a_in) && kombinacyjny(a_out);
+    if (kombinacyjne && zalezy_od(a_out, a_in, ++przeglady)) {
         errno = EINVAL;
         return -1;
     }
@@ -343,15 +590,49 @@ int ma_connect(moore_t *a_in, size_t in, moore_t *a_out, size_t out, size_t num)
         a_in->podlaczenia_do_a[in + i].ja = a_in;
         i++;
     }
+    a_in->brudny = true;
+    a_in->widok_aktualny = false;
+    if (kombinacyjne) {
+        podnies_poziom(a_in, a_out->poziom + 1);
+    }
 
     return 0;
 }
 
+/**
+ * Sprawdza, czy wszystkie bity wejścia biora kolejne bity wyjścia jednego rodzica od granicy
+ * slowa; wtedy krok kopiuje do input cale slowa jego wyjścia zamiast przepisywac bity po jednym.
+ * Niepelne slowo wejścia widzialoby obce bity rodzica, wiec wymagamy n podzielnego przez 64.
+ */
+void wyznacz_widok(moore_t *a) {
+    size_t n = a->typ->n;
+    polaczenie_t const *p = a->podlaczenia_do_a;
+    a->widok = NULL;
+    a->widok_aktualny = true;
+    if (n == 0 || n % 64 != 0 || kombinacyjny(a) || !p[0].a_z_kad || p[0].bit_biore % 64 != 0) {
+        return;
+    }
+    for (size_t j = 1; j < n; j++) {
+        if (p[j].a_z_kad != p[0].a_z_kad || p[j].bit_biore != p[0].bit_biore + j) {
+            return;
+        }
+    }
+    a->widok = p[0].a_z_kad;
+    a->widok_slowo = p[0].bit_biore / 64;
+}
 
-/** Usuwa polaczenia wejśc `a_in`. */
-int ma_disconnect(moore_t *a_in, size_t in, size_t num) {
+int ma_connect(moore_t *a_in, size_t in, moore_t *a_out, size_t out, size_t num) {
+    MA_PROBE4(connect__entry, a_in, in, a_out, num);
+    int wynik = polacz(a_in, in, a_out, out, num);
+    if (slad_wlaczony) slad_polacz(a_in, in, a_out, out, num, wynik);
+    MA_PROBE2(connect__return, a_in, wynik);
+    return wynik;
+}
+
+
+static int rozlacz(moore_t *a_in, size_t in, size_t num) {
     size_t check = SIZE_MAX - num;
-    if (!a_in || num == 0 || check < in || in + num > a_in->n) {
+    if (!a_in || num == 0 || check < in || in + num > a_in->typ->n) {
         errno = EINVAL;
         return -1;
     }
@@ -360,77 +641,189 @@ int ma_disconnect(moore_t *a_in, size_t in, size_t num) {
         a_in->podlaczenia_do_a[in + i].a_z_kad = NULL;
         i++;
     }
-
+    a_in->brudny = true;
+    a_in->widok_aktualny = false;
     return 0;
 }
 
-/** Wykonuje jeden krok dla num automatow: input → state → output. */
-int ma_step(moore_t *at[], size_t num) {
+/** Usuwa polaczenia wejśc `a_in`. */
+int ma_disconnect(moore_t *a_in, size_t in, size_t num) {
+    MA_PROBE3(disconnect__entry, a_in, in, num);
+    int wynik = rozlacz(a_in, in, num);
+    if (slad_wlaczony) slad_rozlacz(a_in, in, num, wynik);
+    MA_PROBE2(disconnect__return, a_in, wynik);
+    return wynik;
+}
+
+static int porownaj_poziomy(void const *x, void const *y) {
+    size_t a = (*(moore_t *const *)x)->poziom, b = (*(moore_t *const *)y)->poziom;
+    return (a > b) - (a < b);
+}
+
+/** Wpisuje do `komb` wezly kombinacyjne `at` w kolejnosci poziomow. */
+static void uloz_kombinacyjne(moore_t *at[], size_t num, moore_t *komb[]) {
+    size_t ile = 0;
+    bool posortowane = true;
+    for (size_t i = 0; i < num; i++) {
+        if (!kombinacyjny(at[i])) continue;
+        posortowane = posortowane && (ile == 0 || komb[ile - 1]->poziom <= at[i]->poziom);
+        komb[ile++] = at[i];
+    }
+    if (!posortowane) {
+        qsort(komb, ile, sizeof(moore_t *), porownaj_poziomy);
+    }
+}
+
+/**
+ * Zwraca wezly kombinacyjne zalezne od wyjścia `a` (z `a`, jesli jest kombinacyjny) w kolejnosci
+ * poziomow: w `bufor` albo w nowej tablicy, gdy jest ich wiecej niz KOMB_NA_STOSIE; NULL bez pamieci.
+ */
+static moore_t **uloz_zalezne(moore_t *a, moore_t *bufor[], size_t *ile) {
+    // Kolejka przegladu wszerz w polach `stos`, jak przy poprawianiu poziomow
+    uint64_t przeglad = ++przeglady;
+    a->przeglad = przeglad;
+    a->stos = NULL;
+    moore_t *ogon = a;
+    size_t zalezne = kombinacyjny(a);
+    for (moore_t *w = a; w; w = w->stos) {
+        for (list_ma *d = w->dzieci->nxt; d; d = d->nxt) {
+            moore_t *dziecko = d->automat_moore;
+            if (!kombinacyjny(dziecko) || dziecko->przeglad == przeglad || !pobiera_z(dziecko, w)) {
+                continue;
+            }
+            dziecko->przeglad = przeglad;
+            dziecko->stos = NULL;
+            ogon->stos = dziecko;
+            ogon = dziecko;
+            zalezne++;
+        }
+    }
+    moore_t **komb = bufor;
+    if (zalezne > KOMB_NA_STOSIE && !(komb = malloc(zalezne * sizeof(moore_t *)))) {
+        MA_PROBE1(alloc__failure, zalezne * sizeof(moore_t *));
+        errno = ENOMEM;
+        return NULL;
+    }
+    size_t k = 0;
+    for (moore_t *w = kombinacyjny(a) ? a : a->stos; w; w = w->stos) {
+        komb[k++] = w;
+    }
+    qsort(komb, k, sizeof(moore_t *), porownaj_poziomy);
+    *ile = k;
+    return komb;
+}
+
+/** Liczy wyjścia wezlow kombinacyjnych w porzadku poziomow; `zatwierdz` konczy krok. */
+static void przelicz_kombinacyjne(moore_t *komb[], size_t ile, bool zatwierdz) {
+    for (size_t i = 0; i < ile; i++) {
+        moore_t *a = komb[i];
+        aktualizuj_wejscie(a);
+        if (zatwierdz) {
+            zatwierdz_wyjscie(a);
+        } else {
+            oblicz_wyjscie(a);
+        }
+        a->zmiana_wyjscia = epoka;
+        a->brudny = true;
+    }
+}
+
+/** Wykonuje jeden krok dla num automatow: input → state → output; `znaczniki` to takty faz. */
+int krok_sieci(moore_t *at[], size_t num, uint64_t *znaczniki) {
+    uint64_t nr = cykl++;
+    MA_PROBE2(step__entry, num, nr);
     if (at == NULL || num == 0) {
         errno = EINVAL;
+        MA_PROBE3(step__return, num, nr, -1);
         return -1;
     }
+    size_t ile_komb = 0, bajty = 0;
     for (size_t i = 0; i < num; i++) {
         moore_t *a = at[i];
-        if (a == NULL) {
+        // Automat wyrzucony do pliku przez ma_spill_step wraca przed krokiem
+        if (a == NULL || (a->wyrzut && przywroc_wyrzucony(a) != 0)) {
+            int blad = a == NULL ? EINVAL : errno;
             for(size_t j=0; j<i;j++) {
                 free(at[j]->next_state);
+                at[j]->next_state = NULL;
             }
-            errno = EINVAL;
+            errno = blad;
+            MA_PROBE3(step__return, num, nr, -1);
             return -1;
         }
-        size_t uint_state = ILE_UINT(a->s);
+        if (kombinacyjny(a)) {
+            ile_komb++;
+            continue;
+        }
+        size_t uint_state = ILE_UINT(a->typ->s);
         uint64_t *next_state = calloc(uint_state, sizeof(uint64_t));
         if (!next_state) {
             for(size_t j=0; j<i;j++) {
                 free(at[j]->next_state);
+                at[j]->next_state = NULL;
             }
+            MA_PROBE1(alloc__failure, uint_state * sizeof(uint64_t));
             errno = ENOMEM;
+            MA_PROBE3(step__return, num, nr, -1);
             return -1;
         }
         a->next_state = next_state;
+        bajty += uint_state * sizeof(uint64_t);
     }
 
+    // Wezly kombinacyjne w kolejnosci poziomow wyznaczonych przy laczeniu; porzadek jest
+    // lokalny dla wywolania, wiec rozne sieci moga byc liczone jednoczesnie
+    moore_t *komb_na_stosie[KOMB_NA_STOSIE];
+    moore_t **komb = komb_na_stosie;
+    if (ile_komb > KOMB_NA_STOSIE && !(komb = malloc(ile_komb * sizeof(moore_t *)))) {
+        for (size_t j = 0; j < num; j++) {
+            free(at[j]->next_state);
+            at[j]->next_state = NULL;
+        }
+        MA_PROBE1(alloc__failure, ile_komb * sizeof(moore_t *));
+        errno = ENOMEM;
+        MA_PROBE3(step__return, num, nr, -1);
+        return -1;
+    }
+    if (ile_komb > 0) {
+        uloz_kombinacyjne(at, num, komb);
+        przelicz_kombinacyjne(komb, ile_komb, false);
+    }
+
+    if (znaczniki) znaczniki[0] = takt();
+    MA_PROBE2(step__prepared, num, bajty);
 
     //aktaulizuje input
     for (size_t i = 0; i < num; i++) {
         moore_t *a = at[i];
+        if (ile_komb > 0 && kombinacyjny(a)) continue;
 
-        //aktualizacja input
-        for (size_t j = 0; j < a->n; j++) {
-            moore_t *b = a->podlaczenia_do_a[j].a_z_kad;
-            if (b != NULL) {
-                uint64_t zkad = b->output[ILE_UINT(a->podlaczenia_do_a[j].bit_biore+1) - 1];
-                uint64_t x = 1ULL << (a->podlaczenia_do_a[j].bit_biore % 64);
-                uint64_t y = x & zkad;
-                size_t slowo = ILE_UINT(j+1) - 1;
-
-                if (y > 0) {
-                    y= 1ULL << j % 64;
-                    a->input[slowo] |= y;
-                } else {
-                    y= 1ULL << j % 64;
-                    a->input[slowo] &= (~y);
-                }
-            }
-        }
-        //input dla a aktualny
-
-
-        size_t uint_state = ILE_UINT(a->s);
-        memcpy(a->next_state, a->state, uint_state * sizeof(uint64_t));
-        a->t(a->next_state, a->input,
-             a->state, a->n, a->s);
+        // Wejście, kopia stanu i przejście; jadra klas rozmiaru dla malych automatow
+        przejscie_automatu(a);
     }
+    if (znaczniki) znaczniki[1] = takt();
+    MA_PROBE1(step__transitioned, num);
     //aktualizujemy output i ustawiamy stany
     for (size_t i = 0; i < num; i++) {
         moore_t *a = at[i];
-        size_t uint_state = ILE_UINT(a->s);
-        memcpy(a->state, a->next_state, uint_state * sizeof(uint64_t));
-        a->y(a->output, a->state, a->m, a->s);
+        if (ile_komb > 0 && kombinacyjny(a)) continue;
+        zatwierdzenie_automatu(a);
+        // Silnik pomijajacy (ma_tuned.c) musi ponownie policzyc ten automat i jego dzieci
+        a->zmiana_wyjscia = epoka;
+        a->brudny = true;
 
         free(a->next_state);
         a->next_state = NULL;
     }
+    // Wyjścia wezlow kombinacyjnych odpowiadaja nowym stanom automatow
+    przelicz_kombinacyjne(komb, ile_komb, true);
+    if (komb != komb_na_stosie) free(komb);
+    MA_PROBE3(step__return, num, nr, 0);
     return 0;
 }
+
+int ma_step(moore_t *at[], size_t num) {
+    int wynik = krok_sieci(at, num, NULL);
+    if (slad_wlaczony) slad_krok(at, num, 1, false, wynik);
+    return wynik;
+}
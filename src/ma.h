@@ -3,22 +3,300 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 typedef struct moore moore_t;
+typedef struct ma_type ma_type_t;
 typedef void (*transition_function_t)(uint64_t *next_state, uint64_t const *input,
                                       uint64_t const *state, size_t n, size_t s);
 typedef void (*output_function_t)(uint64_t *output, uint64_t const *state,
                                   size_t m, size_t s);
+typedef void (*comb_function_t)(uint64_t *output, uint64_t const *input,
+                                size_t m, size_t n);
 
+// Flagi typu automatu
+#define MA_TYPE_PURE 1u            // t i y zaleza wylacznie od swoich argumentow
+#define MA_TYPE_IDENTITY_OUTPUT 2u // wyjscie jest kopia stanu, y moze byc NULL
+
+ma_type_t * ma_type_register(size_t n, size_t m, size_t s, transition_function_t t,
+                             output_function_t y, unsigned flags);
+void ma_type_release(ma_type_t *type);
+moore_t * ma_create_from_type(ma_type_t *type, uint64_t const *q);
 moore_t * ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
                          output_function_t y, uint64_t const *q);
 moore_t * ma_create_simple(size_t n, size_t s, transition_function_t t);
+// Wezel kombinacyjny bez stanu: wyjście = f(biezace wejście). ma_step liczy wezly
+// z `at` w porzadku poziomow przed przejściami automatow i po zatwierdzeniu ich stanow;
+// ma_set_input wezla i ma_set_state rodzica od razu przeliczaja wezly za nimi.
+// ma_connect odrzuca petle kombinacyjne (EINVAL)
+moore_t * ma_create_comb(size_t n, size_t m, comb_function_t f);
 void ma_delete(moore_t *a);
 int ma_connect(moore_t *a_in, size_t in, moore_t *a_out, size_t out, size_t num);
 int ma_disconnect(moore_t *a_in, size_t in, size_t num);
 int ma_set_input(moore_t *a, uint64_t const *input);
 int ma_set_state(moore_t *a, uint64_t const *state);
 uint64_t const * ma_get_output(moore_t const *a);
+// Historia ostatnich `depth` wyjśc zapisywana przez faze commit; ma_get_output_at(a, k)
+// zwraca wyjście sprzed k krokow (0: biezace) lub NULL, gdy nie jest dostepne.
+// Przy wlaczonej historii wskaznik z ma_get_output jest wazny do nastepnego kroku
+int ma_enable_history(moore_t *a, size_t depth);
+void ma_disable_history(moore_t *a);
+uint64_t const * ma_get_output_at(moore_t const *a, size_t cycles_ago);
 int ma_step(moore_t *at[], size_t num);
 
+// Automaty tablicowe: transitions[q << n | x] to nastepnik stanu q (< states) po
+// wejściu x, outputs[q] wyjście (m <= 64); stan automatu to numer stanu
+ma_type_t *ma_table_create(size_t n, size_t m, size_t states, uint32_t const *transitions,
+                           uint64_t const *outputs);
+size_t ma_table_states(ma_type_t const *type);
+
+// Formaty tablic wybierane automatycznie przy tworzeniu typu tablicowego
+#define MA_TABLE_DENSE 0        // Pelna tablica stan x symbol
+#define MA_TABLE_CLASSES 1      // Klasy rownowaznych symboli i tablica stan x klasa
+#define MA_TABLE_DISPLACEMENT 2 // Klasy, domyslny nastepnik i wyjatki upakowane grzebieniem
+
+struct ma_table_report {
+    unsigned format; // MA_TABLE_*
+    size_t states; // Liczba stanow
+    size_t symbols; // Liczba symboli wejścia (2^n)
+    size_t classes; // Liczba klas rownowaznych symboli
+    size_t exceptions; // Przejścia rozne od domyslnego (DISPLACEMENT)
+    size_t bytes; // Pamiec tablic przejść
+    size_t dense_bytes; // Pamiec pelnej tablicy stan x symbol
+    double ratio; // dense_bytes / bytes
+};
+int ma_table_report(ma_type_t const *type, struct ma_table_report *report);
+// Zliczanie odwiedzin stanow wykorzystywane przez ma_table_minimize do numeracji
+int ma_table_profile(ma_type_t *type, int enable);
+// Typ rownowazny o minimalnej liczbie stanow; mapping[q] (opcjonalnie) to nowy numer q
+ma_type_t *ma_table_minimize(ma_type_t const *type, uint32_t *mapping);
+// Jeden automat tablicowy zastepujacy grupe (laczny stan i wejścia zewnetrzne <= 20 bitow);
+// wyjście at[i] zaczyna sie od bitu output_offsets[i] (opcjonalnie) wyjścia produktu.
+// Produkt jest dzieckiem rodzicow spoza grupy; gdy rodzic zostanie usuniety, odlaczony bit
+// produktu zachowuje wartosc odczytana ostatnio (przy splaszczaniu lub w ostatnim kroku),
+// niezaleznie od bitu czlonka, ktory trzyma wlasna.
+moore_t *ma_flatten(moore_t *at[], size_t num, size_t *output_offsets);
+
+// Strumien symboli przez jeden automat; po kazdym kroku do out + k * out_stride
+// trafia min(out_stride, slowa m) slow wyjścia (out_stride == 0: bez wyjśc)
+int ma_run_stream(moore_t *a, uint64_t const *symbols, size_t count, size_t symbol_bits,
+                  uint64_t *out, size_t out_stride);
+// Jak ma_run_stream, ale czyste automaty o s <= 4 i symbolach do 16 bitow sa liczone
+// spekulatywnie przez `threads` watkow (0: liczba procesorow); pozostale sekwencyjnie
+int ma_run_stream_parallel(moore_t *a, uint64_t const *symbols, size_t count,
+                           size_t symbol_bits, uint64_t *out, size_t out_stride,
+                           size_t threads);
+// Jak ma_run_stream(at[i], symbols[i], ...) dla kolejnych i; czyste automaty o s <= 4
+// i symbolach do 4 bitow sa liczone wektorowo po 16-32 naraz (out == NULL: bez wyjśc)
+int ma_run_streams(moore_t *at[], size_t num, uint64_t const *const symbols[],
+                   size_t count, size_t symbol_bits, uint64_t *const out[],
+                   size_t out_stride);
+
+// Wiele automatow na jednym wspolnym strumieniu: kazdy blok symboli jest dekodowany
+// raz i przepuszczany przez wszystkie zarejestrowane automaty. Po kazdym kroku, w ktorym
+// output[0] & match_mask != 0, wolany jest callback z numerem automatu (kolejnosc
+// ma_multi_add), pozycja symbolu w calym strumieniu i pierwszym slowem wyjścia.
+// Zdarzenia jednego bloku sa zglaszane automat po automacie.
+typedef struct ma_multi ma_multi_t;
+typedef void (*ma_match_callback_t)(void *ctx, size_t automaton, uint64_t position,
+                                    uint64_t output);
+ma_multi_t *ma_multi_create(size_t symbol_bits, ma_match_callback_t callback, void *ctx);
+int ma_multi_add(ma_multi_t *mm, moore_t *a, uint64_t match_mask);
+int ma_multi_feed(ma_multi_t *mm, uint64_t const *symbols, size_t count);
+uint64_t ma_multi_position(ma_multi_t const *mm);
+void ma_multi_destroy(ma_multi_t *mm);
+
+// Symboliczna (BDD) osiagalnosc stanow sieci; wejścia spoza zbioru sa dowolne.
+// Automaty o s + n <= 16 sa opisywane automatycznie, wieksze rownaniami bitow:
+// wyrazenia nad sK (bit stanu) i iK (bit wejścia) z ! & ^ | ( ) 0 1.
+#define MA_SYMBOLIC_NEXT 0   // Rownanie bitu nastepnego stanu
+#define MA_SYMBOLIC_OUTPUT 1 // Rownanie bitu wyjścia (tylko bity stanu)
+typedef struct ma_symbolic ma_symbolic_t;
+ma_symbolic_t *ma_symbolic_create(moore_t *at[], size_t num);
+int ma_symbolic_equation(ma_symbolic_t *sym, size_t automaton, int kind, size_t bit,
+                         char const *expr);
+// 1, gdy bit wyjścia at[automaton] moze byc ustawiony w osiagalnym stanie, 0 gdy nigdy
+int ma_symbolic_output_reachable(ma_symbolic_t *sym, size_t automaton, size_t bit);
+// Punkt staly osiagalnosci od biezacych stanow: liczba stanow sieci i iteracji obrazu
+int ma_symbolic_reach(ma_symbolic_t *sym, double *states, size_t *iterations);
+// Przesiewanie zmiennych (rowniez samoczynne przy sprzataniu) i rozmiar BDD modelu w wezlach
+int ma_symbolic_reorder(ma_symbolic_t *sym);
+size_t ma_symbolic_nodes(ma_symbolic_t const *sym);
+void ma_symbolic_destroy(ma_symbolic_t *sym);
+
+// Histogramy opoznien krokow w nanosekundach: przedzialy logarytmiczne z bledem
+// wzglednym do 1/32, zapis kosztuje kilka nanosekund (rdtsc). Percentyl 100 to
+// dokladne maksimum; pusty histogram daje 0.
+#define MA_PHASE_STEP 0       // Caly krok
+#define MA_PHASE_PREPARE 1    // Bufory next_state i porzadek wezlow kombinacyjnych
+#define MA_PHASE_TRANSITION 2 // Wejścia i przejścia automatow
+#define MA_PHASE_COMMIT 3     // Zatwierdzenie stanow i wyjść
+#define MA_PHASES 4
+typedef struct ma_latency ma_latency_t;
+ma_latency_t *ma_latency_create(int per_phase);
+int ma_step_measured(ma_latency_t *lat, moore_t *at[], size_t num);
+int ma_latency_record(ma_latency_t *lat, int phase, uint64_t ns);
+uint64_t ma_latency_count(ma_latency_t const *lat, int phase);
+uint64_t ma_latency_percentile(ma_latency_t const *lat, int phase, double percentile);
+void ma_latency_reset(ma_latency_t *lat);
+void ma_latency_destroy(ma_latency_t *lat);
+
+// Tryb czasu rzeczywistego: bufory kroku przydzielone i dotkniete z gory, automaty
+// podzielone miedzy `threads` watkow (wolajacy jest jednym z nich) czekajacych na
+// barierach w petli aktywnej. ma_realtime_step nie alokuje pamieci ani nie usypia.
+// Siec nie moze zawierac wezlow kombinacyjnych; jej automaty musza zyc dluzej niz tryb.
+#define MA_RT_PIN 1u  // Przypina watki robocze do kolejnych dozwolonych procesorow
+#define MA_RT_LOCK 2u // Blokuje pamiec sieci i stosy w RAM (mlock); blad, gdy system odmowi
+typedef struct ma_realtime ma_realtime_t;
+ma_realtime_t *ma_realtime_create(moore_t *at[], size_t num, size_t threads, unsigned flags);
+int ma_realtime_step(ma_realtime_t *rt);
+int ma_realtime_run(ma_realtime_t *rt, size_t cycles, ma_latency_t *latency);
+void ma_realtime_destroy(ma_realtime_t *rt);
+
+// Nagrywanie wywolan API do zwartego pliku binarnego i odtwarzanie go z pomiarem czasu.
+// Nagrywane sa ma_create_full, ma_create_simple, ma_create_from_type, ma_create_comb,
+// ma_delete, ma_connect, ma_disconnect, ma_set_input, ma_set_state, ma_step (takze
+// ma_step_measured) i ma_run_tuned; funkcje przejść, wyjść i wezlow kombinacyjnych
+// zapisujemy przez identyfikatory zarejestrowane w obu procesach. Typ z ma_create_from_type
+// jest zapisywany razem z automatem (typy tablicowe nie maja funkcji, wiec odtwarzamy je
+// tylko z MA_REPLAY_STUBS).
+// Wywolania dotyczace automatow spoza nagrania lub nieznanych funkcji sa pomijane
+// (skipped), chyba ze MA_REPLAY_STUBS podstawia za nie funkcje zastepcze.
+#define MA_TRACE_CREATE_FULL 0
+#define MA_TRACE_CREATE_SIMPLE 1
+#define MA_TRACE_DELETE 2
+#define MA_TRACE_CONNECT 3
+#define MA_TRACE_DISCONNECT 4
+#define MA_TRACE_SET_INPUT 5
+#define MA_TRACE_SET_STATE 6
+#define MA_TRACE_STEP 7
+#define MA_TRACE_RUN_TUNED 8
+#define MA_TRACE_CREATE_FROM_TYPE 9
+#define MA_TRACE_CREATE_COMB 10
+#define MA_TRACE_CALLS 11
+#define MA_REPLAY_STUBS 1u // Nieznane funkcje zastepowane funkcjami o podobnym koszcie
+
+struct ma_replay_report {
+    uint64_t calls[MA_TRACE_CALLS]; // Odtworzone wywolania kazdego rodzaju
+    double ns[MA_TRACE_CALLS]; // Laczny czas tych wywolan
+    uint64_t skipped; // Wywolania pominiete
+    uint64_t mismatches; // Wywolania z innym wynikiem (sukces/blad) niz nagrany
+};
+int ma_trace_register_transition(uint32_t id, transition_function_t t);
+int ma_trace_register_output(uint32_t id, output_function_t y);
+int ma_trace_register_comb(uint32_t id, comb_function_t f);
+int ma_trace_start(char const *path);
+int ma_trace_stop(void);
+int ma_replay(char const *path, unsigned flags, struct ma_replay_report *report);
+
+// Analiza ksztaltu sieci: rozklady stopni, silnie spojne skladowe, glebokosc grafu
+// skladowych, ruch bitow i szacunek pamieci dotykanej w kroku. Krawedzie to rozne pary
+// rodzic -> dziecko w `at`; bity z automatow spoza `at` liczone sa jako zewnetrzne.
+#define MA_EXEC_SEQUENTIAL 0   // Siec za mala na zysk z innego sposobu wykonania
+#define MA_EXEC_PARALLEL 1     // Podzial automatow miedzy watki w kazdym kroku
+#define MA_EXEC_EVENT_DRIVEN 2 // Pomijanie niezmienionych automatow (MA_ENGINE_SKIP)
+#define MA_EXEC_PIPELINED 3    // Siec bez sprzezen: etapy grafu na osobnych watkach
+#define MA_TOPOLOGY_BUCKETS 8  // Przedzialy histogramow: 0, 1, 2-3, 4-7, ..., >= 64
+
+struct ma_topology_report {
+    size_t automata; // Liczba automatow
+    size_t types; // Liczba roznych typow
+    size_t largest_type; // Najwiecej automatow jednego typu
+    size_t pure_automata; // Automaty typow MA_TYPE_PURE
+    size_t edges; // Rozne krawedzie rodzic -> dziecko
+    size_t fan_in_histogram[MA_TOPOLOGY_BUCKETS]; // Rozni rodzice automatu
+    size_t fan_out_histogram[MA_TOPOLOGY_BUCKETS]; // Rozne dzieci automatu
+    size_t max_fan_in, max_fan_out;
+    double mean_fan_in; // Rowne sredniemu rozgalezieniu wyjść
+    size_t sources, sinks; // Automaty bez rodzicow / bez dzieci w `at`
+    size_t components; // Silnie spojne skladowe
+    size_t largest_component;
+    size_t cyclic_components; // Skladowe ze sprzezeniem (takze petla na sobie)
+    size_t cyclic_automata; // Automaty w takich skladowych
+    size_t depth; // Najdluzsza sciezka grafu skladowych (w skladowych)
+    size_t routed_bits; // Bity przesylane w kazdym kroku miedzy automatami `at`
+    size_t external_bits; // Bity z automatow spoza `at`
+    size_t free_bits; // Niepodlaczone bity wejść
+    size_t bytes_per_step; // Szacunek bajtow dotykanych przez ma_step
+    int suggested; // MA_EXEC_*
+};
+int ma_analyze(moore_t *at[], size_t num, struct ma_topology_report *report);
+
+// Wielocyklowe wykonanie z automatycznym wyborem silnika
+#define MA_ENGINE_SWEEP 0         // Liczy wszystkie automaty w podanej kolejnosci
+#define MA_ENGINE_SWEEP_BY_TYPE 1 // Liczy wszystkie automaty pogrupowane wedlug typu
+#define MA_ENGINE_SKIP 2          // Pomija niezmienione automaty typow MA_TYPE_PURE
+#define MA_ENGINE_SKIP_BY_TYPE 3  // Jak MA_ENGINE_SKIP, z grupowaniem wedlug typu
+
+int ma_run_tuned(moore_t *at[], size_t num, size_t cycles);
+int ma_tuned_engine(moore_t *at[], size_t num);
+// Wykonanie wskazana konfiguracja MA_ENGINE_* bez strojenia (np. do porownan z ma_step);
+// slad nagrywa je jako ma_run_tuned
+int ma_run_engine(moore_t *at[], size_t num, size_t cycles, int engine);
+
+// Rozniczkowy fuzzer porownujacy alternatywny silnik kroku z ma_step
+typedef int (*ma_step_function_t)(moore_t *at[], size_t num);
+typedef struct ma_fuzz_report {
+    uint64_t seed;            // Ziarno ostatniej wykonanej rundy
+    size_t rounds;            // Liczba wykonanych rund
+    size_t operations;        // Liczba wykonanych operacji
+    size_t steps;             // Liczba wykonanych krokow
+    size_t divergence;        // Numer operacji z pierwsza rozbieznoscia w rundzie
+    size_t reproducer_length; // Liczba operacji zminimalizowanego reproduktora
+    double reference_ns;      // Sredni czas kroku ma_step
+    double candidate_ns;      // Sredni czas kroku kandydata
+} ma_fuzz_report_t;
+int ma_fuzz(ma_step_function_t candidate, uint64_t seed, size_t rounds, size_t length,
+            ma_fuzz_report_t *report, FILE *out);
+
+// Zliczanie przelaczen bitow stanu i wyjścia w fazie commit
+int ma_toggle_enable(moore_t *a);
+void ma_toggle_disable(moore_t *a);
+int ma_toggle_export(moore_t *a, uint64_t *state_toggles, uint64_t *output_toggles,
+                     uint64_t *cycles);
+int ma_toggle_activity(moore_t *a, double *state_activity, double *output_activity);
+
+// Trwaly, odporny na awarie zapis stanu sieci w pliku mapowanym w pamieci. Od otwarcia
+// do ma_persist_close bufory automatow leza w odwzorowaniu pliku: siec krokujemy przez
+// ma_persist_step, historii nie mozna wlaczyc, a ma_delete wolno wywolac dopiero po
+// zamknieciu. Tylko ma_persist_step zwieksza ma_persist_cycle i co `interval` krokow
+// zatwierdza plik; zwykly ma_step zmienia stan w odwzorowaniu, ale licznika nie zwieksza
+// i nie zatwierdza, wiec stan trafia do pliku dopiero przy najblizszym zatwierdzeniu
+// (ma_persist_commit lub okresowym w ma_persist_step). ma_persist_close nie zatwierdza.
+typedef struct ma_persist ma_persist_t;
+ma_persist_t * ma_persist_open(char const *path, moore_t *at[], size_t num,
+                               size_t interval);
+int ma_persist_step(ma_persist_t *p);
+int ma_persist_commit(ma_persist_t *p);
+uint64_t ma_persist_cycle(ma_persist_t const *p);
+void ma_persist_close(ma_persist_t *p);
+
+// Sieci wieksze niz pamiec: gdy state i input automatow zbioru zajmuja wiecej niz `budget`
+// bajtow, bufory automatow MA_TYPE_PURE stabilnych od `idle_cycles` krokow trafiaja do
+// pliku `path` (usuwanego z katalogu od razu). Wyjścia zostaja w pamieci. ma_spill_step
+// liczy tylko automaty, ktore moga sie zmienic, i przywraca je na zadanie; ma_set_input,
+// ma_set_state i ma_step przywracaja wyrzucony automat same. Innych silnikow i ma_delete
+// automatow zbioru mozna uzyc dopiero po ma_spill_close, ktore przywraca wszystkie automaty;
+// do tego czasu silniki (strumienie, ma_run_tuned, ma_multi, ma_realtime, ma_flatten,
+// ma_symbolic) zwracaja EBUSY dla wyrzuconego automatu.
+// Przy `path` NULL bufory zostaja w pamieci skompresowane wbudowanym kodem (slowa zerowe,
+// powtorzenia, slownik zbioru), a restores liczy dekompresje. Kompresowany jest kazdy automat
+// bezczynny od `idle_cycles` krokow, takze ponizej budzetu; budzet ogranicza tylko zapis do pliku
+typedef struct ma_spill ma_spill_t;
+struct ma_spill_report {
+    size_t automata;         // Automaty w zbiorze
+    size_t spilled;          // Automaty, ktorych bufory sa w pliku lub skompresowane
+    size_t resident_bytes;   // Bajty state i input w pamieci
+    size_t spilled_bytes;    // Bajty state i input w pliku lub przed kompresja
+    size_t compressed_bytes; // Bajty skompresowanych buforow w pamieci (bez pliku)
+    uint64_t evictions;      // Liczba wyrzucen
+    uint64_t restores;       // Liczba przywrocen
+    uint64_t prefetches;     // Liczba zapowiedzi odczytu dla automatow, ktore zaraz wroca
+};
+ma_spill_t *ma_spill_open(char const *path, moore_t *at[], size_t num, size_t budget,
+                          size_t idle_cycles);
+int ma_spill_step(ma_spill_t *sp);
+int ma_spill_stats(ma_spill_t const *sp, struct ma_spill_report *report);
+int ma_spill_close(ma_spill_t *sp);
+
 #endif
@@ -0,0 +1,192 @@
+// Zliczanie przelaczen bitow stanu i wyjścia automatow do estymacji mocy.
+//
+// Faza commit liczy maske XOR starej i nowej wartosci kazdego slowa i dodaje ja
+// do pionowego licznika: bit b slowa j jest licznikiem zapisanym w bitach b kolejnych
+// plaszczyzn. Dodanie maski to lancuch polsumatorow, wiec 64 bity sa zliczane
+// kilkoma operacjami na slowach. Zanim licznik sie przepelni, jego zawartosc jest
+// przelewana do dokladnych 64-bitowych sum poszczegolnych bitow.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PLASZCZYZNY 8 // Szerokosc licznika pionowego w bitach
+#define MAKS_W_LICZNIKU ((1u << PLASZCZYZNY) - 1) // Po tylu cyklach przelewamy liczniki
+
+struct aktywnosc {
+    uint64_t cykle; // Liczba zliczonych cykli
+    unsigned w_liczniku; // Cykle zliczone od ostatniego przelania
+    uint64_t *plaszczyzny; // PLASZCZYZNY slow na kazde slowo stanu, potem wyjścia
+    uint64_t *sumy; // Dokladne liczby przelaczen: s bitow stanu, potem m bitow wyjścia
+    uint64_t *stare_wyjscie; // Wyjście sprzed commitu
+};
+
+/** Maska bitow nalezacych do ostatniego slowa bufora o `bity` bitach. */
+static uint64_t maska_ostatniego(size_t bity) {
+    return bity % 64 ? (1ULL << (bity % 64)) - 1 : UINT64_MAX;
+}
+
+/** Dodaje maske przelaczen do pionowego licznika jednego slowa. */
+static inline void dodaj(uint64_t *plaszczyzny, uint64_t przeniesienie) {
+    for (size_t k = 0; k < PLASZCZYZNY && przeniesienie; k++) {
+        uint64_t nowe = plaszczyzny[k] & przeniesienie;
+        plaszczyzny[k] ^= przeniesienie;
+        przeniesienie = nowe;
+    }
+}
+
+/** Przelewa pionowe liczniki `slowa` slow do sum `bity` bitow. */
+static void przelej(uint64_t *plaszczyzny, uint64_t *sumy, size_t slowa, size_t bity) {
+    for (size_t j = 0; j < slowa; j++, plaszczyzny += PLASZCZYZNY) {
+        uint64_t niezerowe = 0;
+        for (size_t k = 0; k < PLASZCZYZNY; k++) {
+            niezerowe |= plaszczyzny[k];
+        }
+        while (niezerowe) {
+            size_t b = (size_t)__builtin_ctzll(niezerowe);
+            niezerowe &= niezerowe - 1;
+            uint64_t wartosc = 0;
+            for (size_t k = 0; k < PLASZCZYZNY; k++) {
+                wartosc |= ((plaszczyzny[k] >> b) & 1) << k;
+            }
+            if (64 * j + b < bity) {
+                sumy[64 * j + b] += wartosc;
+            }
+        }
+        memset(plaszczyzny, 0, PLASZCZYZNY * sizeof(uint64_t));
+    }
+}
+
+static void przelej_wszystko(moore_t *a) {
+    struct aktywnosc *akt = a->aktywnosc;
+    size_t slowa_s = ILE_UINT(a->typ->s);
+    przelej(akt->plaszczyzny, akt->sumy, slowa_s, a->typ->s);
+    przelej(akt->plaszczyzny + slowa_s * PLASZCZYZNY, akt->sumy + a->typ->s,
+            ILE_UINT(a->typ->m), a->typ->m);
+    akt->w_liczniku = 0;
+}
+
+int aktywnosc_dla_pamieci(moore_t const *a, blok_pamieci_t f) {
+    struct aktywnosc const *akt = a->aktywnosc;
+    if (!akt) return 0;
+    size_t s = a->typ->s, m = a->typ->m;
+    size_t slowa = (ILE_UINT(s) + ILE_UINT(m)) * PLASZCZYZNY + s + m + ILE_UINT(m);
+    return f(akt, sizeof(*akt)) | f(akt->plaszczyzny, slowa * sizeof(uint64_t));
+}
+
+/** Wlacza (i zeruje) zliczanie przelaczen automatu. */
+int ma_toggle_enable(moore_t *a) {
+    if (!a) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t s = a->typ->s, m = a->typ->m;
+    size_t slowa = ILE_UINT(s) + ILE_UINT(m);
+    if (s > SIZE_MAX / 4 || m > SIZE_MAX / 4) {
+        errno = ENOMEM;
+        return -1;
+    }
+    struct aktywnosc *akt = calloc(1, sizeof(struct aktywnosc));
+    uint64_t *pamiec = calloc(slowa * PLASZCZYZNY + s + m + ILE_UINT(m), sizeof(uint64_t));
+    if (!akt || !pamiec) {
+        free(akt);
+        free(pamiec);
+        errno = ENOMEM;
+        return -1;
+    }
+    akt->plaszczyzny = pamiec;
+    akt->sumy = pamiec + slowa * PLASZCZYZNY;
+    akt->stare_wyjscie = akt->sumy + s + m;
+
+    ma_toggle_disable(a);
+    a->aktywnosc = akt;
+    return 0;
+}
+
+/** Wylacza zliczanie przelaczen i zwalnia liczniki. */
+void ma_toggle_disable(moore_t *a) {
+    if (!a || !a->aktywnosc) return;
+    free(a->aktywnosc->plaszczyzny);
+    free(a->aktywnosc);
+    a->aktywnosc = NULL;
+}
+
+/** Commit stanu i wyjścia z dodaniem przelaczen do licznikow. */
+void aktywnosc_zatwierdz(moore_t *a) {
+    struct aktywnosc *akt = a->aktywnosc;
+    size_t slowa_s = ILE_UINT(a->typ->s), slowa_m = ILE_UINT(a->typ->m);
+    uint64_t *plaszczyzny = akt->plaszczyzny;
+
+    for (size_t j = 0; j < slowa_s; j++, plaszczyzny += PLASZCZYZNY) {
+        uint64_t maska = a->state[j] ^ a->next_state[j];
+        if (j == slowa_s - 1) {
+            maska &= maska_ostatniego(a->typ->s);
+        }
+        dodaj(plaszczyzny, maska);
+        a->state[j] = a->next_state[j];
+    }
+
+    memcpy(akt->stare_wyjscie, a->output, slowa_m * sizeof(uint64_t));
+    zatwierdz_wyjscie(a);
+    for (size_t j = 0; j < slowa_m; j++, plaszczyzny += PLASZCZYZNY) {
+        uint64_t maska = akt->stare_wyjscie[j] ^ a->output[j];
+        if (j == slowa_m - 1) {
+            maska &= maska_ostatniego(a->typ->m);
+        }
+        dodaj(plaszczyzny, maska);
+    }
+
+    akt->cykle++;
+    if (++akt->w_liczniku == MAKS_W_LICZNIKU) {
+        przelej_wszystko(a);
+    }
+}
+
+/** Kopiuje dokladne liczby przelaczen kazdego bitu stanu (s) i wyjścia (m) oraz liczbe cykli. */
+int ma_toggle_export(moore_t *a, uint64_t *state_toggles, uint64_t *output_toggles,
+                     uint64_t *cycles) {
+    if (!a || !a->aktywnosc) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct aktywnosc *akt = a->aktywnosc;
+    przelej_wszystko(a);
+    if (state_toggles) {
+        memcpy(state_toggles, akt->sumy, a->typ->s * sizeof(uint64_t));
+    }
+    if (output_toggles) {
+        memcpy(output_toggles, akt->sumy + a->typ->s, a->typ->m * sizeof(uint64_t));
+    }
+    if (cycles) {
+        *cycles = akt->cykle;
+    }
+    return 0;
+}
+
+/** Oblicza srednie wspolczynniki aktywnosci (przelaczenia na bit na cykl) stanu i wyjścia. */
+int ma_toggle_activity(moore_t *a, double *state_activity, double *output_activity) {
+    if (!a || !a->aktywnosc) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct aktywnosc *akt = a->aktywnosc;
+    przelej_wszystko(a);
+    uint64_t suma_s = 0, suma_m = 0;
+    for (size_t i = 0; i < a->typ->s; i++) {
+        suma_s += akt->sumy[i];
+    }
+    for (size_t i = 0; i < a->typ->m; i++) {
+        suma_m += akt->sumy[a->typ->s + i];
+    }
+    double cykle = akt->cykle ? (double)akt->cykle : 1.0;
+    if (state_activity) {
+        *state_activity = (double)suma_s / ((double)a->typ->s * cykle);
+    }
+    if (output_activity) {
+        *output_activity = (double)suma_m / ((double)a->typ->m * cykle);
+    }
+    return 0;
+}
@@ -0,0 +1,1334 @@
+// Symboliczna osiagalnosc stanow sieci automatow na zredukowanych uporzadkowanych BDD.
+//
+// Pakiet BDD trzyma wezly w jednej tablicy z tablica unikalnosci (kazda funkcja ma
+// jeden wezel) i stratna pamiecia podreczna wynikow operacji. Poczatkowy porzadek zmiennych
+// to automaty w kolejnosci przeszukiwania polaczen, dla kazdego najpierw jego wejścia,
+// potem bity stanu, z kazda zmienna nastepnego stanu tuz za biezaca. Wezly pamietaja numer
+// zmiennej, a jej poziom wynika z permutacji zmieniany przez przesiewanie (Rudell): przy
+// sprzataniu kazda zmienna jest przesuwana zamianami sasiednich poziomow w miejscu tablicy
+// unikalnosci na poziom, na ktorym BDD modelu jest najmniejsze.
+//
+// Funkcje przejścia i wyjścia malych automatow sa wyliczane z callbackow, wieksze
+// opisuje sie rownaniami. Wejścia podlaczone do automatow zbioru sa zastepowane
+// funkcjami wyjśc rodzicow, pozostale sa dowolne. Obraz zbioru stanow liczymy iloczynem
+// relacji kolejnych automatow, kwantyfikujac kazda zmienna zaraz po ostatniej relacji,
+// ktora jej uzywa.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAKS_WYLICZANIA 16 // Maksymalne s + n automatu opisywanego przez wyliczenie
+#define ROZMIAR_PAMIECI (1u << 18) // Liczba wpisow pamieci podrecznej operacji
+#define POCZATKOWE_KUBELKI (1u << 12) // Poczatkowy rozmiar tablicy unikalnosci
+#define PROG_SPRZATANIA (1u << 20) // Liczba zywych wezlow uruchamiajaca sprzatanie
+#define MAKS_ZAMIAN 2000000 // Budzet zamian sasiednich poziomow jednego przesiewania
+#define MAKS_PRZESIEWANYCH 1000 // Liczba najliczniejszych zmiennych przesiewanych
+
+#define FALSZ 0u
+#define PRAWDA 1u
+#define BRAK UINT32_MAX // Bit bez opisu
+#define LISC UINT32_MAX // Zmienna lisci: ponizej wszystkich zmiennych
+
+// Operacje w pamieci podrecznej
+enum { OP_AND = 1, OP_OR, OP_XOR, OP_ITE, OP_EXISTS, OP_AND_EXISTS, OP_PRZEMIANUJ, OP_KOFAKTOR };
+
+// Rodzaje zmiennych
+enum { ZM_WEJSCIE, ZM_BIEZACA, ZM_NASTEPNA };
+
+typedef struct wezel {
+    uint32_t zmienna; // Numer zmiennej; poziom daje bdd_t.poziomy
+    uint32_t niski, wysoki; // Nastepniki dla wartosci 0 i 1
+    uint32_t nastepny; // Kolejny wezel w kubelku lub na liscie wolnych
+} wezel_t;
+
+typedef struct wpis {
+    uint32_t op, f, g, h, wynik;
+} wpis_t;
+
+typedef struct bdd {
+    wezel_t *wezly;
+    size_t ile; // Uzyte pozycje tablicy wezlow (zywe i wolne)
+    size_t pojemnosc;
+    size_t zywe; // Wezly nie lezace na liscie wolnych
+    uint32_t *kubelki; // Glowy list kubelkow tablicy unikalnosci
+    size_t maska_kubelkow;
+    uint32_t wolne; // Lista wolnych wezlow (BRAK: pusta)
+    wpis_t *pamiec; // Pamiec podreczna operacji
+    uint32_t *poziomy; // Poziom kazdej zmiennej w biezacym porzadku
+    uint32_t *kolejnosc; // Zmienna na kazdym poziomie
+    uint32_t ile_zmiennych;
+    bool blad; // Zabraklo pamieci
+} bdd_t;
+
+/** PAKIET BDD **/
+
+static inline uint32_t zmienna(bdd_t const *b, uint32_t f) { return b->wezly[f].zmienna; }
+static inline uint32_t poziom(bdd_t const *b, uint32_t f) {
+    uint32_t v = b->wezly[f].zmienna;
+    return v == LISC ? LISC : b->poziomy[v];
+}
+static inline uint32_t niski(bdd_t const *b, uint32_t f) { return b->wezly[f].niski; }
+static inline uint32_t wysoki(bdd_t const *b, uint32_t f) { return b->wezly[f].wysoki; }
+
+static inline size_t skrot3(uint32_t a, uint32_t b, uint32_t c) {
+    uint64_t h = a * 0x9e3779b97f4a7c15ULL;
+    h ^= (h >> 29) + b * 0xbf58476d1ce4e5b9ULL;
+    h ^= (h >> 31) + c * 0x94d049bb133111ebULL;
+    return (size_t)(h ^ (h >> 32));
+}
+
+static int bdd_inicjuj(bdd_t *b, uint32_t zmienne) {
+    memset(b, 0, sizeof(*b));
+    b->pojemnosc = POCZATKOWE_KUBELKI;
+    b->wezly = malloc(b->pojemnosc * sizeof(wezel_t));
+    b->kubelki = malloc(POCZATKOWE_KUBELKI * sizeof(uint32_t));
+    b->pamiec = calloc(ROZMIAR_PAMIECI, sizeof(wpis_t));
+    b->poziomy = malloc((zmienne + 1) * sizeof(uint32_t));
+    b->kolejnosc = malloc((zmienne + 1) * sizeof(uint32_t));
+    if (!b->wezly || !b->kubelki || !b->pamiec || !b->poziomy || !b->kolejnosc) {
+        free(b->wezly);
+        free(b->kubelki);
+        free(b->pamiec);
+        free(b->poziomy);
+        free(b->kolejnosc);
+        return -1;
+    }
+    b->ile_zmiennych = zmienne;
+    for (uint32_t v = 0; v < zmienne; v++) {
+        b->poziomy[v] = b->kolejnosc[v] = v;
+    }
+    b->maska_kubelkow = POCZATKOWE_KUBELKI - 1;
+    memset(b->kubelki, 0xff, POCZATKOWE_KUBELKI * sizeof(uint32_t));
+    for (uint32_t i = 0; i < 2; i++) {
+        b->wezly[i] = (wezel_t){.zmienna = LISC, .niski = i, .wysoki = i, .nastepny = BRAK};
+    }
+    b->ile = b->zywe = 2;
+    b->wolne = BRAK;
+    return 0;
+}
+
+static void bdd_zwolnij(bdd_t *b) {
+    free(b->wezly);
+    free(b->kubelki);
+    free(b->pamiec);
+    free(b->poziomy);
+    free(b->kolejnosc);
+}
+
+/** Podwaja tablice unikalnosci i rozklada do niej zywe wezly. */
+static void powieksz_kubelki(bdd_t *b) {
+    size_t nowy = 2 * (b->maska_kubelkow + 1);
+    uint32_t *kubelki = malloc(nowy * sizeof(uint32_t));
+    if (!kubelki) return; // Dluzsze listy sa wolniejsze, ale poprawne
+    memset(kubelki, 0xff, nowy * sizeof(uint32_t));
+    for (size_t k = 0; k <= b->maska_kubelkow; k++) {
+        for (uint32_t w = b->kubelki[k]; w != BRAK;) {
+            wezel_t *x = &b->wezly[w];
+            uint32_t nastepny = x->nastepny;
+            size_t h = skrot3(x->zmienna, x->niski, x->wysoki) & (nowy - 1);
+            x->nastepny = kubelki[h];
+            kubelki[h] = w;
+            w = nastepny;
+        }
+    }
+    free(b->kubelki);
+    b->kubelki = kubelki;
+    b->maska_kubelkow = nowy - 1;
+}
+
+/** Zwraca jedyny wezel (v, niski, wysoki), tworzac go w razie potrzeby. */
+static uint32_t mk(bdd_t *b, uint32_t v, uint32_t lo, uint32_t hi) {
+    if (lo == hi || b->blad) return lo;
+    size_t h = skrot3(v, lo, hi) & b->maska_kubelkow;
+    for (uint32_t w = b->kubelki[h]; w != BRAK; w = b->wezly[w].nastepny) {
+        wezel_t const *x = &b->wezly[w];
+        if (x->zmienna == v && x->niski == lo && x->wysoki == hi) return w;
+    }
+    uint32_t w;
+    if (b->wolne != BRAK) {
+        w = b->wolne;
+        b->wolne = b->wezly[w].nastepny;
+    } else {
+        if (b->ile == b->pojemnosc) {
+            wezel_t *wezly = b->pojemnosc < UINT32_MAX / 4
+                                 ? realloc(b->wezly, 2 * b->pojemnosc * sizeof(wezel_t))
+                                 : NULL;
+            if (!wezly) {
+                b->blad = true;
+                return FALSZ;
+            }
+            b->wezly = wezly;
+            b->pojemnosc *= 2;
+        }
+        w = (uint32_t)b->ile++;
+    }
+    b->wezly[w] = (wezel_t){.zmienna = v, .niski = lo, .wysoki = hi, .nastepny = b->kubelki[h]};
+    b->kubelki[h] = w;
+    if (++b->zywe > 2 * (b->maska_kubelkow + 1)) {
+        powieksz_kubelki(b);
+    }
+    return w;
+}
+
+static inline wpis_t *wpis(bdd_t *b, uint32_t op, uint32_t f, uint32_t g, uint32_t h) {
+    return &b->pamiec[(skrot3(f, g, h) + op * 0x5bd1e995u) & (ROZMIAR_PAMIECI - 1)];
+}
+
+static inline bool znajdz(bdd_t *b, uint32_t op, uint32_t f, uint32_t g, uint32_t h,
+                          uint32_t *wynik) {
+    wpis_t const *e = wpis(b, op, f, g, h);
+    if (e->op == op && e->f == f && e->g == g && e->h == h) {
+        *wynik = e->wynik;
+        return true;
+    }
+    return false;
+}
+
+static inline uint32_t zapamietaj(bdd_t *b, uint32_t op, uint32_t f, uint32_t g, uint32_t h,
+                                  uint32_t wynik) {
+    if (!b->blad) {
+        *wpis(b, op, f, g, h) = (wpis_t){op, f, g, h, wynik};
+    }
+    return wynik;
+}
+
+static inline uint32_t bdd_zmienna(bdd_t *b, uint32_t v) { return mk(b, v, FALSZ, PRAWDA); }
+
+static uint32_t bdd_ite(bdd_t *b, uint32_t f, uint32_t g, uint32_t h);
+
+/** Wezel (v, lo, hi) dla dowolnych poziomow lo i hi (przez ite, gdy v nie lezy nad nimi). */
+static uint32_t wezel(bdd_t *b, uint32_t v, uint32_t lo, uint32_t hi) {
+    if (b->poziomy[v] < poziom(b, lo) && b->poziomy[v] < poziom(b, hi)) {
+        return mk(b, v, lo, hi);
+    }
+    return bdd_ite(b, bdd_zmienna(b, v), hi, lo);
+}
+
+/** Zmienna wierzcholka f lub g lezaca wyzej w porzadku. */
+static inline uint32_t wyzsza(bdd_t const *b, uint32_t f, uint32_t g) {
+    return poziom(b, f) <= poziom(b, g) ? zmienna(b, f) : zmienna(b, g);
+}
+
+/** Kofaktory f wzgledem zmiennej v (f nie zalezy od zmiennych powyzej v). */
+static inline void kofaktory(bdd_t const *b, uint32_t f, uint32_t v, uint32_t *f0, uint32_t *f1) {
+    if (zmienna(b, f) == v) {
+        *f0 = niski(b, f);
+        *f1 = wysoki(b, f);
+    } else {
+        *f0 = *f1 = f;
+    }
+}
+
+static inline uint32_t min3(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t m = a < b ? a : b;
+    return m < c ? m : c;
+}
+
+/** AND, OR lub XOR dwoch funkcji. */
+static uint32_t bdd_op(bdd_t *b, uint32_t op, uint32_t f, uint32_t g) {
+    switch (op) {
+    case OP_AND:
+        if (f == FALSZ || g == FALSZ) return FALSZ;
+        if (f == PRAWDA || f == g) return g;
+        if (g == PRAWDA) return f;
+        break;
+    case OP_OR:
+        if (f == PRAWDA || g == PRAWDA) return PRAWDA;
+        if (f == FALSZ || f == g) return g;
+        if (g == FALSZ) return f;
+        break;
+    default:
+        if (f == g) return FALSZ;
+        if (f == FALSZ) return g;
+        if (g == FALSZ) return f;
+        break;
+    }
+    if (f > g) {
+        uint32_t t = f;
+        f = g;
+        g = t;
+    }
+    uint32_t wynik;
+    if (znajdz(b, op, f, g, 0, &wynik)) return wynik;
+    uint32_t v = wyzsza(b, f, g);
+    uint32_t f0, f1, g0, g1;
+    kofaktory(b, f, v, &f0, &f1);
+    kofaktory(b, g, v, &g0, &g1);
+    uint32_t lo = bdd_op(b, op, f0, g0);
+    uint32_t hi = bdd_op(b, op, f1, g1);
+    return zapamietaj(b, op, f, g, 0, mk(b, v, lo, hi));
+}
+
+static inline uint32_t bdd_and(bdd_t *b, uint32_t f, uint32_t g) { return bdd_op(b, OP_AND, f, g); }
+static inline uint32_t bdd_or(bdd_t *b, uint32_t f, uint32_t g) { return bdd_op(b, OP_OR, f, g); }
+static inline uint32_t bdd_xor(bdd_t *b, uint32_t f, uint32_t g) { return bdd_op(b, OP_XOR, f, g); }
+static inline uint32_t bdd_not(bdd_t *b, uint32_t f) { return bdd_op(b, OP_XOR, f, PRAWDA); }
+
+/** if f then g else h. */
+static uint32_t bdd_ite(bdd_t *b, uint32_t f, uint32_t g, uint32_t h) {
+    if (f == PRAWDA) return g;
+    if (f == FALSZ) return h;
+    if (g == h) return g;
+    if (g == PRAWDA && h == FALSZ) return f;
+    uint32_t wynik;
+    if (znajdz(b, OP_ITE, f, g, h, &wynik)) return wynik;
+    uint32_t v = b->kolejnosc[min3(poziom(b, f), poziom(b, g), poziom(b, h))];
+    uint32_t f0, f1, g0, g1, h0, h1;
+    kofaktory(b, f, v, &f0, &f1);
+    kofaktory(b, g, v, &g0, &g1);
+    kofaktory(b, h, v, &h0, &h1);
+    uint32_t lo = bdd_ite(b, f0, g0, h0);
+    uint32_t hi = bdd_ite(b, f1, g1, h1);
+    return zapamietaj(b, OP_ITE, f, g, h, mk(b, v, lo, hi));
+}
+
+/** f z podstawiona wartoscia zmiennej v. */
+static uint32_t bdd_kofaktor(bdd_t *b, uint32_t f, uint32_t v, bool wartosc) {
+    if (poziom(b, f) > b->poziomy[v]) return f;
+    if (zmienna(b, f) == v) return wartosc ? wysoki(b, f) : niski(b, f);
+    uint32_t wynik;
+    if (znajdz(b, OP_KOFAKTOR, f, v, wartosc, &wynik)) return wynik;
+    uint32_t lo = bdd_kofaktor(b, niski(b, f), v, wartosc);
+    uint32_t hi = bdd_kofaktor(b, wysoki(b, f), v, wartosc);
+    return zapamietaj(b, OP_KOFAKTOR, f, v, wartosc, mk(b, zmienna(b, f), lo, hi));
+}
+
+/** Podstawia funkcje g za zmienna v w f. */
+static uint32_t bdd_podstaw(bdd_t *b, uint32_t f, uint32_t v, uint32_t g) {
+    uint32_t f0 = bdd_kofaktor(b, f, v, false), f1 = bdd_kofaktor(b, f, v, true);
+    return bdd_ite(b, g, f1, f0);
+}
+
+/** Kwantyfikacja egzystencjalna f po zmiennych kostki. */
+static uint32_t bdd_exists(bdd_t *b, uint32_t f, uint32_t kostka) {
+    while (kostka != PRAWDA && poziom(b, kostka) < poziom(b, f)) {
+        kostka = wysoki(b, kostka);
+    }
+    if (f <= PRAWDA || kostka == PRAWDA) return f;
+    uint32_t wynik;
+    if (znajdz(b, OP_EXISTS, f, kostka, 0, &wynik)) return wynik;
+    uint32_t v = zmienna(b, f);
+    if (zmienna(b, kostka) == v) {
+        uint32_t reszta = wysoki(b, kostka);
+        uint32_t lo = bdd_exists(b, niski(b, f), reszta);
+        wynik = lo == PRAWDA ? PRAWDA : bdd_or(b, lo, bdd_exists(b, wysoki(b, f), reszta));
+    } else {
+        uint32_t lo = bdd_exists(b, niski(b, f), kostka);
+        uint32_t hi = bdd_exists(b, wysoki(b, f), kostka);
+        wynik = mk(b, v, lo, hi);
+    }
+    return zapamietaj(b, OP_EXISTS, f, kostka, 0, wynik);
+}
+
+/** Iloczyn relacyjny: exists kostka . f & g, bez budowania calego iloczynu. */
+static uint32_t bdd_and_exists(bdd_t *b, uint32_t f, uint32_t g, uint32_t kostka) {
+    if (f == FALSZ || g == FALSZ) return FALSZ;
+    if (f == PRAWDA) return bdd_exists(b, g, kostka);
+    if (g == PRAWDA || f == g) return bdd_exists(b, f, kostka);
+    if (f > g) {
+        uint32_t t = f;
+        f = g;
+        g = t;
+    }
+    uint32_t v = wyzsza(b, f, g);
+    while (kostka != PRAWDA && poziom(b, kostka) < b->poziomy[v]) {
+        kostka = wysoki(b, kostka);
+    }
+    if (kostka == PRAWDA) return bdd_and(b, f, g);
+    uint32_t wynik;
+    if (znajdz(b, OP_AND_EXISTS, f, g, kostka, &wynik)) return wynik;
+    uint32_t f0, f1, g0, g1;
+    kofaktory(b, f, v, &f0, &f1);
+    kofaktory(b, g, v, &g0, &g1);
+    if (zmienna(b, kostka) == v) {
+        uint32_t reszta = wysoki(b, kostka);
+        uint32_t lo = bdd_and_exists(b, f0, g0, reszta);
+        wynik = lo == PRAWDA ? PRAWDA : bdd_or(b, lo, bdd_and_exists(b, f1, g1, reszta));
+    } else {
+        uint32_t lo = bdd_and_exists(b, f0, g0, kostka);
+        uint32_t hi = bdd_and_exists(b, f1, g1, kostka);
+        wynik = mk(b, v, lo, hi);
+    }
+    return zapamietaj(b, OP_AND_EXISTS, f, g, kostka, wynik);
+}
+
+/**
+ * Zamienia zmienne nastepnego stanu na biezace (v -> v - 1) w funkcji wylacznie zmiennych
+ * nastepnego stanu. Dopoki przesiewanie nie rozdzieli par, zamiana zachowuje porzadek.
+ */
+static uint32_t bdd_przemianuj(bdd_t *b, uint32_t f) {
+    if (f <= PRAWDA) return f;
+    uint32_t wynik;
+    if (znajdz(b, OP_PRZEMIANUJ, f, 0, 0, &wynik)) return wynik;
+    uint32_t lo = bdd_przemianuj(b, niski(b, f));
+    uint32_t hi = bdd_przemianuj(b, wysoki(b, f));
+    return zapamietaj(b, OP_PRZEMIANUJ, f, 0, 0, wezel(b, zmienna(b, f) - 1, lo, hi));
+}
+
+/** Koniunkcja zmiennych (kostka); `zmienne` w kolejnosci poziomow. */
+static uint32_t bdd_kostka(bdd_t *b, uint32_t const *zmienne, size_t ile) {
+    uint32_t k = PRAWDA;
+    for (size_t i = ile; i-- > 0;) {
+        k = mk(b, zmienne[i], FALSZ, k);
+    }
+    return k;
+}
+
+/** Buduje funkcje z tablicy prawdy; bit i indeksu (od najstarszego) to zmienne[i]. */
+static uint32_t z_tablicy(bdd_t *b, uint8_t const *tablica, uint32_t const *zmienne,
+                          size_t k) {
+    if (k == 0) return tablica[0] ? PRAWDA : FALSZ;
+    size_t polowa = (size_t)1 << (k - 1);
+    uint32_t lo = z_tablicy(b, tablica, zmienne + 1, k - 1);
+    uint32_t hi = z_tablicy(b, tablica + polowa, zmienne + 1, k - 1);
+    return wezel(b, zmienne[0], lo, hi);
+}
+
+static void oznacz(bdd_t const *b, uint32_t f, uint8_t *znaczniki) {
+    while (f > PRAWDA && !znaczniki[f]) {
+        znaczniki[f] = 1;
+        oznacz(b, niski(b, f), znaczniki);
+        f = wysoki(b, f);
+    }
+}
+
+/** Zwalnia wezly nieosiagalne z korzeni i czysci pamiec podreczna. */
+static int bdd_sprzataj(bdd_t *b, uint32_t const *korzenie, size_t ile) {
+    uint8_t *znaczniki = calloc(b->ile, 1);
+    if (!znaczniki) return -1;
+    for (size_t i = 0; i < ile; i++) {
+        if (korzenie[i] != BRAK) oznacz(b, korzenie[i], znaczniki);
+    }
+    memset(b->kubelki, 0xff, (b->maska_kubelkow + 1) * sizeof(uint32_t));
+    b->wolne = BRAK;
+    b->zywe = 2;
+    for (size_t w = b->ile; w-- > 2;) {
+        wezel_t *x = &b->wezly[w];
+        if (znaczniki[w]) {
+            size_t h = skrot3(x->zmienna, x->niski, x->wysoki) & b->maska_kubelkow;
+            x->nastepny = b->kubelki[h];
+            b->kubelki[h] = (uint32_t)w;
+            b->zywe++;
+        } else {
+            x->zmienna = LISC - 1; // Martwy wezel nie pasuje do zadnego wyszukiwania
+            x->nastepny = b->wolne;
+            b->wolne = (uint32_t)w;
+        }
+    }
+    memset(b->pamiec, 0, ROZMIAR_PAMIECI * sizeof(wpis_t));
+    free(znaczniki);
+    return 0;
+}
+
+/** PRZESTAWIANIE ZMIENNYCH **/
+
+// Stan przesiewania: liczniki odwolan i listy wezlow kazdej zmiennej obok tablicy wezlow
+typedef struct przestawianie {
+    uint32_t *odwolania; // Liczba rodzicow i korzeni kazdego wezla
+    uint32_t *nastepny; // Kolejny wezel tej samej zmiennej
+    uint32_t *glowy; // Pierwszy wezel kazdej zmiennej
+    size_t *ile; // Liczba zywych wezlow kazdej zmiennej
+    size_t pojemnosc; // Rozmiar tablic odwolania i nastepny
+    uint32_t martwe; // Wezly zwolnione w trakcie; wracaja na liste wolnych na koncu
+    size_t zamiany; // Pozostaly budzet zamian
+} przestawianie_t;
+
+/** Zapewnia miejsce na `potrzebne` nowych wezlow, powiekszajac tablice w razie potrzeby. */
+static bool zapewnij_miejsce(bdd_t *b, przestawianie_t *p, size_t potrzebne) {
+    while (b->pojemnosc - b->ile < potrzebne) {
+        wezel_t *wezly = b->pojemnosc < UINT32_MAX / 4
+                             ? realloc(b->wezly, 2 * b->pojemnosc * sizeof(wezel_t))
+                             : NULL;
+        if (!wezly) return false;
+        b->wezly = wezly;
+        b->pojemnosc *= 2;
+    }
+    if (p->pojemnosc < b->pojemnosc) {
+        uint32_t *odwolania = realloc(p->odwolania, b->pojemnosc * sizeof(uint32_t));
+        if (odwolania) p->odwolania = odwolania;
+        uint32_t *nastepny = realloc(p->nastepny, b->pojemnosc * sizeof(uint32_t));
+        if (nastepny) p->nastepny = nastepny;
+        if (!odwolania || !nastepny) return false;
+        memset(p->odwolania + p->pojemnosc, 0,
+               (b->pojemnosc - p->pojemnosc) * sizeof(uint32_t));
+        p->pojemnosc = b->pojemnosc;
+    }
+    return true;
+}
+
+static void usun_z_kubelka(bdd_t *b, uint32_t w) {
+    wezel_t const *x = &b->wezly[w];
+    uint32_t *ogniwo = &b->kubelki[skrot3(x->zmienna, x->niski, x->wysoki) & b->maska_kubelkow];
+    while (*ogniwo != w) ogniwo = &b->wezly[*ogniwo].nastepny;
+    *ogniwo = x->nastepny;
+}
+
+static void wstaw_do_kubelka(bdd_t *b, uint32_t w) {
+    wezel_t *x = &b->wezly[w];
+    size_t h = skrot3(x->zmienna, x->niski, x->wysoki) & b->maska_kubelkow;
+    x->nastepny = b->kubelki[h];
+    b->kubelki[h] = w;
+}
+
+/** Zdejmuje jedno odwolanie do f; wezly bez odwolan umieraja kaskadowo (bez rekurencji). */
+static void zwolnij_odwolanie(bdd_t *b, przestawianie_t *p, uint32_t f) {
+    if (f <= PRAWDA || --p->odwolania[f] > 0) return;
+    usun_z_kubelka(b, f);
+    b->wezly[f].nastepny = BRAK;
+    uint32_t stos = f;
+    while (stos != BRAK) {
+        uint32_t w = stos;
+        wezel_t *x = &b->wezly[w];
+        stos = x->nastepny;
+        uint32_t dzieci[2] = {x->niski, x->wysoki};
+        for (int i = 0; i < 2; i++) {
+            uint32_t c = dzieci[i];
+            if (c > PRAWDA && --p->odwolania[c] == 0) {
+                usun_z_kubelka(b, c);
+                b->wezly[c].nastepny = stos;
+                stos = c;
+            }
+        }
+        p->ile[x->zmienna]--;
+        b->zywe--;
+        x->zmienna = LISC - 1;
+        x->nastepny = p->martwe;
+        p->martwe = w;
+    }
+}
+
+/** Wezel (v, lo, hi) z jednym odwolaniem wiecej; nowy trafia na liste zmiennej v. */
+static uint32_t wezel_przestawiany(bdd_t *b, przestawianie_t *p, uint32_t v, uint32_t lo,
+                                   uint32_t hi) {
+    if (lo == hi) {
+        if (lo > PRAWDA) p->odwolania[lo]++;
+        return lo;
+    }
+    size_t zywe = b->zywe;
+    uint32_t w = mk(b, v, lo, hi);
+    if (b->zywe != zywe) {
+        p->odwolania[w] = 0;
+        p->nastepny[w] = p->glowy[v];
+        p->glowy[v] = w;
+        p->ile[v]++;
+        if (lo > PRAWDA) p->odwolania[lo]++;
+        if (hi > PRAWDA) p->odwolania[hi]++;
+    }
+    p->odwolania[w]++;
+    return w;
+}
+
+/**
+ * Zamienia zmienne poziomow l i l + 1. Wezly x = kolejnosc[l] z dzieckiem y = kolejnosc[l + 1]
+ * staja sie w miejscu wezlami y, wiec odwolania do nich z zewnatrz pozostaja wazne.
+ * Wymaga miejsca na 2 * ile[x] nowych wezlow.
+ */
+static void zamien(bdd_t *b, przestawianie_t *p, uint32_t l) {
+    uint32_t x = b->kolejnosc[l], y = b->kolejnosc[l + 1];
+    uint32_t lista = p->glowy[x];
+    p->glowy[x] = BRAK;
+    while (lista != BRAK) {
+        uint32_t f = lista;
+        lista = p->nastepny[f];
+        if (zmienna(b, f) != x) continue; // Umarl w trakcie przesiewania
+        uint32_t f0 = niski(b, f), f1 = wysoki(b, f);
+        if (zmienna(b, f0) != y && zmienna(b, f1) != y) {
+            p->nastepny[f] = p->glowy[x];
+            p->glowy[x] = f;
+            continue;
+        }
+        uint32_t f00, f01, f10, f11;
+        kofaktory(b, f0, y, &f00, &f01);
+        kofaktory(b, f1, y, &f10, &f11);
+        uint32_t lo = wezel_przestawiany(b, p, x, f00, f10);
+        uint32_t hi = wezel_przestawiany(b, p, x, f01, f11);
+        usun_z_kubelka(b, f);
+        b->wezly[f].zmienna = y;
+        b->wezly[f].niski = lo;
+        b->wezly[f].wysoki = hi;
+        wstaw_do_kubelka(b, f);
+        p->nastepny[f] = p->glowy[y];
+        p->glowy[y] = f;
+        p->ile[x]--;
+        p->ile[y]++;
+        zwolnij_odwolanie(b, p, f0);
+        zwolnij_odwolanie(b, p, f1);
+    }
+    b->kolejnosc[l] = y;
+    b->kolejnosc[l + 1] = x;
+    b->poziomy[x] = l + 1;
+    b->poziomy[y] = l;
+}
+
+/** Przesuwa zmienna v o jeden poziom w dol lub w gore; false, gdy zabraklo pamieci lub budzetu. */
+static bool przesun(bdd_t *b, przestawianie_t *p, uint32_t v, bool w_dol) {
+    uint32_t l = w_dol ? b->poziomy[v] : b->poziomy[v] - 1;
+    if (p->zamiany == 0 || !zapewnij_miejsce(b, p, 2 * p->ile[b->kolejnosc[l]])) {
+        return false;
+    }
+    p->zamiany--;
+    zamien(b, p, l);
+    return true;
+}
+
+/** Przesiewa v ku blizszemu koncowi, potem ku dalszemu, i wraca na najlepszy poziom. */
+static void przesiej(bdd_t *b, przestawianie_t *p, uint32_t v) {
+    uint32_t n = b->ile_zmiennych, najlepszy_poziom = b->poziomy[v];
+    size_t najlepszy = b->zywe;
+    bool w_dol = n - 1 - b->poziomy[v] < b->poziomy[v];
+    for (int etap = 0; etap < 2; etap++, w_dol = !w_dol) {
+        while (w_dol ? b->poziomy[v] + 1 < n : b->poziomy[v] > 0) {
+            if (!przesun(b, p, v, w_dol)) break;
+            if (b->zywe < najlepszy) {
+                najlepszy = b->zywe;
+                najlepszy_poziom = b->poziomy[v];
+            } else if (b->zywe * 5 > najlepszy * 6) {
+                break; // Ponad 1.2 najlepszego rozmiaru
+            }
+        }
+    }
+    while (b->poziomy[v] != najlepszy_poziom) {
+        // Powrot nie zuzywa budzetu; przy braku pamieci zostaje porzadek posredni
+        p->zamiany++;
+        if (!przesun(b, p, v, b->poziomy[v] < najlepszy_poziom)) break;
+    }
+}
+
+typedef struct licznosc {
+    size_t ile;
+    uint32_t zmienna;
+} licznosc_t;
+
+static int porownaj_licznosci(void const *a, void const *b) {
+    licznosc_t const *x = a, *y = b;
+    if (x->ile != y->ile) return x->ile < y->ile ? 1 : -1;
+    return x->zmienna < y->zmienna ? -1 : x->zmienna > y->zmienna;
+}
+
+/**
+ * Sprzata i przesiewa zmienne (od najliczniejszej), zmniejszajac BDD korzeni. Wezly korzeni
+ * pozostaja wazne. Zwraca -1 tylko, gdy zabraklo pamieci na sprzatanie lub przesiewanie.
+ */
+static int bdd_przestaw(bdd_t *b, uint32_t const *korzenie, size_t ile) {
+    if (b->blad || bdd_sprzataj(b, korzenie, ile) != 0) return -1;
+    uint32_t n = b->ile_zmiennych;
+    przestawianie_t p = {
+        .odwolania = calloc(b->pojemnosc, sizeof(uint32_t)),
+        .nastepny = malloc(b->pojemnosc * sizeof(uint32_t)),
+        .glowy = malloc((n + 1) * sizeof(uint32_t)),
+        .ile = calloc(n + 1, sizeof(size_t)),
+        .pojemnosc = b->pojemnosc,
+        .martwe = BRAK,
+        .zamiany = MAKS_ZAMIAN,
+    };
+    licznosc_t *licznosci = malloc((n + 1) * sizeof(licznosc_t));
+    int wynik = -1;
+    if (p.odwolania && p.nastepny && p.glowy && p.ile && licznosci) {
+        memset(p.glowy, 0xff, (n + 1) * sizeof(uint32_t));
+        for (size_t h = 0; h <= b->maska_kubelkow; h++) {
+            for (uint32_t w = b->kubelki[h]; w != BRAK; w = b->wezly[w].nastepny) {
+                wezel_t const *x = &b->wezly[w];
+                p.nastepny[w] = p.glowy[x->zmienna];
+                p.glowy[x->zmienna] = w;
+                p.ile[x->zmienna]++;
+                if (x->niski > PRAWDA) p.odwolania[x->niski]++;
+                if (x->wysoki > PRAWDA) p.odwolania[x->wysoki]++;
+            }
+        }
+        for (size_t i = 0; i < ile; i++) {
+            if (korzenie[i] != BRAK && korzenie[i] > PRAWDA) p.odwolania[korzenie[i]]++;
+        }
+        for (uint32_t v = 0; v < n; v++) licznosci[v] = (licznosc_t){p.ile[v], v};
+        qsort(licznosci, n, sizeof(licznosc_t), porownaj_licznosci);
+        for (uint32_t k = 0; k < n && k < MAKS_PRZESIEWANYCH && licznosci[k].ile > 0; k++) {
+            przesiej(b, &p, licznosci[k].zmienna);
+        }
+        while (p.martwe != BRAK) {
+            uint32_t w = p.martwe;
+            p.martwe = b->wezly[w].nastepny;
+            b->wezly[w].nastepny = b->wolne;
+            b->wolne = w;
+        }
+        memset(b->pamiec, 0, ROZMIAR_PAMIECI * sizeof(wpis_t));
+        wynik = b->blad ? -1 : 0;
+    }
+    free(p.odwolania);
+    free(p.nastepny);
+    free(p.glowy);
+    free(p.ile);
+    free(licznosci);
+    return wynik;
+}
+
+/** SIEC SYMBOLICZNA **/
+
+// Opis jednego automatu zbioru
+typedef struct automat_symboliczny {
+    moore_t *a;
+    size_t n, s, m;
+    uint32_t wejscia; // Pierwsza zmienna wejśc; wejście j to wejscia + j
+    uint32_t stan; // Bit stanu j: zmienna biezaca stan + 2j, nastepna stan + 2j + 1
+    uint32_t *przejscia; // s funkcji nastepnego stanu nad stanem i wejściami automatu
+    uint32_t *wyjscia; // m funkcji wyjścia nad stanem automatu
+    size_t *rodzic; // Indeks rodzica w zbiorze dla kazdego wejścia lub SIZE_MAX
+} automat_symboliczny_t;
+
+struct ma_symbolic {
+    bdd_t bdd;
+    automat_symboliczny_t *automaty;
+    size_t num;
+    uint32_t zmienne; // Liczba zmiennych
+    uint8_t *rodzaj; // ZM_* dla kazdej zmiennej
+    bool skompilowany;
+    uint32_t *relacje; // Relacja przejścia kazdego automatu
+    uint32_t *kostki; // Zmienne kwantyfikowane po relacji i (ostatnie uzycie)
+    uint32_t kostka_wstepna; // Zmienne nieuzywane przez zadna relacje
+    uint32_t poczatkowy; // Stan poczatkowy sieci
+    uint32_t osiagalne; // Zbior osiagalny (gdy policzone)
+    bool policzone;
+    size_t iteracje; // Liczba obrazow policzonych do punktu stalego
+    size_t prog_sprzatania;
+};
+
+static size_t indeks(moore_t *at[], size_t num, moore_t const *a) {
+    for (size_t i = 0; i < num; i++) {
+        if (at[i] == a) return i;
+    }
+    return SIZE_MAX;
+}
+
+void ma_symbolic_destroy(ma_symbolic_t *sym) {
+    if (!sym) return;
+    for (size_t i = 0; sym->automaty && i < sym->num; i++) {
+        free(sym->automaty[i].przejscia);
+        free(sym->automaty[i].wyjscia);
+        free(sym->automaty[i].rodzic);
+    }
+    free(sym->automaty);
+    free(sym->rodzaj);
+    free(sym->relacje);
+    free(sym->kostki);
+    bdd_zwolnij(&sym->bdd);
+    free(sym);
+}
+
+/** Wylicza funkcje przejścia i wyjścia malego automatu i buduje z nich BDD. */
+static int wylicz(ma_symbolic_t *sym, automat_symboliczny_t *as) {
+    bdd_t *b = &sym->bdd;
+    ma_type_t const *typ = as->a->typ;
+    size_t n = as->n, s = as->s, k = n + s, kombinacje = (size_t)1 << k;
+    size_t bity = s > as->m ? s : as->m;
+    uint8_t *tablice = malloc(bity * kombinacje);
+    uint32_t zmienne[MAKS_WYLICZANIA];
+    uint64_t *wyjscie = calloc(ILE_UINT(as->m), sizeof(uint64_t));
+    if (!tablice || !wyjscie) {
+        free(tablice);
+        free(wyjscie);
+        return -1;
+    }
+    // Bit i indeksu (od najstarszego): wejścia 0..n-1, potem bity stanu 0..s-1
+    for (size_t i = 0; i < n; i++) zmienne[i] = as->wejscia + (uint32_t)i;
+    for (size_t j = 0; j < s; j++) zmienne[n + j] = as->stan + 2 * (uint32_t)j;
+    for (size_t c = 0; c < kombinacje; c++) {
+        uint64_t x = 0, q = 0, nastepny;
+        for (size_t i = 0; i < k; i++) {
+            uint64_t bit = (c >> (k - 1 - i)) & 1;
+            if (i < n) x |= bit << i;
+            else q |= bit << (i - n);
+        }
+        nastepny = q;
+        przejscie_typu(typ, &nastepny, &x, &q);
+        for (size_t j = 0; j < s; j++) {
+            tablice[j * kombinacje + c] = (nastepny >> j) & 1;
+        }
+    }
+    for (size_t j = 0; j < s; j++) {
+        as->przejscia[j] = z_tablicy(b, tablice + j * kombinacje, zmienne, k);
+    }
+    // Wyjście zalezy tylko od stanu
+    size_t stany = (size_t)1 << s;
+    for (size_t q = 0; q < stany; q++) {
+        uint64_t stan = q;
+        size_t c = 0;
+        for (size_t j = 0; j < s; j++) c |= ((q >> j) & 1) << (s - 1 - j);
+        if (typ->flagi & MA_TYPE_IDENTITY_OUTPUT) {
+            wyjscie[0] = q;
+        } else {
+            wyjscie_typu(typ, wyjscie, &stan);
+        }
+        for (size_t j = 0; j < as->m; j++) {
+            tablice[j * stany + c] = (wyjscie[j / 64] >> (j % 64)) & 1;
+        }
+    }
+    for (size_t j = 0; j < as->m; j++) {
+        as->wyjscia[j] = z_tablicy(b, tablice + j * stany, zmienne + n, s);
+    }
+    free(tablice);
+    free(wyjscie);
+    return b->blad ? -1 : 0;
+}
+
+/**
+ * Buduje symboliczny model sieci `at`. Automaty o s + n <= 16 sa opisywane przez
+ * wyliczenie t i y (musza byc deterministyczne); wieksze wymagaja rownan
+ * ma_symbolic_equation. Wejścia niepodlaczone do automatow zbioru moga miec dowolna wartosc.
+ */
+ma_symbolic_t *ma_symbolic_create(moore_t *at[], size_t num) {
+    if (!at || num == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t zmienne = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (!at[i] || indeks(at, i, at[i]) != SIZE_MAX || kombinacyjny(at[i])) {
+            errno = EINVAL;
+            return NULL;
+        }
+        if (at[i]->wyrzut) {
+            errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+            return NULL;
+        }
+        zmienne += at[i]->typ->n + 2 * at[i]->typ->s;
+    }
+    if (zmienne >= UINT32_MAX / 2) {
+        errno = EINVAL;
+        return NULL;
+    }
+    ma_symbolic_t *sym = calloc(1, sizeof(ma_symbolic_t));
+    if (!sym) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (bdd_inicjuj(&sym->bdd, (uint32_t)zmienne) != 0) {
+        free(sym);
+        errno = ENOMEM;
+        return NULL;
+    }
+    sym->num = num;
+    sym->zmienne = (uint32_t)zmienne;
+    sym->prog_sprzatania = PROG_SPRZATANIA;
+    sym->automaty = calloc(num, sizeof(automat_symboliczny_t));
+    sym->rodzaj = calloc(zmienne, 1);
+    size_t *kolejnosc = calloc(num, sizeof(size_t));
+    bool *odwiedzony = calloc(num, sizeof(bool));
+    bool brak = !sym->automaty || !sym->rodzaj || !kolejnosc || !odwiedzony;
+
+    // Porzadek automatow: przeszukiwanie wszerz po polaczeniach w obie strony,
+    // wiec automaty wymieniajace bity dostaja sasiednie zmienne
+    size_t ile = 0;
+    for (size_t start = 0; !brak && start < num; start++) {
+        if (odwiedzony[start]) continue;
+        odwiedzony[start] = true;
+        kolejnosc[ile++] = start;
+        for (size_t glowa = ile - 1; glowa < ile; glowa++) {
+            moore_t *a = at[kolejnosc[glowa]];
+            for (size_t j = 0; j < a->typ->n; j++) {
+                size_t r = indeks(at, num, a->podlaczenia_do_a[j].a_z_kad);
+                if (r != SIZE_MAX && !odwiedzony[r]) {
+                    odwiedzony[r] = true;
+                    kolejnosc[ile++] = r;
+                }
+            }
+            for (list_ma *d = a->dzieci->nxt; d; d = d->nxt) {
+                size_t r = indeks(at, num, d->automat_moore);
+                if (r != SIZE_MAX && !odwiedzony[r]) {
+                    odwiedzony[r] = true;
+                    kolejnosc[ile++] = r;
+                }
+            }
+        }
+    }
+
+    uint32_t v = 0;
+    for (size_t k = 0; !brak && k < num; k++) {
+        size_t i = kolejnosc[k];
+        automat_symboliczny_t *as = &sym->automaty[i];
+        moore_t *a = at[i];
+        as->a = a;
+        as->n = a->typ->n;
+        as->s = a->typ->s;
+        as->m = a->typ->m;
+        as->wejscia = v;
+        for (size_t j = 0; j < as->n; j++) sym->rodzaj[v++] = ZM_WEJSCIE;
+        as->stan = v;
+        for (size_t j = 0; j < as->s; j++) {
+            sym->rodzaj[v++] = ZM_BIEZACA;
+            sym->rodzaj[v++] = ZM_NASTEPNA;
+        }
+        as->przejscia = malloc(as->s * sizeof(uint32_t));
+        as->wyjscia = malloc(as->m * sizeof(uint32_t));
+        as->rodzic = malloc((as->n ? as->n : 1) * sizeof(size_t));
+        brak = !as->przejscia || !as->wyjscia || !as->rodzic;
+    }
+    for (size_t i = 0; !brak && i < num; i++) {
+        automat_symboliczny_t *as = &sym->automaty[i];
+        for (size_t j = 0; j < as->n; j++) {
+            as->rodzic[j] = indeks(at, num, as->a->podlaczenia_do_a[j].a_z_kad);
+        }
+        memset(as->przejscia, 0xff, as->s * sizeof(uint32_t));
+        memset(as->wyjscia, 0xff, as->m * sizeof(uint32_t));
+        if (as->n + as->s <= MAKS_WYLICZANIA) {
+            brak = wylicz(sym, as) != 0;
+        } else if (as->a->typ->flagi & MA_TYPE_IDENTITY_OUTPUT) {
+            for (size_t j = 0; j < as->m; j++) {
+                as->wyjscia[j] = bdd_zmienna(&sym->bdd, as->stan + 2 * (uint32_t)j);
+            }
+        }
+    }
+    free(kolejnosc);
+    free(odwiedzony);
+    if (brak || sym->bdd.blad) {
+        ma_symbolic_destroy(sym);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return sym;
+}
+
+/** ROWNANIA **/
+
+typedef struct parser {
+    char const *p;
+    ma_symbolic_t *sym;
+    automat_symboliczny_t const *as;
+    bool wyjscie; // Rownanie wyjścia: bez zmiennych wejśc
+    bool blad;
+} parser_t;
+
+static uint32_t parsuj_lub(parser_t *ps);
+
+static void spacje(parser_t *ps) {
+    while (*ps->p == ' ' || *ps->p == '\t') ps->p++;
+}
+
+static uint32_t parsuj_atom(parser_t *ps) {
+    bdd_t *b = &ps->sym->bdd;
+    spacje(ps);
+    char c = *ps->p;
+    if (c == '!') {
+        ps->p++;
+        return bdd_not(b, parsuj_atom(ps));
+    }
+    if (c == '(') {
+        ps->p++;
+        uint32_t f = parsuj_lub(ps);
+        spacje(ps);
+        if (*ps->p != ')') ps->blad = true;
+        else ps->p++;
+        return f;
+    }
+    if (c == '0' || c == '1') {
+        ps->p++;
+        return c == '1' ? PRAWDA : FALSZ;
+    }
+    if ((c == 's' || c == 'i') && ps->p[1] >= '0' && ps->p[1] <= '9') {
+        char *koniec;
+        unsigned long bit = strtoul(ps->p + 1, &koniec, 10);
+        ps->p = koniec;
+        if (c == 's' && bit < ps->as->s) {
+            return bdd_zmienna(b, ps->as->stan + 2 * (uint32_t)bit);
+        }
+        if (c == 'i' && bit < ps->as->n && !ps->wyjscie) {
+            return bdd_zmienna(b, ps->as->wejscia + (uint32_t)bit);
+        }
+    }
+    ps->blad = true;
+    return FALSZ;
+}
+
+static uint32_t parsuj_i(parser_t *ps) {
+    uint32_t f = parsuj_atom(ps);
+    for (spacje(ps); *ps->p == '&' && !ps->blad; spacje(ps)) {
+        ps->p++;
+        f = bdd_and(&ps->sym->bdd, f, parsuj_atom(ps));
+    }
+    return f;
+}
+
+static uint32_t parsuj_xor(parser_t *ps) {
+    uint32_t f = parsuj_i(ps);
+    for (spacje(ps); *ps->p == '^' && !ps->blad; spacje(ps)) {
+        ps->p++;
+        f = bdd_xor(&ps->sym->bdd, f, parsuj_i(ps));
+    }
+    return f;
+}
+
+static uint32_t parsuj_lub(parser_t *ps) {
+    uint32_t f = parsuj_xor(ps);
+    for (spacje(ps); *ps->p == '|' && !ps->blad; spacje(ps)) {
+        ps->p++;
+        f = bdd_or(&ps->sym->bdd, f, parsuj_xor(ps));
+    }
+    return f;
+}
+
+/**
+ * Opisuje bit `bit` nastepnego stanu (MA_SYMBOLIC_NEXT) lub wyjścia (MA_SYMBOLIC_OUTPUT)
+ * automatu at[automaton] wyrazeniem nad jego bitami stanu sK i wejśc iK z operatorami
+ * ! & ^ | (od najsilniejszego), nawiasami i stalymi 0, 1.
+ */
+int ma_symbolic_equation(ma_symbolic_t *sym, size_t automaton, int kind, size_t bit,
+                         char const *expr) {
+    if (!sym || automaton >= sym->num || !expr ||
+        (kind != MA_SYMBOLIC_NEXT && kind != MA_SYMBOLIC_OUTPUT)) {
+        errno = EINVAL;
+        return -1;
+    }
+    automat_symboliczny_t *as = &sym->automaty[automaton];
+    if (bit >= (kind == MA_SYMBOLIC_NEXT ? as->s : as->m)) {
+        errno = EINVAL;
+        return -1;
+    }
+    parser_t ps = {.p = expr, .sym = sym, .as = as, .wyjscie = kind == MA_SYMBOLIC_OUTPUT};
+    uint32_t f = parsuj_lub(&ps);
+    spacje(&ps);
+    if (ps.blad || *ps.p != '\0') {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sym->bdd.blad) {
+        errno = ENOMEM;
+        return -1;
+    }
+    (kind == MA_SYMBOLIC_NEXT ? as->przejscia : as->wyjscia)[bit] = f;
+    sym->skompilowany = false;
+    sym->policzone = false;
+    return 0;
+}
+
+/** OSIAGALNOSC **/
+
+/** Dopisuje zmienne funkcji f do znacznikow (ostatnie uzycie = relacja r). */
+static void zaznacz_nosnik(bdd_t const *b, uint32_t f, uint8_t *odwiedzone, size_t *ostatnie,
+                           size_t r) {
+    while (f > PRAWDA && !odwiedzone[f]) {
+        odwiedzone[f] = 1;
+        ostatnie[zmienna(b, f)] = r;
+        zaznacz_nosnik(b, niski(b, f), odwiedzone, ostatnie, r);
+        f = wysoki(b, f);
+    }
+}
+
+/** Buduje relacje przejścia automatow, harmonogram kwantyfikacji i stan poczatkowy. */
+static int kompiluj(ma_symbolic_t *sym) {
+    bdd_t *b = &sym->bdd;
+    size_t num = sym->num;
+    free(sym->relacje);
+    free(sym->kostki);
+    sym->relacje = calloc(num, sizeof(uint32_t));
+    sym->kostki = calloc(num, sizeof(uint32_t));
+    size_t *ostatnie = malloc((sym->zmienne + num) * sizeof(size_t));
+    uint32_t *lista = malloc((sym->zmienne + 1) * sizeof(uint32_t));
+    if (!sym->relacje || !sym->kostki || !ostatnie || !lista) {
+        free(ostatnie);
+        free(lista);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // Relacje w kolejnosci poziomow: automat o wyzszym pierwszym bicie stanu najpierw
+    size_t *porzadek = ostatnie + sym->zmienne;
+    for (size_t i = 0; i < num; i++) porzadek[i] = i;
+    for (size_t i = 1; i < num; i++) {
+        for (size_t j = i; j > 0 && b->poziomy[sym->automaty[porzadek[j]].stan] <
+                                        b->poziomy[sym->automaty[porzadek[j - 1]].stan]; j--) {
+            size_t t = porzadek[j];
+            porzadek[j] = porzadek[j - 1];
+            porzadek[j - 1] = t;
+        }
+    }
+    for (size_t k = 0; k < num; k++) {
+        automat_symboliczny_t const *as = &sym->automaty[porzadek[k]];
+        uint32_t relacja = PRAWDA;
+        for (size_t j = 0; j < as->s; j++) {
+            uint32_t f = as->przejscia[j];
+            if (f == BRAK) {
+                free(ostatnie);
+                free(lista);
+                errno = EINVAL; // Automat bez opisu przejścia
+                return -1;
+            }
+            // Wejścia od rodzicow zastepujemy ich funkcjami wyjśc
+            for (size_t i = 0; i < as->n; i++) {
+                size_t r = as->rodzic[i];
+                if (r == SIZE_MAX) continue;
+                uint32_t g = sym->automaty[r].wyjscia[as->a->podlaczenia_do_a[i].bit_biore];
+                if (g == BRAK) {
+                    free(ostatnie);
+                    free(lista);
+                    errno = EINVAL; // Rodzic bez opisu wyjścia
+                    return -1;
+                }
+                f = bdd_podstaw(b, f, as->wejscia + (uint32_t)i, g);
+            }
+            uint32_t nastepna = bdd_zmienna(b, as->stan + 2 * (uint32_t)j + 1);
+            relacja = bdd_and(b, relacja, bdd_not(b, bdd_xor(b, nastepna, f)));
+        }
+        sym->relacje[k] = relacja;
+    }
+
+    // Ostatnia relacja uzywajaca kazdej zmiennej biezacej i wejścia
+    uint8_t *odwiedzone = calloc(b->ile, 1);
+    if (!odwiedzone) {
+        free(ostatnie);
+        free(lista);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (uint32_t v = 0; v < sym->zmienne; v++) ostatnie[v] = SIZE_MAX;
+    for (size_t k = 0; k < num; k++) {
+        memset(odwiedzone, 0, b->ile);
+        zaznacz_nosnik(b, sym->relacje[k], odwiedzone, ostatnie, k);
+    }
+    free(odwiedzone);
+    for (size_t k = 0; k <= num; k++) {
+        size_t ile = 0;
+        for (uint32_t l = 0; l < sym->zmienne; l++) {
+            uint32_t v = b->kolejnosc[l];
+            if (sym->rodzaj[v] != ZM_NASTEPNA && ostatnie[v] == (k == num ? SIZE_MAX : k)) {
+                lista[ile++] = v;
+            }
+        }
+        uint32_t kostka = bdd_kostka(b, lista, ile);
+        if (k == num) sym->kostka_wstepna = kostka;
+        else sym->kostki[k] = kostka;
+    }
+
+    // Stan poczatkowy z biezacych stanow automatow
+    for (size_t i = 0; i < sym->num; i++) {
+        if (sym->automaty[i].a->wyrzut) {
+            free(ostatnie);
+            free(lista);
+            errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+            return -1;
+        }
+    }
+    uint32_t poczatkowy = PRAWDA;
+    for (size_t i = sym->num; i-- > 0;) {
+        automat_symboliczny_t const *as = &sym->automaty[i];
+        for (size_t j = as->s; j-- > 0;) {
+            uint32_t x = bdd_zmienna(b, as->stan + 2 * (uint32_t)j);
+            bool jeden = (as->a->state[j / 64] >> (j % 64)) & 1;
+            poczatkowy = bdd_and(b, poczatkowy, jeden ? x : bdd_not(b, x));
+        }
+    }
+    sym->poczatkowy = poczatkowy;
+    free(ostatnie);
+    free(lista);
+    if (b->blad) {
+        errno = ENOMEM;
+        return -1;
+    }
+    sym->skompilowany = true;
+    return 0;
+}
+
+/** Obraz zbioru stanow przez jeden krok sieci. */
+static uint32_t obraz(ma_symbolic_t *sym, uint32_t zbior) {
+    bdd_t *b = &sym->bdd;
+    uint32_t acc = bdd_exists(b, zbior, sym->kostka_wstepna);
+    for (size_t k = 0; k < sym->num; k++) {
+        acc = bdd_and_exists(b, acc, sym->relacje[k], sym->kostki[k]);
+    }
+    return bdd_przemianuj(b, acc);
+}
+
+/** Funkcje modelu i `dodatkowe` jako korzenie (BRAK tam, gdzie funkcji nie ma). */
+static uint32_t *korzenie_modelu(ma_symbolic_t const *sym, uint32_t const *dodatkowe,
+                                 size_t ile_dodatkowych, size_t *ile) {
+    size_t rozmiar = ile_dodatkowych + 2 * sym->num + 3;
+    for (size_t i = 0; i < sym->num; i++) {
+        rozmiar += sym->automaty[i].s + sym->automaty[i].m;
+    }
+    uint32_t *korzenie = malloc(rozmiar * sizeof(uint32_t));
+    if (!korzenie) return NULL;
+    size_t k = 0;
+    for (size_t i = 0; i < ile_dodatkowych; i++) korzenie[k++] = dodatkowe[i];
+    for (size_t i = 0; i < sym->num; i++) {
+        automat_symboliczny_t const *as = &sym->automaty[i];
+        for (size_t j = 0; j < as->s; j++) korzenie[k++] = as->przejscia[j];
+        for (size_t j = 0; j < as->m; j++) korzenie[k++] = as->wyjscia[j];
+        korzenie[k++] = sym->skompilowany ? sym->relacje[i] : BRAK;
+        korzenie[k++] = sym->skompilowany ? sym->kostki[i] : BRAK;
+    }
+    korzenie[k++] = sym->skompilowany ? sym->kostka_wstepna : BRAK;
+    korzenie[k++] = sym->skompilowany ? sym->poczatkowy : BRAK;
+    korzenie[k++] = sym->policzone ? sym->osiagalne : BRAK;
+    *ile = k;
+    return korzenie;
+}
+
+/**
+ * Sprzata po przekroczeniu progu. Gdy po sprzataniu zostaje ponad polowa progu, przesiewa
+ * zmienne; dopiero jesli i to nie pomoze, prog rosnie.
+ */
+static int sprzataj(ma_symbolic_t *sym, uint32_t const *dodatkowe, size_t ile_dodatkowych) {
+    bdd_t *b = &sym->bdd;
+    if (b->zywe < sym->prog_sprzatania) return 0;
+    size_t ile;
+    uint32_t *korzenie = korzenie_modelu(sym, dodatkowe, ile_dodatkowych, &ile);
+    if (!korzenie) return -1;
+    int wynik = bdd_sprzataj(b, korzenie, ile);
+    if (wynik == 0 && b->zywe * 2 > sym->prog_sprzatania) {
+        bdd_przestaw(b, korzenie, ile); // Bez pamieci na przesiewanie zostaje stary porzadek
+    }
+    free(korzenie);
+    if (b->zywe * 2 > sym->prog_sprzatania) {
+        sym->prog_sprzatania = b->zywe * 2;
+    }
+    return wynik;
+}
+
+/** Sprzata i przesiewa zmienne modelu; wyniki i policzony zbior osiagalny pozostaja wazne. */
+int ma_symbolic_reorder(ma_symbolic_t *sym) {
+    if (!sym) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t ile;
+    uint32_t *korzenie = korzenie_modelu(sym, NULL, 0, &ile);
+    if (!korzenie || bdd_przestaw(&sym->bdd, korzenie, ile) != 0) {
+        free(korzenie);
+        errno = ENOMEM;
+        return -1;
+    }
+    free(korzenie);
+    return 0;
+}
+
+/** Liczba wezlow BDD osiagalnych z funkcji modelu (bez wezlow martwych i roboczych). */
+size_t ma_symbolic_nodes(ma_symbolic_t const *sym) {
+    if (!sym) {
+        errno = EINVAL;
+        return 0;
+    }
+    bdd_t const *b = &sym->bdd;
+    size_t ile, wynik = 0;
+    uint32_t *korzenie = korzenie_modelu(sym, NULL, 0, &ile);
+    uint8_t *znaczniki = calloc(b->ile, 1);
+    if (korzenie && znaczniki) {
+        for (size_t i = 0; i < ile; i++) {
+            if (korzenie[i] != BRAK) oznacz(b, korzenie[i], znaczniki);
+        }
+        for (size_t w = 2; w < b->ile; w++) wynik += znaczniki[w];
+    } else {
+        errno = ENOMEM;
+    }
+    free(korzenie);
+    free(znaczniki);
+    return wynik;
+}
+
+/**
+ * Iteruje obrazy od stanu poczatkowego do punktu stalego. Jesli `cel` nie jest BRAK,
+ * konczy, gdy tylko osiagniety zbior przetnie `cel`, i zwraca 1.
+ */
+static int osiagnij(ma_symbolic_t *sym, uint32_t cel) {
+    bdd_t *b = &sym->bdd;
+    if (!sym->skompilowany && kompiluj(sym) != 0) {
+        return -1;
+    }
+    if (sym->policzone) {
+        return cel != BRAK && bdd_and(b, sym->osiagalne, cel) != FALSZ;
+    }
+    uint32_t osiagalne = sym->poczatkowy, front = sym->poczatkowy;
+    size_t iteracje = 0;
+    while (front != FALSZ) {
+        if (cel != BRAK && bdd_and(b, front, cel) != FALSZ) {
+            return b->blad ? (errno = ENOMEM, -1) : 1;
+        }
+        uint32_t nowe = bdd_and(b, obraz(sym, front), bdd_not(b, osiagalne));
+        osiagalne = bdd_or(b, osiagalne, nowe);
+        front = nowe;
+        iteracje++;
+        uint32_t robocze[3] = {osiagalne, front, cel};
+        if (b->blad || sprzataj(sym, robocze, 3) != 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    sym->osiagalne = osiagalne;
+    sym->iteracje = iteracje;
+    sym->policzone = true;
+    return 0;
+}
+
+/** Czy bit `bit` wyjścia automatu at[automaton] moze byc kiedykolwiek ustawiony: 1, 0 lub -1. */
+int ma_symbolic_output_reachable(ma_symbolic_t *sym, size_t automaton, size_t bit) {
+    if (!sym || automaton >= sym->num || bit >= sym->automaty[automaton].m) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint32_t cel = sym->automaty[automaton].wyjscia[bit];
+    if (cel == BRAK) {
+        errno = EINVAL;
+        return -1;
+    }
+    return osiagnij(sym, cel);
+}
+
+static double potega2(uint32_t k) {
+    double wynik = 1;
+    while (k--) wynik *= 2;
+    return wynik;
+}
+
+/** Liczba przypisan zmiennych biezacych od poziomu f w dol; `powyzej` indeksowane poziomem. */
+static double zlicz(ma_symbolic_t const *sym, uint32_t f, double *liczby, uint32_t const *powyzej) {
+    bdd_t const *b = &sym->bdd;
+    if (f == FALSZ) return 0;
+    if (f == PRAWDA) return 1;
+    if (liczby[f] >= 0) return liczby[f];
+    uint32_t l = poziom(b, f), lo = niski(b, f), hi = wysoki(b, f);
+    // Zmienne biezace pominiete miedzy wezlem a dzieckiem sa dowolne
+    uint32_t poziom_lo = lo <= PRAWDA ? sym->zmienne : poziom(b, lo);
+    uint32_t poziom_hi = hi <= PRAWDA ? sym->zmienne : poziom(b, hi);
+    double wynik = zlicz(sym, lo, liczby, powyzej) *
+                       potega2(powyzej[poziom_lo] - powyzej[l + 1]) +
+                   zlicz(sym, hi, liczby, powyzej) *
+                       potega2(powyzej[poziom_hi] - powyzej[l + 1]);
+    liczby[f] = wynik;
+    return wynik;
+}
+
+/** Liczy caly zbior osiagalny; zwraca liczbe stanow sieci i liczbe iteracji obrazu. */
+int ma_symbolic_reach(ma_symbolic_t *sym, double *states, size_t *iterations) {
+    if (!sym) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (osiagnij(sym, BRAK) != 0) {
+        return -1;
+    }
+    if (iterations) {
+        *iterations = sym->iteracje;
+    }
+    if (states) {
+        bdd_t const *b = &sym->bdd;
+        double *liczby = malloc(b->ile * sizeof(double));
+        uint32_t *powyzej = malloc((sym->zmienne + 1) * sizeof(uint32_t));
+        if (!liczby || !powyzej) {
+            free(liczby);
+            free(powyzej);
+            errno = ENOMEM;
+            return -1;
+        }
+        // powyzej[l]: liczba zmiennych biezacych na poziomach mniejszych niz l
+        powyzej[0] = 0;
+        for (uint32_t l = 0; l < sym->zmienne; l++) {
+            powyzej[l + 1] = powyzej[l] + (sym->rodzaj[b->kolejnosc[l]] == ZM_BIEZACA);
+        }
+        for (size_t i = 0; i < b->ile; i++) liczby[i] = -1;
+        uint32_t f = sym->osiagalne;
+        uint32_t l = f <= PRAWDA ? sym->zmienne : poziom(b, f);
+        *states = zlicz(sym, f, liczby, powyzej) * potega2(powyzej[l]);
+        free(liczby);
+        free(powyzej);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Przepustowość kroku dla poszczególnych klas rozmiaru automatów.
+//
+// Użycie: ma_bench [automaty] [kroki]
+//
+// Dla każdej szerokości budujemy łańcuch automatów o n = m = s bitach i mierzymy średni
+// czas kroku na automat w dwóch okablowaniach: wejście to całe wyjście poprzednika
+// (wyrównane słowa, czytane wprost z jego wyjścia) albo to wyjście obrócone o jeden bit
+// (połączenia niewyrównane, więc każdy bit jest przepisywany osobno). Szerokości 64, 128
+// i 256 bitów trafiają do wyspecjalizowanych jąder, 192 i 512 do ścieżki ogólnej.
+
+#include "ma.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static void t_mix(uint64_t *next_state, uint64_t const *input, uint64_t const *state,
+                  size_t n, size_t s) {
+  (void)n;
+  for (size_t k = 0; k < (s + 63) / 64; ++k)
+    next_state[k] = (state[k] << 1 | state[k] >> 63) ^ input[k];
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** Łączy wejście `a` z wyjściem `b`: wprost albo obrócone o bit (niewyrównane). */
+static int wire(moore_t *a, moore_t *b, size_t bits, bool rotated) {
+  if (!rotated)
+    return ma_connect(a, 0, b, 0, bits);
+  if (ma_connect(a, 0, b, 1, bits - 1) != 0)
+    return -1;
+  return ma_connect(a, bits - 1, b, 0, 1);
+}
+
+/** Zwraca ns na krok automatu albo ujemną wartość przy błędzie. */
+static double bench(size_t bits, size_t num, size_t cycles, bool rotated) {
+  moore_t **at = calloc(num, sizeof(moore_t *));
+  uint64_t seed[8] = {0x9e3779b97f4a7c15ULL, 1, 2, 3, 4, 5, 6, 7};
+  double result = -1;
+  if (!at)
+    return result;
+  size_t i = 0;
+  for (; i < num; ++i) {
+    at[i] = ma_create_simple(bits, bits, t_mix);
+    if (!at[i] || (i == 0 ? ma_set_input(at[i], seed) : wire(at[i], at[i - 1], bits, rotated)))
+      break;
+  }
+  if (i == num) {
+    // Rozgrzewka
+    for (size_t c = 0; c < cycles / 10 + 1; ++c)
+      ma_step(at, num);
+    double start = now_ns();
+    size_t c = 0;
+    for (; c < cycles && ma_step(at, num) == 0; ++c)
+      ;
+    if (c == cycles)
+      result = (now_ns() - start) / ((double)cycles * num);
+  }
+  for (size_t k = 0; k < num; ++k)
+    ma_delete(at[k]);
+  free(at);
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 3) {
+    fprintf(stderr, "Użycie:\n%s [automaty] [kroki]\n", argv[0]);
+    return 2;
+  }
+  size_t num = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000;
+  size_t cycles = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000;
+  if (num == 0 || cycles == 0) {
+    fprintf(stderr, "Liczba automatów i kroków musi być dodatnia\n");
+    return 2;
+  }
+
+  static const struct {
+    size_t bits;
+    char const *name;
+  } cases[] = {
+    {64, "klasa 1"}, {128, "klasa 2"}, {256, "klasa 4"}, {192, "ogólna"}, {512, "ogólna"},
+  };
+  printf("%zu automatów, %zu kroków; ns/automat (ns/bit)\n", num, cycles);
+  printf("%-20s %22s %22s\n", "", "słowa poprzednika", "obrót o bit");
+  for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); ++k) {
+    double ns[2];
+    for (int rotated = 0; rotated < 2; ++rotated) {
+      ns[rotated] = bench(cases[k].bits, num, cycles, rotated);
+      if (ns[rotated] < 0) {
+        perror("bench");
+        return 1;
+      }
+    }
+    printf("%4zu bitów  %-8s %12.1f (%7.3f) %12.1f (%7.3f)\n", cases[k].bits, cases[k].name,
+           ns[0], ns[0] / cases[k].bits, ns[1], ns[1] / cases[k].bits);
+  }
+  return 0;
+}
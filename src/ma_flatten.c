@@ -0,0 +1,207 @@
+// Splaszczanie malej grupy polaczonych automatow w jeden automat tablicowy.
+//
+// Stan automatu produktowego to sklejone stany czlonkow grupy, a jego wejścia to
+// te bity wejśc czlonkow, ktore nie pochodza od innych czlonkow. Dla kazdej pary
+// (stan laczny, wejście zewnetrzne) wyliczamy krok calej grupy, wiec krok grupy to
+// potem jeden odczyt tablicy. Wyjście produktu to sklejone wyjścia czlonkow.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAKS_BITOW 20 // Maksymalna laczna szerokosc stanu i wejśc zewnetrznych
+
+// Czlonek splaszczanej grupy
+typedef struct czlonek {
+    moore_t *a;
+    size_t przes_stanu; // Pozycja stanu w stanie lacznym
+    size_t przes_wyjscia; // Pozycja wyjścia w wyjściu produktu
+    uint64_t *wejscie; // Bufor wejścia (ILE_UINT(n) slow)
+    uint64_t stan, nastepny, wyjscie; // s <= 20, m <= 64
+} czlonek_t;
+
+// Zrodlo jednego bitu wejścia czlonka
+typedef struct bit_wejscia {
+    size_t czlonek, bit; // Bit `bit` wejścia czlonka `czlonek`
+    size_t zrodlo; // Indeks czlonka-zrodla lub SIZE_MAX dla wejścia zewnetrznego
+    size_t bit_zrodla; // Bit wyjścia zrodla albo numer wejścia zewnetrznego
+} bit_wejscia_t;
+
+static size_t indeks_w_grupie(moore_t *at[], size_t num, moore_t const *a) {
+    for (size_t i = 0; i < num; i++) {
+        if (at[i] == a) return i;
+    }
+    return SIZE_MAX;
+}
+
+/** Liczy krok grupy z biezacych stanow czlonkow dla wejścia zewnetrznego x. */
+static int krok_grupy(czlonek_t *cz, size_t num, bit_wejscia_t const *bity, size_t ile_bitow,
+                      uint64_t x, uint64_t *laczny) {
+    for (size_t k = 0; k < ile_bitow; k++) {
+        bit_wejscia_t const *b = &bity[k];
+        uint64_t v = b->zrodlo == SIZE_MAX ? x >> b->bit_zrodla
+                                            : cz[b->zrodlo].wyjscie >> b->bit_zrodla;
+        uint64_t maska = 1ULL << (b->bit % 64);
+        if (v & 1) {
+            cz[b->czlonek].wejscie[b->bit / 64] |= maska;
+        } else {
+            cz[b->czlonek].wejscie[b->bit / 64] &= ~maska;
+        }
+    }
+    *laczny = 0;
+    for (size_t i = 0; i < num; i++) {
+        ma_type_t const *typ = cz[i].a->typ;
+        cz[i].nastepny = cz[i].stan;
+        przejscie_typu(typ, &cz[i].nastepny, cz[i].wejscie, &cz[i].stan);
+        if (cz[i].nastepny >> typ->s) {
+            return -1; // Nastepnik nie miesci sie w s bitach
+        }
+        *laczny |= cz[i].nastepny << cz[i].przes_stanu;
+    }
+    return 0;
+}
+
+static void zwolnij_czlonkow(czlonek_t *cz, size_t num) {
+    if (!cz) return;
+    for (size_t i = 0; i < num; i++) {
+        free(cz[i].wejscie);
+    }
+    free(cz);
+}
+
+/**
+ * Zastepuje grupe automatow jednym automatem tablicowym o tym samym zachowaniu. Wejścia
+ * produktu sa podlaczane do tych samych zrodel spoza grupy, a pozostale dostaja biezace
+ * wartosci wejśc czlonkow. Wyjście at[i] zajmuje bity od output_offsets[i] wyjścia
+ * produktu. Funkcje t i y czlonkow musza byc deterministyczne. Bufory czlonkow zostaja
+ * nietkniete; tablice wyliczamy na prywatnych kopiach ich wejśc.
+ */
+moore_t *ma_flatten(moore_t *at[], size_t num, size_t *output_offsets) {
+    if (!at || num == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t S = 0, M = 0, E = 0, ile_bitow = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (at[i] && at[i]->wyrzut) {
+            errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+            return NULL;
+        }
+        if (!at[i] || indeks_w_grupie(at, i, at[i]) != SIZE_MAX || kombinacyjny(at[i]) ||
+            at[i]->typ->s > MAKS_BITOW || at[i]->typ->m > 64 || at[i]->state[0] >> at[i]->typ->s) {
+            errno = EINVAL;
+            return NULL;
+        }
+        S += at[i]->typ->s;
+        M += at[i]->typ->m;
+        ile_bitow += at[i]->typ->n;
+        for (size_t j = 0; j < at[i]->typ->n; j++) {
+            if (indeks_w_grupie(at, num, at[i]->podlaczenia_do_a[j].a_z_kad) == SIZE_MAX) {
+                E++;
+            }
+        }
+    }
+    if (S > MAKS_BITOW || E > MAKS_BITOW - S || M > 64) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    czlonek_t *cz = calloc(num, sizeof(czlonek_t));
+    bit_wejscia_t *bity = calloc(ile_bitow ? ile_bitow : 1, sizeof(bit_wejscia_t));
+    size_t stany = (size_t)1 << S, wiersz = (size_t)1 << E;
+    uint32_t *przejscia = malloc(stany * wiersz * sizeof(uint32_t));
+    uint64_t *wyjscia = malloc(stany * sizeof(uint64_t));
+    bool brak = !cz || !bity || !przejscia || !wyjscia;
+    for (size_t i = 0; !brak && i < num; i++) {
+        cz[i].wejscie = calloc(ILE_UINT(at[i]->typ->n) + 1, sizeof(uint64_t));
+        brak = !cz[i].wejscie;
+    }
+    if (brak) {
+        zwolnij_czlonkow(cz, num);
+        free(bity);
+        free(przejscia);
+        free(wyjscia);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // Uklad stanu, wyjścia i zrodel bitow wejśc
+    uint64_t stan_poczatkowy = 0, wejscie_poczatkowe = 0;
+    size_t przes_s = 0, przes_m = 0, k = 0, zewn = 0;
+    for (size_t i = 0; i < num; i++) {
+        moore_t *a = at[i];
+        cz[i].a = a;
+        cz[i].przes_stanu = przes_s;
+        cz[i].przes_wyjscia = przes_m;
+        if (output_offsets) {
+            output_offsets[i] = przes_m;
+        }
+        stan_poczatkowy |= a->state[0] << przes_s;
+        przes_s += a->typ->s;
+        przes_m += a->typ->m;
+        for (size_t j = 0; j < a->typ->n; j++, k++) {
+            polaczenie_t const *p = &a->podlaczenia_do_a[j];
+            size_t zrodlo = indeks_w_grupie(at, num, p->a_z_kad);
+            bity[k] = (bit_wejscia_t){.czlonek = i, .bit = j, .zrodlo = zrodlo,
+                                      .bit_zrodla = zrodlo == SIZE_MAX ? zewn : p->bit_biore};
+            if (zrodlo == SIZE_MAX) {
+                // Biezaca wartosc bitu bez zapisu do a->input
+                uint64_t v = p->a_z_kad
+                    ? p->a_z_kad->output[p->bit_biore / 64] >> (p->bit_biore % 64)
+                    : a->input[j / 64] >> (j % 64);
+                wejscie_poczatkowe |= (v & 1) << zewn;
+                zewn++;
+            }
+        }
+    }
+
+    // Wyliczenie kroku grupy dla kazdego stanu lacznego i wejścia zewnetrznego
+    for (size_t q = 0; q < stany; q++) {
+        uint64_t wyjscie = 0;
+        for (size_t i = 0; i < num; i++) {
+            ma_type_t const *typ = cz[i].a->typ;
+            cz[i].stan = (q >> cz[i].przes_stanu) & ((1ULL << typ->s) - 1);
+            wyjscie_typu(typ, &cz[i].wyjscie, &cz[i].stan);
+            if (typ->m < 64) {
+                cz[i].wyjscie &= (1ULL << typ->m) - 1;
+            }
+            wyjscie |= cz[i].wyjscie << cz[i].przes_wyjscia;
+        }
+        wyjscia[q] = wyjscie;
+        for (uint64_t x = 0; x < wiersz; x++) {
+            uint64_t laczny;
+            if (krok_grupy(cz, num, bity, ile_bitow, x, &laczny) != 0) {
+                zwolnij_czlonkow(cz, num);
+                free(bity);
+                free(przejscia);
+                free(wyjscia);
+                errno = EINVAL;
+                return NULL;
+            }
+            przejscia[(q << E) | x] = (uint32_t)laczny;
+        }
+    }
+
+    ma_type_t *typ = typ_z_tablic(E, M, stany, przejscia, wyjscia);
+    moore_t *produkt = typ ? ma_create_from_type(typ, &stan_poczatkowy) : NULL;
+    ma_type_release(typ);
+    if (produkt && E > 0) {
+        ma_set_input(produkt, &wejscie_poczatkowe);
+    }
+    // Wejścia zewnetrzne podlaczamy do tych samych zrodel spoza grupy
+    for (size_t b = 0; produkt && b < ile_bitow; b++) {
+        polaczenie_t const *p = &at[bity[b].czlonek]->podlaczenia_do_a[bity[b].bit];
+        if (bity[b].zrodlo == SIZE_MAX && p->a_z_kad &&
+            ma_connect(produkt, bity[b].bit_zrodla, p->a_z_kad, p->bit_biore, 1) != 0) {
+            ma_delete(produkt);
+            produkt = NULL;
+            errno = ENOMEM;
+        }
+    }
+    zwolnij_czlonkow(cz, num);
+    free(bity);
+    return produkt;
+}
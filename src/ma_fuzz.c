@@ -0,0 +1,622 @@
+// Rozniczkowy fuzzer porownujacy alternatywny silnik kroku z referencyjnym ma_step.
+//
+// Kazda runda generuje z ziarna losowa sekwencje operacji (tworzenie automatow z funkcji,
+// typow MA_TYPE_PURE, tablic i wezlow kombinacyjnych, laczenie, rozlaczanie, usuwanie,
+// ustawianie wejśc i stanow, historia, liczniki przelaczen, kroki dowolnych podzbiorow
+// automatow) i odtwarza ja rownolegle w dwoch niezaleznych swiatach. Jeden swiat
+// wykonuje kroki przez ma_step, drugi przez kandydata. Po kazdej operacji porownywane
+// sa wyniki wywolan, wyjścia, historia i liczniki przelaczen wszystkich zywych automatow.
+// Pierwsza rozbieznosc jest minimalizowana przez usuwanie kolejnych operacji, dopoki
+// rozbieznosc nie znika; reproduktor jest wypisywany jako ciag wywolan C.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SLOWA 3 // Maksymalna liczba slow n, m i s w generowanych automatach
+#define ZYWE 16 // Maksymalna liczba jednoczesnie zywych automatow
+#define GLEBOKOSC 4 // Maksymalna glebokosc historii wyjśc
+#define TABELA_WEJSC 3 // Maksymalne n automatow tablicowych
+#define TABELA_STANY 8 // Maksymalna liczba stanow automatow tablicowych
+
+typedef enum {
+    TWORZ, POLACZ, ROZLACZ, USUN, WEJSCIE, STAN, HISTORIA, PRZELACZENIA, KROK
+} rodzaj_t;
+
+// Sposob tworzenia automatu w operacji TWORZ
+typedef enum {
+    Z_FUNKCJI, // ma_create_full lub ma_create_simple
+    Z_TYPU, // ma_type_register(..., MA_TYPE_PURE) i ma_create_from_type
+    Z_TABELI, // ma_table_create i ma_create_from_type
+    KOMBINACYJNY // ma_create_comb
+} sposob_t;
+
+// Jedna operacja sekwencji; automaty sa identyfikowane numerem tworzacej je operacji
+typedef struct operacja {
+    rodzaj_t rodzaj;
+    sposob_t sposob; // TWORZ
+    size_t a, b; // Identyfikatory automatow
+    size_t x, y, z; // TWORZ: n, m, s (stany tablicy); POLACZ: in, out, num; ROZLACZ: in, num;
+                    // HISTORIA: glebokosc (0: wylacz); PRZELACZENIA: 1 wlacz, 0 wylacz
+    unsigned funkcje; // TWORZ: indeks funkcji przejścia i wyjścia lub funkcji wezla
+    uint64_t dane[SLOWA]; // q, wejście, stan lub maska automatow do kroku; TWORZ z tablicy:
+                          // dane[1] to ziarno tablic
+} operacja_t;
+
+// Stan jednego swiata podczas odtwarzania sekwencji
+typedef struct swiat {
+    moore_t **automaty; // automaty[id] lub NULL
+    ma_step_function_t krok; // Silnik kroku tego swiata
+    uint64_t czas; // Laczny czas krokow w ns
+} swiat_t;
+
+static uint64_t losuj(uint64_t *ziarno) {
+    uint64_t z = (*ziarno += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t teraz_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** FUNKCJE AUTOMATOW UZYWANE PRZEZ FUZZER **/
+
+static void t_xor(uint64_t *next_state, uint64_t const *input,
+                  uint64_t const *state, size_t n, size_t s) {
+    for (size_t i = 0; i < ILE_UINT(s); i++) {
+        next_state[i] = state[i] ^ (i < ILE_UINT(n) ? input[i] : 0);
+    }
+}
+
+static void t_licznik(uint64_t *next_state, uint64_t const *input,
+                      uint64_t const *state, size_t n, size_t s) {
+    next_state[0] = state[0] + (n ? input[0] : 0) + 1;
+    for (size_t i = 1; i < ILE_UINT(s); i++) {
+        next_state[i] = state[i - 1] >> 7 | state[i] << 57;
+    }
+}
+
+static void t_miesz(uint64_t *next_state, uint64_t const *input,
+                    uint64_t const *state, size_t n, size_t s) {
+    uint64_t h = 0x243f6a8885a308d3ULL;
+    for (size_t i = 0; i < ILE_UINT(n); i++) {
+        h = (h ^ input[i]) * 0x100000001b3ULL;
+    }
+    for (size_t i = 0; i < ILE_UINT(s); i++) {
+        h = (h ^ state[i]) * 0x9e3779b97f4a7c15ULL;
+        next_state[i] = h ^ (h >> 29);
+    }
+}
+
+static void t_stoj(uint64_t *next_state, uint64_t const *input,
+                   uint64_t const *state, size_t n, size_t s) {
+    (void)next_state, (void)input, (void)state, (void)n, (void)s;
+}
+
+static void y_kopia(uint64_t *output, uint64_t const *state, size_t m, size_t s) {
+    for (size_t i = 0; i < ILE_UINT(m); i++) {
+        output[i] = i < ILE_UINT(s) ? state[i] : 0;
+    }
+}
+
+static void y_neguj(uint64_t *output, uint64_t const *state, size_t m, size_t s) {
+    for (size_t i = 0; i < ILE_UINT(m); i++) {
+        output[i] = ~state[i % ILE_UINT(s)];
+    }
+}
+
+static void k_xor(uint64_t *output, uint64_t const *input, size_t m, size_t n) {
+    for (size_t i = 0; i < ILE_UINT(m); i++) {
+        output[i] = (n ? input[i % ILE_UINT(n)] : 0) ^ 0x5555555555555555ULL;
+    }
+}
+
+static void k_suma(uint64_t *output, uint64_t const *input, size_t m, size_t n) {
+    uint64_t suma = 0;
+    for (size_t i = 0; i < ILE_UINT(m); i++) {
+        suma += i < ILE_UINT(n) ? input[i] : 0;
+        output[i] = suma;
+    }
+}
+
+static transition_function_t const przejscia[] = {t_xor, t_licznik, t_miesz, t_stoj};
+static char const *const nazwy_przejsc[] = {"t_xor", "t_licznik", "t_miesz", "t_stoj"};
+// Ostatnia pozycja: ma_create_simple albo typ z MA_TYPE_IDENTITY_OUTPUT
+static output_function_t const wyjscia[] = {y_kopia, y_neguj, NULL};
+static char const *const nazwy_wyjsc[] = {"y_kopia", "y_neguj", "NULL"};
+static comb_function_t const wezly[] = {k_xor, k_suma};
+static char const *const nazwy_wezlow[] = {"k_xor", "k_suma"};
+#define PRZEJSCIA (sizeof przejscia / sizeof przejscia[0])
+#define WYJSCIA (sizeof wyjscia / sizeof wyjscia[0])
+#define WEZLY (sizeof wezly / sizeof wezly[0])
+
+/** Wypelnia tablice automatu tablicowego z ziarna operacji; co drugi nastepnik to petla. */
+static void wypelnij_tablice(operacja_t const *o, uint32_t *nastepniki, uint64_t *wyjscia_stanow) {
+    uint64_t ziarno = o->dane[1];
+    size_t stany = o->z, symbole = (size_t)1 << o->x;
+    for (size_t q = 0; q < stany; q++) {
+        for (size_t x = 0; x < symbole; x++) {
+            uint64_t r = losuj(&ziarno);
+            nastepniki[q << o->x | x] = r % 2 ? (uint32_t)q : (uint32_t)((r >> 1) % stany);
+        }
+        wyjscia_stanow[q] = losuj(&ziarno);
+    }
+}
+
+/** GENEROWANIE I ODTWARZANIE SEKWENCJI **/
+
+/** Generuje `dlugosc` operacji; wymiary zywych automatow sa sledzone, by wiekszosc wywolan byla poprawna. */
+static void generuj(operacja_t *op, size_t dlugosc, uint64_t ziarno) {
+    size_t zywe[ZYWE], wymiary[ZYWE][3], ile = 0;
+    // Co druga runda bez wezlow kombinacyjnych: z nimi ma_run_tuned liczy jak ma_step
+    bool kombinacyjne = losuj(&ziarno) % 2;
+    for (size_t k = 0; k < dlugosc; k++) {
+        operacja_t *o = &op[k];
+        memset(o, 0, sizeof(*o));
+        for (size_t j = 0; j < SLOWA; j++) {
+            o->dane[j] = losuj(&ziarno);
+        }
+        uint64_t r = losuj(&ziarno);
+        unsigned wybor = (unsigned)(r % 100);
+        if (ile == 0 || (wybor < 15 && ile < ZYWE)) {
+            o->rodzaj = TWORZ;
+            o->x = (r >> 8) % (64 * SLOWA + 1);
+            o->y = 1 + (r >> 16) % (64 * SLOWA);
+            o->z = 1 + (r >> 24) % (64 * SLOWA);
+            o->funkcje = (unsigned)((r >> 32) % (PRZEJSCIA * WYJSCIA));
+            unsigned sposob = (unsigned)((r >> 40) % 8);
+            if (sposob < 3) {
+                o->sposob = Z_FUNKCJI;
+            } else if (sposob < 6) {
+                o->sposob = Z_TYPU;
+            } else {
+                o->sposob = sposob == 7 && kombinacyjne ? KOMBINACYJNY : Z_TABELI;
+            }
+            if (o->sposob == Z_TABELI) {
+                o->x = (r >> 8) % (TABELA_WEJSC + 1);
+                o->y = 1 + (r >> 16) % 64;
+                o->z = 1 + (r >> 24) % TABELA_STANY;
+                o->dane[0] %= o->z;
+            } else if (o->sposob == KOMBINACYJNY) {
+                o->funkcje %= WEZLY;
+            } else if (o->funkcje % WYJSCIA == WYJSCIA - 1) {
+                o->y = o->z; // ma_create_simple i MA_TYPE_IDENTITY_OUTPUT: m = s
+            }
+            zywe[ile] = k;
+            wymiary[ile][0] = o->x;
+            wymiary[ile][1] = o->y;
+            wymiary[ile][2] = o->z;
+            ile++;
+            continue;
+        }
+        size_t i = (r >> 8) % ile, j = (r >> 16) % ile;
+        o->a = zywe[i];
+        o->b = zywe[j];
+        if (wybor < 45) {
+            o->rodzaj = POLACZ;
+            size_t n = wymiary[i][0], m = wymiary[j][1];
+            o->z = 1 + (r >> 24) % 70;
+            o->x = n ? (r >> 32) % n : 0;
+            o->y = (r >> 40) % m;
+            if ((r >> 48) % 8 != 0) {
+                // Zwykle przycinamy do poprawnego zakresu, czasem zostawiamy blad
+                if (o->x + o->z > n) o->z = n > o->x ? n - o->x : 1;
+                if (o->y + o->z > m) o->z = m - o->y;
+                if (o->z == 0) o->z = 1;
+            }
+        } else if (wybor < 55) {
+            o->rodzaj = ROZLACZ;
+            size_t n = wymiary[i][0];
+            o->x = n ? (r >> 24) % n : 0;
+            o->z = 1 + (r >> 32) % (n > o->x ? n - o->x : 1);
+        } else if (wybor < 60) {
+            o->rodzaj = USUN;
+            zywe[i] = zywe[ile - 1];
+            memcpy(wymiary[i], wymiary[ile - 1], sizeof(wymiary[i]));
+            ile--;
+        } else if (wybor < 68) {
+            o->rodzaj = WEJSCIE;
+        } else if (wybor < 72) {
+            o->rodzaj = STAN;
+        } else if (wybor < 75) {
+            o->rodzaj = HISTORIA;
+            o->x = (r >> 24) % (GLEBOKOSC + 1);
+        } else if (wybor < 78) {
+            o->rodzaj = PRZELACZENIA;
+            o->x = (r >> 24) % 4 != 0;
+        } else {
+            o->rodzaj = KROK;
+            if ((r >> 24) % 2) {
+                o->dane[0] = UINT64_MAX;
+            }
+        }
+    }
+}
+
+/** Czy dwa wyjścia o m bitach sa rowne na znaczacych bitach (NULL tylko z NULL). */
+static bool rowne_wyjscia(uint64_t const *x, uint64_t const *y, size_t m) {
+    if (!x || !y) {
+        return x == y;
+    }
+    size_t slowa = ILE_UINT(m);
+    for (size_t j = 0; j < slowa; j++) {
+        uint64_t maska = j + 1 == slowa && m % 64 ? (1ULL << (m % 64)) - 1 : UINT64_MAX;
+        if ((x[j] ^ y[j]) & maska) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Porownuje wyjścia, historie i liczniki przelaczen zywych automatow obu swiatow. */
+static bool zgodne_wyjscia(swiat_t const *w, size_t ile) {
+    for (size_t id = 0; id < ile; id++) {
+        moore_t *a = w[0].automaty[id], *b = w[1].automaty[id];
+        if (!a) continue;
+        size_t m = a->typ->m;
+        for (size_t k = 0; k <= GLEBOKOSC; k++) {
+            if (!rowne_wyjscia(ma_get_output_at(a, k), ma_get_output_at(b, k), m)) {
+                return false;
+            }
+        }
+        uint64_t stan[2][64 * SLOWA], wyjscie[2][64 * SLOWA], cykle[2];
+        int r0 = ma_toggle_export(a, stan[0], wyjscie[0], &cykle[0]);
+        int r1 = ma_toggle_export(b, stan[1], wyjscie[1], &cykle[1]);
+        if (r0 != r1 || (r0 == 0 && (cykle[0] != cykle[1] ||
+                                     memcmp(stan[0], stan[1], a->typ->s * sizeof(uint64_t)) ||
+                                     memcmp(wyjscie[0], wyjscie[1], m * sizeof(uint64_t))))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Wykonuje jedna operacje w swiecie; zwraca wynik wywolania (i errno w *blad). */
+static long wykonaj(swiat_t *w, operacja_t const *o, size_t id, int *blad) {
+    moore_t **at = w->automaty;
+    errno = 0;
+    long wynik = 0;
+    switch (o->rodzaj) {
+        case TWORZ: {
+            transition_function_t t = przejscia[o->funkcje / WYJSCIA];
+            output_function_t y = wyjscia[o->funkcje % WYJSCIA];
+            ma_type_t *typ = NULL;
+            if (o->sposob == Z_FUNKCJI) {
+                at[id] = y ? ma_create_full(o->x, o->y, o->z, t, y, o->dane)
+                           : ma_create_simple(o->x, o->z, t);
+            } else if (o->sposob == KOMBINACYJNY) {
+                at[id] = ma_create_comb(o->x, o->y, wezly[o->funkcje]);
+            } else if (o->sposob == Z_TYPU) {
+                unsigned flagi = MA_TYPE_PURE | (y ? 0 : MA_TYPE_IDENTITY_OUTPUT);
+                typ = ma_type_register(o->x, o->y, o->z, t, y, flagi);
+            } else {
+                uint32_t nastepniki[TABELA_STANY << TABELA_WEJSC];
+                uint64_t wyjscia_stanow[TABELA_STANY];
+                wypelnij_tablice(o, nastepniki, wyjscia_stanow);
+                typ = ma_table_create(o->x, o->y, o->z, nastepniki, wyjscia_stanow);
+            }
+            if (typ) {
+                // Instancja trzyma wlasne odwolanie do typu
+                at[id] = ma_create_from_type(typ, o->dane);
+                ma_type_release(typ);
+            }
+            wynik = at[id] != NULL;
+            break;
+        }
+        case POLACZ:
+            wynik = ma_connect(at[o->a], o->x, at[o->b], o->y, o->z);
+            break;
+        case ROZLACZ:
+            wynik = ma_disconnect(at[o->a], o->x, o->z);
+            break;
+        case USUN:
+            ma_delete(at[o->a]);
+            at[o->a] = NULL;
+            break;
+        case WEJSCIE:
+            wynik = ma_set_input(at[o->a], o->dane);
+            break;
+        case STAN:
+            wynik = ma_set_state(at[o->a], o->dane);
+            break;
+        case HISTORIA:
+            if (o->x) {
+                wynik = ma_enable_history(at[o->a], o->x);
+            } else {
+                ma_disable_history(at[o->a]);
+            }
+            break;
+        case PRZELACZENIA:
+            if (o->x) {
+                wynik = ma_toggle_enable(at[o->a]);
+            } else {
+                ma_toggle_disable(at[o->a]);
+            }
+            break;
+        case KROK: {
+            moore_t *wybrane[ZYWE * 4];
+            size_t ile = 0;
+            for (size_t j = 0; j < id && ile < ZYWE * 4; j++) {
+                if (at[j] && (o->dane[0] >> (j % 64) & 1)) {
+                    wybrane[ile++] = at[j];
+                }
+            }
+            if (ile == 0) break;
+            uint64_t start = teraz_ns();
+            wynik = w->krok(wybrane, ile);
+            w->czas += teraz_ns() - start;
+            break;
+        }
+    }
+    *blad = errno;
+    return wynik;
+}
+
+/** Czy operacja odwoluje sie do automatow, ktore w danym swiecie nie istnieja. */
+static bool pomin(swiat_t const *w, operacja_t const *o) {
+    switch (o->rodzaj) {
+        case TWORZ:
+        case KROK:
+            return false;
+        case POLACZ:
+            return !w->automaty[o->a] || !w->automaty[o->b];
+        default:
+            return !w->automaty[o->a];
+    }
+}
+
+static void sprzataj(swiat_t *w, size_t ile) {
+    for (size_t id = 0; id < ile; id++) {
+        ma_delete(w->automaty[id]);
+        w->automaty[id] = NULL;
+    }
+}
+
+/**
+ * Odtwarza operacje o indeksach `wybrane` w obu swiatach. Zwraca pozycje (w `wybrane`)
+ * pierwszej operacji, po ktorej swiaty sie roznia, lub `ile`, gdy sa zgodne.
+ */
+static size_t odtworz(swiat_t *w, operacja_t const *op, size_t const *wybrane, size_t ile,
+                      size_t *kroki) {
+    size_t wynik = ile;
+    for (size_t k = 0; k < ile && wynik == ile; k++) {
+        size_t id = wybrane[k];
+        operacja_t const *o = &op[id];
+        if (pomin(&w[0], o)) continue;
+        int blad[2];
+        long r0 = wykonaj(&w[0], o, id, &blad[0]);
+        long r1 = wykonaj(&w[1], o, id, &blad[1]);
+        if (o->rodzaj == KROK && kroki) (*kroki)++;
+        if (r0 != r1 || blad[0] != blad[1] ||
+            (o->rodzaj == TWORZ && (w[0].automaty[id] == NULL) != (w[1].automaty[id] == NULL)) ||
+            !zgodne_wyjscia(w, wybrane[ile - 1] + 1)) {
+            wynik = k;
+        }
+    }
+    sprzataj(&w[0], wybrane[ile - 1] + 1);
+    sprzataj(&w[1], wybrane[ile - 1] + 1);
+    return wynik;
+}
+
+/** Wypisuje `ile` slow jako zlozony literal C typu `typ`. */
+static void wypisz_slowa(FILE *out, char const *typ, uint64_t const *slowa, size_t ile) {
+    fprintf(out, "(%s[]){", typ);
+    for (size_t j = 0; j < ile; j++) {
+        fprintf(out, "%s%#llx", j ? ", " : "", (unsigned long long)slowa[j]);
+    }
+    fprintf(out, "}");
+}
+
+/**
+ * Wypisuje operacje jako wywolania C. `zywe[id]` sledzi automaty istniejace w chwili operacji,
+ * tak jak swiaty w odtworz: operacje na nieistniejacych automatach sa pomijane.
+ */
+static void wypisz(FILE *out, operacja_t const *o, size_t id, bool *zywe) {
+    if ((o->rodzaj != TWORZ && o->rodzaj != KROK && !zywe[o->a]) ||
+        (o->rodzaj == POLACZ && !zywe[o->b])) {
+        return;
+    }
+    switch (o->rodzaj) {
+        case TWORZ: {
+            char const *t = nazwy_przejsc[o->funkcje / WYJSCIA];
+            char const *y = nazwy_wyjsc[o->funkcje % WYJSCIA];
+            bool prosty = !wyjscia[o->funkcje % WYJSCIA];
+            if (o->sposob == KOMBINACYJNY) {
+                fprintf(out, "a%zu = ma_create_comb(%zu, %zu, %s);\n", id, o->x, o->y,
+                        nazwy_wezlow[o->funkcje]);
+            } else if (o->sposob == Z_FUNKCJI && prosty) {
+                fprintf(out, "a%zu = ma_create_simple(%zu, %zu, %s);\n", id, o->x, o->z, t);
+            } else if (o->sposob == Z_FUNKCJI) {
+                fprintf(out, "a%zu = ma_create_full(%zu, %zu, %zu, %s, %s, ", id, o->x, o->y,
+                        o->z, t, y);
+                wypisz_slowa(out, "uint64_t", o->dane, SLOWA);
+                fprintf(out, ");\n");
+            } else {
+                if (o->sposob == Z_TYPU) {
+                    fprintf(out, "typ = ma_type_register(%zu, %zu, %zu, %s, %s, %s);\n", o->x,
+                            o->y, o->z, t, y,
+                            prosty ? "MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT" : "MA_TYPE_PURE");
+                } else {
+                    uint32_t nastepniki[TABELA_STANY << TABELA_WEJSC];
+                    uint64_t wyjscia_stanow[TABELA_STANY], szerokie[TABELA_STANY << TABELA_WEJSC];
+                    wypelnij_tablice(o, nastepniki, wyjscia_stanow);
+                    size_t ile = o->z << o->x;
+                    for (size_t j = 0; j < ile; j++) {
+                        szerokie[j] = nastepniki[j];
+                    }
+                    fprintf(out, "typ = ma_table_create(%zu, %zu, %zu, ", o->x, o->y, o->z);
+                    wypisz_slowa(out, "uint32_t", szerokie, ile);
+                    fprintf(out, ", ");
+                    wypisz_slowa(out, "uint64_t", wyjscia_stanow, o->z);
+                    fprintf(out, ");\n");
+                }
+                fprintf(out, "a%zu = ma_create_from_type(typ, ", id);
+                wypisz_slowa(out, "uint64_t", o->dane, SLOWA);
+                fprintf(out, ");\nma_type_release(typ);\n");
+            }
+            zywe[id] = true;
+            break;
+        }
+        case POLACZ:
+            fprintf(out, "ma_connect(a%zu, %zu, a%zu, %zu, %zu);\n", o->a, o->x, o->b, o->y, o->z);
+            break;
+        case ROZLACZ:
+            fprintf(out, "ma_disconnect(a%zu, %zu, %zu);\n", o->a, o->x, o->z);
+            break;
+        case USUN:
+            fprintf(out, "ma_delete(a%zu);\n", o->a);
+            zywe[o->a] = false;
+            break;
+        case WEJSCIE:
+        case STAN:
+            fprintf(out, "%s(a%zu, ", o->rodzaj == WEJSCIE ? "ma_set_input" : "ma_set_state", o->a);
+            wypisz_slowa(out, "uint64_t", o->dane, SLOWA);
+            fprintf(out, ");\n");
+            break;
+        case HISTORIA:
+            if (o->x) {
+                fprintf(out, "ma_enable_history(a%zu, %zu);\n", o->a, o->x);
+            } else {
+                fprintf(out, "ma_disable_history(a%zu);\n", o->a);
+            }
+            break;
+        case PRZELACZENIA:
+            fprintf(out, o->x ? "ma_toggle_enable(a%zu);\n" : "ma_toggle_disable(a%zu);\n", o->a);
+            break;
+        case KROK: {
+            // Ten sam wybor automatow co w wykonaj
+            size_t ile = 0;
+            for (size_t j = 0; j < id && ile < ZYWE * 4; j++) {
+                if (zywe[j] && (o->dane[0] >> (j % 64) & 1)) {
+                    fprintf(out, "%sa%zu", ile ? ", " : "{\n    moore_t *krok[] = {", j);
+                    ile++;
+                }
+            }
+            if (ile > 0) {
+                fprintf(out, "};\n    ma_step(krok, %zu);\n}\n", ile);
+            }
+            break;
+        }
+    }
+}
+
+/** Wypisuje reproduktor: deklaracje automatow i operacje `wybrane` jako ciag wywolan C. */
+static void wypisz_reproduktor(FILE *out, operacja_t const *op, size_t const *wybrane, size_t ile,
+                               size_t automaty) {
+    bool *zywe = calloc(automaty, sizeof(bool));
+    if (!zywe) {
+        fprintf(out, "(brak pamieci na reproduktor)\n");
+        return;
+    }
+    fprintf(out, "// Funkcje t_*, y_* i k_* jak w ma_fuzz.c; kandydat zastepuje ma_step\n");
+    bool typy = false;
+    for (size_t k = 0; k < ile; k++) {
+        operacja_t const *o = &op[wybrane[k]];
+        if (o->rodzaj == TWORZ) {
+            fprintf(out, "moore_t *a%zu = NULL;\n", wybrane[k]);
+            typy = typy || o->sposob == Z_TYPU || o->sposob == Z_TABELI;
+        }
+    }
+    if (typy) {
+        fprintf(out, "ma_type_t *typ;\n");
+    }
+    for (size_t k = 0; k < ile; k++) {
+        wypisz(out, &op[wybrane[k]], wybrane[k], zywe);
+    }
+    free(zywe);
+}
+
+/**
+ * Usuwa z sekwencji kolejne operacje, dopoki rozbieznosc sie utrzymuje.
+ * Zwraca nowa dlugosc `wybrane`.
+ */
+static size_t minimalizuj(swiat_t *w, operacja_t const *op, size_t *wybrane, size_t ile) {
+    bool zmiana = true;
+    while (zmiana) {
+        zmiana = false;
+        for (size_t k = ile; k-- > 0;) {
+            if (ile == 1) break;
+            size_t usuniety = wybrane[k];
+            memmove(&wybrane[k], &wybrane[k + 1], (ile - k - 1) * sizeof(size_t));
+            if (odtworz(w, op, wybrane, ile - 1, NULL) < ile - 1) {
+                ile--;
+                zmiana = true;
+            } else {
+                memmove(&wybrane[k + 1], &wybrane[k], (ile - k - 1) * sizeof(size_t));
+                wybrane[k] = usuniety;
+            }
+        }
+    }
+    return ile;
+}
+
+/** Porownuje `candidate` z ma_step na `rounds` losowych sekwencjach po `length` operacji. */
+int ma_fuzz(ma_step_function_t candidate, uint64_t seed, size_t rounds, size_t length,
+            ma_fuzz_report_t *report, FILE *out) {
+    if (!candidate || rounds == 0 || length == 0 || !report) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(report, 0, sizeof(*report));
+    operacja_t *op = calloc(length, sizeof(operacja_t));
+    size_t *wybrane = calloc(length, sizeof(size_t));
+    moore_t **automaty = calloc(2 * length, sizeof(moore_t *));
+    if (!op || !wybrane || !automaty) {
+        free(op);
+        free(wybrane);
+        free(automaty);
+        errno = ENOMEM;
+        return -1;
+    }
+    swiat_t w[2] = {
+        {.automaty = automaty, .krok = ma_step},
+        {.automaty = automaty + length, .krok = candidate},
+    };
+
+    int wynik = 0;
+    for (size_t runda = 0; runda < rounds && wynik == 0; runda++) {
+        uint64_t ziarno = seed + runda * 0x632be59bd9b4e019ULL;
+        report->seed = ziarno;
+        report->rounds++;
+        generuj(op, length, ziarno);
+        for (size_t k = 0; k < length; k++) {
+            wybrane[k] = k;
+        }
+        size_t rozbieznosc = odtworz(w, op, wybrane, length, &report->steps);
+        report->operations += rozbieznosc < length ? rozbieznosc + 1 : length;
+        if (rozbieznosc == length) continue;
+
+        wynik = 1;
+        report->divergence = rozbieznosc;
+        size_t ile = minimalizuj(w, op, wybrane, rozbieznosc + 1);
+        report->reproducer_length = ile;
+        if (out) {
+            fprintf(out, "rozbieznosc: ziarno %#llx, operacja %zu; reproduktor (%zu operacji):\n",
+                    (unsigned long long)ziarno, rozbieznosc, ile);
+            wypisz_reproduktor(out, op, wybrane, ile, length);
+        }
+    }
+
+    if (report->steps) {
+        report->reference_ns = (double)w[0].czas / (double)report->steps;
+        report->candidate_ns = (double)w[1].czas / (double)report->steps;
+    }
+    if (out) {
+        fprintf(out, "rund %zu, operacji %zu, krokow %zu: ma_step %.1f ns/krok, kandydat %.1f ns/krok\n",
+                report->rounds, report->operations, report->steps, report->reference_ns,
+                report->candidate_ns);
+    }
+    free(op);
+    free(wybrane);
+    free(automaty);
+    return wynik;
+}
@@ -0,0 +1,106 @@
+// Ograniczona historia wyjśc automatu w pierscieniu zarzadzanym przez biblioteke.
+//
+// Po wlaczeniu historii a->output wskazuje biezacy slot pierscienia. Faza commit
+// przesuwa wskaznik na kolejny slot i tam liczy nowe wyjście, wiec zapis wyjścia jest
+// zarazem zapisem historii: starsze wyjścia zostaja w poprzednich slotach, a odczyt
+// wyjścia sprzed k cykli to tylko arytmetyka na indeksie slotu.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WYROWNANIE 4 // Slot zajmuje wielokrotnosc tylu slow (32 bajty)
+
+struct historia {
+    uint64_t *pierscien; // `sloty` slotow po `krok` slow
+    uint64_t *wlasne_wyjscie; // Bufor wyjścia automatu sprzed wlaczenia historii
+    size_t krok; // Slowa jednego slotu
+    size_t sloty; // Glebokosc historii + 1 (biezace wyjście)
+    size_t pozycja; // Slot biezacego wyjścia
+    size_t zapisane; // Liczba dostepnych poprzednich wyjśc (<= sloty - 1)
+};
+
+int historia_dla_pamieci(moore_t const *a, blok_pamieci_t f) {
+    struct historia const *h = a->historia;
+    if (!h) return 0;
+    return f(h, sizeof(*h)) | f(h->pierscien, h->sloty * h->krok * sizeof(uint64_t));
+}
+
+/** Wlacza (od nowa) zapis ostatnich `depth` wyjśc automatu. */
+int ma_enable_history(moore_t *a, size_t depth) {
+    if (!a || depth == 0 || depth == SIZE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (a->trwaly) {
+        errno = EBUSY; // Wyjście lezy w odwzorowaniu pliku ma_persist
+        return -1;
+    }
+    size_t slowa = ILE_UINT(a->typ->m);
+    size_t krok = (slowa + WYROWNANIE - 1) / WYROWNANIE * WYROWNANIE;
+    if (depth + 1 > SIZE_MAX / sizeof(uint64_t) / krok) {
+        errno = ENOMEM;
+        return -1;
+    }
+    struct historia *h = calloc(1, sizeof(struct historia));
+    uint64_t *pierscien = calloc((depth + 1) * krok, sizeof(uint64_t));
+    if (!h || !pierscien) {
+        free(h);
+        free(pierscien);
+        errno = ENOMEM;
+        return -1;
+    }
+    ma_disable_history(a);
+    h->pierscien = pierscien;
+    h->wlasne_wyjscie = a->output;
+    h->krok = krok;
+    h->sloty = depth + 1;
+    memcpy(pierscien, a->output, slowa * sizeof(uint64_t));
+    a->output = pierscien;
+    a->historia = h;
+    return 0;
+}
+
+/** Wylacza historie; biezace wyjście wraca do wlasnego bufora automatu. */
+void ma_disable_history(moore_t *a) {
+    if (!a || !a->historia) return;
+    struct historia *h = a->historia;
+    memcpy(h->wlasne_wyjscie, a->output, ILE_UINT(a->typ->m) * sizeof(uint64_t));
+    a->output = h->wlasne_wyjscie;
+    free(h->pierscien);
+    free(h);
+    a->historia = NULL;
+}
+
+/** Przesuwa biezace wyjście na kolejny slot przed jego obliczeniem. */
+void historia_przesun(moore_t *a) {
+    struct historia *h = a->historia;
+    uint64_t const *poprzednie = a->output;
+    h->pozycja = h->pozycja + 1 == h->sloty ? 0 : h->pozycja + 1;
+    a->output = h->pierscien + h->pozycja * h->krok;
+    if (h->zapisane + 1 < h->sloty) {
+        h->zapisane++;
+    }
+    // Funkcja y moze zalezec od poprzedniej zawartosci bufora; kopia tozsamosci jest zbedna
+    if (!(a->typ->flagi & MA_TYPE_IDENTITY_OUTPUT)) {
+        memcpy(a->output, poprzednie, ILE_UINT(a->typ->m) * sizeof(uint64_t));
+    }
+}
+
+/** Wyjście automatu sprzed `cycles_ago` zatwierdzonych krokow (0: biezace). */
+uint64_t const *ma_get_output_at(moore_t const *a, size_t cycles_ago) {
+    if (!a || (cycles_ago > 0 && (!a->historia || cycles_ago > a->historia->zapisane))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (cycles_ago == 0) {
+        return a->output;
+    }
+    struct historia const *h = a->historia;
+    size_t slot = h->pozycja >= cycles_ago ? h->pozycja - cycles_ago
+                                           : h->pozycja + h->sloty - cycles_ago;
+    return h->pierscien + slot * h->krok;
+}
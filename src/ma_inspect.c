@@ -0,0 +1,236 @@
+// Raport ksztaltu sieci automatow opisanej prostym plikiem tekstowym.
+//
+// Użycie: ma_inspect [plik]   (bez argumentu czyta standardowe wejście)
+//
+// Każdy wiersz to jedno polecenie, '#' zaczyna komentarz:
+//   type <nazwa> <n> <m> <s> [pure] [identity]
+//   automaton <nazwa> <typ> [liczba]
+//   connect <automat> <wejście> <automat> <wyjście> [bity]
+// "automaton x t 8" tworzy automaty x0..x7. Typy o tych samych wymiarach i flagach
+// są w bibliotece jednym typem, więc liczą się razem w rozkładzie automatów na typ.
+
+#include "ma.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE 1024
+
+typedef struct {
+  char *name;
+  ma_type_t *type;
+  size_t s;
+} named_type_t;
+
+typedef struct {
+  char *name;
+  moore_t *a;
+} named_automaton_t;
+
+static named_type_t *types;
+static size_t types_count;
+static named_automaton_t *automata;
+static size_t automata_count, automata_capacity;
+
+// Automaty raportu nie są wykonywane; stan pozostaje bez zmian.
+static void t_hold(uint64_t *next_state, uint64_t const *, uint64_t const *state,
+                   size_t, size_t s) {
+  memcpy(next_state, state, (s + 63) / 64 * sizeof(uint64_t));
+}
+
+static void y_zero(uint64_t *output, uint64_t const *, size_t m, size_t) {
+  memset(output, 0, (m + 63) / 64 * sizeof(uint64_t));
+}
+
+static named_type_t const *find_type(char const *name) {
+  for (size_t i = 0; i < types_count; ++i)
+    if (strcmp(types[i].name, name) == 0)
+      return &types[i];
+  return NULL;
+}
+
+static moore_t *find_automaton(char const *name) {
+  for (size_t i = 0; i < automata_count; ++i)
+    if (strcmp(automata[i].name, name) == 0)
+      return automata[i].a;
+  return NULL;
+}
+
+static int add_automaton(char const *name, named_type_t const *type) {
+  if (find_automaton(name))
+    return -1;
+  if (automata_count == automata_capacity) {
+    size_t capacity = automata_capacity ? 2 * automata_capacity : 64;
+    named_automaton_t *grown = realloc(automata, capacity * sizeof(named_automaton_t));
+    if (!grown)
+      return -1;
+    automata = grown;
+    automata_capacity = capacity;
+  }
+  uint64_t *q = calloc((type->s + 63) / 64, sizeof(uint64_t));
+  moore_t *a = q ? ma_create_from_type(type->type, q) : NULL;
+  char *copy = strdup(name);
+  free(q);
+  if (!a || !copy) {
+    ma_delete(a);
+    free(copy);
+    return -1;
+  }
+  automata[automata_count++] = (named_automaton_t){copy, a};
+  return 0;
+}
+
+// Zwraca 0 lub -1 dla błędnego wiersza.
+static int parse_line(char *line) {
+  char *hash = strchr(line, '#');
+  if (hash)
+    *hash = '\0';
+  char *words[8];
+  size_t count = 0;
+  for (char *w = strtok(line, " \t\r\n"); w; w = strtok(NULL, " \t\r\n")) {
+    if (count == 8)
+      return -1;
+    words[count++] = w;
+  }
+  if (count == 0)
+    return 0;
+
+  if (strcmp(words[0], "type") == 0 && count >= 5) {
+    unsigned flags = 0;
+    for (size_t i = 5; i < count; ++i) {
+      if (strcmp(words[i], "pure") == 0)
+        flags |= MA_TYPE_PURE;
+      else if (strcmp(words[i], "identity") == 0)
+        flags |= MA_TYPE_IDENTITY_OUTPUT;
+      else
+        return -1;
+    }
+    if (find_type(words[1]))
+      return -1;
+    size_t n = strtoull(words[2], NULL, 10), m = strtoull(words[3], NULL, 10),
+           s = strtoull(words[4], NULL, 10);
+    ma_type_t *type = ma_type_register(n, m, s, t_hold,
+                                       flags & MA_TYPE_IDENTITY_OUTPUT ? NULL : y_zero, flags);
+    named_type_t *grown = realloc(types, (types_count + 1) * sizeof(named_type_t));
+    if (!type || !grown) {
+      if (grown)
+        types = grown;
+      ma_type_release(type);
+      return -1;
+    }
+    types = grown;
+    types[types_count++] = (named_type_t){strdup(words[1]), type, s};
+    return types[types_count - 1].name ? 0 : -1;
+  }
+
+  if (strcmp(words[0], "automaton") == 0 && (count == 3 || count == 4)) {
+    named_type_t const *type = find_type(words[2]);
+    if (!type)
+      return -1;
+    if (count == 3)
+      return add_automaton(words[1], type);
+    size_t copies = strtoull(words[3], NULL, 10);
+    char name[MAX_LINE + 32];
+    for (size_t i = 0; i < copies; ++i) {
+      snprintf(name, sizeof name, "%s%zu", words[1], i);
+      if (add_automaton(name, type) != 0)
+        return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(words[0], "connect") == 0 && (count == 5 || count == 6)) {
+    moore_t *a_in = find_automaton(words[1]), *a_out = find_automaton(words[3]);
+    size_t num = count == 6 ? strtoull(words[5], NULL, 10) : 1;
+    if (!a_in || !a_out)
+      return -1;
+    return ma_connect(a_in, strtoull(words[2], NULL, 10), a_out,
+                      strtoull(words[4], NULL, 10), num);
+  }
+  return -1;
+}
+
+static void print_histogram(char const *name, size_t const *histogram) {
+  static char const *const buckets[MA_TOPOLOGY_BUCKETS] = {
+    "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", ">=64"};
+  printf("%-10s", name);
+  for (size_t i = 0; i < MA_TOPOLOGY_BUCKETS; ++i)
+    printf(" %s:%zu", buckets[i], histogram[i]);
+  printf("\n");
+}
+
+static void print_report(struct ma_topology_report const *r) {
+  static char const *const modes[] = {
+    [MA_EXEC_SEQUENTIAL] = "sekwencyjnie (ma_step)",
+    [MA_EXEC_PARALLEL] = "równolegle",
+    [MA_EXEC_EVENT_DRIVEN] = "zdarzeniowo (MA_ENGINE_SKIP)",
+    [MA_EXEC_PIPELINED] = "potokowo"};
+  printf("automaty:           %zu (czystych: %zu)\n", r->automata, r->pure_automata);
+  printf("typy:               %zu (najliczniejszy: %zu automatów)\n", r->types,
+         r->largest_type);
+  printf("krawędzie:          %zu (źródła: %zu, ujścia: %zu)\n", r->edges, r->sources,
+         r->sinks);
+  printf("fan-in:             max %zu, średnio %.2f\n", r->max_fan_in, r->mean_fan_in);
+  printf("fan-out:            max %zu\n", r->max_fan_out);
+  print_histogram("  fan-in", r->fan_in_histogram);
+  print_histogram("  fan-out", r->fan_out_histogram);
+  printf("składowe:           %zu (największa: %zu, ze sprzężeniem: %zu, w nich automatów: %zu)\n",
+         r->components, r->largest_component, r->cyclic_components, r->cyclic_automata);
+  printf("głębokość:          %zu\n", r->depth);
+  printf("bity na krok:       %zu (zewnętrzne: %zu, wolne: %zu)\n", r->routed_bits,
+         r->external_bits, r->free_bits);
+  printf("bajty na krok:      ~%zu\n", r->bytes_per_step);
+  printf("zalecane wykonanie: %s\n", modes[r->suggested]);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 2) {
+    fprintf(stderr, "Użycie:\n%s [plik_sieci]\n", argv[0]);
+    return 2;
+  }
+  FILE *in = argc == 2 ? fopen(argv[1], "r") : stdin;
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  int result = 0;
+  char line[MAX_LINE];
+  for (size_t number = 1; fgets(line, sizeof line, in); ++number) {
+    if (parse_line(line) != 0) {
+      fprintf(stderr, "%zu: błędny wiersz\n", number);
+      result = 1;
+      break;
+    }
+  }
+  if (in != stdin)
+    fclose(in);
+
+  if (result == 0) {
+    moore_t **at = malloc((automata_count ? automata_count : 1) * sizeof(moore_t *));
+    struct ma_topology_report report;
+    for (size_t i = 0; at && i < automata_count; ++i)
+      at[i] = automata[i].a;
+    if (!at || ma_analyze(at, automata_count, &report) != 0) {
+      perror("ma_analyze");
+      result = 1;
+    } else {
+      print_report(&report);
+    }
+    free(at);
+  }
+
+  for (size_t i = 0; i < automata_count; ++i) {
+    ma_delete(automata[i].a);
+    free(automata[i].name);
+  }
+  for (size_t i = 0; i < types_count; ++i) {
+    ma_type_release(types[i].type);
+    free(types[i].name);
+  }
+  free(automata);
+  free(types);
+  return result;
+}
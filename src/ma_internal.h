@@ -0,0 +1,403 @@
+#ifndef MA_INTERNAL_H
+#define MA_INTERNAL_H
+
+// Wewnetrzne struktury biblioteki wspoldzielone przez jej moduly.
+// Nie jest czescia publicznego interfejsu.
+
+#include "ma.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#define ILE_UINT(x) ((x) / 64 + ((x) % 64 != 0)) // Oblicza liczbe 64-bitowych slow potrzebnych na x bitow
+
+
+// Reprezentuje polaczenie bitowe miedzy dwoma automatami
+typedef struct polaczenie {
+    size_t bit_biore; // Ktory bit z automatu nadrzednego jest pobierany
+    moore_t *a_z_kad; // Automat, z ktorego pobierany jest bit
+    moore_t *ja; // Automat, ktory pobiera bit
+} polaczenie_t;
+
+
+// Lista jednokierunkowa dla automatow
+typedef struct Lista {
+    moore_t *automat_moore; // Wskaznik na potomka
+    struct Lista *nxt; // Kolejny element listy
+} list_ma;
+
+// Tablice automatu tablicowego (ma_table.c); stan to numer wiersza. Format (MA_TABLE_*)
+// jest wybierany przy tworzeniu typu wedlug zajmowanej pamieci.
+typedef struct tabela_automatu {
+    size_t stany; // Liczba stanow
+    unsigned format; // MA_TABLE_DENSE, MA_TABLE_CLASSES lub MA_TABLE_DISPLACEMENT
+    uint32_t *przejscia; // DENSE: [q << n | x]; CLASSES: [q * ile_klas + klasa x]
+    uint32_t *klasy; // Klasa rownowaznosci symbolu (CLASSES, DISPLACEMENT) lub NULL
+    size_t ile_klas; // Liczba klas symboli
+    uint32_t *baza; // DISPLACEMENT: przesuniecie wiersza stanu w tablicach wyjatkow
+    uint32_t *domyslny; // DISPLACEMENT: najczestszy nastepnik stanu
+    uint32_t *wlasciciel; // DISPLACEMENT: stan, do ktorego nalezy pozycja (UINT32_MAX: wolna)
+    uint32_t *nastepnik; // DISPLACEMENT: nastepnik zapisany na pozycji
+    size_t dlugosc; // DISPLACEMENT: dlugosc tablic wlasciciel i nastepnik
+    size_t wyjatki; // DISPLACEMENT: liczba przejść roznych od domyslnego
+    uint64_t *wyjscia; // Wyjście (m <= 64) kazdego stanu
+    uint64_t *odwiedziny; // Liczniki wejśc do stanow (profilowanie) lub NULL
+} tabela_automatu_t;
+
+/** Nastepnik stanu q < stany po symbolu x w dowolnym formacie tablicy. */
+static inline uint32_t tabela_nastepnik(tabela_automatu_t const *tab, size_t n, uint64_t q,
+                                        uint64_t x) {
+    switch (tab->format) {
+    case MA_TABLE_CLASSES:
+        return tab->przejscia[q * tab->ile_klas + tab->klasy[x]];
+    case MA_TABLE_DISPLACEMENT: {
+        size_t i = tab->baza[q] + tab->klasy[x];
+        return tab->wlasciciel[i] == q ? tab->nastepnik[i] : tab->domyslny[q];
+    }
+    default:
+        return tab->przejscia[(q << n) | x];
+    }
+}
+
+// Wspolny deskryptor ksztaltu automatu, dzielony przez wszystkie jego instancje
+struct ma_type {
+    size_t n, m, s; // n: liczba wejśc, m: liczba wyjśc, s: liczba bitow stanu
+    transition_function_t t; // Funkcja przejścia (NULL dla automatu tablicowego)
+    output_function_t y; // Funkcja wyjściowa (NULL dla automatu tablicowego)
+    tabela_automatu_t *tabela; // Tablice automatu tablicowego lub NULL
+    unsigned flagi; // Flagi MA_TYPE_*
+    size_t licznik; // Liczba odwolan: instancje oraz rejestracje uzytkownika
+    unsigned klasa; // Klasa rozmiaru (klasa_rozmiaru) ustalana przy rejestracji
+    struct ma_type *nxt; // Kolejny typ w rejestrze
+};
+
+// Reprezentacja automatu Moore'a
+struct moore {
+    ma_type_t *typ; // Wspolny opis wymiarow i funkcji automatu
+
+    uint64_t *input; // Bufor wejśc
+    uint64_t *state; // Bufor stanu
+    uint64_t *output; // Bufor wyjśc
+    uint64_t *next_state; // Bufor na przyszly stan
+
+    list_ma *rodzice; // Lista rodzicow
+    list_ma *dzieci; // Lista dzieci
+    polaczenie_t *podlaczenia_do_a; // Polaczenia wejśc
+
+    struct aktywnosc *aktywnosc; // Liczniki przelaczen bitow lub NULL
+    struct historia *historia; // Pierscien ostatnich wyjśc lub NULL (ma_history.c)
+
+    // Sledzenie zmian dla silnika pomijajacego niezmienione automaty (ma_tuned.c)
+    uint64_t zmiana_wyjscia; // Epoka ostatniej zmiany wyjścia
+    uint64_t odczyt_wejsc; // Epoka ostatniego odczytu wyjśc rodzicow
+    bool stabilny; // Ostatni krok nie zmienil stanu
+    bool brudny; // Wejście, stan lub polaczenia zmienione od ostatniego kroku
+
+    // Widok wejścia: cale wejście to wyrownany ciag slow wyjścia jednego rodzica
+    moore_t const *widok; // Rodzic, ktorego slowa wyjścia kopiujemy w calosci do input, lub NULL
+    size_t widok_slowo; // Pierwsze slowo wyjścia rodzica odpowiadajace wejściu
+    bool widok_aktualny; // widok wyznaczony dla biezacych polaczen
+
+    // Wyrzucanie bezczynnych automatow do pliku (ma_spill.c)
+    struct ma_spill *wyrzut; // Zbior, ktory wyrzucil state i input do pliku, lub NULL
+    uint64_t wyrzut_pozycja; // Polozenie w pliku zbioru albo rozmiar bloku skompresowanego
+    uint8_t *wyrzut_blok; // Skompresowane state i input, gdy zbior nie ma pliku
+
+    struct ma_persist *trwaly; // Plik, w ktorego odwzorowaniu leza bufory automatu, lub NULL (ma_persist.c)
+
+    uint64_t slad; // Numer automatu w nagraniu wywolan API; 0, gdy nienagrany (ma_trace.c)
+
+    // Wezly kombinacyjne (ma_create_comb)
+    size_t poziom; // Wiekszy niz poziom kazdego kombinacyjnego rodzica; 0 dla automatow
+    uint64_t przeglad; // Numer ostatniego przeszukiwania petli, ktore odwiedzilo wezel
+    moore_t *stos; // Nastepny wezel na stosie przegladu (zalezy_od, podnies_poziom)
+    bool na_stosie; // Wezel czeka na stosie podnies_poziom
+};
+
+// Flaga typu wezla kombinacyjnego: s == 0, a y liczy wyjście z wejścia
+#define TYP_KOMBINACYJNY 4u
+
+static inline bool kombinacyjny(moore_t const *a) {
+    return a->typ->flagi & TYP_KOMBINACYJNY;
+}
+
+// Numer ostatniego kroku silnika sledzacego zmiany
+extern _Atomic uint64_t epoka;
+
+void identycznosc(uint64_t *output, uint64_t const *state, size_t m, size_t s);
+
+// Dolacza nowy typ (licznik odwolan 1) do rejestru (ma.c)
+void zarejestruj_typ(ma_type_t *typ);
+// Zwalnia tablice automatu tablicowego (ma_table.c)
+void tabela_zwolnij(tabela_automatu_t *tab);
+// Tworzy typ tablicowy, przejmujac tablice (zwalniane przy bledzie) (ma_table.c)
+ma_type_t *typ_z_tablic(size_t n, size_t m, size_t stany, uint32_t *przejscia,
+                        uint64_t *wyjscia);
+
+/** Liczy nastepny stan wedlug typu: funkcja przejścia albo odczyt z tablicy. */
+static inline void przejscie_typu(ma_type_t const *typ, uint64_t *next_state,
+                                  uint64_t const *input, uint64_t const *state) {
+    tabela_automatu_t *tab = typ->tabela;
+    if (!tab) {
+        typ->t(next_state, input, state, typ->n, typ->s);
+        return;
+    }
+    // Stan spoza tablicy (np. ustawiony recznie) pozostaje bez zmian
+    uint64_t q = state[0];
+    if (q < tab->stany) {
+        uint64_t x = typ->n ? input[0] & (UINT64_MAX >> (64 - typ->n)) : 0;
+        q = tabela_nastepnik(tab, typ->n, q, x);
+    }
+    next_state[0] = q;
+}
+
+/**
+ * Przejście w kroku sieci lub strumienia; przy profilowaniu tablicy liczy odwiedziny stanu.
+ * Wyliczenia przejść (tabelaryzacja, ma_flatten, kodowanie symboliczne) uzywaja samego
+ * przejscie_typu, by nie zaburzac profilu. Typ moze byc wspoldzielony przez watki ma_realtime.
+ */
+static inline void przejscie_kroku(ma_type_t const *typ, uint64_t *next_state,
+                                   uint64_t const *input, uint64_t const *state) {
+    przejscie_typu(typ, next_state, input, state);
+    tabela_automatu_t *tab = typ->tabela;
+    if (tab && tab->odwiedziny && next_state[0] < tab->stany) {
+        __atomic_add_fetch(&tab->odwiedziny[next_state[0]], 1, __ATOMIC_RELAXED);
+    }
+}
+
+/** Liczy wyjście dla stanu wedlug typu. */
+static inline void wyjscie_typu(ma_type_t const *typ, uint64_t *output, uint64_t const *state) {
+    tabela_automatu_t *tab = typ->tabela;
+    if (!tab) {
+        typ->y(output, state, typ->m, typ->s);
+        return;
+    }
+    output[0] = state[0] < tab->stany ? tab->wyjscia[state[0]] : 0;
+}
+
+/** Oblicza wyjście automatu na podstawie jego stanu. */
+static inline void oblicz_wyjscie(moore_t *a) {
+    ma_type_t const *typ = a->typ;
+    if (typ->flagi & MA_TYPE_IDENTITY_OUTPUT) {
+        memcpy(a->output, a->state, ILE_UINT(typ->m) * sizeof(uint64_t));
+    } else if (typ->flagi & TYP_KOMBINACYJNY) {
+        typ->y(a->output, a->input, typ->m, typ->n);
+    } else {
+        wyjscie_typu(typ, a->output, a->state);
+    }
+}
+
+/** Licznik taktow do pomiaru czasu: TSC na x86, w pozostalych nanosekundy zegara. */
+static inline uint64_t takt(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Nanosekundy na takt licznika `takt()`, kalibrowane raz na proces (ma_latency.c)
+double nanosekundy_na_takt(void);
+
+// Krok ma_step; znaczniki[0..1] (gdy podane) to takty konca przygotowania i przejść
+int krok_sieci(moore_t *at[], size_t num, uint64_t *znaczniki);
+
+// Silnik sledzacy zmiany (ma_tuned.c): czy automat moze sie zmienic i krok, ktory przy
+// `pomijaj` nie dotyka buforow automatow, ktore na pewno sie nie zmienia
+bool potrzebny(moore_t const *a);
+int krok_sledzony(moore_t *at[], size_t num, bool pomijaj, size_t *aktywne);
+
+// Wczytuje z pliku state i input wyrzuconego automatu (ma_spill.c); -1 i errno przy bledzie
+int przywroc_wyrzucony(moore_t *a);
+
+// Przesuwa a->output na kolejny slot pierscienia historii (ma_history.c)
+void historia_przesun(moore_t *a);
+
+// Blok pamieci [p, p + rozmiar) dla dotkniecia lub mlock (ma_realtime.c); 0 albo -1
+typedef int (*blok_pamieci_t)(void const *p, size_t rozmiar);
+// Podaja `f` bloki uzywane w kroku przez historie (ma_history.c), liczniki przelaczen
+// (ma_activity.c) i tablice typu (ma_table.c); zwracaja sume logiczna wynikow f
+int historia_dla_pamieci(moore_t const *a, blok_pamieci_t f);
+int aktywnosc_dla_pamieci(moore_t const *a, blok_pamieci_t f);
+int tabela_dla_pamieci(ma_type_t const *typ, blok_pamieci_t f);
+
+/** Oblicza wyjście w fazie commit; przy wlaczonej historii w nowym slocie pierscienia. */
+static inline void zatwierdz_wyjscie(moore_t *a) {
+    if (a->historia) {
+        historia_przesun(a);
+    }
+    oblicz_wyjscie(a);
+}
+
+/** Czy automat musi przejsc commit kazdego kroku (liczniki przelaczen lub historia). */
+static inline bool zatwierdzany_co_krok(moore_t const *a) {
+    return a->aktywnosc || a->historia;
+}
+
+/** Przepisuje do bufora wejśc bity pobierane z wyjśc rodzicow. */
+static inline void aktualizuj_wejscie(moore_t *a) {
+    for (size_t j = 0; j < a->typ->n; j++) {
+        moore_t *b = a->podlaczenia_do_a[j].a_z_kad;
+        if (b != NULL) {
+            uint64_t zkad = b->output[ILE_UINT(a->podlaczenia_do_a[j].bit_biore+1) - 1];
+            uint64_t x = 1ULL << (a->podlaczenia_do_a[j].bit_biore % 64);
+            uint64_t y = x & zkad;
+            size_t slowo = ILE_UINT(j+1) - 1;
+
+            if (y > 0) {
+                y= 1ULL << j % 64;
+                a->input[slowo] |= y;
+            } else {
+                y= 1ULL << j % 64;
+                a->input[slowo] &= (~y);
+            }
+        }
+    }
+}
+
+/** Pobiera k-ty symbol o `bity` bitach z upakowanego strumienia. */
+static inline uint64_t symbol(uint64_t const *symbole, size_t k, size_t bity) {
+    size_t pozycja = k * bity, slowo = pozycja / 64, przesuniecie = pozycja % 64;
+    uint64_t x = symbole[slowo] >> przesuniecie;
+    if (przesuniecie + bity > 64) {
+        x |= symbole[slowo + 1] << (64 - przesuniecie);
+    }
+    return bity == 64 ? x : x & ((1ULL << bity) - 1);
+}
+
+// Faza commit dla automatu ze zliczaniem przelaczen (ma_activity.c)
+void aktywnosc_zatwierdz(moore_t *a);
+
+// Wyznacza widok wejścia automatu dla biezacych polaczen (ma.c)
+void wyznacz_widok(moore_t *a);
+
+/**
+ * Slowa wyjścia rodzica, ktore w calosci tworza wejście, albo NULL, gdy trzeba przepisywac
+ * bity. Kopiujemy je do input w fazie przejścia, zanim commit rodzica je nadpisze.
+ */
+static inline uint64_t const *widok_wejscia(moore_t *a) {
+    if (!a->widok_aktualny) {
+        wyznacz_widok(a);
+    }
+    return a->widok ? a->widok->output + a->widok_slowo : NULL;
+}
+
+// Klasy rozmiaru: W slow stanu i wyjścia oraz brak wejśc albo dokladnie 64 * W bitow wejścia
+// (W = 1, 2, 4). Dla nich krok uzywa jader, w ktorych wszystkie petle, takze rozsylanie
+// bitow wejścia, maja stale granice i sa w pelni rozwijane; pozostale automaty
+// (KLASA_OGOLNA) ida petlami o dlugosci z ILE_UINT i typ->n.
+#define KLASA_OGOLNA 0u
+
+static inline unsigned klasa_rozmiaru(ma_type_t const *typ) {
+    size_t w = ILE_UINT(typ->s);
+    bool pasuje = (w == 1 || w == 2 || w == 4) && ILE_UINT(typ->m) == w &&
+                  (typ->n == 0 || typ->n == 64 * w);
+    return pasuje ? (unsigned)w : KLASA_OGOLNA;
+}
+
+/** Wejście, kopia stanu i przejście automatu klasy W; W jest stala w kazdej instancji. */
+static inline __attribute__((always_inline)) void przejscie_stale(moore_t *a, size_t W) {
+    ma_type_t const *typ = a->typ;
+    uint64_t const *widok = typ->n > 0 ? widok_wejscia(a) : NULL;
+    if (widok) {
+        for (size_t k = 0; k < W; k++) a->input[k] = widok[k];
+    } else if (typ->n > 0) {
+        // W klasie n == 64 * W, wiec petla po bitach ma stala granice
+        polaczenie_t const *p = a->podlaczenia_do_a;
+        for (size_t k = 0; k < W; k++) {
+            uint64_t we = a->input[k];
+#pragma GCC unroll 64
+            for (size_t j = 0; j < 64; j++) {
+                moore_t const *b = p[64 * k + j].a_z_kad;
+                if (b) {
+                    size_t bit = p[64 * k + j].bit_biore;
+                    uint64_t x = (b->output[bit / 64] >> (bit % 64)) & 1;
+                    we = (we & ~(1ULL << j)) | (x << j);
+                }
+            }
+            a->input[k] = we;
+        }
+    }
+    for (size_t k = 0; k < W; k++) a->next_state[k] = a->state[k];
+    przejscie_kroku(typ, a->next_state, a->input, a->state);
+}
+
+/** Zatwierdzenie stanu i wyjścia automatu klasy W (bez licznikow przelaczen). */
+static inline __attribute__((always_inline)) void zatwierdzenie_stale(moore_t *a, size_t W) {
+    for (size_t k = 0; k < W; k++) a->state[k] = a->next_state[k];
+    if (a->historia) {
+        historia_przesun(a);
+    }
+    if (a->typ->flagi & MA_TYPE_IDENTITY_OUTPUT) {
+        for (size_t k = 0; k < W; k++) a->output[k] = a->state[k];
+    } else {
+        wyjscie_typu(a->typ, a->output, a->state);
+    }
+}
+
+#define INSTANCJA_KLASY(W)                                                     \
+    static inline void przejscie_##W(moore_t *a) { przejscie_stale(a, W); }   \
+    static inline void zatwierdzenie_##W(moore_t *a) { zatwierdzenie_stale(a, W); }
+INSTANCJA_KLASY(1)
+INSTANCJA_KLASY(2)
+INSTANCJA_KLASY(4)
+#undef INSTANCJA_KLASY
+
+/** Faza przejścia automatu (bez wezlow kombinacyjnych): jadro klasy albo petle ogolne, wejście ze slow widoku lub z bitow. */
+static inline void przejscie_automatu(moore_t *a) {
+    switch (a->typ->klasa) {
+    case 1: przejscie_1(a); return;
+    case 2: przejscie_2(a); return;
+    case 4: przejscie_4(a); return;
+    }
+    uint64_t const *widok = a->typ->n > 0 ? widok_wejscia(a) : NULL;
+    if (widok) {
+        memcpy(a->input, widok, ILE_UINT(a->typ->n) * sizeof(uint64_t));
+    } else {
+        aktualizuj_wejscie(a);
+    }
+    memcpy(a->next_state, a->state, ILE_UINT(a->typ->s) * sizeof(uint64_t));
+    przejscie_kroku(a->typ, a->next_state, a->input, a->state);
+}
+
+/** Faza commit automatu: jadro klasy, liczniki przelaczen albo petle ogolne. */
+static inline void zatwierdzenie_automatu(moore_t *a) {
+    if (a->aktywnosc) {
+        aktywnosc_zatwierdz(a);
+        return;
+    }
+    switch (a->typ->klasa) {
+    case 1: zatwierdzenie_1(a); return;
+    case 2: zatwierdzenie_2(a); return;
+    case 4: zatwierdzenie_4(a); return;
+    }
+    memcpy(a->state, a->next_state, ILE_UINT(a->typ->s) * sizeof(uint64_t));
+    zatwierdz_wyjscie(a);
+}
+
+// Nagrywanie wywolan API (ma_trace.c); funkcje slad_* wolamy tylko, gdy slad_wlaczony
+extern bool slad_wlaczony;
+void slad_utworz_full(moore_t *a, size_t n, size_t m, size_t s, transition_function_t t,
+                      output_function_t y, uint64_t const *q);
+void slad_utworz_simple(moore_t *a, size_t n, size_t s, transition_function_t t);
+void slad_utworz_z_typu(moore_t *a, ma_type_t const *typ, uint64_t const *q);
+void slad_utworz_komb(moore_t *a, size_t n, size_t m, comb_function_t f);
+void slad_usun(moore_t const *a);
+void slad_polacz(moore_t const *a_in, size_t in, moore_t const *a_out, size_t out, size_t num,
+                 int wynik);
+void slad_rozlacz(moore_t const *a_in, size_t in, size_t num, int wynik);
+void slad_wejscie(moore_t const *a, uint64_t const *input, int wynik);
+void slad_stan(moore_t const *a, uint64_t const *state, int wynik);
+void slad_krok(moore_t *const at[], size_t num, size_t cykle, bool strojony, int wynik);
+
+#endif
@@ -0,0 +1,93 @@
+// Pomiar rozrzutu czasu kroku: ma_step kontra tryb czasu rzeczywistego.
+//
+// Użycie: ma_jitter [automaty] [wątki] [kroki] [budżet_us]
+//
+// Sieć to łańcuch 64-bitowych liczników. Przy podanym budżecie program kończy się kodem 1,
+// gdy najdłuższy krok trybu czasu rzeczywistego go przekroczy.
+
+#include "ma.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void t_count(uint64_t *next_state, uint64_t const *input, uint64_t const *state,
+                    size_t, size_t) {
+  next_state[0] = state[0] + input[0];
+}
+
+static void print_latency(char const *name, ma_latency_t const *lat) {
+  printf("%-10s p50 %8.2f us  p99 %8.2f us  p99.9 %8.2f us  max %8.2f us\n", name,
+         ma_latency_percentile(lat, MA_PHASE_STEP, 50) / 1e3,
+         ma_latency_percentile(lat, MA_PHASE_STEP, 99) / 1e3,
+         ma_latency_percentile(lat, MA_PHASE_STEP, 99.9) / 1e3,
+         ma_latency_percentile(lat, MA_PHASE_STEP, 100) / 1e3);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 5) {
+    fprintf(stderr, "Użycie:\n%s [automaty] [wątki] [kroki] [budżet_us]\n", argv[0]);
+    return 2;
+  }
+  size_t num = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000;
+  size_t threads = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+  size_t cycles = argc > 3 ? strtoull(argv[3], NULL, 10) : 100000;
+  double budget_us = argc > 4 ? strtod(argv[4], NULL) : 0;
+  if (num == 0 || cycles == 0) {
+    fprintf(stderr, "Liczba automatów i kroków musi być dodatnia\n");
+    return 2;
+  }
+
+  moore_t **at = calloc(num, sizeof(moore_t *));
+  const uint64_t one = 1;
+  if (!at) {
+    perror("calloc");
+    return 1;
+  }
+  int result = 0;
+  for (size_t i = 0; i < num && result == 0; ++i) {
+    at[i] = ma_create_simple(64, 64, t_count);
+    if (!at[i] || (i == 0 ? ma_set_input(at[i], &one) : ma_connect(at[i], 0, at[i - 1], 0, 64)))
+      result = 1;
+  }
+  ma_latency_t *step = ma_latency_create(0), *rt_lat = ma_latency_create(0);
+  ma_realtime_t *rt = NULL;
+  if (result == 0 && step && rt_lat) {
+    rt = ma_realtime_create(at, num, threads, MA_RT_PIN | MA_RT_LOCK);
+    if (!rt && (errno == EPERM || errno == ENOMEM || errno == EAGAIN)) {
+      fprintf(stderr, "mlock niedostępny (%s), pamięć tylko dotknięta\n", strerror(errno));
+      rt = ma_realtime_create(at, num, threads, MA_RT_PIN);
+    }
+  }
+  if (!rt) {
+    perror("ma_realtime_create");
+    result = 1;
+  }
+
+  if (result == 0) {
+    // Rozgrzewka, potem naprzemienne serie, żeby oba tryby widziały ten sam stan maszyny
+    ma_realtime_run(rt, cycles / 10 + 1, NULL);
+    for (size_t done = 0; done < cycles; done += 1000) {
+      size_t batch = cycles - done < 1000 ? cycles - done : 1000;
+      for (size_t c = 0; c < batch; ++c)
+        ma_step_measured(step, at, num);
+      ma_realtime_run(rt, batch, rt_lat);
+    }
+    printf("%zu automatów, %zu wątków, %zu kroków\n", num, threads, cycles);
+    print_latency("ma_step", step);
+    print_latency("realtime", rt_lat);
+    double worst_us = ma_latency_percentile(rt_lat, MA_PHASE_STEP, 100) / 1e3;
+    if (budget_us > 0 && worst_us > budget_us) {
+      printf("przekroczony budżet %.2f us\n", budget_us);
+      result = 1;
+    }
+  }
+
+  ma_realtime_destroy(rt);
+  ma_latency_destroy(step);
+  ma_latency_destroy(rt_lat);
+  for (size_t i = 0; i < num; ++i)
+    ma_delete(at[i]);
+  free(at);
+  return result;
+}
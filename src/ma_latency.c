@@ -0,0 +1,169 @@
+// Histogramy opoznien pojedynczych krokow sieci.
+//
+// Przedzialy sa logarytmiczno-liniowe jak w HdrHistogram: kazda oktawa [2^e, 2^(e+1))
+// dzieli sie na PODZIAL rownych czesci, wiec blad wzgledny wartosci nie przekracza
+// 1/PODZIAL, a zapis to jedno clz i inkrementacja licznika. Czas mierzymy licznikiem
+// taktow (rdtsc) przeliczanym na nanosekundy wspolczynnikiem kalibrowanym raz na proces.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BITY_PODZIALU 5
+#define PODZIAL (1u << BITY_PODZIALU) // Przedzialy na oktawe
+#define PRZEDZIALY ((64 - BITY_PODZIALU + 1) * PODZIAL)
+#define KALIBRACJA_NS 5000000 // Czas kalibracji taktow
+
+typedef struct histogram {
+    uint64_t liczniki[PRZEDZIALY];
+    uint64_t ile; // Liczba zapisanych wartosci
+    uint64_t maks; // Najwieksza zapisana wartosc (dokladna)
+} histogram_t;
+
+struct ma_latency {
+    size_t ile_faz; // 1 albo MA_PHASES
+    histogram_t fazy[];
+};
+
+static double ns_na_takt = 1.0;
+static pthread_once_t skalibrowano = PTHREAD_ONCE_INIT;
+
+static uint64_t teraz_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** Wyznacza stosunek nanosekund do taktow licznika na podstawie zegara monotonicznego. */
+static void kalibruj(void) {
+    uint64_t ns0 = teraz_ns(), t0 = takt(), ns1, t1;
+    do {
+        ns1 = teraz_ns();
+        t1 = takt();
+    } while (ns1 - ns0 < KALIBRACJA_NS);
+    if (t1 > t0) {
+        ns_na_takt = (double)(ns1 - ns0) / (double)(t1 - t0);
+    }
+}
+
+double nanosekundy_na_takt(void) {
+    pthread_once(&skalibrowano, kalibruj);
+    return ns_na_takt;
+}
+
+static size_t przedzial(uint64_t x) {
+    if (x < PODZIAL) return (size_t)x;
+    unsigned e = 63 - (unsigned)__builtin_clzll(x);
+    unsigned przesuniecie = e - BITY_PODZIALU;
+    return (size_t)(przesuniecie + 1) * PODZIAL + (size_t)((x >> przesuniecie) - PODZIAL);
+}
+
+/** Najwieksza wartosc nalezaca do przedzialu `k`. */
+static uint64_t gora_przedzialu(size_t k) {
+    if (k < PODZIAL) return k;
+    unsigned przesuniecie = (unsigned)(k / PODZIAL) - 1;
+    uint64_t mantysa = PODZIAL + k % PODZIAL;
+    return ((mantysa + 1) << przesuniecie) - 1;
+}
+
+static void zapisz(histogram_t *h, uint64_t ns) {
+    h->liczniki[przedzial(ns)]++;
+    h->ile++;
+    if (ns > h->maks) h->maks = ns;
+}
+
+static histogram_t const *faza(ma_latency_t const *lat, int phase) {
+    if (!lat || phase < 0 || (size_t)phase >= lat->ile_faz) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return &lat->fazy[phase];
+}
+
+/** Tworzy pusty histogram kroku; `per_phase` dodaje histogramy faz MA_PHASE_*. */
+ma_latency_t *ma_latency_create(int per_phase) {
+    pthread_once(&skalibrowano, kalibruj);
+    size_t ile = per_phase ? MA_PHASES : 1;
+    ma_latency_t *lat = calloc(1, sizeof(ma_latency_t) + ile * sizeof(histogram_t));
+    if (!lat) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    lat->ile_faz = ile;
+    return lat;
+}
+
+void ma_latency_destroy(ma_latency_t *lat) {
+    free(lat);
+}
+
+void ma_latency_reset(ma_latency_t *lat) {
+    if (!lat) return;
+    memset(lat->fazy, 0, lat->ile_faz * sizeof(histogram_t));
+}
+
+/** Jak ma_step, zapisujac czas kroku (i faz) do histogramow; nieudany krok nie jest liczony. */
+int ma_step_measured(ma_latency_t *lat, moore_t *at[], size_t num) {
+    if (!lat) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t znaczniki[2];
+    uint64_t poczatek = takt();
+    int wynik = krok_sieci(at, num, lat->ile_faz > 1 ? znaczniki : NULL);
+    uint64_t koniec = takt();
+    if (slad_wlaczony) slad_krok(at, num, 1, false, wynik);
+    if (wynik != 0) {
+        return -1;
+    }
+    zapisz(&lat->fazy[MA_PHASE_STEP], (uint64_t)((double)(koniec - poczatek) * ns_na_takt));
+    if (lat->ile_faz > 1) {
+        zapisz(&lat->fazy[MA_PHASE_PREPARE],
+               (uint64_t)((double)(znaczniki[0] - poczatek) * ns_na_takt));
+        zapisz(&lat->fazy[MA_PHASE_TRANSITION],
+               (uint64_t)((double)(znaczniki[1] - znaczniki[0]) * ns_na_takt));
+        zapisz(&lat->fazy[MA_PHASE_COMMIT],
+               (uint64_t)((double)(koniec - znaczniki[1]) * ns_na_takt));
+    }
+    return 0;
+}
+
+/** Dopisuje zmierzony poza biblioteka czas (np. ma_run_tuned) do histogramu fazy. */
+int ma_latency_record(ma_latency_t *lat, int phase, uint64_t ns) {
+    histogram_t const *h = faza(lat, phase);
+    if (!h) return -1;
+    zapisz(&lat->fazy[phase], ns);
+    return 0;
+}
+
+uint64_t ma_latency_count(ma_latency_t const *lat, int phase) {
+    histogram_t const *h = faza(lat, phase);
+    return h ? h->ile : 0;
+}
+
+/** Najmniejsza wartosc (ns), od ktorej nie wieksze jest `percentile` procent zapisow. */
+uint64_t ma_latency_percentile(ma_latency_t const *lat, int phase, double percentile) {
+    histogram_t const *h = faza(lat, phase);
+    if (!h || !(percentile >= 0 && percentile <= 100)) {
+        errno = EINVAL;
+        return 0;
+    }
+    if (h->ile == 0) return 0;
+    uint64_t potrzeba = (uint64_t)(percentile / 100.0 * (double)h->ile + 0.5);
+    if (potrzeba == 0) potrzeba = 1;
+    if (potrzeba >= h->ile) return h->maks;
+    uint64_t suma = 0;
+    for (size_t k = 0; k < PRZEDZIALY; k++) {
+        suma += h->liczniki[k];
+        if (suma >= potrzeba) {
+            uint64_t gora = gora_przedzialu(k);
+            return gora < h->maks ? gora : h->maks;
+        }
+    }
+    return h->maks;
+}
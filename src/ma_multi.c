@@ -0,0 +1,255 @@
+// Wiele automatow konsumujacych jeden wspolny strumien symboli w jednym przebiegu.
+//
+// Strumien jest dzielony na bloki po BLOK symboli. Kazdy blok jest dekodowany raz do
+// bufora mieszczacego sie w L1 i przepuszczany przez wszystkie automaty, wiec ruch
+// z pamieci nie rosnie z liczba automatow. Automaty sa liczone grupami po PRZEPLOT:
+// kroki automatow grupy sa przeplatane, wiec niezalezne odczyty tablic przejść
+// nakladaja sie w czasie. Kazdy automat widzi strumien jak w ma_run_stream.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOK 1024 // Liczba symboli dekodowanych naraz
+#define PRZEPLOT 4 // Liczba automatow, ktorych kroki sa przeplatane
+
+// Zarejestrowany automat i jego stan lokalny na czas jednego przebiegu
+typedef struct uczestnik {
+    moore_t *a;
+    uint64_t maska; // Maska zdarzen na pierwszym slowie wyjścia
+    bool szybki; // n, s, m <= 64, bez petli wlasnej i licznikow przelaczen
+    uint64_t wejscie, stan; // Kopie lokalne (szybki)
+    uint64_t maska_pol, wartosc_pol; // Bity wejścia od rodzicow sa stale w przebiegu
+} uczestnik_t;
+
+struct ma_multi {
+    size_t bity; // Szerokosc symbolu
+    ma_match_callback_t callback;
+    void *ctx;
+    uczestnik_t *uczestnicy;
+    size_t ile, pojemnosc;
+    uint64_t pozycja; // Liczba symboli przetworzonych od utworzenia
+    uint64_t *blok; // Zdekodowane symbole biezacego bloku
+    uint64_t *bufor; // Bufor nastepnego stanu automatow wolnych
+    size_t rozmiar_bufora;
+};
+
+/** Tworzy pusty zbior automatow dla symboli o `symbol_bits` bitach. */
+ma_multi_t *ma_multi_create(size_t symbol_bits, ma_match_callback_t callback, void *ctx) {
+    if (symbol_bits == 0 || symbol_bits > 64) {
+        errno = EINVAL;
+        return NULL;
+    }
+    ma_multi_t *mm = calloc(1, sizeof(ma_multi_t));
+    uint64_t *blok = calloc(BLOK, sizeof(uint64_t));
+    if (!mm || !blok) {
+        free(mm);
+        free(blok);
+        errno = ENOMEM;
+        return NULL;
+    }
+    mm->bity = symbol_bits;
+    mm->callback = callback;
+    mm->ctx = ctx;
+    mm->blok = blok;
+    return mm;
+}
+
+void ma_multi_destroy(ma_multi_t *mm) {
+    if (!mm) return;
+    free(mm->uczestnicy);
+    free(mm->blok);
+    free(mm->bufor);
+    free(mm);
+}
+
+/** Rejestruje automat; zwraca jego numer w zdarzeniach albo -1. Automat musi zyc dluzej niz zbior. */
+int ma_multi_add(ma_multi_t *mm, moore_t *a, uint64_t match_mask) {
+    if (!mm || !a || mm->bity > a->typ->n || mm->ile >= INT32_MAX || kombinacyjny(a)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (a->wyrzut) {
+        errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+        return -1;
+    }
+    for (size_t i = 0; i < mm->ile; i++) {
+        if (mm->uczestnicy[i].a == a) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    if (mm->ile == mm->pojemnosc) {
+        size_t nowa = mm->pojemnosc ? 2 * mm->pojemnosc : 8;
+        uczestnik_t *u = realloc(mm->uczestnicy, nowa * sizeof(uczestnik_t));
+        if (!u) {
+            errno = ENOMEM;
+            return -1;
+        }
+        mm->uczestnicy = u;
+        mm->pojemnosc = nowa;
+    }
+    size_t slowa_s = ILE_UINT(a->typ->s);
+    if (slowa_s > mm->rozmiar_bufora) {
+        uint64_t *bufor = calloc(slowa_s, sizeof(uint64_t));
+        if (!bufor) {
+            errno = ENOMEM;
+            return -1;
+        }
+        free(mm->bufor);
+        mm->bufor = bufor;
+        mm->rozmiar_bufora = slowa_s;
+    }
+    mm->uczestnicy[mm->ile] = (uczestnik_t){.a = a, .maska = match_mask};
+    return (int)mm->ile++;
+}
+
+/** Liczba symboli przetworzonych od utworzenia zbioru. */
+uint64_t ma_multi_position(ma_multi_t const *mm) {
+    if (!mm) {
+        errno = EINVAL;
+        return 0;
+    }
+    return mm->pozycja;
+}
+
+/** Przygotowuje kopie lokalne automatu na poczatku przebiegu. */
+static void przygotuj(uczestnik_t *u) {
+    moore_t *a = u->a;
+    ma_type_t const *typ = a->typ;
+    aktualizuj_wejscie(a);
+    u->szybki = typ->n <= 64 && typ->s <= 64 && typ->m <= 64 && !zatwierdzany_co_krok(a);
+    u->maska_pol = 0;
+    for (size_t j = 0; j < typ->n; j++) {
+        moore_t *rodzic = a->podlaczenia_do_a[j].a_z_kad;
+        if (rodzic == a) {
+            u->szybki = false;
+        }
+        if (rodzic && j < 64) {
+            u->maska_pol |= 1ULL << j;
+        }
+    }
+    if (u->szybki) {
+        u->wejscie = a->input[0];
+        u->stan = a->state[0];
+        u->wartosc_pol = a->input[0] & u->maska_pol;
+    }
+}
+
+/** Zapisuje kopie lokalne z powrotem do automatu na koniec przebiegu. */
+static void zakoncz(uczestnik_t *u) {
+    moore_t *a = u->a;
+    if (u->szybki) {
+        a->input[0] = u->wejscie;
+        a->state[0] = u->stan;
+    }
+    oblicz_wyjscie(a);
+    a->zmiana_wyjscia = epoka;
+    a->brudny = true;
+}
+
+/** Krok szybkiego automatu na symbolu x; zwraca pierwsze slowo wyjścia, jesli potrzebne. */
+static inline uint64_t krok_szybki(uczestnik_t *u, uint64_t x, uint64_t maska_symbolu,
+                                   bool wyjscie) {
+    ma_type_t const *typ = u->a->typ;
+    uint64_t wejscie = (u->wejscie & ~maska_symbolu) | x, nastepny = u->stan, out = 0;
+    wejscie = (wejscie & ~u->maska_pol) | u->wartosc_pol;
+    przejscie_kroku(typ, &nastepny, &wejscie, &u->stan);
+    u->wejscie = wejscie;
+    u->stan = nastepny;
+    if (wyjscie) {
+        if (typ->flagi & MA_TYPE_IDENTITY_OUTPUT) {
+            out = nastepny;
+        } else {
+            wyjscie_typu(typ, &out, &nastepny);
+        }
+    }
+    return out;
+}
+
+/** Przepuszcza blok przez grupe do PRZEPLOT szybkich automatow, przeplatajac ich kroki. */
+static void blok_grupy(ma_multi_t *mm, size_t od, size_t ile_w_grupie, size_t dlugosc) {
+    uczestnik_t *u = mm->uczestnicy + od;
+    uint64_t maska_symbolu = mm->bity == 64 ? UINT64_MAX : (1ULL << mm->bity) - 1;
+    bool zdarzenia = mm->callback != NULL;
+    for (size_t k = 0; k < dlugosc; k++) {
+        uint64_t x = mm->blok[k];
+        for (size_t j = 0; j < ile_w_grupie; j++) {
+            bool wyjscie = zdarzenia && u[j].maska;
+            uint64_t out = krok_szybki(&u[j], x, maska_symbolu, wyjscie);
+            if (wyjscie && (out & u[j].maska)) {
+                mm->callback(mm->ctx, od + j, mm->pozycja + k, out);
+            }
+        }
+    }
+}
+
+/** Przepuszcza blok przez automat bez kopii lokalnych (duzy, z petla wlasna lub licznikami). */
+static void blok_wolny(ma_multi_t *mm, size_t i, size_t dlugosc) {
+    moore_t *a = mm->uczestnicy[i].a;
+    ma_type_t const *typ = a->typ;
+    size_t slowa_s = ILE_UINT(typ->s);
+    uint64_t maska_symbolu = mm->bity == 64 ? UINT64_MAX : (1ULL << mm->bity) - 1;
+    a->next_state = mm->bufor;
+    for (size_t k = 0; k < dlugosc; k++) {
+        a->input[0] = (a->input[0] & ~maska_symbolu) | mm->blok[k];
+        aktualizuj_wejscie(a);
+        memcpy(a->next_state, a->state, slowa_s * sizeof(uint64_t));
+        przejscie_kroku(typ, a->next_state, a->input, a->state);
+        if (a->aktywnosc) {
+            aktywnosc_zatwierdz(a);
+        } else {
+            memcpy(a->state, a->next_state, slowa_s * sizeof(uint64_t));
+            zatwierdz_wyjscie(a);
+        }
+        if (mm->callback && (a->output[0] & mm->uczestnicy[i].maska)) {
+            mm->callback(mm->ctx, i, mm->pozycja + k, a->output[0]);
+        }
+    }
+    a->next_state = NULL;
+}
+
+/** Przepuszcza `count` kolejnych symboli strumienia przez wszystkie zarejestrowane automaty. */
+int ma_multi_feed(ma_multi_t *mm, uint64_t const *symbols, size_t count) {
+    if (!mm || (!symbols && count > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < mm->ile; i++) {
+        if (mm->uczestnicy[i].a->wyrzut) {
+            errno = EBUSY; // Zbior ma_spill otwarty po ma_multi_add
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < mm->ile; i++) {
+        przygotuj(&mm->uczestnicy[i]);
+    }
+    for (size_t od = 0; od < count; od += BLOK) {
+        size_t dlugosc = count - od < BLOK ? count - od : BLOK;
+        for (size_t k = 0; k < dlugosc; k++) {
+            mm->blok[k] = symbol(symbols, od + k, mm->bity);
+        }
+        // Kolejne szybkie automaty tworza grupy przeplatane, wolne liczymy osobno
+        for (size_t i = 0; i < mm->ile;) {
+            if (!mm->uczestnicy[i].szybki) {
+                blok_wolny(mm, i++, dlugosc);
+                continue;
+            }
+            size_t g = i;
+            while (g < mm->ile && g - i < PRZEPLOT && mm->uczestnicy[g].szybki) g++;
+            blok_grupy(mm, i, g - i, dlugosc);
+            i = g;
+        }
+        mm->pozycja += dlugosc;
+    }
+    for (size_t i = 0; i < mm->ile; i++) {
+        zakoncz(&mm->uczestnicy[i]);
+    }
+    return 0;
+}
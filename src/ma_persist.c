@@ -0,0 +1,357 @@
+// Trwaly zapis stanu sieci automatow Moore'a w pliku mapowanym w pamieci.
+//
+// Plik zaczyna sie strona naglowka z dwoma slotami dziennika, po ktorej leza dwa
+// banki z buforami state/input/output wszystkich automatow sieci. Bufory automatow leza
+// wprost w jednym z bankow (zywym); drugi bank trzyma ostatni zatwierdzony cykl i nie jest
+// ruszany. Zatwierdzenie wykonuje msync zywego banku (jadro zapisuje tylko brudne strony),
+// zapisuje nowy naglowek wskazujacy ten bank, po czym banki zamieniaja sie rolami: do
+// starego banku kopiujemy tylko automaty zmienione od poprzedniego zatwierdzenia i
+// przestawiamy na niego wskazniki buforow. Awaria w dowolnym momencie zostawia w pliku
+// ostatni kompletnie zatwierdzony cykl.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIA 0x3130545352455041ULL // "APERST01"
+#define SLOTY 2 // Liczba slotow naglowka w dzienniku
+
+// Jeden slot dziennika opisujacy ostatni zatwierdzony cykl
+typedef struct naglowek {
+    uint64_t magia; // Stala MAGIA
+    uint64_t uklad; // Skrot wymiarow sieci, odroznia pliki innych sieci
+    uint64_t cykl; // Numer zatwierdzonego cyklu
+    uint64_t bank; // Bank, w ktorym zapisano ten cykl
+    uint64_t numer; // Numer kolejny zapisu; wygrywa wiekszy
+    uint64_t suma; // Suma kontrolna powyzszych pol
+} naglowek_t;
+
+struct ma_persist {
+    moore_t **at; // Kopia tablicy automatow sieci
+    size_t num; // Liczba automatow
+    size_t interval; // Co ile cykli zatwierdzamy stan
+    uint64_t cykl; // Cykl stanu trzymanego w pamieci
+    uint64_t numer; // Numer ostatnio zapisanego naglowka
+    uint64_t bank; // Bank ostatnio zatwierdzony; zywy to bank ^ 1
+    uint64_t uklad; // Skrot wymiarow sieci
+    int fd; // Deskryptor pliku
+    uint8_t *mapa; // Poczatek odwzorowania pliku
+    size_t rozmiar_naglowka; // Rozmiar strony naglowka
+    size_t rozmiar_banku; // Rozmiar jednego banku (wielokrotnosc strony)
+    size_t *polozenie; // Pierwsze slowo buforow kazdego automatu w banku
+    uint64_t *zmiana; // Cykl ostatniej zmiany buforow kazdego automatu
+    uint64_t przelaczenie; // Cykl ostatniej zamiany bankow
+    bool kombinacyjne; // Siec ma wezly kombinacyjne (krok przez krok_sieci)
+};
+
+/** Dokłada slowo do skrotu FNV-1a. */
+static uint64_t skrot(uint64_t h, uint64_t x) {
+    for (int i = 0; i < 8; i++) {
+        h ^= (x >> (8 * i)) & 0xff;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t suma_naglowka(naglowek_t const *h) {
+    uint64_t suma = 0xcbf29ce484222325ULL;
+    suma = skrot(suma, h->magia);
+    suma = skrot(suma, h->uklad);
+    suma = skrot(suma, h->cykl);
+    suma = skrot(suma, h->bank);
+    suma = skrot(suma, h->numer);
+    return suma;
+}
+
+static uint64_t *poczatek_banku(ma_persist_t const *p, uint64_t bank) {
+    return (uint64_t *)(p->mapa + p->rozmiar_naglowka + bank * p->rozmiar_banku);
+}
+
+/** Liczba slow stanu w banku; jak przy tworzeniu automatu co najmniej jedno. */
+static size_t slowa_stanu(moore_t const *a) {
+    return ILE_UINT(a->typ->s) + (a->typ->s == 0);
+}
+
+/** Liczba slow state, input i output automatu w banku. */
+static size_t slowa_automatu(moore_t const *a) {
+    return slowa_stanu(a) + ILE_UINT(a->typ->n) + ILE_UINT(a->typ->m);
+}
+
+/** Przestawia bufory automatow na ich miejsca w banku. */
+static void ustaw_bufory(ma_persist_t *p, uint64_t bank) {
+    uint64_t *baza = poczatek_banku(p, bank);
+    for (size_t i = 0; i < p->num; i++) {
+        moore_t *a = p->at[i];
+        uint64_t *b = baza + p->polozenie[i];
+        a->state = b;
+        a->input = b + slowa_stanu(a);
+        a->output = a->input + ILE_UINT(a->typ->n);
+    }
+}
+
+/** Kopiuje bufory automatow miedzy bankami; przy `wszystkie` takze niezmienione. */
+static void kopiuj_bank(ma_persist_t *p, uint64_t z, uint64_t do_banku, bool wszystkie) {
+    uint64_t const *zrodlo = poczatek_banku(p, z);
+    uint64_t *cel = poczatek_banku(p, do_banku);
+    for (size_t i = 0; i < p->num; i++) {
+        if (wszystkie || p->zmiana[i] > p->przelaczenie || p->at[i]->brudny) {
+            memcpy(cel + p->polozenie[i], zrodlo + p->polozenie[i],
+                   slowa_automatu(p->at[i]) * sizeof(uint64_t));
+        }
+    }
+}
+
+/** Przenosi bufory automatow z odwzorowania na sterte; false, gdy brakuje pamieci. */
+static bool przenies_na_sterte(ma_persist_t *p) {
+    // Najpierw wszystkie alokacje, zeby przy bledzie nie zostawic sieci w polowie
+    uint64_t **sterta = calloc(3 * p->num, sizeof(uint64_t *));
+    bool udane = sterta != NULL;
+    for (size_t i = 0; udane && i < p->num; i++) {
+        moore_t const *a = p->at[i];
+        if (!a->trwaly) continue;
+        sterta[3 * i] = malloc(slowa_stanu(a) * sizeof(uint64_t));
+        sterta[3 * i + 1] = malloc((ILE_UINT(a->typ->n) + 1) * sizeof(uint64_t));
+        sterta[3 * i + 2] = malloc((ILE_UINT(a->typ->m) + 1) * sizeof(uint64_t));
+        udane = sterta[3 * i] && sterta[3 * i + 1] && sterta[3 * i + 2];
+    }
+    if (!udane) {
+        for (size_t i = 0; sterta && i < 3 * p->num; i++) free(sterta[i]);
+        free(sterta);
+        return false;
+    }
+    for (size_t i = 0; i < p->num; i++) {
+        moore_t *a = p->at[i];
+        if (!a->trwaly) continue;
+        memcpy(sterta[3 * i], a->state, slowa_stanu(a) * sizeof(uint64_t));
+        memcpy(sterta[3 * i + 1], a->input, ILE_UINT(a->typ->n) * sizeof(uint64_t));
+        memcpy(sterta[3 * i + 2], a->output, ILE_UINT(a->typ->m) * sizeof(uint64_t));
+        a->state = sterta[3 * i];
+        a->input = sterta[3 * i + 1];
+        a->output = sterta[3 * i + 2];
+        a->trwaly = NULL;
+    }
+    free(sterta);
+    return true;
+}
+
+/**
+ * Zwalnia zasoby; bufory automatow wracaja na sterte, a biezacy cykl nie jest zatwierdzany.
+ * Bez pamieci na bufory odwzorowanie zostaje, zeby automaty pozostaly uzywalne.
+ */
+void ma_persist_close(ma_persist_t *p) {
+    if (!p) return;
+    if (p->mapa) {
+        if (przenies_na_sterte(p)) {
+            munmap(p->mapa, p->rozmiar_naglowka + 2 * p->rozmiar_banku);
+        } else {
+            errno = ENOMEM;
+        }
+    }
+    if (p->fd >= 0) {
+        close(p->fd);
+    }
+    free(p->polozenie);
+    free(p->zmiana);
+    free(p->at);
+    free(p);
+}
+
+/** Otwiera (lub tworzy) plik stanu sieci; istniejacy zatwierdzony stan jest wczytywany do automatow. */
+ma_persist_t *ma_persist_open(char const *path, moore_t *at[], size_t num,
+                              size_t interval) {
+    if (!path || !at || num == 0 || interval == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t slowa = 0;
+    uint64_t uklad = skrot(0xcbf29ce484222325ULL, num);
+    bool kombinacyjne = false;
+    for (size_t i = 0; i < num; i++) {
+        // Historia przesuwa wskaznik wyjścia, a zbiory wyrzutow zwalniaja bufory
+        if (!at[i] || at[i]->historia || at[i]->wyrzut || at[i]->trwaly) {
+            errno = EINVAL;
+            return NULL;
+        }
+        ma_type_t const *typ = at[i]->typ;
+        slowa += slowa_automatu(at[i]);
+        uklad = skrot(skrot(skrot(uklad, typ->n), typ->m), typ->s);
+        kombinacyjne |= kombinacyjny(at[i]);
+    }
+    for (size_t i = 0; i < num; i++) {
+        for (size_t j = i + 1; j < num; j++) {
+            if (at[i] == at[j]) {
+                errno = EINVAL;
+                return NULL;
+            }
+        }
+    }
+
+    ma_persist_t *p = calloc(1, sizeof(ma_persist_t));
+    if (!p) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    p->fd = -1;
+    p->at = calloc(num, sizeof(moore_t *));
+    p->polozenie = calloc(num, sizeof(size_t));
+    p->zmiana = calloc(num, sizeof(uint64_t));
+    if (!p->at || !p->polozenie || !p->zmiana) {
+        ma_persist_close(p);
+        errno = ENOMEM;
+        return NULL;
+    }
+    memcpy(p->at, at, num * sizeof(moore_t *));
+    p->num = num;
+    p->interval = interval;
+    p->uklad = uklad;
+    p->kombinacyjne = kombinacyjne;
+    for (size_t i = 1; i < num; i++) {
+        p->polozenie[i] = p->polozenie[i - 1] + slowa_automatu(at[i - 1]);
+    }
+
+    size_t strona = (size_t)sysconf(_SC_PAGESIZE);
+    p->rozmiar_naglowka = strona;
+    p->rozmiar_banku = (slowa * sizeof(uint64_t) + strona - 1) / strona * strona;
+    size_t rozmiar = p->rozmiar_naglowka + 2 * p->rozmiar_banku;
+
+    struct stat st;
+    p->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (p->fd < 0 || fstat(p->fd, &st) != 0 ||
+        ((size_t)st.st_size != rozmiar && ftruncate(p->fd, (off_t)rozmiar) != 0)) {
+        int blad = errno;
+        ma_persist_close(p);
+        errno = blad;
+        return NULL;
+    }
+    void *mapa = mmap(NULL, rozmiar, PROT_READ | PROT_WRITE, MAP_SHARED, p->fd, 0);
+    if (mapa == MAP_FAILED) {
+        int blad = errno;
+        ma_persist_close(p);
+        errno = blad;
+        return NULL;
+    }
+    p->mapa = mapa;
+
+    // Wybieramy najnowszy poprawny slot dziennika
+    naglowek_t const *najnowszy = NULL;
+    for (size_t k = 0; k < SLOTY; k++) {
+        naglowek_t const *h = (naglowek_t const *)p->mapa + k;
+        if (h->magia == MAGIA && h->uklad == uklad && h->bank < 2 &&
+            h->suma == suma_naglowka(h) && (!najnowszy || h->numer > najnowszy->numer)) {
+            najnowszy = h;
+        }
+    }
+    if (najnowszy) {
+        p->cykl = najnowszy->cykl;
+        p->bank = najnowszy->bank;
+        p->numer = najnowszy->numer;
+        kopiuj_bank(p, p->bank, p->bank ^ 1, true);
+    } else {
+        // Nowy plik: biezace bufory trafiaja do zywego banku i zostana zatwierdzone jako cykl 0
+        memset(p->mapa, 0, p->rozmiar_naglowka);
+        p->bank = 1;
+        uint64_t *zywy = poczatek_banku(p, 0);
+        for (size_t i = 0; i < num; i++) {
+            moore_t const *a = at[i];
+            uint64_t *b = zywy + p->polozenie[i];
+            memcpy(b, a->state, slowa_stanu(a) * sizeof(uint64_t));
+            b += slowa_stanu(a);
+            memcpy(b, a->input, ILE_UINT(a->typ->n) * sizeof(uint64_t));
+            b += ILE_UINT(a->typ->n);
+            memcpy(b, a->output, ILE_UINT(a->typ->m) * sizeof(uint64_t));
+        }
+    }
+    for (size_t i = 0; i < num; i++) {
+        moore_t *a = at[i];
+        free(a->state);
+        free(a->input);
+        free(a->output);
+        a->trwaly = p;
+        a->zmiana_wyjscia = epoka;
+        a->brudny = true;
+    }
+    ustaw_bufory(p, p->bank ^ 1);
+    p->przelaczenie = p->cykl;
+
+    if (!najnowszy && ma_persist_commit(p) != 0) {
+        int blad = errno;
+        ma_persist_close(p);
+        errno = blad;
+        return NULL;
+    }
+    return p;
+}
+
+/** Zatwierdza biezacy cykl: msync zywego banku, nowy naglowek, zamiana bankow. */
+int ma_persist_commit(ma_persist_t *p) {
+    if (!p) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t zywy = p->bank ^ 1;
+    if (msync(poczatek_banku(p, zywy), p->rozmiar_banku, MS_SYNC) != 0) {
+        return -1;
+    }
+
+    naglowek_t h = {
+        .magia = MAGIA,
+        .uklad = p->uklad,
+        .cykl = p->cykl,
+        .bank = zywy,
+        .numer = p->numer + 1,
+    };
+    h.suma = suma_naglowka(&h);
+    memcpy((naglowek_t *)p->mapa + h.numer % SLOTY, &h, sizeof(h));
+    if (msync(p->mapa, p->rozmiar_naglowka, MS_SYNC) != 0) {
+        return -1;
+    }
+    // Pierwsza zamiana wypelnia pusty bank w calosci, kolejne tylko zmienione automaty
+    kopiuj_bank(p, zywy, p->bank, p->numer == 0);
+    p->bank = zywy;
+    p->numer = h.numer;
+    ustaw_bufory(p, zywy ^ 1);
+    p->przelaczenie = p->cykl;
+    return 0;
+}
+
+/** Wykonuje krok sieci i co `interval` cykli zatwierdza jej stan. */
+int ma_persist_step(ma_persist_t *p) {
+    if (!p) {
+        errno = EINVAL;
+        return -1;
+    }
+    // Silnik pomijajacy nie dotyka automatow, ktore sie nie zmienia; wynik jak z ma_step
+    int wynik = p->kombinacyjne ? krok_sieci(p->at, p->num, NULL)
+                                : krok_sledzony(p->at, p->num, true, NULL);
+    if (slad_wlaczony) slad_krok(p->at, p->num, 1, false, wynik);
+    if (wynik != 0) {
+        return -1;
+    }
+    p->cykl++;
+    for (size_t i = 0; i < p->num; i++) {
+        moore_t const *a = p->at[i];
+        if (a->brudny || a->odczyt_wejsc == epoka) {
+            p->zmiana[i] = p->cykl;
+        }
+    }
+    if (p->cykl % p->interval == 0) {
+        return ma_persist_commit(p);
+    }
+    return 0;
+}
+
+/** Zwraca numer cyklu stanu trzymanego w pamieci. */
+uint64_t ma_persist_cycle(ma_persist_t const *p) {
+    if (!p) {
+        errno = EINVAL;
+        return 0;
+    }
+    return p->cykl;
+}
@@ -0,0 +1,84 @@
+#ifndef MA_PROBES_H
+#define MA_PROBES_H
+
+// Statyczne punkty sledzenia USDT (dostawca "libma") dla bpftrace, perf i SystemTap.
+// Nieaktywny punkt to pojedyncza instrukcja nop; opis argumentow trafia do sekcji
+// .note.stapsdt. Uzywamy <sys/sdt.h>, a gdy go brak, na x86-64 wlasnej, zgodnej z nim
+// postaci notatki. -DMA_NO_PROBES wylacza punkty calkowicie.
+//
+// Punkty i argumenty (kolejno arg0, arg1, ...):
+//   create__entry(n, m, s)             create__return(automat, n, m, s)
+//   delete__entry(automat)             delete__return(automat)
+//   connect__entry(a_in, in, a_out, num)   connect__return(a_in, wynik)
+//   disconnect__entry(a_in, in, num)   disconnect__return(a_in, wynik)
+//   set_input__entry(automat)          set_input__return(automat, wynik)
+//   set_state__entry(automat)          set_state__return(automat, wynik)
+//   get_output__entry(automat)         get_output__return(automat, wyjscie)
+//   step__entry(num, cykl)             step__prepared(num, bajty next_state)
+//   step__transitioned(num)            step__return(num, cykl, wynik)
+//   tuned__entry(num, cykle)           tuned__return(num, cykle, wynik)
+//   alloc__failure(bajty)
+// `cykl` to numer kroku ma_step w procesie; wynik to 0 albo -1; automat 0 po nieudanym
+// utworzeniu; wyjscie to adres bufora wyjścia lub 0. Po delete__return adres jest juz wolny.
+
+#include <stdint.h>
+
+#if !defined(MA_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define MA_PROBE0(nazwa) DTRACE_PROBE(libma, nazwa)
+#define MA_PROBE1(nazwa, a) DTRACE_PROBE1(libma, nazwa, (int64_t)(a))
+#define MA_PROBE2(nazwa, a, b) DTRACE_PROBE2(libma, nazwa, (int64_t)(a), (int64_t)(b))
+#define MA_PROBE3(nazwa, a, b, c) \
+    DTRACE_PROBE3(libma, nazwa, (int64_t)(a), (int64_t)(b), (int64_t)(c))
+#define MA_PROBE4(nazwa, a, b, c, d) \
+    DTRACE_PROBE4(libma, nazwa, (int64_t)(a), (int64_t)(b), (int64_t)(c), (int64_t)(d))
+#elif defined(__x86_64__) && defined(__GNUC__)
+// Notatka w formacie stapsdt v3: adres nop, baza .stapsdt.base, semafor (brak),
+// dostawca, nazwa i opisy argumentow "-8@<operand>"
+#define MA_SDT(nazwa, opis, ...)                                                   \
+    __asm__ __volatile__("990: nop\n"                                              \
+                         ".pushsection .note.stapsdt,\"?\",\"note\"\n"             \
+                         ".balign 4\n"                                             \
+                         ".4byte 992f-991f, 994f-993f, 3\n"                        \
+                         "991: .asciz \"stapsdt\"\n"                               \
+                         "992: .balign 4\n"                                        \
+                         "993: .8byte 990b\n"                                      \
+                         ".8byte _.stapsdt.base\n"                                 \
+                         ".8byte 0\n"                                              \
+                         ".asciz \"libma\"\n"                                      \
+                         ".asciz \"" #nazwa "\"\n"                                 \
+                         ".asciz \"" opis "\"\n"                                   \
+                         "994: .balign 4\n"                                        \
+                         ".popsection\n"                                           \
+                         ".ifndef _.stapsdt.base\n"                                \
+                         ".pushsection .stapsdt.base,\"aG\",\"progbits\","         \
+                         ".stapsdt.base,comdat\n"                                  \
+                         ".weak _.stapsdt.base\n"                                  \
+                         ".hidden _.stapsdt.base\n"                                \
+                         "_.stapsdt.base: .space 1\n"                              \
+                         ".size _.stapsdt.base, 1\n"                               \
+                         ".popsection\n"                                           \
+                         ".endif\n" ::__VA_ARGS__)
+#define MA_PROBE0(nazwa) MA_SDT(nazwa, "")
+#define MA_PROBE1(nazwa, a) MA_SDT(nazwa, "-8@%0", "nor"((int64_t)(a)))
+#define MA_PROBE2(nazwa, a, b) \
+    MA_SDT(nazwa, "-8@%0 -8@%1", "nor"((int64_t)(a)), "nor"((int64_t)(b)))
+#define MA_PROBE3(nazwa, a, b, c)                                            \
+    MA_SDT(nazwa, "-8@%0 -8@%1 -8@%2", "nor"((int64_t)(a)), "nor"((int64_t)(b)), \
+           "nor"((int64_t)(c)))
+#define MA_PROBE4(nazwa, a, b, c, d)                                                   \
+    MA_SDT(nazwa, "-8@%0 -8@%1 -8@%2 -8@%3", "nor"((int64_t)(a)), "nor"((int64_t)(b)), \
+           "nor"((int64_t)(c)), "nor"((int64_t)(d)))
+#endif
+#endif
+
+#ifndef MA_PROBE0
+#define MA_PROBE0(nazwa) ((void)0)
+#define MA_PROBE1(nazwa, a) ((void)(a))
+#define MA_PROBE2(nazwa, a, b) ((void)(a), (void)(b))
+#define MA_PROBE3(nazwa, a, b, c) ((void)(a), (void)(b), (void)(c))
+#define MA_PROBE4(nazwa, a, b, c, d) ((void)(a), (void)(b), (void)(c), (void)(d))
+#endif
+
+#endif
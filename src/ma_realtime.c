@@ -0,0 +1,337 @@
+// Tryb czasu rzeczywistego: krok sieci bez alokacji, wywolan systemowych i usypiania.
+//
+// Przy tworzeniu przydzielamy wszystkie bufory next_state i stosy watkow roboczych,
+// dotykamy kazdej strony pamieci sieci (opcjonalnie blokujac ja mlock) i dzielimy automaty
+// na ciagle przedzialy o podobnym koszcie. Krok to trzy bariery: start, koniec przejść
+// i koniec zatwierdzania. Watki robocze czekaja na barierach w petli aktywnej; dopiero
+// po bardzo dlugim oczekiwaniu (brak krokow) oddaja procesor przez sched_yield.
+
+#define _GNU_SOURCE
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define STOS (256 * 1024) // Stos watku roboczego, caly dotkniety przy starcie
+#define LINIA 64 // Rozmiar linii pamieci podrecznej
+#define OBROTY_DO_USTAPIENIA (1u << 14) // Obroty petli oczekiwania przed sched_yield
+
+typedef struct bariera {
+    size_t licznik __attribute__((aligned(LINIA)));
+    unsigned faza __attribute__((aligned(LINIA)));
+    size_t uczestnicy;
+} bariera_t;
+
+typedef struct pracownik {
+    struct ma_realtime *rt;
+    size_t od, do_; // Przedzial automatow
+    pthread_t watek;
+    void *stos;
+} pracownik_t;
+
+struct ma_realtime {
+    moore_t **at;
+    size_t num;
+    uint64_t **nastepne; // nastepne[i]: bufor next_state at[i]
+    uint64_t *bufor_nastepnych;
+    size_t rozmiar_nastepnych;
+    pracownik_t *pracownicy; // pracownicy[0] to watek wolajacy
+    size_t watki, uruchomione;
+    bariera_t bariera;
+    bool koniec;
+    bool zablokowane; // Pamiec zablokowana mlock
+};
+
+static inline void pauza(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+/** Bariera z odwracana faza; czeka w petli aktywnej. */
+static void czekaj(bariera_t *b) {
+    unsigned faza = __atomic_load_n(&b->faza, __ATOMIC_ACQUIRE);
+    if (__atomic_add_fetch(&b->licznik, 1, __ATOMIC_ACQ_REL) == b->uczestnicy) {
+        __atomic_store_n(&b->licznik, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&b->faza, faza + 1, __ATOMIC_RELEASE);
+        return;
+    }
+    unsigned obroty = 0;
+    while (__atomic_load_n(&b->faza, __ATOMIC_ACQUIRE) == faza) {
+        pauza();
+        if (++obroty == OBROTY_DO_USTAPIENIA) {
+            sched_yield();
+            obroty = 0;
+        }
+    }
+}
+
+static void przejscia(ma_realtime_t *rt, size_t od, size_t do_) {
+    for (size_t i = od; i < do_; i++) {
+        moore_t *a = rt->at[i];
+        a->next_state = rt->nastepne[i];
+        przejscie_automatu(a);
+    }
+}
+
+static void zatwierdzenia(ma_realtime_t *rt, size_t od, size_t do_) {
+    for (size_t i = od; i < do_; i++) {
+        moore_t *a = rt->at[i];
+        zatwierdzenie_automatu(a);
+        a->zmiana_wyjscia = epoka;
+        a->brudny = true;
+        a->next_state = NULL;
+    }
+}
+
+static void *petla_pracownika(void *arg) {
+    pracownik_t *p = arg;
+    ma_realtime_t *rt = p->rt;
+    // Strony stosu sa juz dotkniete, ale pierwsze wywolania tez nie moga powodowac bledow strony
+    volatile char zapas[4096];
+    memset((char *)zapas, 0, sizeof(zapas));
+    for (;;) {
+        czekaj(&rt->bariera);
+        if (__atomic_load_n(&rt->koniec, __ATOMIC_ACQUIRE)) break;
+        przejscia(rt, p->od, p->do_);
+        czekaj(&rt->bariera);
+        zatwierdzenia(rt, p->od, p->do_);
+        czekaj(&rt->bariera);
+    }
+    return NULL;
+}
+
+/** Zapisuje kazda strone bloku, zeby krok nie trafial na pierwsze odwolania do stron. */
+static void dotknij(void *p, size_t rozmiar) {
+    if (!p || rozmiar == 0) return;
+    size_t strona = (size_t)sysconf(_SC_PAGESIZE);
+    volatile char *c = p;
+    for (size_t k = 0; k < rozmiar; k += strona) c[k] = c[k];
+    c[rozmiar - 1] = c[rozmiar - 1];
+}
+
+/** Wszystkie bloki pamieci kroku, z historia, licznikami i tablicami; `f` dostaje kazdy. */
+static int dla_pamieci(ma_realtime_t *rt, blok_pamieci_t f) {
+    int wynik = 0;
+    for (size_t i = 0; i < rt->num; i++) {
+        moore_t *a = rt->at[i];
+        ma_type_t const *typ = a->typ;
+        wynik |= f(a, sizeof(moore_t));
+        wynik |= f(typ, sizeof(ma_type_t));
+        wynik |= f(a->state, ILE_UINT(typ->s) * sizeof(uint64_t));
+        wynik |= f(a->input, ILE_UINT(typ->n) * sizeof(uint64_t));
+        wynik |= f(a->output, ILE_UINT(typ->m) * sizeof(uint64_t));
+        wynik |= f(a->podlaczenia_do_a, typ->n * sizeof(polaczenie_t));
+        wynik |= historia_dla_pamieci(a, f);
+        wynik |= aktywnosc_dla_pamieci(a, f);
+        wynik |= tabela_dla_pamieci(typ, f);
+    }
+    wynik |= f(rt, sizeof(ma_realtime_t));
+    wynik |= f(rt->at, rt->num * sizeof(moore_t *));
+    wynik |= f(rt->nastepne, rt->num * sizeof(uint64_t *));
+    wynik |= f(rt->bufor_nastepnych, rt->rozmiar_nastepnych);
+    wynik |= f(rt->pracownicy, rt->watki * sizeof(pracownik_t));
+    for (size_t k = 1; k < rt->watki; k++) wynik |= f(rt->pracownicy[k].stos, STOS);
+    return wynik;
+}
+
+static int dotknij_blok(void const *p, size_t rozmiar) {
+    dotknij((void *)p, rozmiar);
+    return 0;
+}
+
+static int zablokuj(void const *p, size_t rozmiar) {
+    return p && rozmiar > 0 && mlock(p, rozmiar) != 0 ? -1 : 0;
+}
+
+static int odblokuj(void const *p, size_t rozmiar) {
+    if (p && rozmiar > 0) munlock(p, rozmiar);
+    return 0;
+}
+
+/** Zatrzymuje watki robocze i zwalnia zasoby; automaty sieci zostaja. */
+void ma_realtime_destroy(ma_realtime_t *rt) {
+    if (!rt) return;
+    if (rt->uruchomione > 0) {
+        __atomic_store_n(&rt->koniec, true, __ATOMIC_RELEASE);
+        czekaj(&rt->bariera);
+        for (size_t k = 1; k <= rt->uruchomione; k++) pthread_join(rt->pracownicy[k].watek, NULL);
+    }
+    if (rt->zablokowane) dla_pamieci(rt, odblokuj);
+    for (size_t k = 1; rt->pracownicy && k < rt->watki; k++) free(rt->pracownicy[k].stos);
+    free(rt->pracownicy);
+    free(rt->bufor_nastepnych);
+    free(rt->nastepne);
+    free(rt->at);
+    free(rt);
+}
+
+/** Dzieli automaty na `watki` ciaglych przedzialow o zblizonej liczbie bitow do policzenia. */
+static void podziel(ma_realtime_t *rt) {
+    size_t suma = 0;
+    for (size_t i = 0; i < rt->num; i++) suma += 1 + rt->at[i]->typ->n + rt->at[i]->typ->s;
+    size_t i = 0, dotad = 0;
+    for (size_t k = 0; k < rt->watki; k++) {
+        rt->pracownicy[k].od = i;
+        size_t cel = suma * (k + 1) / rt->watki;
+        while (i < rt->num && (k + 1 == rt->watki || dotad < cel)) {
+            dotad += 1 + rt->at[i]->typ->n + rt->at[i]->typ->s;
+            i++;
+        }
+        rt->pracownicy[k].do_ = i;
+    }
+}
+
+/** Przypina watek roboczy do k-tego (cyklicznie) procesora dozwolonego dla procesu. */
+static void przypnij(pthread_attr_t *atrybuty, size_t k) {
+    cpu_set_t dozwolone, jeden;
+    if (sched_getaffinity(0, sizeof(dozwolone), &dozwolone) != 0) return;
+    int ile = CPU_COUNT(&dozwolone);
+    if (ile <= 0) return;
+    int cel = (int)(k % (size_t)ile);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &dozwolone) && cel-- == 0) {
+            CPU_ZERO(&jeden);
+            CPU_SET(cpu, &jeden);
+            pthread_attr_setaffinity_np(atrybuty, sizeof(jeden), &jeden);
+            return;
+        }
+    }
+}
+
+/**
+ * Przygotowuje siec `at` do krokow czasu rzeczywistego na `threads` watkach (0: liczba
+ * procesorow, w tym wolajacy). Automaty musza istniec, dopoki tryb nie zostanie zniszczony.
+ */
+ma_realtime_t *ma_realtime_create(moore_t *at[], size_t num, size_t threads, unsigned flags) {
+    if (!at || num == 0 || (flags & ~(MA_RT_PIN | MA_RT_LOCK))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (!at[i] || kombinacyjny(at[i])) {
+            errno = EINVAL;
+            return NULL;
+        }
+        if (at[i]->wyrzut) {
+            errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+            return NULL;
+        }
+    }
+    if (threads == 0) {
+        long procesory = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = procesory > 0 ? (size_t)procesory : 1;
+    }
+    if (threads > num) threads = num;
+
+    ma_realtime_t *rt = calloc(1, sizeof(ma_realtime_t));
+    if (!rt) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    rt->num = num;
+    rt->watki = threads;
+    rt->at = malloc(num * sizeof(moore_t *));
+    rt->nastepne = malloc(num * sizeof(uint64_t *));
+    rt->pracownicy = calloc(threads, sizeof(pracownik_t));
+    size_t slowa = 0;
+    for (size_t i = 0; i < num; i++) {
+        // Bufory automatow wyrownane do linii, zeby watki nie dzielily linii
+        slowa += (ILE_UINT(at[i]->typ->s) + LINIA / 8 - 1) / (LINIA / 8) * (LINIA / 8);
+    }
+    rt->rozmiar_nastepnych = slowa * sizeof(uint64_t);
+    void *bufor = NULL;
+    if (posix_memalign(&bufor, LINIA, rt->rozmiar_nastepnych) != 0) bufor = NULL;
+    rt->bufor_nastepnych = bufor;
+    bool gotowe = rt->at && rt->nastepne && rt->pracownicy && rt->bufor_nastepnych;
+    for (size_t k = 1; gotowe && k < threads; k++) {
+        if (posix_memalign(&rt->pracownicy[k].stos, (size_t)sysconf(_SC_PAGESIZE), STOS) != 0) {
+            rt->pracownicy[k].stos = NULL;
+            gotowe = false;
+        }
+    }
+    if (!gotowe) {
+        ma_realtime_destroy(rt);
+        errno = ENOMEM;
+        return NULL;
+    }
+    memcpy(rt->at, at, num * sizeof(moore_t *));
+    uint64_t *p = rt->bufor_nastepnych;
+    for (size_t i = 0; i < num; i++) {
+        rt->nastepne[i] = p;
+        p += (ILE_UINT(at[i]->typ->s) + LINIA / 8 - 1) / (LINIA / 8) * (LINIA / 8);
+    }
+    podziel(rt);
+
+    dla_pamieci(rt, dotknij_blok);
+    if (flags & MA_RT_LOCK) {
+        rt->zablokowane = true;
+        if (dla_pamieci(rt, zablokuj) != 0) {
+            int blad = errno;
+            ma_realtime_destroy(rt);
+            errno = blad;
+            return NULL;
+        }
+    }
+
+    rt->bariera.uczestnicy = threads;
+    for (size_t k = 1; k < threads; k++) {
+        pracownik_t *w = &rt->pracownicy[k];
+        w->rt = rt;
+        pthread_attr_t atrybuty;
+        pthread_attr_init(&atrybuty);
+        pthread_attr_setstack(&atrybuty, w->stos, STOS);
+        if (flags & MA_RT_PIN) przypnij(&atrybuty, k);
+        int blad = pthread_create(&w->watek, &atrybuty, petla_pracownika, w);
+        pthread_attr_destroy(&atrybuty);
+        if (blad != 0) {
+            // Bariera czeka na wszystkich; konczymy tylko juz uruchomione watki
+            rt->bariera.uczestnicy = rt->uruchomione + 1;
+            ma_realtime_destroy(rt);
+            errno = blad;
+            return NULL;
+        }
+        rt->uruchomione++;
+    }
+    return rt;
+}
+
+/** Jeden krok sieci; nie alokuje pamieci i nie wola systemu. */
+int ma_realtime_step(ma_realtime_t *rt) {
+    if (!rt) {
+        errno = EINVAL;
+        return -1;
+    }
+    pracownik_t *p = &rt->pracownicy[0];
+    if (rt->watki > 1) czekaj(&rt->bariera);
+    przejscia(rt, p->od, p->do_);
+    if (rt->watki > 1) czekaj(&rt->bariera);
+    zatwierdzenia(rt, p->od, p->do_);
+    if (rt->watki > 1) czekaj(&rt->bariera);
+    return 0;
+}
+
+/** `cycles` krokow; czas kazdego trafia do histogramu MA_PHASE_STEP `latency` (opcjonalnie). */
+int ma_realtime_run(ma_realtime_t *rt, size_t cycles, ma_latency_t *latency) {
+    if (!rt) {
+        errno = EINVAL;
+        return -1;
+    }
+    double ns_na_takt = nanosekundy_na_takt();
+    for (size_t c = 0; c < cycles; c++) {
+        uint64_t poczatek = takt();
+        ma_realtime_step(rt);
+        if (latency) {
+            uint64_t ns = (uint64_t)((double)(takt() - poczatek) * ns_na_takt);
+            if (ma_latency_record(latency, MA_PHASE_STEP, ns) != 0) return -1;
+        }
+    }
+    return 0;
+}
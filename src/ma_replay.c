@@ -0,0 +1,63 @@
+// Odtwarza nagranie wywołań API (ma_trace_start) z pełną prędkością i wypisuje czasy.
+//
+// Użycie: ma_replay plik_nagrania [powtórzenia]
+//
+// Program nie zna funkcji przejść nagrywającej aplikacji, więc podstawia za nie funkcje
+// zastępcze (MA_REPLAY_STUBS): czasy opisują narzut biblioteki na danej sekwencji wywołań.
+// Aplikacja może odtworzyć nagranie z własnymi funkcjami: ma_trace_register_* i ma_replay.
+
+#include "ma.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static char const *const names[MA_TRACE_CALLS] = {
+  [MA_TRACE_CREATE_FULL] = "ma_create_full",
+  [MA_TRACE_CREATE_SIMPLE] = "ma_create_simple",
+  [MA_TRACE_DELETE] = "ma_delete",
+  [MA_TRACE_CONNECT] = "ma_connect",
+  [MA_TRACE_DISCONNECT] = "ma_disconnect",
+  [MA_TRACE_SET_INPUT] = "ma_set_input",
+  [MA_TRACE_SET_STATE] = "ma_set_state",
+  [MA_TRACE_STEP] = "ma_step",
+  [MA_TRACE_RUN_TUNED] = "ma_run_tuned",
+  [MA_TRACE_CREATE_FROM_TYPE] = "ma_create_from_type",
+  [MA_TRACE_CREATE_COMB] = "ma_create_comb",
+};
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Użycie:\n%s plik_nagrania [powtórzenia]\n", argv[0]);
+    return 2;
+  }
+  unsigned long repetitions = argc == 3 ? strtoul(argv[2], NULL, 10) : 1;
+  if (repetitions == 0)
+    repetitions = 1;
+
+  struct ma_replay_report total = {0};
+  for (unsigned long r = 0; r < repetitions; ++r) {
+    struct ma_replay_report report;
+    if (ma_replay(argv[1], MA_REPLAY_STUBS, &report) != 0) {
+      perror(argv[1]);
+      return 1;
+    }
+    for (int k = 0; k < MA_TRACE_CALLS; ++k) {
+      total.calls[k] += report.calls[k];
+      total.ns[k] += report.ns[k];
+    }
+    total.skipped += report.skipped;
+    total.mismatches += report.mismatches;
+  }
+
+  double sum = 0;
+  printf("%-20s %12s %14s %12s\n", "wywołanie", "liczba", "łącznie [ms]", "ns/wywołanie");
+  for (int k = 0; k < MA_TRACE_CALLS; ++k) {
+    if (total.calls[k] == 0)
+      continue;
+    sum += total.ns[k];
+    printf("%-20s %12llu %14.3f %12.1f\n", names[k], (unsigned long long)total.calls[k],
+           total.ns[k] / 1e6, total.ns[k] / (double)total.calls[k]);
+  }
+  printf("razem: %.3f ms, pominięte: %llu, inny wynik niż w nagraniu: %llu\n", sum / 1e6,
+         (unsigned long long)total.skipped, (unsigned long long)total.mismatches);
+  return 0;
+}
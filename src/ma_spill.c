@@ -0,0 +1,454 @@
+// Symulacja sieci wiekszych niz pamiec: bufory bezczynnych automatow w pliku.
+//
+// Zbior liczy kroki silnikiem pomijajacym (ma_tuned.c), ktory nie dotyka buforow
+// automatow MA_TYPE_PURE stabilnych przy niezmienionych wejściach. Takie automaty po
+// `idle_cycles` krokach bezczynnosci moga oddac state i input do pliku, gdy bufory zbioru
+// przekraczaja budzet; najpierw wypadaja najdluzej bezczynne. Wyjścia zostaja w pamieci,
+// wiec dzieci i ma_get_output czytaja je bez przywracania. Automat wraca przed krokiem,
+// w ktorym moze sie zmienic, a gdy wyjście rodzica zmienilo sie w tym kroku, zapowiadamy
+// odczyt jego bufora (posix_fadvise), zeby jadro wczytalo go w tle.
+//
+// Zbior bez pliku trzyma wyrzucone bufory w pamieci, skompresowane. Kod to ciag znacznikow
+// z dwoma bitami rodzaju i licznikiem 1..64 slow: slowa zerowe, powtorzenia poprzedniego
+// slowa, indeksy jednobajtowe slownika zbioru albo slowa doslowne. Slowa doslowne widziane
+// PROMOCJA razy trafiaja do slownika; wpisy nie zmieniaja sie, wiec stare bloki pozostaja
+// czytelne.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define ZERA 0u // Rodzaje znacznikow kodu: slowa zerowe
+#define POWTORZENIA 1u // Kopie poprzedniego slowa
+#define ZE_SLOWNIKA 2u // Jednobajtowe indeksy slownika
+#define DOSLOWNE 3u // Slowa zapisane wprost
+#define SERIA 64 // Najdluzsza seria jednego znacznika
+#define SLOWNIK 256 // Pojemnosc slownika zbioru
+#define KOSZE 1024 // Rozmiar tablicy liczacej slowa doslowne (potega 2)
+#define PROBY 8 // Dlugosc przeszukiwania liniowego w tablicy
+#define PROMOCJA 3 // Liczba wystapien slowa, po ktorej trafia do slownika
+
+// Slowo doslowne zliczane do slownika
+typedef struct kosz {
+    uint64_t slowo; // Slowo (0: wolny kosz)
+    uint32_t licznik; // Liczba wystapien w zakodowanych buforach
+    int32_t indeks; // Pozycja w slowniku lub -1
+} kosz_t;
+
+// Automat kandydujacy do wyrzucenia
+typedef struct kandydat {
+    uint64_t bezczynnosc; // Liczba krokow bez zmiany stanu
+    size_t indeks; // Numer automatu w zbiorze
+} kandydat_t;
+
+struct ma_spill {
+    moore_t **at; // Kopia tablicy automatow zbioru
+    size_t num; // Liczba automatow
+    size_t budzet; // Dopuszczalny rozmiar state i input w pamieci
+    size_t prog; // Liczba krokow bezczynnosci, po ktorej automat mozna wyrzucic
+    uint64_t *bezczynnosc; // Kroki bez zmiany stanu kazdego automatu
+    kandydat_t *kandydaci; // Bufor na kandydatow do wyrzucenia
+    int fd; // Deskryptor pliku wyrzutow
+    size_t rezydentne; // Bajty state i input w pamieci
+    size_t wyrzucone; // Liczba wyrzuconych automatow
+    size_t bajty_wyrzucone; // Bajty state i input w pliku
+    uint64_t wyrzucenia, przywrocenia, zapowiedzi; // Liczniki do ma_spill_stats
+
+    // Kompresja w pamieci (zbior bez pliku)
+    uint8_t *roboczy; // Bufor kodowania o rozmiarze najgorszego przypadku
+    size_t bajty_skompresowane; // Laczny rozmiar blokow w pamieci
+    uint64_t slownik[SLOWNIK]; // Czeste slowa doslowne
+    size_t w_slowniku; // Liczba wpisow slownika
+    kosz_t kosze[KOSZE]; // Liczniki slow doslownych
+};
+
+/** Rozmiar state i input automatu w bajtach. */
+static size_t rozmiar_buforow(moore_t const *a) {
+    return (ILE_UINT(a->typ->s) + ILE_UINT(a->typ->n)) * sizeof(uint64_t);
+}
+
+/** Czy automat moze opuscic pamiec: krok silnika pomijajacego go nie liczy, gdy jest stabilny. */
+static bool wyrzucalny(moore_t const *a) {
+    return (a->typ->flagi & MA_TYPE_PURE) && !kombinacyjny(a) && !zatwierdzany_co_krok(a) &&
+           a->typ->s > 0;
+}
+
+/** Zapisuje caly bufor pod danym polozeniem pliku. */
+static int zapisz(int fd, void const *bufor, size_t rozmiar, uint64_t pozycja) {
+    char const *p = bufor;
+    while (rozmiar > 0) {
+        ssize_t k = pwrite(fd, p, rozmiar, (off_t)pozycja);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += k;
+        rozmiar -= (size_t)k;
+        pozycja += (uint64_t)k;
+    }
+    return 0;
+}
+
+/** Wczytuje caly bufor spod danego polozenia pliku. */
+static int wczytaj(int fd, void *bufor, size_t rozmiar, uint64_t pozycja) {
+    char *p = bufor;
+    while (rozmiar > 0) {
+        ssize_t k = pread(fd, p, rozmiar, (off_t)pozycja);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (k == 0) {
+            errno = EIO;
+            return -1;
+        }
+        p += k;
+        rozmiar -= (size_t)k;
+        pozycja += (uint64_t)k;
+    }
+    return 0;
+}
+
+/** Kosz slowa w tablicy licznikow albo NULL, gdy slowa nie ma i nie ma dla niego miejsca. */
+static kosz_t *kosz_slowa(ma_spill_t *sp, uint64_t w) {
+    size_t h = (size_t)((w * 0x9e3779b97f4a7c15ULL) >> 54);
+    for (size_t k = 0; k < PROBY; k++) {
+        kosz_t *ko = &sp->kosze[(h + k) & (KOSZE - 1)];
+        if (ko->slowo == w || ko->slowo == 0) {
+            return ko;
+        }
+    }
+    return NULL;
+}
+
+/** Indeks slowa w slowniku lub -1. */
+static int w_slowniku(ma_spill_t *sp, uint64_t w) {
+    kosz_t const *ko = kosz_slowa(sp, w);
+    return ko && ko->slowo == w ? ko->indeks : -1;
+}
+
+/** Zlicza slowo doslowne; po PROMOCJA wystapieniach dopisuje je do slownika. */
+static void policz_doslowne(ma_spill_t *sp, uint64_t w) {
+    kosz_t *ko = kosz_slowa(sp, w);
+    if (!ko) return;
+    if (ko->slowo == 0) {
+        *ko = (kosz_t){.slowo = w, .indeks = -1};
+    }
+    if (++ko->licznik >= PROMOCJA && ko->indeks < 0 && sp->w_slowniku < SLOWNIK) {
+        ko->indeks = (int32_t)sp->w_slowniku;
+        sp->slownik[sp->w_slowniku++] = w;
+    }
+}
+
+/** Koduje `ile` slow do `wyj`; zwraca liczbe bajtow kodu. */
+static size_t koduj(ma_spill_t *sp, uint64_t const *slowa, size_t ile, uint8_t *wyj) {
+    size_t o = 0;
+    for (size_t i = 0; i < ile;) {
+        uint64_t w = slowa[i];
+        unsigned rodzaj = w == 0                        ? ZERA
+                          : i > 0 && w == slowa[i - 1] ? POWTORZENIA
+                          : w_slowniku(sp, w) >= 0      ? ZE_SLOWNIKA
+                                                        : DOSLOWNE;
+        size_t znacznik = o++, k = 0;
+        for (; k < SERIA && i < ile; k++, i++) {
+            w = slowa[i];
+            if (rodzaj == ZERA) {
+                if (w != 0) break;
+            } else if (rodzaj == POWTORZENIA) {
+                if (w != slowa[i - 1]) break;
+            } else {
+                // Zera i powtorzenia przerywaja serie, bo koduja sie taniej
+                if (w == 0 || (i > 0 && w == slowa[i - 1])) break;
+                int indeks = w_slowniku(sp, w);
+                if ((rodzaj == ZE_SLOWNIKA) != (indeks >= 0)) break;
+                if (rodzaj == ZE_SLOWNIKA) {
+                    wyj[o++] = (uint8_t)indeks;
+                } else {
+                    memcpy(wyj + o, &w, sizeof(w));
+                    o += sizeof(w);
+                    policz_doslowne(sp, w);
+                }
+            }
+        }
+        wyj[znacznik] = (uint8_t)(rodzaj << 6 | (k - 1));
+    }
+    return o;
+}
+
+/** Dekoduje `ile` slow z `we`; zwraca liczbe przeczytanych bajtow kodu. */
+static size_t dekoduj(ma_spill_t const *sp, uint8_t const *we, uint64_t *slowa, size_t ile) {
+    size_t o = 0;
+    for (size_t i = 0; i < ile;) {
+        unsigned rodzaj = we[o] >> 6;
+        size_t k = (size_t)(we[o++] & (SERIA - 1)) + 1;
+        for (; k > 0; k--, i++) {
+            switch (rodzaj) {
+            case ZERA: slowa[i] = 0; break;
+            case POWTORZENIA: slowa[i] = slowa[i - 1]; break;
+            case ZE_SLOWNIKA: slowa[i] = sp->slownik[we[o++]]; break;
+            default:
+                memcpy(&slowa[i], we + o, sizeof(uint64_t));
+                o += sizeof(uint64_t);
+            }
+        }
+    }
+    return o;
+}
+
+/** Zapisuje state i input do pliku albo do bloku skompresowanego; 1, gdy kompresja nic nie daje. */
+static int zapisz_bufory(ma_spill_t *sp, moore_t *a) {
+    size_t slowa_s = ILE_UINT(a->typ->s), slowa_n = ILE_UINT(a->typ->n);
+    if (sp->fd >= 0) {
+        if (zapisz(sp->fd, a->state, slowa_s * sizeof(uint64_t), a->wyrzut_pozycja) != 0 ||
+            zapisz(sp->fd, a->input, slowa_n * sizeof(uint64_t),
+                   a->wyrzut_pozycja + slowa_s * sizeof(uint64_t)) != 0) {
+            return -1;
+        }
+        return 0;
+    }
+    size_t rozmiar = koduj(sp, a->state, slowa_s, sp->roboczy);
+    rozmiar += koduj(sp, a->input, slowa_n, sp->roboczy + rozmiar);
+    if (rozmiar >= rozmiar_buforow(a)) {
+        return 1;
+    }
+    a->wyrzut_blok = malloc(rozmiar);
+    if (!a->wyrzut_blok) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(a->wyrzut_blok, sp->roboczy, rozmiar);
+    a->wyrzut_pozycja = rozmiar;
+    sp->bajty_skompresowane += rozmiar;
+    return 0;
+}
+
+/** Przenosi state i input automatu do pliku lub bloku i zwalnia je; 1, gdy nie warto. */
+static int wyrzuc(ma_spill_t *sp, moore_t *a) {
+    size_t slowa_n = ILE_UINT(a->typ->n);
+    int wynik = zapisz_bufory(sp, a);
+    if (wynik != 0) {
+        return wynik;
+    }
+    free(a->state);
+    a->state = NULL;
+    if (slowa_n > 0) {
+        free(a->input);
+        a->input = NULL;
+    }
+    a->wyrzut = sp;
+    size_t rozmiar = rozmiar_buforow(a);
+    sp->rezydentne -= rozmiar;
+    sp->bajty_wyrzucone += rozmiar;
+    sp->wyrzucone++;
+    sp->wyrzucenia++;
+    return 0;
+}
+
+/** Wczytuje z pliku state i input wyrzuconego automatu. */
+int przywroc_wyrzucony(moore_t *a) {
+    ma_spill_t *sp = a->wyrzut;
+    size_t slowa_s = ILE_UINT(a->typ->s), slowa_n = ILE_UINT(a->typ->n);
+    uint64_t *stan = malloc(slowa_s * sizeof(uint64_t));
+    uint64_t *wejscie = slowa_n > 0 ? malloc(slowa_n * sizeof(uint64_t)) : NULL;
+    if (!stan || (slowa_n > 0 && !wejscie)) {
+        free(stan);
+        free(wejscie);
+        errno = ENOMEM;
+        return -1;
+    }
+    if (sp->fd < 0) {
+        size_t o = dekoduj(sp, a->wyrzut_blok, stan, slowa_s);
+        dekoduj(sp, a->wyrzut_blok + o, wejscie, slowa_n);
+        free(a->wyrzut_blok);
+        a->wyrzut_blok = NULL;
+        sp->bajty_skompresowane -= a->wyrzut_pozycja;
+    } else if (wczytaj(sp->fd, stan, slowa_s * sizeof(uint64_t), a->wyrzut_pozycja) != 0 ||
+               wczytaj(sp->fd, wejscie, slowa_n * sizeof(uint64_t),
+                       a->wyrzut_pozycja + slowa_s * sizeof(uint64_t)) != 0) {
+        free(stan);
+        free(wejscie);
+        return -1;
+    }
+    a->state = stan;
+    if (slowa_n > 0) {
+        a->input = wejscie;
+    }
+    a->wyrzut = NULL;
+    size_t rozmiar = rozmiar_buforow(a);
+    sp->rezydentne += rozmiar;
+    sp->bajty_wyrzucone -= rozmiar;
+    sp->wyrzucone--;
+    sp->przywrocenia++;
+    return 0;
+}
+
+static int porownaj_kandydatow(void const *x, void const *y) {
+    uint64_t a = ((kandydat_t const *)x)->bezczynnosc;
+    uint64_t b = ((kandydat_t const *)y)->bezczynnosc;
+    return (a < b) - (a > b);
+}
+
+/** Wyrzuca najdluzej bezczynne automaty: do pliku ponad budzet, kompresuje wszystkie bezczynne. */
+static int zmiesc_w_budzecie(ma_spill_t *sp) {
+    size_t ile = 0;
+    for (size_t i = 0; i < sp->num; i++) {
+        moore_t const *a = sp->at[i];
+        if (!a->wyrzut && sp->bezczynnosc[i] >= sp->prog && !potrzebny(a)) {
+            sp->kandydaci[ile++] = (kandydat_t){.bezczynnosc = sp->bezczynnosc[i], .indeks = i};
+        }
+    }
+    qsort(sp->kandydaci, ile, sizeof(kandydat_t), porownaj_kandydatow);
+    // Kompresja w pamieci nie kosztuje I/O, wiec nie czeka na przekroczenie budzetu
+    bool bez_budzetu = sp->fd < 0;
+    for (size_t k = 0; k < ile && (bez_budzetu || sp->rezydentne > sp->budzet); k++) {
+        size_t i = sp->kandydaci[k].indeks;
+        int wynik = wyrzuc(sp, sp->at[i]);
+        if (wynik < 0) {
+            return -1;
+        }
+        if (wynik > 0) {
+            // Bufory nie kurcza sie; sprobujemy ponownie po kolejnym okresie bezczynnosci
+            sp->bezczynnosc[i] = 0;
+        }
+    }
+    return 0;
+}
+
+static void zwolnij(ma_spill_t *sp) {
+    if (sp->fd >= 0) {
+        close(sp->fd);
+    }
+    free(sp->at);
+    free(sp->bezczynnosc);
+    free(sp->kandydaci);
+    free(sp->roboczy);
+    free(sp);
+}
+
+/** Otwiera zbior automatow z plikiem wyrzutow `path` (NULL: kompresja w pamieci) i budzetem. */
+ma_spill_t *ma_spill_open(char const *path, moore_t *at[], size_t num, size_t budget,
+                          size_t idle_cycles) {
+    if (!at || num == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t najwiecej_slow = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (!at[i] || at[i]->wyrzut || at[i]->trwaly) {
+            errno = EINVAL;
+            return NULL;
+        }
+        size_t slowa = rozmiar_buforow(at[i]) / sizeof(uint64_t);
+        najwiecej_slow = slowa > najwiecej_slow ? slowa : najwiecej_slow;
+    }
+    ma_spill_t *sp = calloc(1, sizeof(ma_spill_t));
+    if (!sp) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    sp->fd = -1;
+    sp->at = calloc(num, sizeof(moore_t *));
+    sp->bezczynnosc = calloc(num, sizeof(uint64_t));
+    sp->kandydaci = calloc(num, sizeof(kandydat_t));
+    // Najgorszy przypadek kodu: same slowa doslowne i znacznik na kazda serie w obu buforach
+    sp->roboczy = path ? NULL : malloc(najwiecej_slow * (sizeof(uint64_t) + 1) + 2);
+    if (!sp->at || !sp->bezczynnosc || !sp->kandydaci || (!path && !sp->roboczy)) {
+        zwolnij(sp);
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (path) {
+        sp->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (sp->fd < 0) {
+            int blad = errno;
+            zwolnij(sp);
+            errno = blad;
+            return NULL;
+        }
+        // Plik jest prywatny dla zbioru; po zamknieciu deskryptora znika
+        unlink(path);
+    }
+    memcpy(sp->at, at, num * sizeof(moore_t *));
+    sp->num = num;
+    sp->budzet = budget;
+    sp->prog = idle_cycles;
+    uint64_t pozycja = 0;
+    for (size_t i = 0; i < num; i++) {
+        at[i]->wyrzut_pozycja = pozycja;
+        pozycja += rozmiar_buforow(at[i]);
+        sp->rezydentne += rozmiar_buforow(at[i]);
+    }
+    return sp;
+}
+
+/** Krok zbioru: przywraca automaty, ktore moga sie zmienic, liczy je i wyrzuca nadmiar. */
+int ma_spill_step(ma_spill_t *sp) {
+    if (!sp) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i = 0; i < sp->num; i++) {
+        moore_t *a = sp->at[i];
+        if (a->wyrzut && potrzebny(a)) {
+            if (przywroc_wyrzucony(a) != 0) {
+                return -1;
+            }
+            sp->bezczynnosc[i] = 0;
+        }
+    }
+    if ((sp->fd < 0 || sp->rezydentne > sp->budzet) && zmiesc_w_budzecie(sp) != 0) {
+        return -1;
+    }
+    if (krok_sledzony(sp->at, sp->num, true, NULL) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < sp->num; i++) {
+        moore_t *a = sp->at[i];
+        if (!a->wyrzut) {
+            sp->bezczynnosc[i] = a->stabilny && wyrzucalny(a) ? sp->bezczynnosc[i] + 1 : 0;
+        } else if (sp->fd >= 0 && potrzebny(a)) {
+            // Wyjście rodzica wlasnie sie zmienilo: automat wroci w nastepnym kroku
+            posix_fadvise(sp->fd, (off_t)a->wyrzut_pozycja, (off_t)rozmiar_buforow(a),
+                          POSIX_FADV_WILLNEED);
+            sp->zapowiedzi++;
+        }
+    }
+    return 0;
+}
+
+/** Wypelnia raport zajetosci pamieci i licznikow zbioru. */
+int ma_spill_stats(ma_spill_t const *sp, struct ma_spill_report *report) {
+    if (!sp || !report) {
+        errno = EINVAL;
+        return -1;
+    }
+    *report = (struct ma_spill_report){
+        .automata = sp->num,
+        .spilled = sp->wyrzucone,
+        .resident_bytes = sp->rezydentne,
+        .spilled_bytes = sp->bajty_wyrzucone,
+        .compressed_bytes = sp->bajty_skompresowane,
+        .evictions = sp->wyrzucenia,
+        .restores = sp->przywrocenia,
+        .prefetches = sp->zapowiedzi,
+    };
+    return 0;
+}
+
+/** Przywraca wszystkie automaty i zamyka zbior; przy bledzie zbior pozostaje otwarty. */
+int ma_spill_close(ma_spill_t *sp) {
+    if (!sp) {
+        return 0;
+    }
+    for (size_t i = 0; i < sp->num; i++) {
+        if (sp->at[i]->wyrzut && przywroc_wyrzucony(sp->at[i]) != 0) {
+            return -1;
+        }
+    }
+    zwolnij(sp);
+    return 0;
+}
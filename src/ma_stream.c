@@ -0,0 +1,718 @@
+// Przepuszczanie strumienia symboli przez pojedynczy automat jednym wywolaniem.
+//
+// Kazdy symbol zastepuje najmlodsze bity wejścia, po czym automat wykonuje krok,
+// dokladnie jak ciag ma_set_input, ma_step(&a, 1) i ma_get_output. Rodzice automatu
+// nie wykonuja krokow, wiec podlaczone bity wejścia sa w trakcie strumienia stale.
+// Dla malych automatow stan, wejście i wyjście sa trzymane w zmiennych lokalnych.
+// Automaty o co najwyzej 16 stanach moga byc wykonywane rownolegle: strumien jest
+// dzielony na fragmenty, a kazdy watek liczy swoj fragment ze wszystkich stanow
+// poczatkowych naraz, scalajac sciezki, ktore trafily do tego samego stanu.
+// Wiele takich automatow z osobnymi strumieniami liczymy wektorowo, po jednym w pasie.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Czy automat pobiera jakis bit wejścia z wlasnego wyjścia. */
+static bool petla_wlasna(moore_t const *a) {
+    for (size_t j = 0; j < a->typ->n; j++) {
+        if (a->podlaczenia_do_a[j].a_z_kad == a) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Wersja dla s, n, m <= 64: jedno slowo stanu, wejścia i wyjścia w zmiennych lokalnych. */
+static void strumien_maly(moore_t *a, uint64_t const *symbole, size_t ile, size_t bity,
+                          uint64_t *out, size_t out_stride) {
+    ma_type_t const *typ = a->typ;
+    bool tozsamosc = typ->flagi & MA_TYPE_IDENTITY_OUTPUT;
+    size_t n = typ->n;
+    uint64_t maska_symbolu = bity == 64 ? UINT64_MAX : (1ULL << bity) - 1;
+
+    // Podlaczone bity sa stale: wyznaczamy je raz
+    aktualizuj_wejscie(a);
+    uint64_t maska_pol = 0;
+    for (size_t j = 0; j < n; j++) {
+        if (a->podlaczenia_do_a[j].a_z_kad) {
+            maska_pol |= 1ULL << j;
+        }
+    }
+    uint64_t wartosc_pol = a->input[0] & maska_pol;
+    uint64_t wejscie = a->input[0], stan = a->state[0], nastepny, wyjscie;
+
+    for (size_t k = 0; k < ile; k++) {
+        wejscie = (wejscie & ~maska_symbolu) | symbol(symbole, k, bity);
+        wejscie = (wejscie & ~maska_pol) | wartosc_pol;
+        nastepny = stan;
+        przejscie_kroku(typ, &nastepny, &wejscie, &stan);
+        stan = nastepny;
+        if (out) {
+            if (tozsamosc) {
+                wyjscie = stan;
+            } else {
+                wyjscie_typu(typ, &wyjscie, &stan);
+            }
+            out[k * out_stride] = wyjscie;
+        }
+    }
+    a->input[0] = wejscie;
+    a->state[0] = stan;
+}
+
+/** Czy strumien automatu liczymy bez bufora nastepnego stanu (strumien_maly). */
+static bool strumien_bez_bufora(moore_t const *a) {
+    ma_type_t const *typ = a->typ;
+    return typ->n <= 64 && typ->s <= 64 && typ->m <= 64 && !zatwierdzany_co_krok(a) &&
+           !petla_wlasna(a);
+}
+
+/** Wykonuje strumien dla poprawnych argumentow; `bufor` ma ILE_UINT(s) slow, gdy potrzebny. */
+static void wykonaj_strumien(moore_t *a, uint64_t const *symbols, size_t count,
+                             size_t symbol_bits, uint64_t *out, size_t out_stride,
+                             uint64_t *bufor) {
+    ma_type_t const *typ = a->typ;
+    size_t slowa_s = ILE_UINT(typ->s), slowa_m = ILE_UINT(typ->m);
+
+    if (strumien_bez_bufora(a)) {
+        strumien_maly(a, symbols, count, symbol_bits, out, out_stride);
+    } else {
+        uint64_t maska_symbolu = symbol_bits == 64 ? UINT64_MAX : (1ULL << symbol_bits) - 1;
+        size_t kopiowane = out_stride < slowa_m ? out_stride : slowa_m;
+        a->next_state = bufor;
+        for (size_t k = 0; k < count; k++) {
+            a->input[0] = (a->input[0] & ~maska_symbolu) | symbol(symbols, k, symbol_bits);
+            aktualizuj_wejscie(a);
+            memcpy(a->next_state, a->state, slowa_s * sizeof(uint64_t));
+            przejscie_kroku(typ, a->next_state, a->input, a->state);
+            if (a->aktywnosc) {
+                aktywnosc_zatwierdz(a);
+            } else {
+                memcpy(a->state, a->next_state, slowa_s * sizeof(uint64_t));
+                zatwierdz_wyjscie(a);
+            }
+            if (out) {
+                memcpy(out + k * out_stride, a->output, kopiowane * sizeof(uint64_t));
+            }
+        }
+        a->next_state = NULL;
+    }
+
+    oblicz_wyjscie(a);
+    a->zmiana_wyjscia = epoka;
+    a->brudny = true;
+}
+
+/** Przepuszcza `count` symboli po `symbol_bits` bitow przez automat, zapisujac wyjścia po kazdym kroku. */
+int ma_run_stream(moore_t *a, uint64_t const *symbols, size_t count, size_t symbol_bits,
+                  uint64_t *out, size_t out_stride) {
+    if (!a || (!symbols && count > 0) || symbol_bits == 0 || symbol_bits > 64 ||
+        symbol_bits > a->typ->n || kombinacyjny(a)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (a->wyrzut) {
+        errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (out_stride == 0) {
+        out = NULL;
+    }
+    uint64_t *bufor = NULL;
+    if (!strumien_bez_bufora(a)) {
+        bufor = calloc(ILE_UINT(a->typ->s), sizeof(uint64_t));
+        if (!bufor) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    wykonaj_strumien(a, symbols, count, symbol_bits, out, out_stride, bufor);
+    free(bufor);
+    return 0;
+}
+
+/** RÓWNOLEGLE WYKONANIE STRUMIENIA DLA AUTOMATOW O MALYM STANIE **/
+
+#define STANY 16 // Maksymalna liczba stanow automatu tabelaryzowanego (s <= 4)
+#define BITY_TABELI 16 // Maksymalna szerokosc symbolu tabelaryzowanego automatu
+#define SCALANIE 64 // Co ile symboli laczymy zbiezne sciezki
+
+// Automat stablicowany przez wyliczenie funkcji przejścia dla wszystkich par (stan, symbol)
+typedef struct tabela_strumienia {
+    uint8_t *przejscia; // przejscia[x * STANY + q]: stan po symbolu x ze stanu q
+    uint64_t wyjscia[STANY]; // Pierwsze slowo wyjścia dla kazdego stanu
+    uint64_t wejscie; // Wejście z wyzerowanymi bitami symbolu i ustalonymi bitami podlaczonymi
+    uint64_t maska_pol; // Bity wejścia pobierane od rodzicow
+} tabela_strumienia_t;
+
+/** Wyznacza wejście automatu (n <= 64) bez bitow symbolu oraz maske bitow podlaczonych. */
+static void wejscie_bazowe(moore_t *a, size_t bity, uint64_t *wejscie, uint64_t *maska_pol) {
+    aktualizuj_wejscie(a);
+    *maska_pol = 0;
+    for (size_t j = 0; j < a->typ->n; j++) {
+        if (a->podlaczenia_do_a[j].a_z_kad) {
+            *maska_pol |= 1ULL << j;
+        }
+    }
+    uint64_t maska_symbolu = bity == 64 ? UINT64_MAX : (1ULL << bity) - 1;
+    *wejscie = a->input[0] & ~(maska_symbolu & ~*maska_pol);
+}
+
+/**
+ * Tabelaryzuje automat dla symboli o `bity` bitach. Zwraca 1, gdy automat nie spelnia
+ * warunkow: czysty typ, s <= 4, n, m <= 64, stan i wszystkie nastepniki mieszcza sie
+ * w s bitach, brak petli wlasnej i licznikow przelaczen; -1 przy braku pamieci.
+ */
+static int tabelaryzuj(moore_t *a, size_t bity, tabela_strumienia_t *tab) {
+    ma_type_t const *typ = a->typ;
+    size_t stany = (size_t)1 << typ->s;
+    if (!(typ->flagi & MA_TYPE_PURE) || typ->s > 4 || typ->n > 64 || typ->m > 64 ||
+        bity > BITY_TABELI || zatwierdzany_co_krok(a) || petla_wlasna(a) ||
+        a->state[0] >= stany) {
+        return 1;
+    }
+    size_t symbole = (size_t)1 << bity;
+    tab->przejscia = calloc(symbole * STANY, sizeof(uint8_t));
+    if (!tab->przejscia) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    wejscie_bazowe(a, bity, &tab->wejscie, &tab->maska_pol);
+    uint64_t maska_pol = tab->maska_pol;
+
+    for (uint64_t q = 0; q < stany; q++) {
+        uint64_t stan = q;
+        if (typ->flagi & MA_TYPE_IDENTITY_OUTPUT) {
+            tab->wyjscia[q] = q;
+        } else {
+            wyjscie_typu(typ, &tab->wyjscia[q], &stan);
+        }
+        for (uint64_t x = 0; x < symbole; x++) {
+            uint64_t wejscie = tab->wejscie | (x & ~maska_pol), nastepny = q;
+            przejscie_typu(typ, &nastepny, &wejscie, &stan);
+            if (nastepny >= stany) {
+                free(tab->przejscia);
+                tab->przejscia = NULL;
+                return 1;
+            }
+            tab->przejscia[x * STANY + q] = (uint8_t)nastepny;
+        }
+    }
+    return 0;
+}
+
+// Zadanie jednego watku: fragment strumienia
+typedef struct fragment {
+    tabela_strumienia_t const *tab;
+    uint64_t const *symbole;
+    size_t od, do_; // Zakres symboli [od, do_)
+    size_t bity;
+    uint8_t mapa[STANY]; // Stan koncowy fragmentu dla kazdego stanu poczatkowego
+    uint8_t start; // Prawdziwy stan poczatkowy (faza wyjśc)
+    uint64_t *out;
+    size_t out_stride;
+} fragment_t;
+
+/** Faza 1: wyznacza mape stan poczatkowy -> stan koncowy fragmentu, scalajac zbiezne sciezki. */
+static void *mapuj_fragment(void *arg) {
+    fragment_t *f = arg;
+    uint8_t const *przejscia = f->tab->przejscia;
+    uint8_t sciezki[STANY], sciezka_stanu[STANY];
+    size_t ile = STANY;
+    for (size_t q = 0; q < STANY; q++) {
+        sciezki[q] = (uint8_t)q;
+        sciezka_stanu[q] = (uint8_t)q;
+    }
+    for (size_t k = f->od; k < f->do_;) {
+        size_t koniec = k + SCALANIE < f->do_ ? k + SCALANIE : f->do_;
+        if (ile == 1) {
+            uint8_t q = sciezki[0];
+            for (; k < koniec; k++) {
+                q = przejscia[symbol(f->symbole, k, f->bity) * STANY + q];
+            }
+            sciezki[0] = q;
+            continue;
+        }
+        for (; k < koniec; k++) {
+            uint8_t const *wiersz = przejscia + symbol(f->symbole, k, f->bity) * STANY;
+            for (size_t i = 0; i < ile; i++) {
+                sciezki[i] = wiersz[sciezki[i]];
+            }
+        }
+        // Sciezki, ktore doszly do tego samego stanu, dalej ida razem
+        size_t nowe = 0;
+        uint8_t indeks[STANY];
+        for (size_t i = 0; i < ile; i++) {
+            size_t j = 0;
+            while (j < nowe && sciezki[j] != sciezki[i]) j++;
+            if (j == nowe) {
+                sciezki[nowe++] = sciezki[i];
+            }
+            indeks[i] = (uint8_t)j;
+        }
+        for (size_t q = 0; q < STANY; q++) {
+            sciezka_stanu[q] = indeks[sciezka_stanu[q]];
+        }
+        ile = nowe;
+    }
+    for (size_t q = 0; q < STANY; q++) {
+        f->mapa[q] = sciezki[sciezka_stanu[q]];
+    }
+    return NULL;
+}
+
+/** Faza 2: przechodzi fragment z prawdziwego stanu poczatkowego, zapisujac wyjścia. */
+static void *wyjscia_fragmentu(void *arg) {
+    fragment_t *f = arg;
+    uint8_t const *przejscia = f->tab->przejscia;
+    uint64_t const *wyjscia = f->tab->wyjscia;
+    uint8_t q = f->start;
+    for (size_t k = f->od; k < f->do_; k++) {
+        q = przejscia[symbol(f->symbole, k, f->bity) * STANY + q];
+        f->out[k * f->out_stride] = wyjscia[q];
+    }
+    return NULL;
+}
+
+/** Uruchamia `funkcja` dla kazdego fragmentu: ostatni w biezacym watku, reszta w nowych. */
+static void rownolegle(void *(*funkcja)(void *), fragment_t *fragmenty, pthread_t *watki,
+                       size_t ile) {
+    size_t uruchomione = 0;
+    for (; uruchomione + 1 < ile; uruchomione++) {
+        if (pthread_create(&watki[uruchomione], NULL, funkcja, &fragmenty[uruchomione]) != 0) {
+            break;
+        }
+    }
+    // Fragmenty, dla ktorych nie udalo sie utworzyc watku, liczymy sami
+    for (size_t i = uruchomione; i < ile; i++) {
+        funkcja(&fragmenty[i]);
+    }
+    for (size_t i = 0; i < uruchomione; i++) {
+        pthread_join(watki[i], NULL);
+    }
+}
+
+/**
+ * Jak ma_run_stream, ale dla automatow o co najwyzej 16 stanach dzieli strumien na
+ * `threads` fragmentow liczonych spekulatywnie ze wszystkich stanow poczatkowych.
+ * Automaty, ktorych nie da sie stablicowac, sa wykonywane przez ma_run_stream.
+ */
+int ma_run_stream_parallel(moore_t *a, uint64_t const *symbols, size_t count,
+                           size_t symbol_bits, uint64_t *out, size_t out_stride,
+                           size_t threads) {
+    if (!a || (!symbols && count > 0) || symbol_bits == 0 || symbol_bits > 64 ||
+        symbol_bits > a->typ->n || kombinacyjny(a)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (a->wyrzut) {
+        errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+        return -1;
+    }
+    if (threads == 0) {
+        long procesory = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = procesory > 0 ? (size_t)procesory : 1;
+    }
+    if (threads > count / SCALANIE) {
+        threads = count / SCALANIE;
+    }
+    // Tablica kosztuje STANY * 2^bity wywolan t; oplaca sie tylko dla dlugich strumieni
+    if (threads < 2 || symbol_bits > BITY_TABELI || count / 4 < ((size_t)STANY << symbol_bits)) {
+        return ma_run_stream(a, symbols, count, symbol_bits, out, out_stride);
+    }
+    tabela_strumienia_t tab = {0};
+    int wynik = tabelaryzuj(a, symbol_bits, &tab);
+    if (wynik < 0) {
+        return -1;
+    }
+    if (wynik > 0) {
+        return ma_run_stream(a, symbols, count, symbol_bits, out, out_stride);
+    }
+
+    fragment_t *fragmenty = calloc(threads, sizeof(fragment_t));
+    pthread_t *watki = calloc(threads, sizeof(pthread_t));
+    if (!fragmenty || !watki) {
+        free(fragmenty);
+        free(watki);
+        free(tab.przejscia);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (size_t i = 0; i < threads; i++) {
+        fragmenty[i] = (fragment_t){
+            .tab = &tab, .symbole = symbols, .bity = symbol_bits,
+            .od = count * i / threads, .do_ = count * (i + 1) / threads,
+            .out = out, .out_stride = out_stride,
+        };
+    }
+
+    rownolegle(mapuj_fragment, fragmenty, watki, threads);
+    uint8_t q = (uint8_t)a->state[0];
+    for (size_t i = 0; i < threads; i++) {
+        fragmenty[i].start = q;
+        q = fragmenty[i].mapa[q];
+    }
+    if (out && out_stride > 0) {
+        rownolegle(wyjscia_fragmentu, fragmenty, watki, threads);
+    }
+
+    a->input[0] = tab.wejscie | (symbol(symbols, count - 1, symbol_bits) & ~tab.maska_pol);
+    a->state[0] = q;
+    oblicz_wyjscie(a);
+    a->zmiana_wyjscia = epoka;
+    a->brudny = true;
+
+    free(fragmenty);
+    free(watki);
+    free(tab.przejscia);
+    return 0;
+}
+
+/** WIELE NIEZALEZNYCH STRUMIENI NARAZ **/
+
+#define BITY_PASOW 4 // Maksymalna szerokosc symbolu w wykonaniu wielopasowym
+#define PASY 32 // Maksymalna liczba pasow jednego przebiegu
+
+// Automaty jednej grupy (wspolna tablica) liczone jednoczesnie, po jednym w pasie
+typedef struct pasy {
+    uint8_t const *przejscia; // Tablica grupy, wiersz STANY bajtow na symbol
+    uint64_t const *wyjscia; // Wyjścia grupy dla kazdego stanu
+    size_t symbole; // Liczba roznych symboli (2^bity)
+    size_t bity; // Szerokosc symbolu
+    size_t ile; // Liczba zajetych pasow
+    bool pisz; // Czy zapisujemy wyjścia
+    size_t out_stride;
+    uint64_t const *strumienie[PASY];
+    uint64_t *out[PASY];
+    uint8_t stany[PASY]; // Stany pasow; wolne pasy maja stan 0
+} pasy_t;
+
+typedef void (*silnik_pasow_t)(pasy_t *p, size_t count);
+
+/** Zbiera k-ty symbol kazdego pasa; wolne pasy dostaja symbol 0. */
+static inline void zbierz_symbole(pasy_t const *p, size_t k, uint8_t *x, size_t szerokosc) {
+    size_t i = 0;
+    for (; i < p->ile; i++) {
+        x[i] = (uint8_t)symbol(p->strumienie[i], k, p->bity);
+    }
+    for (; i < szerokosc; i++) {
+        x[i] = 0;
+    }
+}
+
+static inline void zapisz_wyjscia(pasy_t const *p, size_t k) {
+    for (size_t i = 0; i < p->ile; i++) {
+        if (p->out[i]) {
+            p->out[i][k * p->out_stride] = p->wyjscia[p->stany[i]];
+        }
+    }
+}
+
+static void pasy_skalarne(pasy_t *p, size_t count) {
+    for (size_t k = 0; k < count; k++) {
+        for (size_t i = 0; i < p->ile; i++) {
+            uint64_t x = symbol(p->strumienie[i], k, p->bity);
+            p->stany[i] = p->przejscia[x * STANY + p->stany[i]];
+        }
+        if (p->pisz) {
+            zapisz_wyjscia(p, k);
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// Wiersz tablicy miesci sie w rejestrze, wiec krok 16 pasow to jedno PSHUFB na symbol:
+// kazdy pas bierze wynik z wiersza swojego symbolu przez maske porownania.
+__attribute__((target("ssse3")))
+static void pasy_ssse3(pasy_t *p, size_t count) {
+    __m128i wiersze[1 << BITY_PASOW];
+    for (size_t v = 0; v < p->symbole; v++) {
+        wiersze[v] = _mm_loadu_si128((__m128i const *)(p->przejscia + v * STANY));
+    }
+    __m128i stany = _mm_loadu_si128((__m128i const *)p->stany);
+    uint8_t x[16];
+    for (size_t k = 0; k < count; k++) {
+        zbierz_symbole(p, k, x, 16);
+        __m128i symbole = _mm_loadu_si128((__m128i const *)x), nowe = _mm_setzero_si128();
+        for (size_t v = 0; v < p->symbole; v++) {
+            __m128i maska = _mm_cmpeq_epi8(symbole, _mm_set1_epi8((char)v));
+            nowe = _mm_or_si128(nowe, _mm_and_si128(maska, _mm_shuffle_epi8(wiersze[v], stany)));
+        }
+        stany = nowe;
+        if (p->pisz) {
+            _mm_storeu_si128((__m128i *)p->stany, stany);
+            zapisz_wyjscia(p, k);
+        }
+    }
+    _mm_storeu_si128((__m128i *)p->stany, stany);
+}
+
+// Jak pasy_ssse3, ale 32 pasy; VPSHUFB dziala w polowkach, wiec wiersz jest powielony.
+__attribute__((target("avx2")))
+static void pasy_avx2(pasy_t *p, size_t count) {
+    __m256i wiersze[1 << BITY_PASOW];
+    for (size_t v = 0; v < p->symbole; v++) {
+        __m128i wiersz = _mm_loadu_si128((__m128i const *)(p->przejscia + v * STANY));
+        wiersze[v] = _mm256_broadcastsi128_si256(wiersz);
+    }
+    __m256i stany = _mm256_loadu_si256((__m256i const *)p->stany);
+    uint8_t x[32];
+    for (size_t k = 0; k < count; k++) {
+        zbierz_symbole(p, k, x, 32);
+        __m256i symbole = _mm256_loadu_si256((__m256i const *)x), nowe = _mm256_setzero_si256();
+        for (size_t v = 0; v < p->symbole; v++) {
+            __m256i maska = _mm256_cmpeq_epi8(symbole, _mm256_set1_epi8((char)v));
+            nowe = _mm256_or_si256(nowe,
+                                   _mm256_and_si256(maska, _mm256_shuffle_epi8(wiersze[v], stany)));
+        }
+        stany = nowe;
+        if (p->pisz) {
+            _mm256_storeu_si256((__m256i *)p->stany, stany);
+            zapisz_wyjscia(p, k);
+        }
+    }
+    _mm256_storeu_si256((__m256i *)p->stany, stany);
+}
+#endif
+
+static silnik_pasow_t silnik_pasow = pasy_skalarne;
+static size_t szerokosc_silnika = PASY;
+static pthread_once_t wybrano_silnik = PTHREAD_ONCE_INIT;
+
+/** Wybiera najszerszy silnik obslugiwany przez procesor. */
+static void wybierz_silnik(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        silnik_pasow = pasy_avx2;
+        szerokosc_silnika = 32;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        silnik_pasow = pasy_ssse3;
+        szerokosc_silnika = 16;
+    }
+#endif
+}
+
+// Automat kwalifikujacy sie do wykonania wielopasowego
+typedef struct kandydat {
+    ma_type_t const *typ;
+    uint64_t wejscie, maska_pol; // Razem z typem wyznaczaja tablice
+    size_t indeks; // Pozycja w tablicy at
+} kandydat_t;
+
+static int porownaj_wskazniki(void const *x, void const *y) {
+    uintptr_t a = (uintptr_t)*(moore_t *const *)x, b = (uintptr_t)*(moore_t *const *)y;
+    return (a > b) - (a < b);
+}
+
+static int porownaj_kandydatow(void const *x, void const *y) {
+    kandydat_t const *a = x, *b = y;
+    if (a->typ != b->typ) return (uintptr_t)a->typ < (uintptr_t)b->typ ? -1 : 1;
+    if (a->wejscie != b->wejscie) return a->wejscie < b->wejscie ? -1 : 1;
+    if (a->maska_pol != b->maska_pol) return a->maska_pol < b->maska_pol ? -1 : 1;
+    return (a->indeks > b->indeks) - (a->indeks < b->indeks);
+}
+
+/** Indeks pierwszego kandydata spoza grupy zaczynajacej sie od `od`. */
+static size_t koniec_grupy(kandydat_t const *kandydaci, size_t od, size_t ile) {
+    size_t g = od + 1;
+    while (g < ile && kandydaci[g].typ == kandydaci[od].typ &&
+           kandydaci[g].wejscie == kandydaci[od].wejscie &&
+           kandydaci[g].maska_pol == kandydaci[od].maska_pol) {
+        g++;
+    }
+    return g;
+}
+
+/**
+ * Czy ktorys automat wystepuje dwukrotnie lub czyta wejście z innego automatu listy.
+ * Wtedy kolejnosc wykonania ma znaczenie i strumienie liczymy po kolei.
+ */
+static int zalezne(moore_t *at[], size_t num, bool *wynik) {
+    moore_t **posortowane = calloc(num, sizeof(moore_t *));
+    if (!posortowane) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(posortowane, at, num * sizeof(moore_t *));
+    qsort(posortowane, num, sizeof(moore_t *), porownaj_wskazniki);
+    *wynik = false;
+    for (size_t i = 1; i < num && !*wynik; i++) {
+        *wynik = posortowane[i] == posortowane[i - 1];
+    }
+    for (size_t i = 0; i < num && !*wynik; i++) {
+        for (size_t j = 0; j < at[i]->typ->n && !*wynik; j++) {
+            moore_t *rodzic = at[i]->podlaczenia_do_a[j].a_z_kad;
+            *wynik = rodzic && bsearch(&rodzic, posortowane, num, sizeof(moore_t *),
+                                       porownaj_wskazniki);
+        }
+    }
+    free(posortowane);
+    return 0;
+}
+
+/** Przepuszcza strumienie grupy automatow o wspolnej tablicy przez silnik wielopasowy. */
+static void wykonaj_grupe(moore_t *at[], kandydat_t const *grupa, size_t ile,
+                          tabela_strumienia_t const *tab, uint64_t const *const symbols[],
+                          size_t count, size_t symbol_bits, uint64_t *const out[],
+                          size_t out_stride) {
+    pasy_t p = {
+        .przejscia = tab->przejscia, .wyjscia = tab->wyjscia,
+        .symbole = (size_t)1 << symbol_bits, .bity = symbol_bits,
+        .pisz = out && out_stride > 0, .out_stride = out_stride,
+    };
+    for (size_t od = 0; od < ile; od += szerokosc_silnika) {
+        p.ile = ile - od < szerokosc_silnika ? ile - od : szerokosc_silnika;
+        memset(p.stany, 0, sizeof(p.stany));
+        for (size_t i = 0; i < p.ile; i++) {
+            size_t indeks = grupa[od + i].indeks;
+            p.strumienie[i] = symbols[indeks];
+            p.out[i] = p.pisz ? out[indeks] : NULL;
+            p.stany[i] = (uint8_t)at[indeks]->state[0];
+        }
+        silnik_pasow(&p, count);
+        for (size_t i = 0; i < p.ile; i++) {
+            moore_t *a = at[grupa[od + i].indeks];
+            a->input[0] = tab->wejscie |
+                          (symbol(p.strumienie[i], count - 1, symbol_bits) & ~tab->maska_pol);
+            a->state[0] = p.stany[i];
+            oblicz_wyjscie(a);
+            a->zmiana_wyjscia = epoka;
+            a->brudny = true;
+        }
+    }
+}
+
+/** Czy automat moze trafic do silnika wielopasowego (tabelaryzacja moze go jeszcze odrzucic). */
+static bool kandydat(moore_t const *a) {
+    ma_type_t const *typ = a->typ;
+    return (typ->flagi & MA_TYPE_PURE) && typ->s <= 4 && typ->n <= 64 && typ->m <= 64 &&
+           !zatwierdzany_co_krok(a) && a->state[0] < STANY;
+}
+
+/**
+ * Dziala jak ma_run_stream(at[i], symbols[i], ...) dla kolejnych i. Czyste automaty
+ * o s <= 4 i symbolach do 4 bitow sa grupowane wedlug tablicy przejść i liczone po
+ * 16 lub 32 naraz instrukcjami PSHUFB, jesli procesor je obsluguje.
+ */
+int ma_run_streams(moore_t *at[], size_t num, uint64_t const *const symbols[],
+                   size_t count, size_t symbol_bits, uint64_t *const out[],
+                   size_t out_stride) {
+    if (!at || !symbols || symbol_bits == 0 || symbol_bits > 64) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (!at[i] || (!symbols[i] && count > 0) || symbol_bits > at[i]->typ->n ||
+            kombinacyjny(at[i])) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (at[i]->wyrzut) {
+            errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+            return -1;
+        }
+    }
+    if (count == 0 || num == 0) {
+        return 0;
+    }
+    if (out_stride == 0) {
+        out = NULL;
+    }
+    pthread_once(&wybrano_silnik, wybierz_silnik);
+
+    bool kolejno = symbol_bits > BITY_PASOW;
+    if (!kolejno && zalezne(at, num, &kolejno) != 0) {
+        return -1;
+    }
+    // Wszystkie alokacje przed pierwszym automatem, zeby brak pamieci nie zostawil
+    // strumieni w polowie: bufor nastepnego stanu, kandydaci i tablice
+    size_t slowa_bufora = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (!strumien_bez_bufora(at[i]) && ILE_UINT(at[i]->typ->s) > slowa_bufora) {
+            slowa_bufora = ILE_UINT(at[i]->typ->s);
+        }
+    }
+    uint64_t *bufor = slowa_bufora ? calloc(slowa_bufora, sizeof(uint64_t)) : NULL;
+    kandydat_t *kandydaci = NULL;
+    tabela_strumienia_t *tablice = NULL;
+    if (!kolejno) {
+        kandydaci = calloc(num, sizeof(kandydat_t));
+        tablice = calloc(num, sizeof(tabela_strumienia_t));
+    }
+    if ((slowa_bufora && !bufor) || (!kolejno && (!kandydaci || !tablice))) {
+        free(bufor);
+        free(kandydaci);
+        free(tablice);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // Automaty spoza silnika wielopasowego beda liczone osobno; sa od siebie niezalezne
+    size_t ile = 0;
+    for (size_t i = 0; i < num; i++) {
+        moore_t *a = at[i];
+        if (!kolejno && kandydat(a)) {
+            kandydaci[ile].typ = a->typ;
+            kandydaci[ile].indeks = i;
+            wejscie_bazowe(a, symbol_bits, &kandydaci[ile].wejscie, &kandydaci[ile].maska_pol);
+            ile++;
+        }
+    }
+    if (ile > 1) {
+        qsort(kandydaci, ile, sizeof(kandydat_t), porownaj_kandydatow);
+    }
+
+    int wynik = 0;
+    size_t grupy = 0;
+    for (size_t od = 0; od < ile && wynik >= 0; od = koniec_grupy(kandydaci, od, ile)) {
+        wynik = tabelaryzuj(at[kandydaci[od].indeks], symbol_bits, &tablice[grupy++]);
+    }
+    if (wynik < 0) {
+        for (size_t g = 0; g < grupy; g++) {
+            free(tablice[g].przejscia);
+        }
+        free(bufor);
+        free(kandydaci);
+        free(tablice);
+        return -1;
+    }
+
+    // Od tego miejsca nic juz nie alokujemy
+    for (size_t i = 0; i < num; i++) {
+        if (!kolejno && kandydat(at[i])) continue;
+        wykonaj_strumien(at[i], symbols[i], count, symbol_bits, out ? out[i] : NULL,
+                         out_stride, bufor);
+    }
+    for (size_t od = 0, g, k = 0; od < ile; od = g, k++) {
+        g = koniec_grupy(kandydaci, od, ile);
+        if (tablice[k].przejscia) {
+            wykonaj_grupe(at, kandydaci + od, g - od, &tablice[k], symbols, count,
+                          symbol_bits, out, out_stride);
+            free(tablice[k].przejscia);
+            continue;
+        }
+        // Nastepniki nie mieszcza sie w s bitach: grupa liczona po kolei
+        for (size_t i = od; i < g; i++) {
+            size_t indeks = kandydaci[i].indeks;
+            wykonaj_strumien(at[indeks], symbols[indeks], count, symbol_bits,
+                             out ? out[indeks] : NULL, out_stride, bufor);
+        }
+    }
+    free(bufor);
+    free(kandydaci);
+    free(tablice);
+    return 0;
+}
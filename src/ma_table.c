@@ -0,0 +1,719 @@
+// Automaty tablicowe: przejścia i wyjścia trzymane w tablicach biblioteki.
+//
+// Stan automatu tablicowego to numer wiersza, a krok to jeden odczyt
+// przejscia[q << n | x]. Duze tablice sa przy tworzeniu kompresowane: symbole
+// o identycznych kolumnach lacza sie w klasy, a wiersze z dominujacym nastepnikiem
+// zapisuja tylko wyjatki w tablicach grzebieniowych (row displacement), wiec odczyt
+// to nadal dwa lub trzy dostepy do pamieci. ma_table_minimize laczy stany nierozroznialne algorytmem
+// Hopcrofta: zaczyna od podzialu stanow wedlug wyjścia i dzieli bloki przeciwobrazami
+// innych blokow, az podzial przestanie sie zmieniac. Klasy sa potem numerowane tak,
+// by czesto odwiedzane stany (wedlug profilu) lub stany osiagane po sobie (BFS)
+// lezaly obok siebie w tablicy.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAKS_WEJSC 24 // Maksymalna liczba wejśc automatu tablicowego
+#define PROG_GESTEJ (32 * 1024) // Tablice przejść do tej wielkosci nie sa kompresowane
+
+/** Liczba bitow potrzebnych na numer stanu (co najmniej 1). */
+static size_t bity_stanu(size_t stany) {
+    size_t s = 1;
+    while (s < 64 && ((uint64_t)1 << s) < stany) {
+        s++;
+    }
+    return s;
+}
+
+void tabela_zwolnij(tabela_automatu_t *tab) {
+    if (!tab) return;
+    free(tab->przejscia);
+    free(tab->klasy);
+    free(tab->baza);
+    free(tab->domyslny);
+    free(tab->wlasciciel);
+    free(tab->nastepnik);
+    free(tab->wyjscia);
+    free(tab->odwiedziny);
+    free(tab);
+}
+
+int tabela_dla_pamieci(ma_type_t const *typ, blok_pamieci_t f) {
+    tabela_automatu_t const *tab = typ->tabela;
+    if (!tab) return 0;
+    size_t symbole = (size_t)1 << typ->n, u32 = sizeof(uint32_t), u64 = sizeof(uint64_t);
+    int wynik = f(tab, sizeof(*tab)) | f(tab->wyjscia, tab->stany * u64);
+    if (tab->odwiedziny) wynik |= f(tab->odwiedziny, tab->stany * u64);
+    switch (tab->format) {
+    case MA_TABLE_CLASSES:
+        wynik |= f(tab->klasy, symbole * u32) |
+                 f(tab->przejscia, tab->stany * tab->ile_klas * u32);
+        break;
+    case MA_TABLE_DISPLACEMENT:
+        wynik |= f(tab->klasy, symbole * u32) | f(tab->baza, tab->stany * u32) |
+                 f(tab->domyslny, tab->stany * u32) | f(tab->wlasciciel, tab->dlugosc * u32) |
+                 f(tab->nastepnik, tab->dlugosc * u32);
+        break;
+    default:
+        wynik |= f(tab->przejscia, tab->stany * symbole * u32);
+        break;
+    }
+    return wynik;
+}
+
+// Stan lub symbol wraz z kluczem sortowania
+typedef struct klucz {
+    uint64_t wartosc;
+    uint64_t drugi;
+    uint32_t stan;
+} klucz_t;
+
+static int porownaj_klucze(void const *x, void const *y) {
+    klucz_t const *a = x, *b = y;
+    if (a->wartosc != b->wartosc) return a->wartosc < b->wartosc ? -1 : 1;
+    if (a->drugi != b->drugi) return a->drugi < b->drugi ? -1 : 1;
+    return (a->stan > b->stan) - (a->stan < b->stan);
+}
+
+static int porownaj_uint32(void const *x, void const *y) {
+    uint32_t a = *(uint32_t const *)x, b = *(uint32_t const *)y;
+    return (a > b) - (a < b);
+}
+
+/** KOMPRESJA **/
+
+/** Pamiec tablic przejść w danym formacie. */
+static size_t bajty_tabeli(tabela_automatu_t const *tab, size_t n) {
+    size_t symbole = (size_t)1 << n;
+    switch (tab->format) {
+    case MA_TABLE_CLASSES:
+        return (symbole + tab->stany * tab->ile_klas) * sizeof(uint32_t);
+    case MA_TABLE_DISPLACEMENT:
+        return (symbole + 2 * tab->stany + 2 * tab->dlugosc) * sizeof(uint32_t);
+    default:
+        return tab->stany * symbole * sizeof(uint32_t);
+    }
+}
+
+static bool rowne_kolumny(uint32_t const *gesta, size_t stany, size_t n, size_t x, size_t y) {
+    for (size_t q = 0; q < stany; q++) {
+        if (gesta[(q << n) | x] != gesta[(q << n) | y]) return false;
+    }
+    return true;
+}
+
+/**
+ * Dzieli symbole na klasy o identycznych kolumnach tablicy, numerowane wedlug
+ * najmniejszego symbolu. Buduje tab->klasy i tablice stan x klasa; zwraca -1 przy
+ * braku pamieci.
+ */
+static int wyznacz_klasy(tabela_automatu_t *tab, size_t n, uint32_t const *gesta) {
+    size_t symbole = (size_t)1 << n, stany = tab->stany;
+    klucz_t *klucze = calloc(symbole, sizeof(klucz_t));
+    uint32_t *klasy = malloc(symbole * sizeof(uint32_t));
+    uint32_t *numer = malloc(symbole * sizeof(uint32_t));
+    if (!klucze || !klasy || !numer) {
+        free(klucze);
+        free(klasy);
+        free(numer);
+        return -1;
+    }
+    // Skrot kolumny; symbole o rownych skrotach porownujemy dokladnie
+    for (size_t x = 0; x < symbole; x++) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (size_t q = 0; q < stany; q++) {
+            h = (h ^ gesta[(q << n) | x]) * 0x100000001b3ULL;
+        }
+        klucze[x] = (klucz_t){.wartosc = h, .stan = (uint32_t)x};
+    }
+    qsort(klucze, symbole, sizeof(klucz_t), porownaj_klucze);
+    for (size_t od = 0, g; od < symbole; od = g) {
+        for (g = od; g < symbole && klucze[g].wartosc == klucze[od].wartosc; g++) {
+            uint32_t x = klucze[g].stan;
+            klasy[x] = x;
+            // Reprezentantem klasy jest najmniejszy symbol, ktory wystapil wczesniej
+            for (size_t i = od; i < g; i++) {
+                uint32_t y = klucze[i].stan;
+                if (klasy[y] == y && rowne_kolumny(gesta, stany, n, x, y)) {
+                    klasy[x] = y;
+                    break;
+                }
+            }
+        }
+    }
+    size_t ile = 0;
+    for (size_t x = 0; x < symbole; x++) {
+        numer[x] = klasy[x] == x ? (uint32_t)ile++ : numer[klasy[x]];
+    }
+    free(klucze);
+    free(klasy);
+
+    uint32_t *przejscia = malloc(stany * ile * sizeof(uint32_t));
+    if (!przejscia) {
+        free(numer);
+        return -1;
+    }
+    for (size_t q = 0; q < stany; q++) {
+        for (size_t x = 0; x < symbole; x++) {
+            przejscia[q * ile + numer[x]] = gesta[(q << n) | x];
+        }
+    }
+    tab->klasy = numer;
+    tab->ile_klas = ile;
+    tab->przejscia = przejscia;
+    return 0;
+}
+
+/**
+ * Upakowuje tablice stan x klasa: kazdy stan dostaje najczestszy nastepnik jako domyslny,
+ * a pozostale przejścia trafiaja do wspolnych tablic grzebieniowych pod przesunieciem
+ * wiersza dobranym metoda first-fit. Zwraca -1 przy braku pamieci.
+ */
+static int upakuj_wiersze(tabela_automatu_t *tab, uint32_t const *wiersze) {
+    size_t stany = tab->stany, C = tab->ile_klas;
+    uint32_t *baza = calloc(stany, sizeof(uint32_t));
+    uint32_t *domyslny = calloc(stany, sizeof(uint32_t));
+    uint32_t *kopia = malloc(C * sizeof(uint32_t));
+    uint32_t *kolumny = malloc(C * sizeof(uint32_t));
+    klucz_t *kolejnosc = calloc(stany, sizeof(klucz_t));
+    size_t pojemnosc = 2 * C, dlugosc = 0, wyjatki = 0;
+    uint32_t *wlasciciel = malloc(pojemnosc * sizeof(uint32_t));
+    uint32_t *nastepnik = malloc(pojemnosc * sizeof(uint32_t));
+    bool brak = !baza || !domyslny || !kopia || !kolumny || !kolejnosc || !wlasciciel || !nastepnik;
+
+    // Najczestszy nastepnik w kazdym wierszu i liczba wyjatkow
+    for (size_t q = 0; !brak && q < stany; q++) {
+        uint32_t const *wiersz = wiersze + q * C;
+        memcpy(kopia, wiersz, C * sizeof(uint32_t));
+        qsort(kopia, C, sizeof(uint32_t), porownaj_uint32);
+        size_t najdluzsza = 0;
+        for (size_t od = 0, g; od < C; od = g) {
+            for (g = od; g < C && kopia[g] == kopia[od]; g++) {
+            }
+            if (g - od > najdluzsza) {
+                najdluzsza = g - od;
+                domyslny[q] = kopia[od];
+            }
+        }
+        // Wiersze z wieloma wyjatkami ukladamy najpierw, poki grzebien jest pusty
+        kolejnosc[q] = (klucz_t){.wartosc = najdluzsza, .stan = (uint32_t)q};
+        wyjatki += C - najdluzsza;
+    }
+    if (!brak) {
+        qsort(kolejnosc, stany, sizeof(klucz_t), porownaj_klucze);
+        for (size_t i = 0; i < pojemnosc; i++) {
+            wlasciciel[i] = UINT32_MAX;
+        }
+    }
+
+    size_t pierwsza_wolna = 0;
+    for (size_t i = 0; !brak && i < stany; i++) {
+        uint32_t q = kolejnosc[i].stan;
+        uint32_t const *wiersz = wiersze + (size_t)q * C;
+        size_t ile = 0;
+        for (size_t c = 0; c < C; c++) {
+            if (wiersz[c] != domyslny[q]) {
+                kolumny[ile++] = (uint32_t)c;
+            }
+        }
+        if (ile == 0) {
+            continue; // Baza 0: zadna pozycja nie nalezy do q
+        }
+        while (pierwsza_wolna < dlugosc && wlasciciel[pierwsza_wolna] != UINT32_MAX) {
+            pierwsza_wolna++;
+        }
+        size_t b = pierwsza_wolna > kolumny[0] ? pierwsza_wolna - kolumny[0] : 0;
+        for (;; b++) {
+            // Kazda pozycja b + c dla c < C musi istniec, bo odczyt nie sprawdza zakresu
+            if (b + C > pojemnosc) {
+                size_t nowa = 2 * (b + C);
+                uint32_t *w = realloc(wlasciciel, nowa * sizeof(uint32_t));
+                if (w) wlasciciel = w;
+                uint32_t *nt = w ? realloc(nastepnik, nowa * sizeof(uint32_t)) : NULL;
+                if (nt) nastepnik = nt;
+                if (!w || !nt) {
+                    brak = true;
+                    break;
+                }
+                for (size_t k = pojemnosc; k < nowa; k++) {
+                    wlasciciel[k] = UINT32_MAX;
+                }
+                pojemnosc = nowa;
+            }
+            size_t k = 0;
+            while (k < ile && wlasciciel[b + kolumny[k]] == UINT32_MAX) k++;
+            if (k == ile) break;
+        }
+        if (brak) break;
+        baza[q] = (uint32_t)b;
+        for (size_t k = 0; k < ile; k++) {
+            wlasciciel[b + kolumny[k]] = q;
+            nastepnik[b + kolumny[k]] = wiersz[kolumny[k]];
+        }
+        if (b + C > dlugosc) {
+            dlugosc = b + C;
+        }
+    }
+    free(kopia);
+    free(kolumny);
+    free(kolejnosc);
+    if (brak || dlugosc > UINT32_MAX) {
+        free(baza);
+        free(domyslny);
+        free(wlasciciel);
+        free(nastepnik);
+        return -1;
+    }
+    if (dlugosc < C) {
+        dlugosc = C; // Stany bez wyjatkow czytaja pozycje 0 .. C - 1
+    }
+    tab->baza = baza;
+    tab->domyslny = domyslny;
+    tab->wlasciciel = wlasciciel;
+    tab->nastepnik = nastepnik;
+    tab->dlugosc = dlugosc;
+    tab->wyjatki = wyjatki;
+    return 0;
+}
+
+/**
+ * Wybiera format tablicy przejść. Tablice mieszczace sie w PROG_GESTEJ zostaja pelne;
+ * wieksze sa dzielone na klasy symboli, a gdy to nie wystarcza, upakowywane z domyslnym
+ * nastepnikiem. Wygrywa format zajmujacy najmniej pamieci. Przy braku pamieci na
+ * kompresje tablica zostaje pelna.
+ */
+static void wybierz_format(tabela_automatu_t *tab, size_t n, uint32_t const *gesta) {
+    tab->format = MA_TABLE_DENSE;
+    size_t pelna = bajty_tabeli(tab, n);
+    if (pelna <= PROG_GESTEJ || wyznacz_klasy(tab, n, gesta) != 0) {
+        return;
+    }
+    tab->format = MA_TABLE_CLASSES;
+    size_t klasowa = bajty_tabeli(tab, n);
+    if (klasowa > PROG_GESTEJ && upakuj_wiersze(tab, tab->przejscia) == 0) {
+        tab->format = MA_TABLE_DISPLACEMENT;
+        if (bajty_tabeli(tab, n) < klasowa) {
+            free(tab->przejscia);
+            tab->przejscia = NULL;
+            return;
+        }
+        free(tab->baza);
+        free(tab->domyslny);
+        free(tab->wlasciciel);
+        free(tab->nastepnik);
+        tab->baza = tab->domyslny = tab->wlasciciel = tab->nastepnik = NULL;
+        tab->format = MA_TABLE_CLASSES;
+    }
+    if (klasowa >= pelna) {
+        free(tab->przejscia);
+        free(tab->klasy);
+        tab->przejscia = tab->klasy = NULL;
+        tab->format = MA_TABLE_DENSE;
+    }
+}
+
+/**
+ * Tworzy typ tablicowy z pelnej tablicy `gesta`. Jesli `wlasna` nie jest NULL, to jest
+ * ta sama tablica przekazana na wlasnosc. Wyjścia sa przejmowane zawsze.
+ */
+static ma_type_t *utworz_typ(size_t n, size_t m, size_t stany, uint32_t const *gesta,
+                             uint32_t *wlasna, uint64_t *wyjscia) {
+    ma_type_t *typ = calloc(1, sizeof(ma_type_t));
+    tabela_automatu_t *tab = calloc(1, sizeof(tabela_automatu_t));
+    if (!typ || !tab) {
+        free(typ);
+        free(tab);
+        free(wlasna);
+        free(wyjscia);
+        errno = ENOMEM;
+        return NULL;
+    }
+    tab->stany = stany;
+    tab->wyjscia = wyjscia;
+    wybierz_format(tab, n, gesta);
+    if (tab->format != MA_TABLE_DENSE) {
+        free(wlasna);
+    } else if (wlasna) {
+        tab->przejscia = wlasna;
+    } else {
+        size_t rozmiar = bajty_tabeli(tab, n);
+        tab->przejscia = malloc(rozmiar);
+        if (!tab->przejscia) {
+            tabela_zwolnij(tab);
+            free(typ);
+            errno = ENOMEM;
+            return NULL;
+        }
+        memcpy(tab->przejscia, gesta, rozmiar);
+    }
+    typ->n = n;
+    typ->m = m;
+    typ->s = bity_stanu(stany);
+    typ->tabela = tab;
+    typ->flagi = MA_TYPE_PURE;
+    typ->licznik = 1;
+    zarejestruj_typ(typ);
+    return typ;
+}
+
+/** Tworzy typ tablicowy, przejmujac tablice (zwalniane przy bledzie). */
+ma_type_t *typ_z_tablic(size_t n, size_t m, size_t stany, uint32_t *przejscia,
+                        uint64_t *wyjscia) {
+    return utworz_typ(n, m, stany, przejscia, przejscia, wyjscia);
+}
+
+/** Tworzy typ automatu tablicowego: transitions[q << n | x] to nastepnik, outputs[q] wyjście. */
+ma_type_t *ma_table_create(size_t n, size_t m, size_t states, uint32_t const *transitions,
+                           uint64_t const *outputs) {
+    if (!transitions || !outputs || m == 0 || m > 64 || n > MAKS_WEJSC || states == 0 ||
+        states - 1 > UINT32_MAX) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t wiersz = (size_t)1 << n;
+    if (states > SIZE_MAX / sizeof(uint32_t) / wiersz) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (size_t i = 0; i < states * wiersz; i++) {
+        if (transitions[i] >= states) {
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+    uint64_t *wyjscia = malloc(states * sizeof(uint64_t));
+    if (!wyjscia) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    uint64_t maska = m == 64 ? UINT64_MAX : (1ULL << m) - 1;
+    for (size_t q = 0; q < states; q++) {
+        wyjscia[q] = outputs[q] & maska;
+    }
+    return utworz_typ(n, m, states, transitions, NULL, wyjscia);
+}
+
+/** Wypelnia raport formatu i pamieci tablicy typu tablicowego. */
+int ma_table_report(ma_type_t const *type, struct ma_table_report *report) {
+    if (!type || !type->tabela || !report) {
+        errno = EINVAL;
+        return -1;
+    }
+    tabela_automatu_t const *tab = type->tabela;
+    size_t symbole = (size_t)1 << type->n;
+    report->format = tab->format;
+    report->states = tab->stany;
+    report->symbols = symbole;
+    report->classes = tab->format == MA_TABLE_DENSE ? symbole : tab->ile_klas;
+    report->exceptions = tab->format == MA_TABLE_DISPLACEMENT ? tab->wyjatki : 0;
+    report->bytes = bajty_tabeli(tab, type->n);
+    report->dense_bytes = tab->stany * symbole * sizeof(uint32_t);
+    report->ratio = (double)report->dense_bytes / (double)report->bytes;
+    return 0;
+}
+
+/** Zwraca liczbe stanow typu tablicowego (0 dla innych typow). */
+size_t ma_table_states(ma_type_t const *type) {
+    if (!type || !type->tabela) {
+        errno = EINVAL;
+        return 0;
+    }
+    return type->tabela->stany;
+}
+
+/** Wlacza (zerujac liczniki) lub wylacza zliczanie odwiedzin stanow typu tablicowego. */
+int ma_table_profile(ma_type_t *type, int enable) {
+    if (!type || !type->tabela) {
+        errno = EINVAL;
+        return -1;
+    }
+    tabela_automatu_t *tab = type->tabela;
+    if (!enable) {
+        free(tab->odwiedziny);
+        tab->odwiedziny = NULL;
+        return 0;
+    }
+    uint64_t *odwiedziny = calloc(tab->stany, sizeof(uint64_t));
+    if (!odwiedziny) {
+        errno = ENOMEM;
+        return -1;
+    }
+    free(tab->odwiedziny);
+    tab->odwiedziny = odwiedziny;
+    return 0;
+}
+
+/** MINIMALIZACJA **/
+
+// Podzial stanow na bloki; stany bloku b zajmuja elementy[poczatek[b] .. koniec[b])
+typedef struct podzial {
+    uint32_t *elementy; // Stany uporzadkowane blokami
+    uint32_t *pozycja; // Pozycja stanu w elementy
+    uint32_t *blok; // Blok stanu
+    uint32_t *poczatek, *koniec; // Zakres bloku
+    uint32_t *zaznaczone; // Koniec zaznaczonej czesci bloku (zaznaczone leza na poczatku)
+    size_t bloki; // Liczba blokow
+} podzial_t;
+
+/** Nastepnik stanu q po symbolach klasy c (po symbolu c, gdy tablica nie ma klas). */
+static inline uint32_t nastepnik_klasy(tabela_automatu_t const *tab, size_t n,
+                                       uint32_t const *symbol_klasy, size_t q, size_t c) {
+    return tabela_nastepnik(tab, n, q, symbol_klasy ? symbol_klasy[c] : c);
+}
+
+/** Przesuwa stan q do zaznaczonej czesci jego bloku; nowo dotkniete bloki trafiaja do listy. */
+static void zaznacz(podzial_t *p, uint32_t q, uint32_t *dotkniete, size_t *ile_dotknietych) {
+    uint32_t b = p->blok[q], i = p->pozycja[q], j = p->zaznaczone[b];
+    if (i < j) return;
+    uint32_t inny = p->elementy[j];
+    p->elementy[j] = q;
+    p->pozycja[q] = j;
+    p->elementy[i] = inny;
+    p->pozycja[inny] = i;
+    if (j == p->poczatek[b]) {
+        dotkniete[(*ile_dotknietych)++] = b;
+    }
+    p->zaznaczone[b]++;
+}
+
+/**
+ * Zwraca typ tablicowy z minimalna liczba stanow, rownowazny `type`. Jesli `mapping` nie
+ * jest NULL, mapping[q] dostaje nowy numer starego stanu q. Gdy typ ma wlaczone
+ * profilowanie, klasy sa numerowane od najczesciej odwiedzanych.
+ */
+ma_type_t *ma_table_minimize(ma_type_t const *type, uint32_t *mapping) {
+    if (!type || !type->tabela) {
+        errno = EINVAL;
+        return NULL;
+    }
+    tabela_automatu_t const *tab = type->tabela;
+    // Symbole jednej klasy sa nierozroznialne, wiec alfabetem podzialu sa klasy
+    size_t Q = tab->stany, n = type->n, symbole = (size_t)1 << n;
+    size_t sigma = tab->klasy ? tab->ile_klas : symbole;
+    if (Q > UINT32_MAX / sigma) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    uint32_t *symbol_klasy = NULL;
+    if (tab->klasy) {
+        symbol_klasy = malloc(sigma * sizeof(uint32_t));
+        if (!symbol_klasy) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        for (size_t x = symbole; x-- > 0;) {
+            symbol_klasy[tab->klasy[x]] = (uint32_t)x;
+        }
+    }
+
+    podzial_t p = {0};
+    uint32_t *pamiec = calloc(7 * Q, sizeof(uint32_t));
+    uint32_t *kopia = pamiec ? pamiec + 6 * Q : NULL; // Migawka bloku rozdzielajacego
+    uint32_t *odwr_poczatek = calloc(sigma * (Q + 1), sizeof(uint32_t));
+    uint32_t *odwr = calloc(sigma * Q, sizeof(uint32_t));
+    uint8_t *w_pracy = calloc(sigma * Q, sizeof(uint8_t));
+    size_t *praca = calloc(sigma * Q, sizeof(size_t));
+    uint32_t *dotkniete = calloc(Q, sizeof(uint32_t));
+    klucz_t *klucze = calloc(Q, sizeof(klucz_t));
+    uint32_t *nowy = calloc(Q, sizeof(uint32_t));
+    uint32_t *przejscia = NULL;
+    uint64_t *wyjscia = NULL;
+    if (!pamiec || !odwr_poczatek || !odwr || !w_pracy || !praca || !dotkniete ||
+        !klucze || !nowy) {
+        goto brak_pamieci;
+    }
+    p.elementy = pamiec;
+    p.pozycja = pamiec + Q;
+    p.blok = pamiec + 2 * Q;
+    p.poczatek = pamiec + 3 * Q;
+    p.koniec = pamiec + 4 * Q;
+    p.zaznaczone = pamiec + 5 * Q;
+
+    // Przeciwobrazy: stany q o nastepniku t po klasie x leza w odwr[pocz[t] .. pocz[t + 1]),
+    // gdzie pocz = odwr_poczatek + x * (Q + 1). Zliczamy je pod pocz[t + 1], sumujemy
+    // prefiksowo, a wypelniajac od konca zakresu cofamy pocz[t + 1] na jego poczatek.
+    for (size_t q = 0; q < Q; q++) {
+        for (size_t x = 0; x < sigma; x++) {
+            odwr_poczatek[x * (Q + 1) + nastepnik_klasy(tab, n, symbol_klasy, q, x) + 1]++;
+        }
+    }
+    for (size_t x = 0; x < sigma; x++) {
+        uint32_t *pocz = odwr_poczatek + x * (Q + 1);
+        pocz[0] = (uint32_t)(x * Q);
+        for (size_t t = 1; t <= Q; t++) {
+            pocz[t] += pocz[t - 1];
+        }
+    }
+    for (size_t q = 0; q < Q; q++) {
+        for (size_t x = 0; x < sigma; x++) {
+            odwr[--odwr_poczatek[x * (Q + 1) + nastepnik_klasy(tab, n, symbol_klasy, q, x) + 1]] = (uint32_t)q;
+        }
+    }
+    for (size_t x = 0; x < sigma; x++) {
+        uint32_t *pocz = odwr_poczatek + x * (Q + 1);
+        memmove(pocz, pocz + 1, Q * sizeof(uint32_t));
+        pocz[Q] = (uint32_t)((x + 1) * Q);
+    }
+
+    // Podzial poczatkowy wedlug wyjścia
+    for (size_t q = 0; q < Q; q++) {
+        klucze[q] = (klucz_t){.wartosc = tab->wyjscia[q], .stan = (uint32_t)q};
+    }
+    qsort(klucze, Q, sizeof(klucz_t), porownaj_klucze);
+    size_t najwiekszy = 0;
+    for (size_t i = 0; i < Q; i++) {
+        uint32_t q = klucze[i].stan;
+        if (i == 0 || klucze[i].wartosc != klucze[i - 1].wartosc) {
+            p.poczatek[p.bloki] = (uint32_t)i;
+            p.zaznaczone[p.bloki] = (uint32_t)i;
+            p.bloki++;
+        }
+        p.elementy[i] = q;
+        p.pozycja[q] = (uint32_t)i;
+        p.blok[q] = (uint32_t)(p.bloki - 1);
+        p.koniec[p.bloki - 1] = (uint32_t)i + 1;
+        if (p.koniec[p.bloki - 1] - p.poczatek[p.bloki - 1] >
+            p.koniec[najwiekszy] - p.poczatek[najwiekszy]) {
+            najwiekszy = p.bloki - 1;
+        }
+    }
+
+    // Wystarczy rozdzielac wszystkimi blokami poza jednym
+    size_t ile_pracy = 0;
+    for (size_t b = 0; b < p.bloki; b++) {
+        for (size_t x = 0; b != najwiekszy && x < sigma; x++) {
+            w_pracy[b * sigma + x] = 1;
+            praca[ile_pracy++] = b * sigma + x;
+        }
+    }
+
+    while (ile_pracy > 0) {
+        size_t para = praca[--ile_pracy];
+        w_pracy[para] = 0;
+        size_t b = para / sigma, x = para % sigma;
+        uint32_t const *pocz = odwr_poczatek + x * (Q + 1);
+
+        // Zaznaczanie przesuwa stany wewnatrz blokow, wiec przegladamy migawke bloku b
+        size_t rozmiar = p.koniec[b] - p.poczatek[b], ile_dotknietych = 0;
+        memcpy(kopia, p.elementy + p.poczatek[b], rozmiar * sizeof(uint32_t));
+        for (size_t i = 0; i < rozmiar; i++) {
+            uint32_t t = kopia[i];
+            for (uint32_t k = pocz[t]; k < pocz[t + 1]; k++) {
+                zaznacz(&p, odwr[k], dotkniete, &ile_dotknietych);
+            }
+        }
+
+        for (size_t i = 0; i < ile_dotknietych; i++) {
+            uint32_t c = dotkniete[i];
+            if (p.zaznaczone[c] == p.koniec[c]) {
+                p.zaznaczone[c] = p.poczatek[c];
+                continue;
+            }
+            // Zaznaczona czesc staje sie nowym blokiem
+            size_t nb = p.bloki++;
+            p.poczatek[nb] = p.poczatek[c];
+            p.koniec[nb] = p.zaznaczone[c];
+            p.zaznaczone[nb] = p.poczatek[nb];
+            p.poczatek[c] = p.koniec[nb];
+            p.zaznaczone[c] = p.poczatek[c];
+            for (uint32_t k = p.poczatek[nb]; k < p.koniec[nb]; k++) {
+                p.blok[p.elementy[k]] = (uint32_t)nb;
+            }
+            bool mniejszy_nowy = p.koniec[nb] - p.poczatek[nb] <= p.koniec[c] - p.poczatek[c];
+            for (size_t y = 0; y < sigma; y++) {
+                size_t dodawany = w_pracy[c * sigma + y] || mniejszy_nowy ? nb : c;
+                if (!w_pracy[dodawany * sigma + y]) {
+                    w_pracy[dodawany * sigma + y] = 1;
+                    praca[ile_pracy++] = dodawany * sigma + y;
+                }
+            }
+        }
+    }
+
+    // Numeracja klas: BFS od klasy stanu 0 po reprezentantach, potem reszta
+    size_t B = p.bloki, ranga = 0;
+    uint32_t *kolejka = dotkniete; // Juz niepotrzebne, ma Q >= B miejsc
+    for (size_t b = 0; b < B; b++) {
+        nowy[b] = UINT32_MAX;
+    }
+    for (size_t start = 0; start < Q; start++) {
+        uint32_t bs = p.blok[start];
+        if (nowy[bs] != UINT32_MAX) continue;
+        size_t glowa = 0, ogon = 0;
+        kolejka[ogon++] = bs;
+        nowy[bs] = (uint32_t)ranga++;
+        while (glowa < ogon) {
+            uint32_t b = kolejka[glowa++], rep = p.elementy[p.poczatek[b]];
+            for (size_t x = 0; x < sigma; x++) {
+                uint32_t c = p.blok[nastepnik_klasy(tab, n, symbol_klasy, rep, x)];
+                if (nowy[c] == UINT32_MAX) {
+                    nowy[c] = (uint32_t)ranga++;
+                    kolejka[ogon++] = c;
+                }
+            }
+        }
+    }
+    // Z profilem: najpierw najczesciej odwiedzane klasy, remisy wedlug kolejnosci BFS
+    if (tab->odwiedziny) {
+        for (size_t b = 0; b < B; b++) {
+            klucze[b] = (klucz_t){.wartosc = UINT64_MAX, .drugi = nowy[b], .stan = (uint32_t)b};
+        }
+        // Klucz maleje z liczba odwiedzin, wiec sortowanie rosnace stawia najczestsze na poczatku
+        for (size_t q = 0; q < Q; q++) {
+            klucze[p.blok[q]].wartosc -= tab->odwiedziny[q];
+        }
+        qsort(klucze, B, sizeof(klucz_t), porownaj_klucze);
+        for (size_t i = 0; i < B; i++) {
+            nowy[klucze[i].stan] = (uint32_t)i;
+        }
+    }
+
+    przejscia = malloc(B * symbole * sizeof(uint32_t));
+    wyjscia = malloc(B * sizeof(uint64_t));
+    if (!przejscia || !wyjscia) {
+        goto brak_pamieci;
+    }
+    for (size_t b = 0; b < B; b++) {
+        uint32_t rep = p.elementy[p.poczatek[b]];
+        size_t wiersz = (size_t)nowy[b] << n;
+        for (size_t x = 0; x < symbole; x++) {
+            przejscia[wiersz | x] = nowy[p.blok[tabela_nastepnik(tab, n, rep, x)]];
+        }
+        wyjscia[nowy[b]] = tab->wyjscia[rep];
+    }
+    if (mapping) {
+        for (size_t q = 0; q < Q; q++) {
+            mapping[q] = nowy[p.blok[q]];
+        }
+    }
+
+    free(pamiec);
+    free(odwr_poczatek);
+    free(odwr);
+    free(w_pracy);
+    free(praca);
+    free(dotkniete);
+    free(klucze);
+    free(nowy);
+    free(symbol_klasy);
+    return typ_z_tablic(n, type->m, B, przejscia, wyjscia);
+
+brak_pamieci:
+    free(pamiec);
+    free(odwr_poczatek);
+    free(odwr);
+    free(w_pracy);
+    free(praca);
+    free(dotkniete);
+    free(klucze);
+    free(nowy);
+    free(symbol_klasy);
+    free(przejscia);
+    free(wyjscia);
+    errno = ENOMEM;
+    return NULL;
+}
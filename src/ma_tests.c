@@ -6,10 +6,14 @@
 #include "memory_tests.h"
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /** MAKRA SKRACAJĄCE IMPLEMENTACJĘ TESTÓW **/
 
@@ -586,6 +590,1830 @@ static int cycle(void) {
   return PASS;
 }
 
+// Testuje wspoldzielone typy automatów.
+static int types(void) {
+  memory_test_data_t *mtd = get_memory_test_data();
+  unsigned alloc_before = mtd->alloc_counter, free_before = mtd->free_counter;
+  const uint64_t q = 5, x = 3;
+  moore_t *a[3];
+
+  TEST_NULL_EINVAL(ma_type_register(1, 1, 1, NULL, y_forward, 0));
+  TEST_NULL_EINVAL(ma_type_register(1, 1, 1, t_one, NULL, 0));
+  TEST_NULL_EINVAL(ma_type_register(1, 0, 1, t_one, y_forward, 0));
+  TEST_NULL_EINVAL(ma_type_register(1, 2, 1, t_one, NULL, MA_TYPE_IDENTITY_OUTPUT));
+  TEST_NULL_EINVAL(ma_create_from_type(NULL, &q));
+
+  ma_type_t *adder = ma_type_register(64, 64, 64, t_one, NULL,
+                                      MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT);
+  ma_type_t *same = ma_type_register(64, 64, 64, t_one, NULL,
+                                     MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT);
+  assert(adder && same);
+  ASSERT(adder == same);
+  ma_type_release(same);
+  TEST_NULL_EINVAL(ma_create_from_type(adder, NULL));
+
+  a[0] = ma_create_from_type(adder, &q);
+  a[1] = ma_create_from_type(adder, &q);
+  a[2] = ma_create_full(64, 64, 64, t_one, y_one, &q);
+  assert(a[0] && a[1] && a[2]);
+  ma_type_release(adder);
+
+  ASSERT(ma_get_output(a[0])[0] == 5);
+  ASSERT(ma_get_output(a[2])[0] == 6);
+  ASSERT(ma_set_input(a[0], &x) == 0);
+  ASSERT(ma_connect(a[1], 0, a[0], 0, 64) == 0);
+  ASSERT(ma_connect(a[2], 0, a[1], 0, 64) == 0);
+  ASSERT(ma_step(a, SIZE(a)) == 0);
+  ASSERT(ma_get_output(a[0])[0] == 8);
+  ASSERT(ma_get_output(a[1])[0] == 10);
+  ASSERT(ma_get_output(a[2])[0] == 11);
+
+  for (size_t i = 0; i < SIZE(a); ++i)
+    ma_delete(a[i]);
+  ASSERT(mtd->alloc_counter - alloc_before == mtd->free_counter - free_before);
+  return PASS;
+}
+
+// Testuje zapis stanu sieci w pliku i wznowienie po utracie procesu.
+static int persist(void) {
+  char path[] = "/tmp/ma_persist_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  unlink(path);
+
+  uint64_t x = 1;
+  moore_t *a[2];
+  for (int round = 0; round < 2; ++round) {
+    a[0] = ma_create_simple(1, 1, t_two);
+    a[1] = ma_create_simple(1, 1, t_two);
+    assert(a[0] && a[1]);
+    ASSERT(ma_connect(a[1], 0, a[0], 0, 1) == 0);
+
+    ma_persist_t *p = ma_persist_open(path, a, SIZE(a), 2);
+    assert(p);
+    if (round == 0) {
+      ASSERT(ma_persist_cycle(p) == 0);
+      ASSERT(ma_set_input(a[0], &x) == 0);
+      for (int i = 0; i < 3; ++i)
+        ASSERT(ma_persist_step(p) == 0);
+      ASSERT(ma_persist_cycle(p) == 3);
+      ASSERT(ma_get_output(a[1])[0] == 1 && ma_get_output(a[0])[0] == 1);
+    } else {
+      // Cykl 3 nie zostal zatwierdzony, wiec wracamy do cyklu 2.
+      ASSERT(ma_persist_cycle(p) == 2);
+      ASSERT(ma_get_output(a[1])[0] == 1 && ma_get_output(a[0])[0] == 0);
+      ASSERT(ma_persist_step(p) == 0);
+      ASSERT(ma_get_output(a[1])[0] == 1 && ma_get_output(a[0])[0] == 1);
+    }
+    ma_persist_close(p);
+    ma_delete(a[0]);
+    ma_delete(a[1]);
+  }
+
+  TEST_NULL_EINVAL(ma_persist_open(path, a, 0, 1));
+  TEST_NULL_EINVAL(ma_persist_open(NULL, a, 1, 1));
+  unlink(path);
+  return PASS;
+}
+
+// Bufory automatów leżą w odwzorowaniu pliku: zatwierdzenie kopiuje do drugiego banku
+// tylko zmienione automaty, a po zamknięciu automaty wracają na stertę z bieżącym stanem.
+static int persist_banks(void) {
+  enum { NUM = 16 };
+  char path[] = "/tmp/ma_persist_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  unlink(path);
+
+  uint64_t const one = 1, five = 5, seven = 7;
+  moore_t *a[NUM];
+  for (int round = 0; round < 2; ++round) {
+    for (size_t i = 0; i < NUM; ++i) {
+      a[i] = ma_create_simple(64, 64, t_one);
+      assert(a[i]);
+    }
+    ma_persist_t *p = ma_persist_open(path, a, NUM, 2);
+    assert(p);
+    errno = 0;
+    ASSERT(ma_enable_history(a[0], 2) == -1 && errno == EBUSY);
+    TEST_NULL_EINVAL(ma_persist_open(path, a, NUM, 2));
+    TEST_NULL_EINVAL(ma_spill_open(NULL, a, NUM, 0, 1));
+    if (round == 0) {
+      ASSERT(ma_set_input(a[3], &one) == 0);
+      ASSERT(ma_set_input(a[9], &five) == 0);
+      for (int c = 0; c < 5; ++c) {
+        ASSERT(ma_persist_step(p) == 0);
+        if (c == 2)
+          ASSERT(ma_set_state(a[12], &seven) == 0);
+      }
+      ASSERT(ma_get_output(a[3])[0] == 5 && ma_get_output(a[9])[0] == 25);
+    } else {
+      // Cykl 5 nie został zatwierdzony; wejścia wracają razem ze stanem cyklu 4.
+      ASSERT(ma_persist_cycle(p) == 4);
+      ASSERT(ma_get_output(a[3])[0] == 4 && ma_get_output(a[9])[0] == 20);
+      ASSERT(ma_get_output(a[12])[0] == 7 && ma_get_output(a[0])[0] == 0);
+      for (int c = 0; c < 4; ++c)
+        ASSERT(ma_persist_step(p) == 0);
+      ASSERT(ma_get_output(a[3])[0] == 8 && ma_get_output(a[9])[0] == 40);
+    }
+    ma_persist_close(p);
+    if (round == 1) {
+      // Po zamknięciu bufory są zwykłą pamięcią automatu.
+      ASSERT(ma_enable_history(a[3], 2) == 0);
+      ASSERT(ma_step(a, NUM) == 0);
+      ASSERT(ma_get_output(a[3])[0] == 9 && ma_get_output(a[12])[0] == 7);
+    }
+    for (size_t i = 0; i < NUM; ++i)
+      ma_delete(a[i]);
+  }
+  unlink(path);
+  return PASS;
+}
+
+// Testuje zliczanie przełączeń bitów stanu i wyjścia.
+static int toggles(void) {
+  const uint64_t q = 0, x = 1;
+  uint64_t st[64], out[64], cycles;
+  double as, ao;
+  moore_t *a[3];
+
+  a[0] = ma_create_simple(1, 1, t_two);
+  a[1] = ma_create_simple(1, 1, t_two);
+  a[2] = ma_create_full(64, 64, 64, t_one, y_one, &q);
+  assert(a[0] && a[1] && a[2]);
+  ASSERT(ma_set_input(a[0], &x) == 0);
+  ASSERT(ma_set_input(a[2], &x) == 0);
+  ASSERT(ma_connect(a[1], 0, a[0], 0, 1) == 0);
+
+  TEST_EINVAL(ma_toggle_export(a[0], st, out, &cycles));
+  for (size_t i = 0; i < SIZE(a); ++i)
+    ASSERT(ma_toggle_enable(a[i]) == 0);
+
+  for (int i = 0; i < 600; ++i)
+    ASSERT(ma_step(a, SIZE(a)) == 0);
+
+  ASSERT(ma_toggle_export(a[0], st, out, &cycles) == 0);
+  ASSERT(cycles == 600 && st[0] == 600 && out[0] == 600);
+  ASSERT(ma_toggle_export(a[1], st, out, &cycles) == 0);
+  ASSERT(st[0] == 300 && out[0] == 300);
+  ASSERT(ma_toggle_activity(a[1], &as, &ao) == 0);
+  ASSERT(as == 0.5 && ao == 0.5);
+
+  // Licznik 0..600: bit k przełącza się floor(600 / 2^k) razy.
+  ASSERT(ma_toggle_export(a[2], st, out, &cycles) == 0);
+  for (size_t k = 0; k < 64; ++k)
+    ASSERT(st[k] == (UINT64_C(600) >> k));
+  ASSERT(out[0] == 600 && out[1] == 300 && out[9] == 1 && out[10] == 0);
+
+  ma_toggle_disable(a[1]);
+  TEST_EINVAL(ma_toggle_activity(a[1], &as, &ao));
+  for (size_t i = 0; i < SIZE(a); ++i)
+    ma_delete(a[i]);
+  return PASS;
+}
+
+// Buduje sieć z kilkoma aktywnymi i wieloma stabilnymi automatami.
+static void build_mixed(moore_t *a[], size_t num, ma_type_t *cnt, ma_type_t *cst,
+                        ma_type_t *fwd) {
+  const uint64_t q = 0;
+  for (size_t i = 0; i < num; ++i) {
+    uint64_t s = i * 0x9e3779b97f4a7c15ULL;
+    if (i % 8 == 0)
+      a[i] = ma_create_from_type(cnt, &q);
+    else if (i % 3 == 0)
+      a[i] = ma_create_from_type(cst, &s);
+    else
+      a[i] = ma_create_from_type(fwd, &s);
+    assert(a[i]);
+  }
+  for (size_t i = 1; i < num; ++i)
+    assert(ma_connect(a[i], 0, a[i / 2], (i * 13) % 64, 64 - (i * 13) % 64) == 0);
+}
+
+// Wątek wykonujący ma_run_tuned na sieci 64 automatów.
+static void *run_tuned_thread(void *net) {
+  return ma_run_tuned(net, 64, 300) == 0 ? NULL : net;
+}
+
+// Testuje wielocyklowe wykonanie z automatycznym wyborem silnika.
+static int tuned(void) {
+  moore_t *a[64], *b[64];
+  ma_type_t *cnt = ma_type_register(64, 64, 64, t_one, y_one, MA_TYPE_PURE);
+  ma_type_t *cst = ma_type_register(64, 64, 64, t_const, NULL,
+                                    MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT);
+  ma_type_t *fwd = ma_type_register(64, 64, 64, t_forward, NULL,
+                                    MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT);
+  assert(cnt && cst && fwd);
+  build_mixed(a, SIZE(a), cnt, cst, fwd);
+  build_mixed(b, SIZE(b), cnt, cst, fwd);
+
+  TEST_EINVAL(ma_run_tuned(NULL, 1, 1));
+  TEST_EINVAL(ma_run_tuned(a, 0, 1));
+  TEST_EINVAL(ma_run_engine(a, SIZE(a), 1, -1));
+  TEST_EINVAL(ma_run_engine(a, SIZE(a), 1, MA_ENGINE_SKIP_BY_TYPE + 1));
+  ASSERT(ma_tuned_engine(a, SIZE(a)) == -1);
+
+  for (uint64_t round = 0; round < 5; ++round) {
+    uint64_t x = round + 1, z = x * 0x0123456789abcdefULL;
+    ASSERT(ma_set_input(a[0], &x) == 0);
+    ASSERT(ma_set_input(b[0], &x) == 0);
+    ASSERT(ma_run_tuned(a, SIZE(a), 150) == 0);
+    for (int i = 0; i < 150; ++i)
+      ASSERT(ma_step(b, SIZE(b)) == 0);
+    // Zmiany z zewnątrz muszą dotrzeć do automatów, które silnik pomija.
+    ASSERT(ma_set_state(a[9], &z) == 0);
+    ASSERT(ma_set_state(b[9], &z) == 0);
+    ASSERT(ma_set_input(a[8], &z) == 0);
+    ASSERT(ma_set_input(b[8], &z) == 0);
+    ASSERT(ma_run_tuned(a, SIZE(a), 150) == 0);
+    for (int i = 0; i < 150; ++i)
+      ASSERT(ma_step(b, SIZE(b)) == 0);
+    for (size_t i = 0; i < SIZE(a); ++i)
+      ASSERT(ma_get_output(a[i])[0] == ma_get_output(b[i])[0]);
+  }
+  int engine = ma_tuned_engine(a, SIZE(a));
+  ASSERT(engine >= MA_ENGINE_SWEEP && engine <= MA_ENGINE_SKIP_BY_TYPE);
+
+  // Równoległe strojenie dwóch sieci o tym samym stanie daje te same wyjścia.
+  pthread_t threads[2];
+  moore_t **nets[2] = {a, b};
+  for (size_t k = 0; k < 2; ++k)
+    ASSERT(pthread_create(&threads[k], NULL, run_tuned_thread, nets[k]) == 0);
+  for (size_t k = 0; k < 2; ++k) {
+    void *result;
+    ASSERT(pthread_join(threads[k], &result) == 0);
+    ASSERT(result == NULL);
+  }
+  for (size_t i = 0; i < SIZE(a); ++i)
+    ASSERT(ma_get_output(a[i])[0] == ma_get_output(b[i])[0]);
+
+  // Skrót opisuje budowę sieci, nie adresy: odbudowana sieć nie jest strojona od nowa.
+  engine = ma_tuned_engine(a, SIZE(a));
+  ASSERT(engine >= MA_ENGINE_SWEEP && ma_tuned_engine(b, SIZE(b)) == engine);
+  for (size_t i = 0; i < SIZE(a); ++i)
+    ma_delete(a[i]);
+  build_mixed(a, SIZE(a), cnt, cst, fwd);
+  ASSERT(ma_tuned_engine(a, SIZE(a)) == engine);
+  ASSERT(ma_tuned_engine(a, SIZE(a) - 1) == -1);
+
+  for (size_t i = 0; i < SIZE(a); ++i) {
+    ma_delete(a[i]);
+    ma_delete(b[i]);
+  }
+  ma_type_release(cnt);
+  ma_type_release(cst);
+  ma_type_release(fwd);
+  return PASS;
+}
+
+// Silnik kroku przez ma_run_tuned.
+static int step_tuned(moore_t *at[], size_t num) {
+  return ma_run_tuned(at, num, 1);
+}
+
+// Silniki pomijające niezmienione automaty MA_TYPE_PURE, bez strojenia.
+static int step_skip(moore_t *at[], size_t num) {
+  return ma_run_engine(at, num, 1, MA_ENGINE_SKIP);
+}
+
+static int step_skip_by_type(moore_t *at[], size_t num) {
+  return ma_run_engine(at, num, 1, MA_ENGINE_SKIP_BY_TYPE);
+}
+
+// Błędny silnik: gubi stan pierwszego automatu w dużych krokach.
+static int step_broken(moore_t *at[], size_t num) {
+  static const uint64_t zero[3];
+  int result = ma_step(at, num);
+  if (result == 0 && num >= 3)
+    ma_set_state(at[0], zero);
+  return result;
+}
+
+// Testuje różnicowy fuzzer silników kroku.
+static int fuzz(void) {
+  ma_fuzz_report_t report;
+  FILE *devnull = fopen("/dev/null", "w");
+  assert(devnull);
+
+  TEST_EINVAL(ma_fuzz(NULL, 1, 1, 10, &report, NULL));
+  TEST_EINVAL(ma_fuzz(ma_step, 1, 1, 0, &report, NULL));
+
+  ASSERT(ma_fuzz(ma_step, 1, 20, 200, &report, NULL) == 0);
+  ASSERT(report.rounds == 20 && report.steps > 0);
+  ASSERT(ma_fuzz(step_tuned, 2, 20, 200, &report, devnull) == 0);
+  ASSERT(ma_fuzz(step_skip, 4, 50, 200, &report, devnull) == 0);
+  ASSERT(ma_fuzz(step_skip_by_type, 5, 50, 200, &report, devnull) == 0);
+
+  ASSERT(ma_fuzz(step_broken, 3, 20, 200, &report, devnull) == 1);
+  ASSERT(report.reproducer_length > 0);
+  ASSERT(report.reproducer_length <= report.divergence + 1);
+
+  fclose(devnull);
+  return PASS;
+}
+
+static void t_decode(uint64_t *next_state, uint64_t const *input,
+                     uint64_t const *state, size_t, size_t s) {
+  uint64_t h = (state[0] * 31 + (input[0] & 0xfff)) ^ (state[0] >> 5);
+  next_state[0] = h & (UINT64_MAX >> (64 - s));
+}
+
+// Porównuje ma_run_stream z ciągiem ma_set_input, ma_step i ma_get_output.
+static int check_stream(moore_t *a, moore_t *b, uint64_t const *symbols,
+                        size_t count, size_t bits, size_t stride, size_t m) {
+  uint64_t out[300 * 3], in[3] = {0x5a5a5a5a5a5a5a5aULL, 7, 9};
+  size_t words = stride < (m + 63) / 64 ? stride : (m + 63) / 64;
+
+  ASSERT(ma_set_input(a, in) == 0);
+  ASSERT(ma_set_input(b, in) == 0);
+  ASSERT(ma_run_stream(a, symbols, count, bits, out, stride) == 0);
+  for (size_t k = 0; k < count; ++k) {
+    size_t pos = k * bits;
+    uint64_t sym = symbols[pos / 64] >> (pos % 64);
+    if (pos % 64 + bits > 64)
+      sym |= symbols[pos / 64 + 1] << (64 - pos % 64);
+    sym &= UINT64_MAX >> (64 - bits);
+    in[0] = (in[0] & ~(UINT64_MAX >> (64 - bits))) | sym;
+    ASSERT(ma_set_input(b, in) == 0);
+    ASSERT(ma_step(&b, 1) == 0);
+    for (size_t j = 0; j < words; ++j)
+      ASSERT(out[k * stride + j] == ma_get_output(b)[j]);
+  }
+  ASSERT(memcmp(ma_get_output(a), ma_get_output(b), words * sizeof(uint64_t)) == 0);
+  return PASS;
+}
+
+// Testuje przepuszczanie strumienia symboli przez automat.
+static int stream(void) {
+  uint64_t symbols[100];
+  const uint64_t q = 0x1234, c = 0xa;
+  for (size_t i = 0; i < SIZE(symbols); ++i)
+    symbols[i] = (i + 1) * 0x9e3779b97f4a7c15ULL;
+
+  // Mały automat: bity 8..11 wejścia pochodzą od stałego rodzica.
+  moore_t *p = ma_create_full(0, 4, 4, t_const, y_forward, &c);
+  moore_t *a = ma_create_full(12, 20, 20, t_decode, y_forward, &q);
+  moore_t *b = ma_create_full(12, 20, 20, t_decode, y_forward, &q);
+  assert(p && a && b);
+  ASSERT(ma_connect(a, 8, p, 0, 4) == 0);
+  ASSERT(ma_connect(b, 8, p, 0, 4) == 0);
+  ASSERT(check_stream(a, b, symbols, 300, 7, 1, 20) == PASS);
+  ASSERT(check_stream(a, b, symbols, 200, 8, 2, 20) == PASS);
+  TEST_EINVAL(ma_run_stream(a, symbols, 1, 13, NULL, 0));
+  TEST_EINVAL(ma_run_stream(a, symbols, 1, 0, NULL, 0));
+  TEST_EINVAL(ma_run_stream(NULL, symbols, 1, 8, NULL, 0));
+  ma_delete(a);
+  ma_delete(b);
+  ma_delete(p);
+
+  // Automat z pętlą własną i wielosłowowym stanem.
+  a = ma_create_simple(192, 192, t_forward);
+  b = ma_create_simple(192, 192, t_forward);
+  assert(a && b);
+  ASSERT(ma_connect(a, 64, a, 0, 128) == 0);
+  ASSERT(ma_connect(b, 64, b, 0, 128) == 0);
+  ASSERT(check_stream(a, b, symbols, 100, 64, 3, 192) == PASS);
+  ASSERT(check_stream(a, b, symbols, 100, 33, 2, 192) == PASS);
+  ma_delete(a);
+  ma_delete(b);
+  return PASS;
+}
+
+static void t_nibble(uint64_t *next_state, uint64_t const *input,
+                     uint64_t const *state, size_t, size_t) {
+  uint64_t x = input[0] & 0x3f;
+  // Bit 7 włącza zerowanie, po którym ścieżki z różnych stanów się schodzą.
+  if ((input[0] >> 7) && x % 11 == 0)
+    next_state[0] = 0;
+  else
+    next_state[0] = (state[0] * 5 + x + (input[0] >> 6)) & 0xf;
+}
+
+// Testuje równoległe przepuszczanie strumienia przez automat o 16 stanach.
+static int parallel(void) {
+  enum { COUNT = 20000, BITS = 6 };
+  static uint64_t symbols[COUNT * BITS / 64 + 1], out_a[COUNT], out_b[COUNT];
+  const uint64_t q = 3, c = 2, in = 0;
+  for (size_t i = 0; i < SIZE(symbols); ++i)
+    symbols[i] = (i + 1) * 0x9e3779b97f4a7c15ULL;
+
+  ma_type_t *type = ma_type_register(8, 4, 4, t_nibble, y_forward, MA_TYPE_PURE);
+  moore_t *p = ma_create_full(0, 2, 2, t_const, y_forward, &c);
+  moore_t *a = ma_create_from_type(type, &q);
+  moore_t *b = ma_create_from_type(type, &q);
+  assert(type && p && a && b);
+  ASSERT(ma_connect(a, 6, p, 0, 2) == 0);
+  ASSERT(ma_connect(b, 6, p, 0, 2) == 0);
+  ASSERT(ma_set_input(a, &in) == 0 && ma_set_input(b, &in) == 0);
+
+  for (size_t threads = 0; threads <= 5; threads += 5) {
+    ASSERT(ma_run_stream_parallel(a, symbols, COUNT, BITS, out_a, 1, threads) == 0);
+    ASSERT(ma_run_stream(b, symbols, COUNT, BITS, out_b, 1) == 0);
+    ASSERT(memcmp(out_a, out_b, sizeof(out_a)) == 0);
+    ASSERT(ma_get_output(a)[0] == ma_get_output(b)[0]);
+  }
+  // Bez zerowania ścieżki nigdy się nie schodzą.
+  const uint64_t c1 = 1;
+  ASSERT(ma_set_state(p, &c1) == 0);
+  ASSERT(ma_step(&p, 1) == 0);
+  ASSERT(ma_run_stream_parallel(a, symbols, COUNT, BITS, out_a, 1, 4) == 0);
+  ASSERT(ma_run_stream(b, symbols, COUNT, BITS, out_b, 1) == 0);
+  ASSERT(memcmp(out_a, out_b, sizeof(out_a)) == 0);
+  // Bez wyjść liczy się tylko stan końcowy.
+  ASSERT(ma_run_stream_parallel(a, symbols, COUNT, BITS, NULL, 0, 3) == 0);
+  ASSERT(ma_run_stream(b, symbols, COUNT, BITS, NULL, 0) == 0);
+  ASSERT(ma_get_output(a)[0] == ma_get_output(b)[0]);
+  ASSERT(ma_step(&a, 1) == 0 && ma_step(&b, 1) == 0);
+  ASSERT(ma_get_output(a)[0] == ma_get_output(b)[0]);
+
+  // Stan spoza 4 bitów: wykonanie sekwencyjne daje ten sam wynik.
+  const uint64_t big = 0x35;
+  ASSERT(ma_set_state(a, &big) == 0 && ma_set_state(b, &big) == 0);
+  ASSERT(ma_run_stream_parallel(a, symbols, COUNT, BITS, out_a, 1, 4) == 0);
+  ASSERT(ma_run_stream(b, symbols, COUNT, BITS, out_b, 1) == 0);
+  ASSERT(memcmp(out_a, out_b, sizeof(out_a)) == 0);
+  TEST_EINVAL(ma_run_stream_parallel(a, symbols, 1, 9, NULL, 0, 2));
+
+  ma_delete(a);
+  ma_delete(b);
+  ma_delete(p);
+  ma_type_release(type);
+  return PASS;
+}
+
+// Porównuje ma_run_streams z osobnymi wywołaniami ma_run_stream na bliźniakach.
+static int check_streams(moore_t *a[], moore_t *b[], size_t num,
+                         uint64_t const *const symbols[], size_t count, size_t bits) {
+  enum { MAX = 80, COUNT = 300 };
+  static uint64_t out_a[MAX][COUNT], out_b[COUNT];
+  uint64_t *out[MAX];
+  for (size_t i = 0; i < num; ++i)
+    out[i] = out_a[i];
+
+  ASSERT(ma_run_streams(a, num, symbols, count, bits, out, 1) == 0);
+  for (size_t i = 0; i < num; ++i) {
+    ASSERT(ma_run_stream(b[i], symbols[i], count, bits, out_b, 1) == 0);
+    ASSERT(memcmp(out_a[i], out_b, count * sizeof(uint64_t)) == 0);
+    ASSERT(ma_get_output(a[i])[0] == ma_get_output(b[i])[0]);
+  }
+  return PASS;
+}
+
+// Testuje wektorowe wykonanie wielu strumieni przez małe automaty.
+static int streams(void) {
+  enum { NUM = 75 };
+  static uint64_t data[NUM + 64];
+  uint64_t const *symbols[NUM];
+  moore_t *a[NUM], *b[NUM];
+  const uint64_t c[2] = {1, 2};
+  for (size_t i = 0; i < SIZE(data); ++i)
+    data[i] = (i + 7) * 0x9e3779b97f4a7c15ULL;
+  for (size_t i = 0; i < NUM; ++i)
+    symbols[i] = data + i;
+
+  // Dwie grupy czystych automatów różniące się bitami od rodzica i jeden zwykły.
+  ma_type_t *type = ma_type_register(8, 4, 4, t_nibble, y_forward, MA_TYPE_PURE);
+  moore_t *p[2] = {ma_create_full(0, 2, 2, t_const, y_forward, &c[0]),
+                   ma_create_full(0, 2, 2, t_const, y_forward, &c[1])};
+  assert(type && p[0] && p[1]);
+  for (size_t i = 0; i < NUM; ++i) {
+    uint64_t q = i % 16;
+    if (i == NUM - 1) {
+      a[i] = ma_create_simple(8, 8, t_forward);
+      b[i] = ma_create_simple(8, 8, t_forward);
+    } else {
+      a[i] = ma_create_from_type(type, &q);
+      b[i] = ma_create_from_type(type, &q);
+    }
+    assert(a[i] && b[i]);
+    ASSERT(ma_connect(a[i], 6, p[i % 2], 0, 2) == 0);
+    ASSERT(ma_connect(b[i], 6, p[i % 2], 0, 2) == 0);
+  }
+  ASSERT(check_streams(a, b, NUM, symbols, 300, 4) == PASS);
+  ASSERT(check_streams(a, b, NUM, symbols, 200, 3) == PASS);
+  ASSERT(check_streams(a, b, NUM, symbols, 100, 6) == PASS);
+
+  // Automat czytający z innego automatu listy wymusza kolejne wykonanie.
+  ASSERT(ma_connect(a[1], 4, a[0], 0, 2) == 0);
+  ASSERT(ma_connect(b[1], 4, b[0], 0, 2) == 0);
+  ASSERT(check_streams(a, b, NUM, symbols, 300, 4) == PASS);
+
+  ASSERT(ma_run_streams(a, NUM, symbols, 0, 4, NULL, 0) == 0);
+  TEST_EINVAL(ma_run_streams(a, NUM, symbols, 1, 9, NULL, 0));
+  TEST_EINVAL(ma_run_streams(NULL, NUM, symbols, 1, 4, NULL, 0));
+
+  for (size_t i = 0; i < NUM; ++i) {
+    ma_delete(a[i]);
+    ma_delete(b[i]);
+  }
+  ma_delete(p[0]);
+  ma_delete(p[1]);
+  ma_type_release(type);
+  return PASS;
+}
+
+// Testuje automaty tablicowe i ich minimalizację.
+static int table(void) {
+  // Licznik modulo 3 bitu 0 zerowany bitem 1, z każdym stanem w trzech kopiach.
+  enum { COPIES = 3, STATES = 3 * COPIES };
+  uint32_t delta[STATES << 2], mapping[STATES], bad[4] = {0, 1, 2, 4};
+  uint64_t lambda[STATES];
+  for (uint32_t q = 0; q < STATES; ++q) {
+    for (uint32_t x = 0; x < 4; ++x) {
+      uint32_t v = x & 2 ? 0 : (q % 3 + (x & 1)) % 3;
+      delta[q << 2 | x] = v + 3 * ((q + x) % COPIES);
+    }
+    lambda[q] = q % 3 == 0 ? 0x101 : 0x10;
+  }
+
+  ma_type_t *type = ma_table_create(2, 12, STATES, delta, lambda);
+  assert(type);
+  ASSERT(ma_table_states(type) == STATES);
+  ma_type_t *min = ma_table_minimize(type, mapping);
+  assert(min);
+  ASSERT(ma_table_states(min) == 3);
+  ASSERT(mapping[0] == 0 && mapping[3] == 0 && mapping[4] == mapping[1]);
+
+  // Oryginał i wersja minimalna dają te same wyjścia.
+  uint64_t q = 7, q_min = mapping[7], x = 0;
+  moore_t *a = ma_create_from_type(type, &q);
+  moore_t *b = ma_create_from_type(min, &q_min);
+  assert(a && b);
+  for (size_t i = 0; i < 200; ++i) {
+    x = (x * 0x9e3779b97f4a7c15ULL + i) ^ (x >> 17);
+    uint64_t in = (x >> 30) & 3;
+    ASSERT(ma_set_input(a, &in) == 0 && ma_set_input(b, &in) == 0);
+    moore_t *both[] = {a, b};
+    ASSERT(ma_step(both, 2) == 0);
+    ASSERT(ma_get_output(a)[0] == ma_get_output(b)[0]);
+  }
+  uint64_t symbols[4] = {0x123456789abcdefULL, 0xfedcba9876543210ULL, 7, 0};
+  uint64_t out_a[100], out_b[100];
+  ASSERT(ma_run_stream(a, symbols, 100, 2, out_a, 1) == 0);
+  ASSERT(ma_run_stream(b, symbols, 100, 2, out_b, 1) == 0);
+  ASSERT(memcmp(out_a, out_b, sizeof(out_a)) == 0);
+
+  // Profil: najczęściej odwiedzana klasa dostaje numer 0.
+  ASSERT(mapping[5] != 0);
+  ASSERT(ma_table_profile(type, 1) == 0);
+  q = 5;
+  ASSERT(ma_set_state(a, &q) == 0);
+  x = 0;
+  ASSERT(ma_set_input(a, &x) == 0);
+  for (size_t i = 0; i < 10; ++i)
+    ASSERT(ma_step(&a, 1) == 0);
+  // Wyliczanie wszystkich przejść w ma_flatten nie liczy się do profilu.
+  for (size_t i = 0; i < 8; ++i) {
+    moore_t *flat = ma_flatten(&a, 1, NULL);
+    ASSERT(flat);
+    ma_delete(flat);
+  }
+  ma_type_t *hot = ma_table_minimize(type, mapping);
+  assert(hot);
+  ASSERT(mapping[5] == 0 && ma_table_states(hot) == 3);
+  ASSERT(ma_table_profile(type, 0) == 0);
+
+  TEST_NULL_EINVAL(ma_table_create(2, 12, 4, delta, lambda));
+  TEST_NULL_EINVAL(ma_table_create(0, 65, 1, bad, lambda));
+  ASSERT(ma_table_create(0, 1, 4, bad, lambda) == NULL);
+  ma_type_t *plain = ma_type_register(1, 1, 1, t_forward, y_forward, 0);
+  assert(plain);
+  TEST_NULL_EINVAL(ma_table_minimize(plain, NULL));
+  TEST_EINVAL(ma_table_profile(plain, 1));
+
+  ma_delete(a);
+  ma_delete(b);
+  ma_type_release(plain);
+  ma_type_release(hot);
+  ma_type_release(min);
+  ma_type_release(type);
+  return PASS;
+}
+
+static void t_count_en(uint64_t *next_state, uint64_t const *input,
+                       uint64_t const *old_state, size_t, size_t) {
+  next_state[0] = (old_state[0] + (input[0] & 1)) & 7;
+}
+
+static void t_shift_in(uint64_t *next_state, uint64_t const *input,
+                       uint64_t const *old_state, size_t, size_t) {
+  next_state[0] = ((old_state[0] << 1) | (input[0] & 1) | ((input[0] >> 1) & 1)) & 15;
+}
+
+static void y_low2(uint64_t *output, uint64_t const *state, size_t, size_t) {
+  output[0] = state[0] ^ 2;
+}
+
+// Testuje spłaszczanie grupy automatów w jeden automat tablicowy.
+static int flatten(void) {
+  const uint64_t q0 = 0, q1 = 5, q2 = 9, free_in = 2;
+  size_t offsets[2];
+
+  // Zewnętrzny przełącznik steruje licznikiem, którego bit 2 wpada do rejestru.
+  moore_t *e = ma_create_simple(0, 1, t_neg);
+  moore_t *c = ma_create_full(1, 3, 3, t_count_en, y_low2, &q1);
+  moore_t *r = ma_create_full(2, 4, 4, t_shift_in, y_forward, &q2);
+  assert(e && c && r);
+  ASSERT(ma_connect(c, 0, e, 0, 1) == 0);
+  ASSERT(ma_connect(r, 0, c, 2, 1) == 0);
+  ASSERT(ma_set_input(r, &free_in) == 0);
+
+  moore_t *group[] = {c, r};
+  moore_t *flat = ma_flatten(group, 2, offsets);
+  assert(flat);
+  ASSERT(offsets[0] == 0 && offsets[1] == 3);
+  moore_t *all[] = {e, c, r, flat};
+  for (size_t i = 0; i < 40; ++i) {
+    uint64_t out = ma_get_output(flat)[0];
+    ASSERT((out & 7) == ma_get_output(c)[0]);
+    ASSERT((out >> 3 & 15) == ma_get_output(r)[0]);
+    ASSERT(ma_step(all, 4) == 0);
+  }
+
+  // ma_flatten nie nadpisuje wejść członków. Po usunięciu rodzica spoza grupy odłączony
+  // bit produktu zachowuje wartość odczytaną przy spłaszczaniu, a bit członka swoją.
+  moore_t *e2 = ma_create_simple(0, 1, t_neg);
+  moore_t *c2 = ma_create_full(1, 3, 3, t_count_en, y_forward, &q0);
+  assert(e2 && c2);
+  ASSERT(ma_connect(c2, 0, e2, 0, 1) == 0);
+  ASSERT(ma_step(&e2, 1) == 0 && ma_get_output(e2)[0] == 1);
+  moore_t *flat2 = ma_flatten(&c2, 1, NULL);
+  assert(flat2);
+  ma_delete(e2);
+  moore_t *pair[] = {c2, flat2};
+  ASSERT(ma_step(pair, 2) == 0);
+  ASSERT(ma_get_output(c2)[0] == 0 && ma_get_output(flat2)[0] == 1);
+  ma_delete(flat2);
+  ma_delete(c2);
+
+  moore_t *wide = ma_create_full(0, 1, 17, t_count_en, y_forward, &q0);
+  assert(wide);
+  moore_t *too_big[] = {c, wide};
+  TEST_NULL_EINVAL(ma_flatten(too_big, 2, NULL));
+  moore_t *twice[] = {c, c};
+  TEST_NULL_EINVAL(ma_flatten(twice, 2, NULL));
+  TEST_NULL_EINVAL(ma_flatten(NULL, 1, NULL));
+
+  ma_delete(wide);
+  ma_delete(flat);
+  ma_delete(e);
+  ma_delete(c);
+  ma_delete(r);
+  return PASS;
+}
+
+// Sprawdza krok automatu tablicowego z pełną tablicą przejść.
+static int check_table(ma_type_t *type, uint32_t const *delta, size_t n, uint64_t q) {
+  moore_t *a = ma_create_from_type(type, &q);
+  assert(a);
+  uint64_t x = q;
+  for (size_t i = 0; i < 2000; ++i) {
+    x = x * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL;
+    uint64_t in = x >> 40;
+    ASSERT(ma_set_input(a, &in) == 0);
+    ASSERT(ma_step(&a, 1) == 0);
+    q = delta[q << n | (in & ((1u << n) - 1))];
+    ASSERT(ma_get_output(a)[0] == q);
+  }
+  ma_delete(a);
+  return PASS;
+}
+
+// Testuje automatyczny wybór skompresowanego formatu tablicy.
+static int compressed(void) {
+  enum { N = 6, STATES = 2000 };
+  static uint32_t delta[STATES << N];
+  static uint64_t lambda[STATES];
+  struct ma_table_report report;
+  uint64_t x = 1;
+
+  // Osiem klas symboli, w każdym wierszu dominuje jeden następnik.
+  for (uint32_t q = 0; q < STATES; ++q) {
+    lambda[q] = q;
+    x = x * 0x9e3779b97f4a7c15ULL + 1;
+    for (uint32_t c = 0; c < (1 << N); ++c)
+      delta[q << N | c] = c % 8 == q % 8 ? (x >> 33) % STATES : (q * 7 + 1) % STATES;
+  }
+  ma_type_t *type = ma_table_create(N, 16, STATES, delta, lambda);
+  assert(type);
+  ASSERT(ma_table_report(type, &report) == 0);
+  ASSERT(report.format == MA_TABLE_DISPLACEMENT);
+  ASSERT(report.classes == 8 && report.exceptions <= STATES);
+  ASSERT(report.dense_bytes == sizeof(delta) && report.ratio > 4);
+  ASSERT(check_table(type, delta, N, 17) == PASS);
+  ma_type_t *min = ma_table_minimize(type, NULL);
+  assert(min);
+  ASSERT(ma_table_states(min) == STATES);
+  ma_type_release(min);
+  ma_type_release(type);
+
+  // Kolumny bez powtórzeń: tablica zostaje pełna.
+  for (size_t i = 0; i < SIZE(delta); ++i) {
+    x = x * 0x9e3779b97f4a7c15ULL + 1;
+    delta[i] = (x >> 33) % STATES;
+  }
+  type = ma_table_create(N, 16, STATES, delta, lambda);
+  assert(type);
+  ASSERT(ma_table_report(type, &report) == 0);
+  ASSERT(report.format == MA_TABLE_DENSE && report.ratio == 1);
+  ASSERT(check_table(type, delta, N, 5) == PASS);
+  ma_type_release(type);
+
+  TEST_EINVAL(ma_table_report(NULL, &report));
+  return PASS;
+}
+
+typedef struct {
+  size_t count[16];
+  uint64_t hash[16];
+  uint64_t last[16];
+  bool ordered;
+} match_log_t;
+
+static void on_match(void *ctx, size_t automaton, uint64_t position, uint64_t output) {
+  match_log_t *log = ctx;
+  if (log->count[automaton] > 0 && position <= log->last[automaton])
+    log->ordered = false;
+  log->count[automaton]++;
+  log->hash[automaton] = log->hash[automaton] * 31 + position * 7 + output;
+  log->last[automaton] = position;
+}
+
+// Testuje wiele automatów na jednym wspólnym strumieniu.
+static int multi(void) {
+  enum { NUM = 9, COUNT = 4200, FIRST = 2496, BITS = 4 };
+  static uint64_t data[COUNT * BITS / 64 + 1], out[COUNT];
+  static uint32_t delta[4 << BITS];
+  const uint64_t lambda[4] = {0, 0, 0, 1}, q = 1;
+  match_log_t log = {.ordered = true}, expected = {.ordered = true};
+  moore_t *a[NUM], *b[NUM];
+  for (size_t i = 0; i < SIZE(data); ++i)
+    data[i] = (i + 3) * 0x9e3779b97f4a7c15ULL;
+
+  // Tablicowe liczniki wystąpień symbolu modulo 4 oraz automaty z funkcjami.
+  ma_type_t *types[6];
+  for (size_t i = 0; i < 6; ++i) {
+    for (uint32_t st = 0; st < 4; ++st)
+      for (uint32_t x = 0; x < (1 << BITS); ++x)
+        delta[st << BITS | x] = x == i + 1 ? (st + 1) % 4 : st;
+    types[i] = ma_table_create(BITS, 1, 4, delta, lambda);
+    assert(types[i]);
+    a[i] = ma_create_from_type(types[i], &q);
+    b[i] = ma_create_from_type(types[i], &q);
+  }
+  for (size_t i = 6; i < 8; ++i) {
+    a[i] = ma_create_full(12, 20, 20, t_decode, y_forward, &q);
+    b[i] = ma_create_full(12, 20, 20, t_decode, y_forward, &q);
+  }
+  // Pętla własna wymusza wolną ścieżkę.
+  a[8] = ma_create_simple(8, 8, t_forward);
+  b[8] = ma_create_simple(8, 8, t_forward);
+  for (size_t i = 0; i < NUM; ++i)
+    assert(a[i] && b[i]);
+  ASSERT(ma_connect(a[8], 4, a[8], 0, 4) == 0);
+  ASSERT(ma_connect(b[8], 4, b[8], 0, 4) == 0);
+
+  ma_multi_t *mm = ma_multi_create(BITS, on_match, &log);
+  assert(mm);
+  for (size_t i = 0; i < NUM; ++i)
+    ASSERT(ma_multi_add(mm, a[i], i < 6 ? 1 : 0x10) == (int)i);
+  TEST_EINVAL(ma_multi_add(mm, a[0], 1));
+  ASSERT(ma_multi_feed(mm, data, FIRST) == 0);
+  ASSERT(ma_multi_feed(mm, data + FIRST * BITS / 64, COUNT - FIRST) == 0);
+  ASSERT(ma_multi_position(mm) == COUNT);
+
+  for (size_t i = 0; i < NUM; ++i) {
+    ASSERT(ma_run_stream(b[i], data, COUNT, BITS, out, 1) == 0);
+    for (size_t k = 0; k < COUNT; ++k)
+      if (out[k] & (i < 6 ? 1 : 0x10))
+        on_match(&expected, i, k, out[k]);
+    ASSERT(log.count[i] == expected.count[i] && log.hash[i] == expected.hash[i]);
+    ASSERT(ma_get_output(a[i])[0] == ma_get_output(b[i])[0]);
+  }
+  ASSERT(log.ordered && log.count[0] > 0);
+
+  ma_multi_destroy(mm);
+  TEST_NULL_EINVAL(ma_multi_create(0, NULL, NULL));
+  for (size_t i = 0; i < NUM; ++i) {
+    ma_delete(a[i]);
+    ma_delete(b[i]);
+  }
+  for (size_t i = 0; i < 6; ++i)
+    ma_type_release(types[i]);
+  return PASS;
+}
+
+static void t_decimal(uint64_t *next_state, uint64_t const *input,
+                      uint64_t const *old_state, size_t, size_t) {
+  next_state[0] = (input[0] & 1) ? (old_state[0] + 1) % 10 : old_state[0];
+}
+
+static void t_latch(uint64_t *next_state, uint64_t const *input,
+                    uint64_t const *old_state, size_t, size_t) {
+  uint64_t lo = input[0] & 15, hi = input[0] >> 4 & 15;
+  next_state[0] = old_state[0] | (lo > 9) | (lo == 9 && hi == 9) << 1;
+}
+
+// Testuje symboliczną osiągalność na sieci zbyt dużej dla jawnego przeszukiwania.
+static int symbolic(void) {
+  enum { NUM = 40 };
+  const uint64_t zero[1] = {0};
+  moore_t *c[NUM + 2];
+  double states;
+  size_t iterations;
+
+  // 40 niezależnych liczników dziesiętnych: 10^40 stanów.
+  for (size_t i = 0; i < NUM; ++i) {
+    c[i] = ma_create_simple(1, 4, t_decimal);
+    assert(c[i]);
+  }
+  ma_symbolic_t *sym = ma_symbolic_create(c, NUM);
+  assert(sym);
+  ASSERT(ma_symbolic_reach(sym, &states, &iterations) == 0);
+  ASSERT(states > 0.999999e40 && states < 1.000001e40 && iterations == 10);
+  // Przesiewanie nie zmienia policzonego zbioru.
+  ASSERT(ma_symbolic_reorder(sym) == 0);
+  ASSERT(ma_symbolic_reach(sym, &states, &iterations) == 0);
+  ASSERT(states > 0.999999e40 && states < 1.000001e40 && iterations == 10);
+  ma_symbolic_destroy(sym);
+
+  // Zatrzask ustawia bit 0 dla cyfry > 9 (nigdy), a bit 1 dla pary 99.
+  c[NUM] = ma_create_full(8, 2, 2, t_latch, y_forward, zero);
+  // 64-bitowy rejestr przesuwny opisany równaniami, zasilany bitem 3 licznika.
+  c[NUM + 1] = ma_create_simple(1, 64, t_neg);
+  assert(c[NUM] && c[NUM + 1]);
+  ASSERT(ma_connect(c[NUM], 0, c[0], 0, 4) == 0);
+  ASSERT(ma_connect(c[NUM], 4, c[1], 0, 4) == 0);
+  ASSERT(ma_connect(c[NUM + 1], 0, c[0], 3, 1) == 0);
+  sym = ma_symbolic_create(c, NUM + 2);
+  assert(sym);
+  TEST_EINVAL(ma_symbolic_output_reachable(sym, NUM + 1, 63));
+  ASSERT(ma_symbolic_equation(sym, NUM + 1, MA_SYMBOLIC_NEXT, 0, "i0") == 0);
+  char expr[16];
+  for (size_t k = 1; k < 64; ++k) {
+    snprintf(expr, sizeof expr, "s%zu", k - 1);
+    ASSERT(ma_symbolic_equation(sym, NUM + 1, MA_SYMBOLIC_NEXT, k, expr) == 0);
+  }
+  TEST_EINVAL(ma_symbolic_equation(sym, NUM + 1, MA_SYMBOLIC_NEXT, 64, "s0"));
+  TEST_EINVAL(ma_symbolic_equation(sym, NUM + 1, MA_SYMBOLIC_NEXT, 0, "s0 &"));
+  TEST_EINVAL(ma_symbolic_equation(sym, NUM + 1, MA_SYMBOLIC_OUTPUT, 0, "i0"));
+  ASSERT(ma_symbolic_output_reachable(sym, NUM, 0) == 0);
+  ASSERT(ma_symbolic_output_reachable(sym, NUM, 1) == 1);
+  ASSERT(ma_symbolic_output_reachable(sym, NUM + 1, 63) == 1);
+  // Wyjście równe stałej nigdy nie jest ustawione.
+  ASSERT(ma_symbolic_equation(sym, NUM + 1, MA_SYMBOLIC_OUTPUT, 5, "s5 & !s5 | 0") == 0);
+  ASSERT(ma_symbolic_output_reachable(sym, NUM + 1, 5) == 0);
+  ASSERT(ma_symbolic_reach(sym, NULL, &iterations) == 0);
+  ASSERT(iterations > 64);
+  ma_symbolic_destroy(sym);
+
+  TEST_NULL_EINVAL(ma_symbolic_create(c, 0));
+  for (size_t i = 0; i < NUM + 2; ++i)
+    ma_delete(c[i]);
+  return PASS;
+}
+
+// Testuje przesiewanie zmiennych na funkcji wykładniczej w początkowym porządku.
+static int symbolic_reorder(void) {
+  enum { PARY = 12, S = 2 * PARY };
+  const uint64_t jeden[1] = {1};
+  moore_t *a = ma_create_simple(1, S, t_neg);
+  assert(a);
+  ASSERT(ma_set_state(a, jeden) == 0);
+  ma_symbolic_t *sym = ma_symbolic_create(&a, 1);
+  assert(sym);
+  // Pierścień z jedną jedynką: S stanów.
+  char expr[512];
+  for (size_t k = 0; k < S; ++k) {
+    snprintf(expr, sizeof expr, "s%zu", (k + 1) % S);
+    ASSERT(ma_symbolic_equation(sym, 0, MA_SYMBOLIC_NEXT, k, expr) == 0);
+  }
+  // Suma par odległych bitów: 2^PARY węzłów w porządku s0..s23, liniowo po przeplocie.
+  size_t dlugosc = 0;
+  for (size_t k = 0; k < PARY; ++k) {
+    dlugosc += (size_t)snprintf(expr + dlugosc, sizeof expr - dlugosc, "%ss%zu & s%zu",
+                                k ? " | " : "", k, k + PARY);
+  }
+  ASSERT(ma_symbolic_equation(sym, 0, MA_SYMBOLIC_OUTPUT, 0, expr) == 0);
+  double states;
+  size_t iterations;
+  ASSERT(ma_symbolic_reach(sym, &states, &iterations) == 0);
+  ASSERT(states == S && iterations == S);
+  ASSERT(ma_symbolic_output_reachable(sym, 0, 0) == 0);
+  size_t przed = ma_symbolic_nodes(sym);
+  ASSERT(przed > 1u << PARY);
+  ASSERT(ma_symbolic_reorder(sym) == 0);
+  size_t po = ma_symbolic_nodes(sym);
+  ASSERT(po > 0 && po * 10 < przed);
+  ASSERT(ma_symbolic_reach(sym, &states, &iterations) == 0);
+  ASSERT(states == S && iterations == S);
+  ASSERT(ma_symbolic_output_reachable(sym, 0, 0) == 0);
+  ASSERT(ma_symbolic_output_reachable(sym, 0, PARY - 1) == 1);
+
+  // Nowe równania i ponowna kompilacja działają w przestawionym porządku:
+  // z trwałym bitem 0 jedynki wypełniają pierścień od góry (znów S stanów).
+  ASSERT(ma_symbolic_equation(sym, 0, MA_SYMBOLIC_NEXT, 0, "s1 | s0") == 0);
+  ASSERT(ma_symbolic_reach(sym, &states, &iterations) == 0);
+  ASSERT(ma_symbolic_output_reachable(sym, 0, 0) == 1);
+  ASSERT(ma_symbolic_reorder(sym) == 0);
+  double jeszcze;
+  ASSERT(ma_symbolic_reach(sym, &jeszcze, NULL) == 0);
+  ASSERT(jeszcze == states && states == S);
+  TEST_EINVAL(ma_symbolic_reorder(NULL));
+  ma_symbolic_destroy(sym);
+  ma_delete(a);
+  return PASS;
+}
+
+static void f_xor5(uint64_t *output, uint64_t const *input, size_t, size_t) {
+  output[0] = (input[0] ^ 5) & 7;
+}
+
+// Osobna sieć z łańcuchem węzłów w odwróconej kolejności, krokowana w wątku.
+static void *comb_thread(void *) {
+  enum { LEN = 100, STEPS = 200 };
+  const uint64_t one = 1, q = 0;
+  moore_t *at[LEN + 1];
+  at[LEN] = ma_create_full(1, 3, 3, t_count_en, y_forward, &q);
+  assert(at[LEN]);
+  for (size_t i = 0; i < LEN; ++i) {
+    at[i] = ma_create_comb(3, 3, f_xor5);
+    assert(at[i]);
+  }
+  bool blad = false;
+  if (ma_set_input(at[LEN], &one) != 0)
+    blad = true;
+  // at[LEN - 1] czyta licznik, at[0] jest ostatnim poziomem.
+  for (size_t i = 0; i < LEN; ++i)
+    if (ma_connect(at[i], 0, at[i + 1], 0, 3) != 0)
+      blad = true;
+  for (int k = 0; k < STEPS && !blad; ++k)
+    if (ma_step(at, LEN + 1) != 0 || ma_get_output(at[0])[0] != ma_get_output(at[LEN])[0])
+      blad = true;
+  for (size_t i = 0; i <= LEN; ++i)
+    ma_delete(at[i]);
+  return (void *)(uintptr_t)blad;
+}
+
+// Testuje węzły kombinacyjne liczone bez opóźnienia w kolejności poziomów.
+static int comb(void) {
+  const uint64_t one = 1, q = 0;
+  moore_t *c = ma_create_full(1, 3, 3, t_count_en, y_forward, &q);
+  moore_t *r = ma_create_simple(3, 3, t_forward);
+  moore_t *g1 = ma_create_comb(3, 3, f_xor5);
+  moore_t *g2 = ma_create_comb(3, 3, f_xor5);
+  assert(c && r && g1 && g2);
+  ASSERT(ma_set_input(c, &one) == 0);
+  // c -> g1 -> g2 -> r: dwa poziomy logiki między rejestrami.
+  ASSERT(ma_connect(g2, 0, g1, 0, 3) == 0);
+  ASSERT(ma_connect(g1, 0, c, 0, 3) == 0);
+  ASSERT(ma_connect(r, 0, g2, 0, 3) == 0);
+  // Pętle kombinacyjne są odrzucane, pętle przez rejestr dozwolone.
+  TEST_EINVAL(ma_connect(g1, 0, g2, 0, 1));
+  TEST_EINVAL(ma_connect(g1, 0, g1, 1, 1));
+  ASSERT(ma_connect(c, 0, g2, 0, 1) == 0);
+  ASSERT(ma_disconnect(c, 0, 1) == 0);
+  ASSERT(ma_set_input(c, &one) == 0);
+
+  // Ustawienie stanu rodzica lub wejścia węzła od razu zmienia wyjścia węzłów za nim.
+  const uint64_t six = 6;
+  ASSERT(ma_set_state(c, &six) == 0);
+  ASSERT(ma_get_output(g1)[0] == 3 && ma_get_output(g2)[0] == 6);
+  ASSERT(ma_set_state(c, &q) == 0);
+  ASSERT(ma_get_output(g1)[0] == 5 && ma_get_output(g2)[0] == 0);
+  moore_t *g3 = ma_create_comb(3, 3, f_xor5);
+  assert(g3);
+  ASSERT(ma_get_output(g3)[0] == 5);
+  ASSERT(ma_set_input(g3, &six) == 0);
+  ASSERT(ma_get_output(g3)[0] == 3);
+  ASSERT(ma_connect(g3, 0, g1, 0, 2) == 0);
+  ASSERT(ma_set_input(g1, &six) == 0);
+  // g1 bierze wejście z c, a g3 bity 0-1 z g1 i bit 2 z ostatniego ma_set_input.
+  ASSERT(ma_get_output(g1)[0] == 5 && ma_get_output(g3)[0] == ((4 | 1) ^ 5));
+  ma_delete(g3);
+
+  moore_t *at[] = {r, g2, c, g1};
+  for (uint64_t i = 0; i < 20; ++i) {
+    uint64_t prev = ma_get_output(c)[0];
+    ASSERT(ma_step(at, 4) == 0);
+    ASSERT(ma_get_output(c)[0] == (i + 1) % 8);
+    // Rejestr widzi stan licznika z tego samego cyklu.
+    ASSERT(ma_get_output(r)[0] == prev);
+    ASSERT(ma_get_output(g1)[0] == (ma_get_output(c)[0] ^ 5));
+    ASSERT(ma_get_output(g2)[0] == ma_get_output(c)[0]);
+  }
+
+  // Po odwróceniu kolejności g1 musi być liczony po g2.
+  ASSERT(ma_disconnect(g2, 0, 3) == 0);
+  ASSERT(ma_connect(g2, 0, c, 0, 3) == 0);
+  ASSERT(ma_connect(g1, 0, g2, 0, 3) == 0);
+  ASSERT(ma_connect(r, 0, g1, 0, 3) == 0);
+  TEST_EINVAL(ma_connect(g2, 0, g1, 0, 1));
+  for (uint64_t i = 0; i < 10; ++i) {
+    uint64_t prev = ma_get_output(c)[0];
+    ASSERT(ma_run_tuned(at, 4, 1) == 0);
+    ASSERT(ma_get_output(r)[0] == prev);
+    ASSERT(ma_get_output(g1)[0] == ma_get_output(c)[0]);
+  }
+
+  // Długi łańcuch łączony od końca: poziomy poprawiane w głąb bez rekurencji.
+  enum { CHAIN = 4096 };
+  moore_t **chain = malloc((CHAIN + 2) * sizeof(moore_t *));
+  assert(chain);
+  for (size_t i = 0; i < CHAIN; ++i) {
+    chain[i] = ma_create_comb(3, 3, f_xor5);
+    assert(chain[i]);
+  }
+  for (size_t i = CHAIN - 1; i > 0; --i)
+    ASSERT(ma_connect(chain[i], 0, chain[i - 1], 0, 3) == 0);
+  ASSERT(ma_connect(chain[0], 0, c, 0, 3) == 0);
+  TEST_EINVAL(ma_connect(chain[0], 0, chain[CHAIN - 1], 0, 1));
+  ASSERT(ma_connect(r, 0, chain[CHAIN - 1], 0, 3) == 0);
+  chain[CHAIN] = c;
+  chain[CHAIN + 1] = r;
+  for (uint64_t i = 0; i < 5; ++i) {
+    uint64_t prev = ma_get_output(c)[0];
+    ASSERT(ma_step(chain, CHAIN + 2) == 0);
+    ASSERT(ma_get_output(r)[0] == prev);
+    ASSERT(ma_get_output(chain[CHAIN - 1])[0] == ma_get_output(c)[0]);
+  }
+  for (size_t i = 0; i < CHAIN; ++i)
+    ma_delete(chain[i]);
+  free(chain);
+
+  // Porządek węzłów jest lokalny dla kroku: osobne sieci można krokować równolegle.
+  pthread_t threads[2];
+  for (size_t i = 0; i < 2; ++i)
+    ASSERT(pthread_create(&threads[i], NULL, comb_thread, NULL) == 0);
+  for (size_t i = 0; i < 2; ++i) {
+    void *wynik;
+    ASSERT(pthread_join(threads[i], &wynik) == 0);
+    ASSERT(wynik == NULL);
+  }
+
+  TEST_NULL_EINVAL(ma_create_comb(3, 0, f_xor5));
+  TEST_NULL_EINVAL(ma_create_comb(3, 3, NULL));
+  ma_delete(g1);
+  ASSERT(ma_step(at, 3) == 0);
+  ma_delete(g2);
+  ma_delete(c);
+  ma_delete(r);
+  return PASS;
+}
+
+// Testuje pierścień historii wyjść zapisywany przez fazę commit.
+static int history(void) {
+  enum { DEPTH = 5 };
+  const uint64_t one = 1, q = 0, q2[2] = {0, 0};
+  moore_t *c = ma_create_full(1, 3, 3, t_count_en, y_low2, &q);
+  moore_t *r = ma_create_simple(3, 3, t_forward);
+  moore_t *w = ma_create_simple(1, 70, t_const);
+  assert(c && r && w);
+  ASSERT(ma_set_input(c, &one) == 0);
+  ASSERT(ma_connect(r, 0, c, 0, 3) == 0);
+  ASSERT(ma_set_state(w, q2) == 0);
+  ASSERT(ma_enable_history(c, DEPTH) == 0);
+  ASSERT(ma_enable_history(w, 2) == 0);
+  TEST_NULL_EINVAL(ma_get_output_at(c, 1));
+  ASSERT(ma_get_output_at(c, 0)[0] == 2);
+
+  moore_t *at[] = {c, r, w};
+  for (uint64_t i = 1; i <= 12; ++i) {
+    ASSERT(i % 3 ? ma_step(at, 3) == 0 : ma_run_tuned(at, 3, 1) == 0);
+    // Dziecko czyta bieżący slot pierścienia.
+    ASSERT(ma_get_output(r)[0] == (((i - 1) % 8) ^ 2));
+    for (uint64_t k = 0; k <= DEPTH && k <= i; ++k)
+      ASSERT(ma_get_output_at(c, k)[0] == (((i - k) % 8) ^ 2));
+    if (i < DEPTH)
+      TEST_NULL_EINVAL(ma_get_output_at(c, i + 1));
+  }
+  TEST_NULL_EINVAL(ma_get_output_at(c, DEPTH + 1));
+  // Stabilny automat też dostaje wpis w każdym kroku.
+  ASSERT(ma_get_output_at(w, 2) && ma_get_output_at(w, 2)[1] == 0);
+
+  // Strumień zapisuje każdy krok, a wyłączenie zostawia bieżące wyjście.
+  uint64_t ones[1] = {UINT64_MAX};
+  ASSERT(ma_run_stream(c, ones, 3, 1, NULL, 0) == 0);
+  ASSERT(ma_get_output_at(c, 3)[0] == ((12 % 8) ^ 2));
+  ASSERT(ma_get_output_at(c, 1)[0] == ((14 % 8) ^ 2));
+  ma_disable_history(c);
+  ASSERT(ma_get_output(c)[0] == ((15 % 8) ^ 2));
+  TEST_NULL_EINVAL(ma_get_output_at(c, 1));
+  TEST_EINVAL(ma_enable_history(c, 0));
+  ma_delete(c);
+  ma_delete(r);
+  ma_delete(w);
+  return PASS;
+}
+
+static void *churn(void *) {
+  for (int i = 0; i < 50; ++i) {
+    moore_t *a = ma_create_simple(8, 100, t_forward);
+    assert(a);
+    ma_delete(a);
+  }
+  return NULL;
+}
+
+static bool has_site(memory_profile_site_t const *sites, size_t count, char const *name,
+                     uint64_t calls) {
+  for (size_t i = 0; i < count; ++i)
+    if (sites[i].symbol && strcmp(sites[i].symbol, name) == 0 && sites[i].calls >= calls)
+      return true;
+  return false;
+}
+
+// Testuje profil alokacji z licznikami wątków i miejscami wywołania.
+static int profile(void) {
+  enum { NUM = 20, STEPS = 30 };
+  const uint64_t q[4] = {0};
+  moore_t *a[NUM];
+  memory_profile_totals_t t;
+  memory_profile_site_t sites[32];
+
+  memory_profile_reset();
+  memory_profile_enable(true);
+  for (size_t i = 0; i < NUM; ++i) {
+    a[i] = ma_create_full(64, 200, 200, t_forward, y_forward, q);
+    assert(a[i]);
+  }
+  for (size_t i = 1; i < NUM; ++i)
+    ASSERT(ma_connect(a[i], 0, a[i - 1], 0, 64) == 0);
+  memory_profile_totals(&t);
+  int64_t live = 0;
+  for (size_t k = 0; k < MEMORY_PROFILE_CLASSES; ++k)
+    live += t.live_blocks[k];
+  ASSERT(t.allocs > 0 && t.frees == 0 && (uint64_t)live == t.allocs);
+  int64_t after_create = t.live_bytes;
+  for (size_t k = 0; k < STEPS; ++k)
+    ASSERT(ma_step(a, NUM) == 0);
+
+  pthread_t threads[2];
+  for (size_t i = 0; i < 2; ++i)
+    ASSERT(pthread_create(&threads[i], NULL, churn, NULL) == 0);
+  for (size_t i = 0; i < 2; ++i)
+    ASSERT(pthread_join(threads[i], NULL) == 0);
+
+  memory_profile_totals(&t);
+  ASSERT(t.live_bytes == after_create && t.peak_bytes > after_create);
+  size_t count = memory_profile_sites(sites, SIZE(sites));
+  ASSERT(count > 2 && count <= SIZE(sites) && t.lost_sites == 0);
+  // Bufory next_state alokuje krok_sieci, wspólny dla ma_step i ma_step_measured.
+  ASSERT(has_site(sites, count, "krok_sieci", NUM * STEPS));
+  ASSERT(has_site(sites, count, "dodaj_do_listy", 2 * (NUM - 1)));
+  for (size_t i = 1; i < count; ++i)
+    ASSERT(sites[i - 1].bytes >= sites[i].bytes);
+
+  for (size_t i = 0; i < NUM; ++i)
+    ma_delete(a[i]);
+  memory_profile_enable(false);
+  memory_profile_totals(&t);
+  ASSERT(t.allocs == t.frees && t.live_bytes == 0 && t.bytes_allocated == t.bytes_freed);
+  ASSERT(t.threads >= 3);
+  for (size_t k = 0; k < MEMORY_PROFILE_CLASSES; ++k)
+    ASSERT(t.live_blocks[k] == 0);
+  FILE *null = fopen("/dev/null", "w");
+  assert(null);
+  memory_profile_report(null, 10);
+  fclose(null);
+  return PASS;
+}
+
+static int topology(void) {
+  enum { N = 80 };
+  const uint64_t q = 0;
+  ma_type_t *reg = ma_type_register(2, 2, 2, t_forward, NULL,
+                                    MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT);
+  moore_t *at[N], *x = ma_create_simple(1, 1, t_forward);
+  assert(reg && x);
+  for (size_t i = 0; i < N; ++i) {
+    at[i] = ma_create_from_type(reg, &q);
+    assert(at[i]);
+    if (i > 0)
+      ASSERT(ma_connect(at[i], 0, at[i - 1], 0, 2) == 0);
+  }
+  ASSERT(ma_connect(at[50], 1, at[5], 0, 1) == 0);
+  ASSERT(ma_connect(at[0], 0, x, 0, 1) == 0);
+
+  // Łańcuch bez sprzężeń: każdy automat jest osobną składową.
+  struct ma_topology_report r;
+  ASSERT(ma_analyze(at, N, &r) == 0);
+  ASSERT(r.automata == N && r.types == 1 && r.largest_type == N && r.pure_automata == N);
+  ASSERT(r.edges == N && r.max_fan_in == 2 && r.max_fan_out == 2);
+  ASSERT(r.fan_in_histogram[0] == 1 && r.fan_in_histogram[1] == N - 2 &&
+         r.fan_in_histogram[2] == 1);
+  ASSERT(r.fan_out_histogram[0] == 1 && r.fan_out_histogram[2] == 1);
+  ASSERT(r.sources == 1 && r.sinks == 1);
+  ASSERT(r.components == N && r.largest_component == 1 && r.cyclic_components == 0);
+  ASSERT(r.depth == N);
+  ASSERT(r.routed_bits == 2 * (N - 1) && r.external_bits == 1 && r.free_bits == 1);
+  ASSERT(r.bytes_per_step > 0);
+  ASSERT(r.suggested == MA_EXEC_PIPELINED);
+
+  // Sprzężenie zamyka łańcuch w jedną składową.
+  ASSERT(ma_connect(at[0], 1, at[N - 1], 1, 1) == 0);
+  ASSERT(ma_analyze(at, N, &r) == 0);
+  ASSERT(r.components == 1 && r.largest_component == N && r.cyclic_components == 1 &&
+         r.cyclic_automata == N && r.depth == 1 && r.sources == 0 && r.sinks == 0);
+  ASSERT(r.suggested == MA_EXEC_EVENT_DRIVEN);
+
+  // Odłączone połączenie znika z raportu; zbiór częściowy widzi resztę jako zewnętrzną.
+  ASSERT(ma_disconnect(at[0], 1, 1) == 0);
+  ASSERT(ma_analyze(at, N, &r) == 0);
+  ASSERT(r.components == N && r.depth == N && r.free_bits == 1);
+  ASSERT(ma_analyze(at + 10, 10, &r) == 0);
+  ASSERT(r.edges == 9 && r.external_bits == 2 && r.depth == 10 &&
+         r.suggested == MA_EXEC_SEQUENTIAL);
+  ASSERT(ma_connect(x, 0, x, 0, 1) == 0);
+  ASSERT(ma_analyze(&x, 1, &r) == 0);
+  ASSERT(r.cyclic_components == 1 && r.cyclic_automata == 1 && r.edges == 1);
+
+  moore_t *dup[] = {at[0], at[1], at[0]};
+  TEST_EINVAL(ma_analyze(dup, 3, &r));
+  TEST_EINVAL(ma_analyze(at, 0, &r));
+  TEST_EINVAL(ma_analyze(at, N, NULL));
+  for (size_t i = 0; i < N; ++i)
+    ma_delete(at[i]);
+  ma_delete(x);
+  ma_type_release(reg);
+  return PASS;
+}
+
+static int latency(void) {
+  // Znane wartości: percentyle mieszczą się w błędzie przedziału, maksimum jest dokładne.
+  ma_latency_t *lat = ma_latency_create(1);
+  assert(lat);
+  for (uint64_t ns = 1; ns <= 10000; ++ns)
+    ASSERT(ma_latency_record(lat, MA_PHASE_TRANSITION, ns) == 0);
+  ASSERT(ma_latency_count(lat, MA_PHASE_TRANSITION) == 10000);
+  ASSERT(ma_latency_count(lat, MA_PHASE_STEP) == 0);
+  ASSERT(ma_latency_percentile(lat, MA_PHASE_STEP, 50) == 0);
+  uint64_t p50 = ma_latency_percentile(lat, MA_PHASE_TRANSITION, 50);
+  uint64_t p99 = ma_latency_percentile(lat, MA_PHASE_TRANSITION, 99);
+  uint64_t p999 = ma_latency_percentile(lat, MA_PHASE_TRANSITION, 99.9);
+  ASSERT(p50 >= 5000 && p50 <= 5000 + 5000 / 32);
+  ASSERT(p99 >= 9900 && p99 <= 9900 + 9900 / 32);
+  ASSERT(p999 >= 9990 && p999 <= 10000);
+  ASSERT(ma_latency_percentile(lat, MA_PHASE_TRANSITION, 100) == 10000);
+  ASSERT(ma_latency_percentile(lat, MA_PHASE_TRANSITION, 0) == 1);
+  ASSERT(ma_latency_record(lat, MA_PHASE_STEP, UINT64_MAX) == 0);
+  ASSERT(ma_latency_percentile(lat, MA_PHASE_STEP, 50) == UINT64_MAX);
+
+  // Kroki sieci: każda faza dostaje zapis, a faza nie trwa dłużej niż cały krok.
+  ma_latency_reset(lat);
+  ASSERT(ma_latency_count(lat, MA_PHASE_TRANSITION) == 0);
+  const uint64_t q = 0;
+  moore_t *at[8];
+  for (size_t i = 0; i < SIZE(at); ++i) {
+    at[i] = ma_create_full(64, 64, 64, t_one, y_one, &q);
+    assert(at[i]);
+    if (i > 0)
+      ASSERT(ma_connect(at[i], 0, at[i - 1], 0, 64) == 0);
+  }
+  for (int i = 0; i < 1000; ++i)
+    ASSERT(ma_step_measured(lat, at, SIZE(at)) == 0);
+  uint64_t step_max = ma_latency_percentile(lat, MA_PHASE_STEP, 100);
+  ASSERT(step_max > 0);
+  for (int phase = 0; phase < MA_PHASES; ++phase) {
+    ASSERT(ma_latency_count(lat, phase) == 1000);
+    ASSERT(ma_latency_percentile(lat, phase, 50) <= ma_latency_percentile(lat, phase, 99));
+    ASSERT(ma_latency_percentile(lat, phase, 99) <= ma_latency_percentile(lat, phase, 99.9));
+    ASSERT(ma_latency_percentile(lat, phase, 100) <= step_max);
+  }
+  // Nieudany krok nie trafia do histogramu.
+  moore_t *third = at[3];
+  at[3] = NULL;
+  TEST_EINVAL(ma_step_measured(lat, at, SIZE(at)));
+  at[3] = third;
+  ASSERT(ma_latency_count(lat, MA_PHASE_STEP) == 1000);
+  TEST_EINVAL(ma_step_measured(NULL, at, 3));
+  TEST_EINVAL(ma_latency_record(lat, MA_PHASES, 1));
+  errno = 0;
+  ASSERT(ma_latency_percentile(lat, MA_PHASE_STEP, 101) == 0 && errno == EINVAL);
+  ma_latency_destroy(lat);
+
+  // Bez podziału na fazy jest tylko histogram całego kroku.
+  lat = ma_latency_create(0);
+  assert(lat);
+  ASSERT(ma_step_measured(lat, at, 3) == 0);
+  ASSERT(ma_latency_count(lat, MA_PHASE_STEP) == 1);
+  TEST_EINVAL(ma_latency_record(lat, MA_PHASE_COMMIT, 1));
+  ma_latency_destroy(lat);
+  for (size_t i = 0; i < SIZE(at); ++i)
+    ma_delete(at[i]);
+  return PASS;
+}
+
+static uint64_t seen_state;
+
+static void y_seen(uint64_t *output, uint64_t const *state, size_t, size_t) {
+  output[0] = state[0] + 1;
+  seen_state = state[0];
+}
+
+static uint64_t seen_input;
+
+static void f_seen(uint64_t *output, uint64_t const *input, size_t, size_t) {
+  output[0] = (input[0] ^ 5) & 7;
+  seen_input = input[0];
+}
+
+static int trace(void) {
+  char path[] = "/tmp/ma_trace_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0)
+    return WRONG_TEST;
+  close(fd);
+  ASSERT(ma_trace_register_transition(1, t_one) == 0);
+  ASSERT(ma_trace_register_output(2, y_seen) == 0);
+  ASSERT(ma_trace_register_transition(3, t_forward) == 0);
+
+  const uint64_t q[1] = {5}, x[1] = {3}, st[1] = {7};
+  moore_t *before = ma_create_simple(1, 1, t_forward);
+  assert(before);
+  ASSERT(ma_trace_start(path) == 0);
+  errno = 0;
+  ASSERT(ma_trace_start(path) == -1 && errno == EBUSY);
+  moore_t *a = ma_create_full(64, 64, 64, t_one, y_seen, q);
+  moore_t *b = ma_create_simple(64, 64, t_forward);
+  moore_t *c = ma_create_full(1, 1, 1, t_two, y_one, q);
+  assert(a && b && c);
+  ASSERT(ma_connect(b, 0, a, 0, 64) == 0);
+  TEST_EINVAL(ma_connect(b, 0, a, 10, 64));
+  ASSERT(ma_set_input(a, x) == 0);
+  ASSERT(ma_set_state(b, st) == 0);
+  moore_t *at[] = {a, b}, *with_before[] = {a, b, before};
+  for (int i = 0; i < 100; ++i)
+    ASSERT(ma_step(at, 2) == 0);
+  ASSERT(ma_run_tuned(at, 2, 50) == 0);
+  uint64_t recorded = seen_state;
+  ASSERT(recorded == 5 + 3 * 150);
+  // Krok z automatem spoza nagrania nie zostanie odtworzony.
+  ASSERT(ma_step(with_before, 3) == 0);
+  ASSERT(ma_disconnect(b, 0, 8) == 0);
+  ma_delete(c);
+  ASSERT(ma_trace_stop() == 0);
+  TEST_EINVAL(ma_trace_stop());
+
+  // Powtarzane kroki na tej samej tablicy zajmują po jednym bajcie.
+  struct stat info;
+  ASSERT(stat(path, &info) == 0 && info.st_size < 1024);
+
+  // Odtworzenie daje ten sam stan; automat spoza nagrania i nieznana funkcja są pomijane.
+  struct ma_replay_report r;
+  seen_state = 0;
+  ASSERT(ma_replay(path, 0, &r) == 0);
+  ASSERT(seen_state == recorded);
+  ASSERT(r.calls[MA_TRACE_CREATE_FULL] == 1 && r.calls[MA_TRACE_CREATE_SIMPLE] == 1);
+  ASSERT(r.calls[MA_TRACE_CONNECT] == 2 && r.calls[MA_TRACE_DISCONNECT] == 1);
+  ASSERT(r.calls[MA_TRACE_SET_INPUT] == 1 && r.calls[MA_TRACE_SET_STATE] == 1);
+  ASSERT(r.calls[MA_TRACE_STEP] == 100 && r.calls[MA_TRACE_RUN_TUNED] == 1);
+  ASSERT(r.calls[MA_TRACE_DELETE] == 0 && r.skipped == 3 && r.mismatches == 0);
+  ASSERT(r.ns[MA_TRACE_STEP] > 0);
+  ASSERT(ma_replay(path, MA_REPLAY_STUBS, &r) == 0);
+  ASSERT(r.calls[MA_TRACE_CREATE_FULL] == 2 && r.calls[MA_TRACE_DELETE] == 1);
+  ASSERT(r.skipped == 1 && r.mismatches == 0);
+
+  // Zmieniona funkcja wyjścia nie pasuje do nagrania, obcy plik jest odrzucany.
+  ASSERT(ma_trace_register_output(2, y_one) == 0);
+  seen_state = 0;
+  ASSERT(ma_replay(path, 0, &r) == 0 && seen_state == 0);
+  ASSERT(ma_trace_register_output(2, y_seen) == 0);
+  FILE *f = fopen(path, "wb");
+  ASSERT(f && fputs("not a trace", f) >= 0 && fclose(f) == 0);
+  TEST_EINVAL(ma_replay(path, 0, &r));
+  TEST_EINVAL(ma_replay(path, 2, &r));
+  ma_delete(a);
+  ma_delete(b);
+
+  // Automaty z zarejestrowanego typu i węzły kombinacyjne też są nagrywane.
+  ASSERT(ma_trace_register_comb(4, f_seen) == 0);
+  ma_type_t *type = ma_type_register(64, 64, 64, t_one, y_seen, MA_TYPE_PURE);
+  assert(type);
+  ASSERT(ma_trace_start(path) == 0);
+  moore_t *typed = ma_create_from_type(type, q);
+  moore_t *gate = ma_create_comb(3, 3, f_seen);
+  assert(typed && gate);
+  TEST_NULL_EINVAL(ma_create_from_type(NULL, q));
+  ASSERT(ma_connect(gate, 0, typed, 0, 3) == 0);
+  ASSERT(ma_set_input(typed, x) == 0);
+  moore_t *net[] = {typed, gate};
+  for (int i = 0; i < 10; ++i)
+    ASSERT(ma_step(net, 2) == 0);
+  recorded = seen_state;
+  uint64_t recorded_input = seen_input;
+  ASSERT(recorded == 5 + 3 * 10 && recorded_input == ((recorded + 1) & 7));
+  ma_delete(gate);
+  ma_delete(typed);
+  ASSERT(ma_trace_stop() == 0);
+
+  seen_state = seen_input = 0;
+  ASSERT(ma_replay(path, 0, &r) == 0);
+  ASSERT(seen_state == recorded && seen_input == recorded_input);
+  ASSERT(r.calls[MA_TRACE_CREATE_FROM_TYPE] == 1 && r.calls[MA_TRACE_CREATE_COMB] == 1);
+  ASSERT(r.calls[MA_TRACE_STEP] == 10 && r.calls[MA_TRACE_DELETE] == 2);
+  ASSERT(r.skipped == 1 && r.mismatches == 0);
+  ma_type_release(type);
+  unlink(path);
+  ma_delete(before);
+  return PASS;
+}
+
+// Dwie identyczne sieci: rt liczona w trybie czasu rzeczywistego, ref przez ma_step.
+static int realtime_network(moore_t *rt[], moore_t *ref[], size_t num) {
+  const uint64_t q[2] = {1, 2}, x[2] = {3, 0};
+  for (size_t i = 0; i < num; ++i) {
+    moore_t **net[] = {rt, ref};
+    for (size_t k = 0; k < 2; ++k) {
+      net[k][i] = i % 3 ? ma_create_full(64, 64, 64, t_one, y_one, q)
+                        : ma_create_simple(70, 70, t_forward);
+      if (!net[k][i])
+        return WRONG_TEST;
+      if (i == 0 && ma_set_input(net[k][i], x) != 0)
+        return WRONG_TEST;
+      if (i > 0 && ma_connect(net[k][i], 0, net[k][i - 1], 0, 64) != 0)
+        return WRONG_TEST;
+    }
+  }
+  return PASS;
+}
+
+static int realtime(void) {
+  enum { NUM = 24 };
+  moore_t *rt[NUM], *ref[NUM];
+  ASSERT(realtime_network(rt, ref, NUM) == PASS);
+  ASSERT(ma_enable_history(rt[5], 3) == 0 && ma_enable_history(ref[5], 3) == 0);
+  ASSERT(ma_toggle_enable(rt[7]) == 0 && ma_toggle_enable(ref[7]) == 0);
+
+  // Wynik zgodny z ma_step dla jednego i kilku wątków.
+  for (size_t threads = 1; threads <= 3; threads += 2) {
+    ma_realtime_t *r = ma_realtime_create(rt, NUM, threads, threads > 1 ? MA_RT_PIN : 0);
+    ASSERT(r);
+    for (int c = 0; c < 50; ++c) {
+      ASSERT(ma_realtime_step(r) == 0);
+      ASSERT(ma_step(ref, NUM) == 0);
+      for (size_t i = 0; i < NUM; ++i)
+        ASSERT(memcmp(ma_get_output(rt[i]), ma_get_output(ref[i]), sizeof(uint64_t)) == 0);
+    }
+    ASSERT(memcmp(ma_get_output_at(rt[5], 2), ma_get_output_at(ref[5], 2),
+                  sizeof(uint64_t)) == 0);
+    ma_realtime_destroy(r);
+  }
+  uint64_t toggles[2][64], rt_cycles, ref_cycles;
+  ASSERT(ma_toggle_export(rt[7], toggles[0], NULL, &rt_cycles) == 0);
+  ASSERT(ma_toggle_export(ref[7], toggles[1], NULL, &ref_cycles) == 0);
+  ASSERT(rt_cycles == 100 && ref_cycles == 100);
+  ASSERT(memcmp(toggles[0], toggles[1], sizeof(toggles[0])) == 0);
+
+  // Kroki nie alokują pamięci; czasy trafiają do histogramu.
+  ma_realtime_t *r = ma_realtime_create(rt, NUM, 2, 0);
+  ma_latency_t *lat = ma_latency_create(0);
+  ASSERT(r && lat);
+  memory_profile_totals_t before, after;
+  memory_profile_reset();
+  memory_profile_enable(true);
+  memory_profile_totals(&before);
+  ASSERT(ma_realtime_run(r, 200, lat) == 0);
+  memory_profile_totals(&after);
+  memory_profile_enable(false);
+  ASSERT(after.allocs == before.allocs && after.frees == before.frees);
+  ASSERT(ma_latency_count(lat, MA_PHASE_STEP) == 200);
+  ASSERT(ma_latency_percentile(lat, MA_PHASE_STEP, 100) > 0);
+  ma_realtime_destroy(r);
+  ma_latency_destroy(lat);
+
+  // mlock może być niedozwolony, ale wtedy tylko z błędem systemu.
+  errno = 0;
+  r = ma_realtime_create(rt, NUM, 1, MA_RT_LOCK);
+  ASSERT(r || errno == EPERM || errno == ENOMEM || errno == EAGAIN);
+  if (r)
+    ASSERT(ma_realtime_step(r) == 0);
+  ma_realtime_destroy(r);
+
+  // Skompresowane tablice typu tablicowego też należą do pamięci kroku.
+  enum { N = 6, STATES = 2000 };
+  static uint32_t delta[STATES << N];
+  static uint64_t lambda[STATES];
+  for (uint32_t q = 0; q < STATES; ++q) {
+    lambda[q] = q;
+    for (uint32_t c = 0; c < (1 << N); ++c)
+      delta[q << N | c] = c % 8 == q % 8 ? (q * 31 + c) % STATES : (q * 7 + 1) % STATES;
+  }
+  ma_type_t *type = ma_table_create(N, 16, STATES, delta, lambda);
+  struct ma_table_report report;
+  assert(type);
+  ASSERT(ma_table_report(type, &report) == 0 && report.format == MA_TABLE_DISPLACEMENT);
+  const uint64_t start[1] = {0};
+  moore_t *tab[2] = {ma_create_from_type(type, start), ma_create_from_type(type, start)};
+  assert(tab[0] && tab[1]);
+  ASSERT(ma_enable_history(tab[0], 2) == 0 && ma_toggle_enable(tab[0]) == 0);
+  r = ma_realtime_create(tab, 1, 1, 0);
+  ASSERT(r);
+  for (uint64_t c = 0; c < 40; ++c) {
+    const uint64_t in[1] = {c * 11 % 64};
+    ASSERT(ma_set_input(tab[0], in) == 0 && ma_set_input(tab[1], in) == 0);
+    ASSERT(ma_realtime_step(r) == 0 && ma_step(&tab[1], 1) == 0);
+    ASSERT(ma_get_output(tab[0])[0] == ma_get_output(tab[1])[0]);
+  }
+  ma_realtime_destroy(r);
+  ma_delete(tab[0]);
+  ma_delete(tab[1]);
+  ma_type_release(type);
+
+  moore_t *comb = ma_create_comb(1, 1, f_xor5);
+  assert(comb);
+  moore_t *with_comb[] = {rt[0], comb};
+  TEST_NULL_EINVAL(ma_realtime_create(with_comb, 2, 1, 0));
+  TEST_NULL_EINVAL(ma_realtime_create(rt, NUM, 1, 4));
+  TEST_NULL_EINVAL(ma_realtime_create(rt, 0, 1, 0));
+  TEST_EINVAL(ma_realtime_step(NULL));
+  ma_delete(comb);
+  for (size_t i = 0; i < NUM; ++i) {
+    ma_delete(rt[i]);
+    ma_delete(ref[i]);
+  }
+  return PASS;
+}
+
+// Klasy rozmiaru: jądra o stałej liczbie słów i ścieżka ogólna dają ten sam wynik
+// co model bitowy, także dla szerokości niebędących wielokrotnością 64.
+static int classes(void) {
+  static const size_t widths[] = {40, 64, 100, 128, 192, 200, 256, 300};
+  enum { NUM = 3, WORDS = 5 };
+  for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+    size_t bits = widths[w];
+    moore_t *at[NUM];
+    uint64_t in[NUM][WORDS], out[NUM][WORDS] = {{0}};
+    for (size_t i = 0; i < NUM; ++i) {
+      at[i] = ma_create_simple(bits, bits, t_forward);
+      assert(at[i]);
+      for (size_t k = 0; k < WORDS; ++k)
+        in[i][k] = 0x9e3779b97f4a7c15ULL * (i * WORDS + k + 1);
+      if (bits % 64)
+        in[i][bits / 64] &= (1ULL << bits % 64) - 1;
+      ASSERT(ma_set_input(at[i], in[i]) == 0);
+    }
+    // Bity nieparzyste z permutacji wyjścia poprzednika, parzyste stałe.
+    for (size_t i = 1; i < NUM; ++i)
+      for (size_t j = 1; j < bits; j += 2)
+        ASSERT(ma_connect(at[i], j, at[i - 1], (j * 7 + 3) % bits, 1) == 0);
+
+    for (int c = 0; c < 6; ++c) {
+      for (size_t i = 1; i < NUM; ++i)
+        for (size_t j = 1; j < bits; j += 2) {
+          size_t src = (j * 7 + 3) % bits;
+          uint64_t bit = out[i - 1][src / 64] >> src % 64 & 1;
+          in[i][j / 64] = (in[i][j / 64] & ~(1ULL << j % 64)) | bit << j % 64;
+        }
+      memcpy(out, in, sizeof(out));
+      ASSERT(ma_step(at, NUM) == 0);
+      for (size_t i = 0; i < NUM; ++i)
+        ASSERT(memcmp(ma_get_output(at[i]), out[i], (bits + 63) / 64 * sizeof(uint64_t)) == 0);
+    }
+    for (size_t i = 0; i < NUM; ++i)
+      ma_delete(at[i]);
+  }
+  return PASS;
+}
+
+// Wejście w całości z wyrównanych słów jednego rodzica jest czytane wprost z jego wyjścia;
+// połączenia niewyrównane, częściowe i zmiany okablowania wracają do kopii bitów.
+static int views(void) {
+  const uint64_t x[3] = {0x1111, 0x2222, 0x3333}, z[2] = {0};
+  moore_t *at[4];
+  at[0] = ma_create_simple(192, 192, t_forward);
+  at[1] = ma_create_simple(128, 128, t_forward); // Słowa 1-2 wyjścia at[0]
+  at[2] = ma_create_simple(64, 64, t_forward);   // Słowo 0 wyjścia at[1]
+  at[3] = ma_create_simple(64, 64, t_forward);   // Bity 1-64 wyjścia at[1]
+  for (size_t i = 0; i < 4; ++i)
+    assert(at[i]);
+  ASSERT(ma_set_input(at[0], x) == 0);
+  ASSERT(ma_set_input(at[1], z) == 0 && ma_set_input(at[2], z) == 0);
+  ASSERT(ma_connect(at[1], 0, at[0], 64, 128) == 0);
+  ASSERT(ma_connect(at[2], 0, at[1], 0, 64) == 0);
+  ASSERT(ma_connect(at[3], 0, at[1], 1, 64) == 0);
+
+  ASSERT(ma_step(at, 4) == 0);
+  ASSERT(ma_get_output(at[1])[0] == 0 && ma_get_output(at[1])[1] == 0);
+  ASSERT(ma_step(at, 4) == 0);
+  ASSERT(ma_get_output(at[1])[0] == 0x2222 && ma_get_output(at[1])[1] == 0x3333);
+  ASSERT(ma_get_output(at[2])[0] == 0);
+  ASSERT(ma_step(at, 4) == 0);
+  ASSERT(ma_get_output(at[2])[0] == 0x2222);
+  ASSERT(ma_get_output(at[3])[0] == (0x2222 >> 1 | 0x3333ULL << 63));
+
+  // Po odłączeniu bitu 0 reszta wejścia at[2] zostaje w buforze, bit 0 z ma_set_input.
+  ASSERT(ma_disconnect(at[2], 0, 1) == 0);
+  ASSERT(ma_step(at, 4) == 0);
+  ASSERT(ma_get_output(at[2])[0] == 0x2222);
+  ASSERT(ma_set_input(at[2], &x[0]) == 0);
+  ASSERT(ma_step(at, 4) == 0);
+  ASSERT(ma_get_output(at[2])[0] == 0x2223);
+  ASSERT(ma_connect(at[2], 0, at[1], 0, 1) == 0);
+  ASSERT(ma_step(at, 4) == 0);
+  ASSERT(ma_get_output(at[2])[0] == 0x2222);
+
+  // Usunięcie rodzica zostawia w wejściu at[2] kopię jego ostatniego wyjścia.
+  ma_delete(at[1]);
+  moore_t *rest[] = {at[0], at[2], at[3]};
+  ASSERT(ma_step(rest, 3) == 0);
+  ASSERT(ma_get_output(at[2])[0] == 0x2222);
+  for (size_t i = 0; i < 3; ++i)
+    ma_delete(rest[i]);
+  return PASS;
+}
+
+// Wejście czytane słowami z rodzica zachowuje wartość z ostatniego kroku po odłączeniu,
+// usunięciu rodzica i przełączeniu części bitów (jak przy kopiowaniu bit po bicie).
+static int views_retain(void) {
+  const uint64_t one = 1, zero = 0;
+  for (int variant = 0; variant < 3; ++variant) {
+    moore_t *parent = ma_create_simple(64, 64, t_one);
+    moore_t *child = ma_create_simple(64, 64, t_forward);
+    moore_t *other = ma_create_simple(64, 64, t_forward);
+    assert(parent && child && other);
+    ASSERT(ma_set_input(parent, &one) == 0 && ma_set_input(other, &zero) == 0);
+    ASSERT(ma_connect(child, 0, parent, 0, 64) == 0);
+    moore_t *at[] = {other, child, parent};
+    for (int c = 0; c < 5; ++c)
+      ASSERT(ma_step(at, 3) == 0);
+    ASSERT(ma_get_output(parent)[0] == 5 && ma_get_output(child)[0] == 4);
+    if (variant == 0) {
+      ASSERT(ma_disconnect(child, 0, 64) == 0);
+    } else if (variant == 1) {
+      ma_delete(parent);
+    } else {
+      ASSERT(ma_connect(child, 0, other, 0, 1) == 0);
+      ASSERT(ma_disconnect(child, 1, 63) == 0);
+    }
+    ASSERT(ma_step(at, variant == 1 ? 2 : 3) == 0);
+    ASSERT(ma_get_output(child)[0] == 4);
+    if (variant != 1)
+      ma_delete(parent);
+    ma_delete(child);
+    ma_delete(other);
+  }
+  return PASS;
+}
+
+// Bezczynne automaty oddają bufory do pliku, wracają przy zmianie wejścia lub zapisie,
+// a sieć liczy to samo co ma_step.
+static int spill(void) {
+  enum { NUM = 32, BUDGET = 4 * 8 * sizeof(uint64_t) };
+  char path[] = "/tmp/ma_spill_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  ma_type_t *type = ma_type_register(256, 256, 256, t_forward, NULL,
+                                     MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT);
+  const uint64_t q[4] = {0}, x[3][4] = {{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 9, 9, 9}};
+  assert(type);
+  moore_t *at[NUM], *ref[NUM];
+  for (size_t i = 0; i < NUM; ++i) {
+    moore_t **net[] = {at, ref};
+    for (size_t k = 0; k < 2; ++k) {
+      net[k][i] = ma_create_from_type(type, q);
+      assert(net[k][i]);
+      if (i == 0)
+        ASSERT(ma_set_input(net[k][i], x[0]) == 0);
+      else
+        ASSERT(ma_connect(net[k][i], 0, net[k][i - 1], 0, 256) == 0);
+    }
+  }
+  TEST_NULL_EINVAL(ma_spill_open(path, NULL, NUM, BUDGET, 2));
+  TEST_NULL_EINVAL(ma_spill_open(path, at, 0, BUDGET, 2));
+  ma_spill_t *sp = ma_spill_open(path, at, NUM, BUDGET, 2);
+  ASSERT(sp);
+  ASSERT(access(path, F_OK) != 0);
+
+  for (int c = 0; c < 120; ++c) {
+    if (c == 40) {
+      ASSERT(ma_set_input(at[0], x[1]) == 0 && ma_set_input(ref[0], x[1]) == 0);
+    }
+    if (c == 80) {
+      ASSERT(ma_set_state(at[NUM / 2], x[2]) == 0 && ma_set_state(ref[NUM / 2], x[2]) == 0);
+    }
+    ASSERT(ma_spill_step(sp) == 0);
+    ASSERT(ma_step(ref, NUM) == 0);
+    for (size_t i = 0; i < NUM; ++i)
+      ASSERT(memcmp(ma_get_output(at[i]), ma_get_output(ref[i]), 4 * sizeof(uint64_t)) == 0);
+  }
+  struct ma_spill_report r;
+  ASSERT(ma_spill_stats(sp, &r) == 0);
+  ASSERT(r.automata == NUM && r.spilled > 0 && r.resident_bytes <= BUDGET);
+  ASSERT(r.spilled_bytes == r.spilled * 8 * sizeof(uint64_t));
+  ASSERT(r.evictions > NUM && r.restores > 0 && r.prefetches > 0);
+  TEST_EINVAL(ma_spill_stats(sp, NULL));
+  TEST_EINVAL(ma_spill_step(NULL));
+
+  // Inne silniki odrzucają wyrzucone automaty aż do ma_spill_close.
+  size_t spilled = 0;
+  for (ma_realtime_t *rt; (rt = ma_realtime_create(&at[spilled], 1, 1, 0)); ++spilled) {
+    ma_realtime_destroy(rt);
+    ASSERT(spilled + 1 < NUM);
+  }
+  ASSERT(errno == EBUSY);
+  moore_t *evicted[] = {at[spilled]};
+  uint64_t const *symbols[] = {x[0]};
+  errno = 0;
+  ASSERT(ma_run_tuned(evicted, 1, 1) == -1 && errno == EBUSY);
+  errno = 0;
+  ASSERT(ma_run_stream(evicted[0], x[0], 4, 8, NULL, 0) == -1 && errno == EBUSY);
+  errno = 0;
+  ASSERT(ma_run_streams(evicted, 1, symbols, 4, 8, NULL, 0) == -1 && errno == EBUSY);
+  errno = 0;
+  ASSERT(!ma_flatten(evicted, 1, NULL) && errno == EBUSY);
+  ma_multi_t *mm = ma_multi_create(8, NULL, NULL);
+  assert(mm);
+  errno = 0;
+  ASSERT(ma_multi_add(mm, evicted[0], 1) == -1 && errno == EBUSY);
+  ma_multi_destroy(mm);
+
+  // ma_step sam przywraca wyrzucone automaty.
+  ASSERT(ma_step(at, NUM) == 0 && ma_step(ref, NUM) == 0);
+  ASSERT(ma_spill_stats(sp, &r) == 0 && r.spilled == 0);
+  ASSERT(ma_spill_step(sp) == 0 && ma_spill_close(sp) == 0);
+  ASSERT(ma_step(ref, NUM) == 0 && ma_step(at, NUM) == 0);
+  for (size_t i = 0; i < NUM; ++i) {
+    ASSERT(memcmp(ma_get_output(at[i]), ma_get_output(ref[i]), 4 * sizeof(uint64_t)) == 0);
+    ma_delete(at[i]);
+    ma_delete(ref[i]);
+  }
+  ma_type_release(type);
+  return PASS;
+}
+
+static void t_hold(uint64_t *, uint64_t const *, uint64_t const *, size_t, size_t) {}
+
+// Zbiór bez pliku kompresuje bufory bezczynnych automatów w pamięci: zera, powtórzenia,
+// słownik i słowa dosłowne wracają bez zmian, a nieściśliwe bufory zostają na miejscu.
+static int compress(void) {
+  enum { NUM = 64, WORDS = 16 };
+  ma_type_t *type = ma_type_register(0, 64 * WORDS, 64 * WORDS, t_hold, NULL,
+                                     MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT);
+  assert(type);
+  moore_t *at[NUM + 1];
+  uint64_t q[NUM + 1][WORDS] = {{0}};
+  for (size_t i = 0; i <= NUM; ++i) {
+    for (size_t k = 0; k < WORDS; ++k) {
+      if (i == NUM)
+        q[i][k] = 0x9e3779b97f4a7c15ULL * (k + 1); // Same różne słowa
+      else if (k >= 4 && k < 8)
+        q[i][k] = 0xaaaa5555aaaa5555ULL;
+      else if (k == 8 || k == 10)
+        q[i][k] = 0x1234;
+      else if (k == 9)
+        q[i][k] = 0xc2b2ae3d27d4eb4fULL * (i + 1);
+    }
+    at[i] = ma_create_from_type(type, q[i]);
+    assert(at[i]);
+  }
+  ma_spill_t *sp = ma_spill_open(NULL, at, NUM + 1, 0, 1);
+  ASSERT(sp);
+  for (int c = 0; c < 3; ++c)
+    ASSERT(ma_spill_step(sp) == 0);
+  struct ma_spill_report r;
+  ASSERT(ma_spill_stats(sp, &r) == 0);
+  ASSERT(r.spilled == NUM && r.resident_bytes == WORDS * sizeof(uint64_t));
+  ASSERT(r.spilled_bytes == NUM * WORDS * sizeof(uint64_t));
+  ASSERT(r.compressed_bytes > 0 && r.compressed_bytes * 4 < r.spilled_bytes);
+  for (size_t i = 0; i <= NUM; ++i)
+    ASSERT(memcmp(ma_get_output(at[i]), q[i], sizeof(q[i])) == 0);
+
+  // ma_step rozpakowuje wszystko, ma_set_state pojedynczy automat.
+  ASSERT(ma_step(at, NUM + 1) == 0);
+  ASSERT(ma_spill_stats(sp, &r) == 0);
+  ASSERT(r.spilled == 0 && r.compressed_bytes == 0 && r.restores == NUM);
+  for (size_t i = 0; i <= NUM; ++i)
+    ASSERT(memcmp(ma_get_output(at[i]), q[i], sizeof(q[i])) == 0);
+  for (int c = 0; c < 3; ++c)
+    ASSERT(ma_spill_step(sp) == 0);
+  ASSERT(ma_set_state(at[3], q[NUM]) == 0);
+  ASSERT(memcmp(ma_get_output(at[3]), q[NUM], sizeof(q[NUM])) == 0);
+  ASSERT(ma_spill_close(sp) == 0);
+  ASSERT(ma_step(at, NUM + 1) == 0);
+  ASSERT(memcmp(ma_get_output(at[5]), q[5], sizeof(q[5])) == 0);
+
+  // Kompresja nie czeka na przekroczenie budżetu: bezczynne automaty kurczą się po progu.
+  sp = ma_spill_open(NULL, at, NUM, SIZE_MAX, 2);
+  ASSERT(sp);
+  ASSERT(ma_spill_step(sp) == 0 && ma_spill_step(sp) == 0);
+  ASSERT(ma_spill_stats(sp, &r) == 0 && r.spilled == 0);
+  ASSERT(ma_spill_step(sp) == 0);
+  ASSERT(ma_spill_stats(sp, &r) == 0);
+  // at[3] ma teraz stan z samych różnych słów i zostaje nieskompresowany.
+  ASSERT(r.spilled == NUM - 1 && r.resident_bytes == WORDS * sizeof(uint64_t));
+  ASSERT(r.compressed_bytes > 0);
+  ASSERT(ma_spill_close(sp) == 0);
+  ASSERT(memcmp(ma_get_output(at[7]), q[7], sizeof(q[7])) == 0);
+  for (size_t i = 0; i <= NUM; ++i)
+    ma_delete(at[i]);
+  ma_type_release(type);
+  return PASS;
+}
+
 // Testuje próbę alokowania dużo za dużej pamięci.
 static int alloc(void) {
   const uint64_t q = 0;
@@ -899,6 +2727,33 @@ static const test_list_t test_list[] = {
   TEST(pipeline),
   TEST(shift),
   TEST(cycle),
+  TEST(types),
+  TEST(persist),
+  TEST(persist_banks),
+  TEST(toggles),
+  TEST(tuned),
+  TEST(fuzz),
+  TEST(stream),
+  TEST(parallel),
+  TEST(streams),
+  TEST(table),
+  TEST(flatten),
+  TEST(compressed),
+  TEST(multi),
+  TEST(symbolic),
+  TEST(symbolic_reorder),
+  TEST(comb),
+  TEST(history),
+  TEST(profile),
+  TEST(topology),
+  TEST(latency),
+  TEST(trace),
+  TEST(realtime),
+  TEST(classes),
+  TEST(views),
+  TEST(views_retain),
+  TEST(spill),
+  TEST(compress),
   TEST(alloc),
   TEST(memory),
   TEST(weak),
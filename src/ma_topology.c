@@ -0,0 +1,305 @@
+// Analiza ksztaltu sieci automatow na potrzeby wyboru sposobu wykonania.
+//
+// Wszystkie miary liczymy w czasie liniowym od liczby automatow i bitow wejśc.
+// Krawedzie bierzemy z podlaczenia_do_a, bo listy rodzicow i dzieci zachowuja wpisy
+// odlaczonych automatow. Silnie spojne skladowe wyznacza iteracyjny algorytm Tarjana,
+// ktory zwraca je w odwrotnej kolejnosci topologicznej, wiec glebokosc grafu skladowych
+// liczymy w tym samym przebiegu.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MALA_SIEC 64 // Ponizej tylu automatow zalecamy zwykle ma_step
+#define MIN_ETAPOW 4 // Najmniejsza glebokosc oplacalna dla potoku
+
+// Odwzorowanie wskaznika automatu na jego indeks w `at` (adresowanie otwarte)
+typedef struct indeksy {
+    moore_t const **klucze;
+    size_t *wartosci;
+    size_t maska;
+} indeksy_t;
+
+static size_t skrot_wskaznika(moore_t const *a) {
+    return (size_t)(((uintptr_t)a * 0x9e3779b97f4a7c15ULL) >> 17);
+}
+
+static int indeksy_zbuduj(indeksy_t *ix, moore_t *at[], size_t num) {
+    size_t rozmiar = 16;
+    while (rozmiar < 2 * num) rozmiar *= 2;
+    ix->klucze = calloc(rozmiar, sizeof(moore_t *));
+    ix->wartosci = malloc(rozmiar * sizeof(size_t));
+    ix->maska = rozmiar - 1;
+    if (!ix->klucze || !ix->wartosci) {
+        return -1;
+    }
+    for (size_t i = 0; i < num; i++) {
+        size_t h = skrot_wskaznika(at[i]) & ix->maska;
+        while (ix->klucze[h] && ix->klucze[h] != at[i]) h = (h + 1) & ix->maska;
+        if (ix->klucze[h]) {
+            errno = EINVAL; // Automat wystepuje dwa razy
+            return -1;
+        }
+        ix->klucze[h] = at[i];
+        ix->wartosci[h] = i;
+    }
+    return 0;
+}
+
+static size_t indeks(indeksy_t const *ix, moore_t const *a) {
+    if (!a) return SIZE_MAX;
+    for (size_t h = skrot_wskaznika(a) & ix->maska; ix->klucze[h]; h = (h + 1) & ix->maska) {
+        if (ix->klucze[h] == a) return ix->wartosci[h];
+    }
+    return SIZE_MAX;
+}
+
+/** Przedzial histogramu: 0, 1, 2-3, 4-7, ..., ostatni zbiera reszte. */
+static size_t przedzial(size_t x) {
+    size_t k = x ? 64 - (size_t)__builtin_clzll(x) : 0;
+    return k < MA_TOPOLOGY_BUCKETS ? k : MA_TOPOLOGY_BUCKETS - 1;
+}
+
+static int porownaj_typy(void const *x, void const *y) {
+    uintptr_t a = (uintptr_t)*(ma_type_t *const *)x, b = (uintptr_t)*(ma_type_t *const *)y;
+    return (a > b) - (a < b);
+}
+
+// Robocze tablice analizy
+typedef struct robocze {
+    size_t *poczatek; // CSR dzieci: poczatek[i]..poczatek[i+1] w `dzieci`
+    size_t *dzieci;
+    size_t *numer, *niski, *stos, *wywolania, *pozycja, *skladowa, *glebokosc;
+    bool *na_stosie;
+} robocze_t;
+
+static void zwolnij_robocze(robocze_t *r) {
+    free(r->poczatek);
+    free(r->dzieci);
+    free(r->numer);
+    free(r->niski);
+    free(r->stos);
+    free(r->wywolania);
+    free(r->pozycja);
+    free(r->skladowa);
+    free(r->glebokosc);
+    free(r->na_stosie);
+}
+
+/** Tarjan bez rekursji; uzupelnia liczbe, rozmiary skladowych i glebokosc. */
+static void skladowe(robocze_t *r, size_t num, struct ma_topology_report *raport) {
+    size_t licznik = 0, wierzch = 0, ile_skladowych = 0;
+    for (size_t i = 0; i < num; i++) r->numer[i] = SIZE_MAX;
+    for (size_t start = 0; start < num; start++) {
+        if (r->numer[start] != SIZE_MAX) continue;
+        size_t glebia = 0;
+        r->wywolania[glebia++] = start;
+        r->pozycja[start] = r->poczatek[start];
+        r->numer[start] = r->niski[start] = licznik++;
+        r->stos[wierzch++] = start;
+        r->na_stosie[start] = true;
+        while (glebia > 0) {
+            size_t v = r->wywolania[glebia - 1];
+            if (r->pozycja[v] < r->poczatek[v + 1]) {
+                size_t w = r->dzieci[r->pozycja[v]++];
+                if (r->numer[w] == SIZE_MAX) {
+                    r->numer[w] = r->niski[w] = licznik++;
+                    r->pozycja[w] = r->poczatek[w];
+                    r->stos[wierzch++] = w;
+                    r->na_stosie[w] = true;
+                    r->wywolania[glebia++] = w;
+                } else if (r->na_stosie[w] && r->numer[w] < r->niski[v]) {
+                    r->niski[v] = r->numer[w];
+                }
+                continue;
+            }
+            glebia--;
+            if (glebia > 0) {
+                size_t u = r->wywolania[glebia - 1];
+                if (r->niski[v] < r->niski[u]) r->niski[u] = r->niski[v];
+            }
+            if (r->niski[v] != r->numer[v]) continue;
+
+            // v jest korzeniem skladowej; jej nastepniki sa juz policzone
+            size_t c = ile_skladowych++, rozmiar = 0, najglebszy = 0, w;
+            size_t od = wierzch;
+            do {
+                w = r->stos[--od];
+                r->skladowa[w] = c;
+                rozmiar++;
+            } while (w != v);
+            bool petla = rozmiar > 1;
+            for (size_t k = od; k < wierzch; k++) {
+                size_t x = r->stos[k];
+                for (size_t e = r->poczatek[x]; e < r->poczatek[x + 1]; e++) {
+                    size_t y = r->dzieci[e];
+                    if (r->skladowa[y] == c) {
+                        petla = true;
+                    } else if (r->glebokosc[r->skladowa[y]] > najglebszy) {
+                        najglebszy = r->glebokosc[r->skladowa[y]];
+                    }
+                }
+            }
+            for (size_t k = od; k < wierzch; k++) r->na_stosie[r->stos[k]] = false;
+            wierzch = od;
+            r->glebokosc[c] = najglebszy + 1;
+            if (r->glebokosc[c] > raport->depth) raport->depth = r->glebokosc[c];
+            if (rozmiar > raport->largest_component) raport->largest_component = rozmiar;
+            if (petla) {
+                raport->cyclic_components++;
+                raport->cyclic_automata += rozmiar;
+            }
+        }
+    }
+    raport->components = ile_skladowych;
+}
+
+/** Wypelnia raport ksztaltu sieci `at`; automaty spoza `at` sa traktowane jak wejścia zewnetrzne. */
+int ma_analyze(moore_t *at[], size_t num, struct ma_topology_report *report) {
+    if (!at || num == 0 || !report) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (!at[i]) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    memset(report, 0, sizeof(*report));
+    report->automata = num;
+
+    indeksy_t ix = {0};
+    robocze_t r = {0};
+    size_t bity = 0;
+    for (size_t i = 0; i < num; i++) bity += at[i]->typ->n;
+    size_t *wejscia = calloc(num, sizeof(size_t)); // Rozni rodzice w zbiorze
+    size_t *wyjscia = calloc(num, sizeof(size_t)); // Rozne dzieci w zbiorze
+    size_t *ostatni = malloc(num * sizeof(size_t)); // Ostatnie dziecko, ktore widzialo rodzica
+    size_t *krawedzie = malloc((bity ? bity : 1) * 2 * sizeof(size_t));
+    ma_type_t **typy = malloc(num * sizeof(ma_type_t *));
+    r.poczatek = calloc(num + 1, sizeof(size_t));
+    r.dzieci = malloc((bity ? bity : 1) * sizeof(size_t));
+    r.numer = malloc(num * sizeof(size_t));
+    r.niski = malloc(num * sizeof(size_t));
+    r.stos = malloc(num * sizeof(size_t));
+    r.wywolania = malloc(num * sizeof(size_t));
+    r.pozycja = malloc(num * sizeof(size_t));
+    r.skladowa = malloc(num * sizeof(size_t));
+    r.glebokosc = malloc(num * sizeof(size_t));
+    r.na_stosie = calloc(num, sizeof(bool));
+    int blad = ENOMEM;
+    bool gotowe = wejscia && wyjscia && ostatni && krawedzie && typy && r.poczatek &&
+                  r.dzieci && r.numer && r.niski && r.stos && r.wywolania && r.pozycja &&
+                  r.skladowa && r.glebokosc && r.na_stosie;
+    if (gotowe && indeksy_zbuduj(&ix, at, num) != 0) {
+        gotowe = false;
+        blad = errno == EINVAL ? EINVAL : ENOMEM;
+    }
+    if (!gotowe) {
+        free(wejscia);
+        free(wyjscia);
+        free(ostatni);
+        free(krawedzie);
+        free(typy);
+        free(ix.klucze);
+        free(ix.wartosci);
+        zwolnij_robocze(&r);
+        errno = blad;
+        return -1;
+    }
+
+    // Rozne krawedzie rodzic -> dziecko i bity przesylane w kazdym kroku
+    size_t ile_krawedzi = 0;
+    for (size_t i = 0; i < num; i++) ostatni[i] = SIZE_MAX;
+    for (size_t i = 0; i < num; i++) {
+        moore_t const *a = at[i];
+        ma_type_t const *typ = a->typ;
+        for (size_t j = 0; j < typ->n; j++) {
+            moore_t const *zrodlo = a->podlaczenia_do_a[j].a_z_kad;
+            if (!zrodlo) {
+                report->free_bits++;
+                continue;
+            }
+            size_t p = indeks(&ix, zrodlo);
+            if (p == SIZE_MAX) {
+                report->external_bits++;
+                continue;
+            }
+            report->routed_bits++;
+            if (ostatni[p] != i) {
+                ostatni[p] = i;
+                wejscia[i]++;
+                wyjscia[p]++;
+                krawedzie[2 * ile_krawedzi] = p;
+                krawedzie[2 * ile_krawedzi + 1] = i;
+                ile_krawedzi++;
+            }
+        }
+        // Bajty kroku: odczyt stanu, zapis i zatwierdzenie next_state, wejście, wyjście,
+        // przeglad tablicy polaczen i odczyt slowa wyjścia rodzica dla kazdego bitu
+        size_t slowa_s = ILE_UINT(typ->s);
+        report->bytes_per_step += sizeof(uint64_t) * (3 * slowa_s + ILE_UINT(typ->n) +
+                                                      ILE_UINT(typ->m)) +
+                                  typ->n * sizeof(polaczenie_t);
+        if (typ->flagi & MA_TYPE_PURE) report->pure_automata++;
+        typy[i] = a->typ;
+    }
+    report->bytes_per_step += sizeof(uint64_t) * (report->routed_bits + report->external_bits);
+    report->edges = ile_krawedzi;
+
+    // Rozklady stopni
+    for (size_t i = 0; i < num; i++) {
+        report->fan_in_histogram[przedzial(wejscia[i])]++;
+        report->fan_out_histogram[przedzial(wyjscia[i])]++;
+        if (wejscia[i] > report->max_fan_in) report->max_fan_in = wejscia[i];
+        if (wyjscia[i] > report->max_fan_out) report->max_fan_out = wyjscia[i];
+        report->sources += wejscia[i] == 0;
+        report->sinks += wyjscia[i] == 0;
+    }
+    report->mean_fan_in = (double)ile_krawedzi / (double)num;
+
+    // Automaty na typ: sortowanie wskaznikow typow (num log num, ale tylko na wskaznikach)
+    qsort(typy, num, sizeof(ma_type_t *), porownaj_typy);
+    for (size_t i = 0, od = 0; i <= num; i++) {
+        if (i == num || typy[i] != typy[od]) {
+            report->types++;
+            if (i - od > report->largest_type) report->largest_type = i - od;
+            od = i;
+        }
+    }
+
+    // CSR dzieci i silnie spojne skladowe
+    for (size_t e = 0; e < ile_krawedzi; e++) r.poczatek[krawedzie[2 * e] + 1]++;
+    for (size_t i = 0; i < num; i++) r.poczatek[i + 1] += r.poczatek[i];
+    memcpy(ostatni, r.poczatek, num * sizeof(size_t));
+    for (size_t e = 0; e < ile_krawedzi; e++) {
+        r.dzieci[ostatni[krawedzie[2 * e]]++] = krawedzie[2 * e + 1];
+    }
+    skladowe(&r, num, report);
+
+    // Zalecenie: male sieci krokiem, potok dla glebokich sieci bez sprzezen, silnik
+    // zdarzeniowy dla czystych automatow o malym rozgalezieniu, w pozostalych watki
+    if (num < MALA_SIEC) {
+        report->suggested = MA_EXEC_SEQUENTIAL;
+    } else if (report->cyclic_components == 0 && report->depth >= MIN_ETAPOW) {
+        report->suggested = MA_EXEC_PIPELINED;
+    } else if (2 * report->pure_automata >= num && report->mean_fan_in <= 4) {
+        report->suggested = MA_EXEC_EVENT_DRIVEN;
+    } else {
+        report->suggested = MA_EXEC_PARALLEL;
+    }
+
+    free(wejscia);
+    free(wyjscia);
+    free(ostatni);
+    free(krawedzie);
+    free(typy);
+    free(ix.klucze);
+    free(ix.wartosci);
+    zwolnij_robocze(&r);
+    return 0;
+}
@@ -0,0 +1,723 @@
+// Nagrywanie wywolan publicznego API do zwartego pliku binarnego i ich odtwarzanie.
+//
+// Plik zaczyna sie od MAGIA i numeru pierwszego automatu nagrania, po ktorych nastepuja
+// rekordy: bajt rodzaju wywolania (MA_TRACE_*, NIEUDANE dla wyniku -1, POWTORZENIE dla
+// kroku na tej samej tablicy co poprzedni) i argumenty jako liczby LEB128. Automaty
+// zapisujemy jako numer wzgledem poczatku nagrania (0: automat spoza nagrania), funkcje
+// jako zarejestrowany identyfikator + 1 (0: niezarejestrowana), bufory jako surowe slowa.
+
+#include "ma.h"
+#include "ma_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAGIA "MATRACE1"
+#define NIEUDANE 0x80u // Wywolanie zwrocilo blad
+#define POWTORZENIE 0x40u // Krok na tablicy automatow z poprzedniego kroku
+#define RODZAJ 0x3fu
+
+bool slad_wlaczony = false;
+
+// Rodzaje rejestrowanych funkcji
+enum { PRZEJSCIE, WYJSCIE, KOMBINACYJNA };
+
+typedef struct funkcja {
+    uint32_t id;
+    unsigned rodzaj; // PRZEJSCIE, WYJSCIE lub KOMBINACYJNA
+    union {
+        transition_function_t t;
+        output_function_t y;
+        comb_function_t f;
+    };
+} funkcja_t;
+
+static pthread_mutex_t blokada = PTHREAD_MUTEX_INITIALIZER;
+static funkcja_t *funkcje = NULL;
+static size_t ile_funkcji = 0;
+static FILE *plik = NULL;
+static bool blad_zapisu = false;
+static uint64_t nastepny_numer = 1; // Numery automatow nie powtarzaja sie miedzy nagraniami
+static uint64_t baza = 1; // Pierwszy numer biezacego nagrania
+static uint64_t *poprzedni_krok = NULL; // Numery automatow ostatniego kroku
+static size_t ile_poprzedni = 0;
+
+static int dopisz_funkcje(funkcja_t f) {
+    pthread_mutex_lock(&blokada);
+    for (size_t i = 0; i < ile_funkcji; i++) {
+        if (funkcje[i].id == f.id && funkcje[i].rodzaj == f.rodzaj) {
+            funkcje[i] = f;
+            pthread_mutex_unlock(&blokada);
+            return 0;
+        }
+    }
+    funkcja_t *nowe = realloc(funkcje, (ile_funkcji + 1) * sizeof(funkcja_t));
+    if (!nowe) {
+        pthread_mutex_unlock(&blokada);
+        errno = ENOMEM;
+        return -1;
+    }
+    funkcje = nowe;
+    funkcje[ile_funkcji++] = f;
+    pthread_mutex_unlock(&blokada);
+    return 0;
+}
+
+/** Nadaje funkcji przejścia identyfikator uzywany w nagraniach. */
+int ma_trace_register_transition(uint32_t id, transition_function_t t) {
+    if (!t || id == UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    return dopisz_funkcje((funkcja_t){.id = id, .rodzaj = PRZEJSCIE, .t = t});
+}
+
+/** Nadaje funkcji wyjścia identyfikator uzywany w nagraniach. */
+int ma_trace_register_output(uint32_t id, output_function_t y) {
+    if (!y || id == UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    return dopisz_funkcje((funkcja_t){.id = id, .rodzaj = WYJSCIE, .y = y});
+}
+
+/** Nadaje funkcji wezla kombinacyjnego identyfikator uzywany w nagraniach. */
+int ma_trace_register_comb(uint32_t id, comb_function_t f) {
+    if (!f || id == UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    return dopisz_funkcje((funkcja_t){.id = id, .rodzaj = KOMBINACYJNA, .f = f});
+}
+
+// Wywolywane pod blokada
+static uint64_t id_przejscia(transition_function_t t) {
+    for (size_t i = 0; i < ile_funkcji; i++) {
+        if (funkcje[i].rodzaj == PRZEJSCIE && funkcje[i].t == t) {
+            return (uint64_t)funkcje[i].id + 1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t id_wyjscia(output_function_t y) {
+    for (size_t i = 0; i < ile_funkcji; i++) {
+        if (funkcje[i].rodzaj == WYJSCIE && funkcje[i].y == y) {
+            return (uint64_t)funkcje[i].id + 1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t id_kombinacyjnej(comb_function_t f) {
+    for (size_t i = 0; i < ile_funkcji; i++) {
+        if (funkcje[i].rodzaj == KOMBINACYJNA && funkcje[i].f == f) {
+            return (uint64_t)funkcje[i].id + 1;
+        }
+    }
+    return 0;
+}
+
+/* Zapis */
+
+static void zapisz_bajt(unsigned x) {
+    if (putc_unlocked((int)x, plik) == EOF) blad_zapisu = true;
+}
+
+static void zapisz_liczbe(uint64_t x) {
+    while (x >= 0x80) {
+        zapisz_bajt((unsigned)(x & 0x7f) | 0x80);
+        x >>= 7;
+    }
+    zapisz_bajt((unsigned)x);
+}
+
+static void zapisz_slowa(uint64_t const *slowa, size_t ile) {
+    zapisz_liczbe(ile);
+    if (ile > 0 && fwrite(slowa, sizeof(uint64_t), ile, plik) != ile) blad_zapisu = true;
+}
+
+static uint64_t numer(moore_t const *a) {
+    return a && a->slad >= baza ? a->slad - baza + 1 : 0;
+}
+
+static void naglowek_rekordu(unsigned rodzaj, int wynik) {
+    zapisz_bajt(rodzaj | (wynik != 0 ? NIEUDANE : 0));
+}
+
+/** Rozpoczyna nagrywanie wywolan API do pliku `path` (zastepujac poprzednie nagranie). */
+int ma_trace_start(char const *path) {
+    if (!path) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        pthread_mutex_unlock(&blokada);
+        errno = EBUSY;
+        return -1;
+    }
+    plik = fopen(path, "wb");
+    if (!plik) {
+        pthread_mutex_unlock(&blokada);
+        return -1;
+    }
+    blad_zapisu = false;
+    baza = nastepny_numer;
+    ile_poprzedni = 0;
+    if (fwrite(MAGIA, 1, 8, plik) != 8) blad_zapisu = true;
+    zapisz_liczbe(baza);
+    slad_wlaczony = true;
+    pthread_mutex_unlock(&blokada);
+    return 0;
+}
+
+/** Konczy nagrywanie; -1, gdy ktorykolwiek zapis sie nie powiodl. */
+int ma_trace_stop(void) {
+    pthread_mutex_lock(&blokada);
+    if (!plik) {
+        pthread_mutex_unlock(&blokada);
+        errno = EINVAL;
+        return -1;
+    }
+    slad_wlaczony = false;
+    bool blad = blad_zapisu;
+    if (fclose(plik) != 0) blad = true;
+    plik = NULL;
+    free(poprzedni_krok);
+    poprzedni_krok = NULL;
+    ile_poprzedni = 0;
+    pthread_mutex_unlock(&blokada);
+    if (blad) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+void slad_utworz_full(moore_t *a, size_t n, size_t m, size_t s, transition_function_t t,
+                      output_function_t y, uint64_t const *q) {
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        naglowek_rekordu(MA_TRACE_CREATE_FULL, a ? 0 : -1);
+        if (a) {
+            a->slad = nastepny_numer++;
+            zapisz_liczbe(n);
+            zapisz_liczbe(m);
+            zapisz_liczbe(s);
+            zapisz_liczbe(id_przejscia(t));
+            zapisz_liczbe(id_wyjscia(y));
+            zapisz_slowa(q, ILE_UINT(s));
+        }
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+void slad_utworz_simple(moore_t *a, size_t n, size_t s, transition_function_t t) {
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        naglowek_rekordu(MA_TRACE_CREATE_SIMPLE, a ? 0 : -1);
+        if (a) {
+            a->slad = nastepny_numer++;
+            zapisz_liczbe(n);
+            zapisz_liczbe(s);
+            zapisz_liczbe(id_przejscia(t));
+        }
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+void slad_utworz_z_typu(moore_t *a, ma_type_t const *typ, uint64_t const *q) {
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        naglowek_rekordu(MA_TRACE_CREATE_FROM_TYPE, a ? 0 : -1);
+        if (a) {
+            // Typ zapisujemy w calosci; wyjście tozsamosciowe nie potrzebuje funkcji
+            unsigned flagi = typ->flagi & (MA_TYPE_PURE | MA_TYPE_IDENTITY_OUTPUT);
+            a->slad = nastepny_numer++;
+            zapisz_liczbe(typ->n);
+            zapisz_liczbe(typ->m);
+            zapisz_liczbe(typ->s);
+            zapisz_liczbe(flagi);
+            zapisz_liczbe(id_przejscia(typ->t));
+            zapisz_liczbe(flagi & MA_TYPE_IDENTITY_OUTPUT ? 0 : id_wyjscia(typ->y));
+            zapisz_slowa(q, ILE_UINT(typ->s));
+        }
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+void slad_utworz_komb(moore_t *a, size_t n, size_t m, comb_function_t f) {
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        naglowek_rekordu(MA_TRACE_CREATE_COMB, a ? 0 : -1);
+        if (a) {
+            a->slad = nastepny_numer++;
+            zapisz_liczbe(n);
+            zapisz_liczbe(m);
+            zapisz_liczbe(id_kombinacyjnej(f));
+        }
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+void slad_usun(moore_t const *a) {
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        naglowek_rekordu(MA_TRACE_DELETE, 0);
+        zapisz_liczbe(numer(a));
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+void slad_polacz(moore_t const *a_in, size_t in, moore_t const *a_out, size_t out, size_t num,
+                 int wynik) {
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        naglowek_rekordu(MA_TRACE_CONNECT, wynik);
+        zapisz_liczbe(numer(a_in));
+        zapisz_liczbe(in);
+        zapisz_liczbe(numer(a_out));
+        zapisz_liczbe(out);
+        zapisz_liczbe(num);
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+void slad_rozlacz(moore_t const *a_in, size_t in, size_t num, int wynik) {
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        naglowek_rekordu(MA_TRACE_DISCONNECT, wynik);
+        zapisz_liczbe(numer(a_in));
+        zapisz_liczbe(in);
+        zapisz_liczbe(num);
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+static void slad_bufor(unsigned rodzaj, moore_t const *a, uint64_t const *bufor, size_t bity,
+                       int wynik) {
+    pthread_mutex_lock(&blokada);
+    if (plik) {
+        naglowek_rekordu(rodzaj, wynik);
+        zapisz_liczbe(numer(a));
+        zapisz_slowa(bufor, wynik == 0 ? ILE_UINT(bity) : 0);
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+void slad_wejscie(moore_t const *a, uint64_t const *input, int wynik) {
+    slad_bufor(MA_TRACE_SET_INPUT, a, input, wynik == 0 ? a->typ->n : 0, wynik);
+}
+
+void slad_stan(moore_t const *a, uint64_t const *state, int wynik) {
+    slad_bufor(MA_TRACE_SET_STATE, a, state, wynik == 0 ? a->typ->s : 0, wynik);
+}
+
+void slad_krok(moore_t *const at[], size_t num, size_t cykle, bool strojony, int wynik) {
+    pthread_mutex_lock(&blokada);
+    if (!plik) {
+        pthread_mutex_unlock(&blokada);
+        return;
+    }
+    if (!at) num = 0;
+    bool powtorzenie = num > 0 && num == ile_poprzedni;
+    for (size_t i = 0; powtorzenie && i < num; i++) {
+        powtorzenie = numer(at[i]) == poprzedni_krok[i];
+    }
+    naglowek_rekordu((strojony ? MA_TRACE_RUN_TUNED : MA_TRACE_STEP) |
+                     (powtorzenie ? POWTORZENIE : 0), wynik);
+    if (strojony) zapisz_liczbe(cykle);
+    if (!powtorzenie) {
+        zapisz_liczbe(num);
+        uint64_t *numery = num > ile_poprzedni ? realloc(poprzedni_krok, num * sizeof(uint64_t))
+                                               : poprzedni_krok;
+        if (numery) {
+            poprzedni_krok = numery;
+            ile_poprzedni = num;
+        } else {
+            ile_poprzedni = 0;
+        }
+        for (size_t i = 0; i < num; i++) {
+            uint64_t k = numer(at[i]);
+            zapisz_liczbe(k);
+            if (numery) numery[i] = k;
+        }
+    }
+    pthread_mutex_unlock(&blokada);
+}
+
+/* Odtwarzanie */
+
+typedef struct czytnik {
+    uint8_t const *dane, *koniec;
+    bool blad;
+} czytnik_t;
+
+static uint64_t czytaj_liczbe(czytnik_t *c) {
+    uint64_t x = 0;
+    for (unsigned przesuniecie = 0; przesuniecie < 64; przesuniecie += 7) {
+        if (c->dane == c->koniec) break;
+        uint8_t b = *c->dane++;
+        x |= (uint64_t)(b & 0x7f) << przesuniecie;
+        if (!(b & 0x80)) return x;
+    }
+    c->blad = true;
+    return 0;
+}
+
+/** Wskaznik na `ile` slow w pliku (bez kopiowania, slowa moga byc niewyrownane). */
+static uint8_t const *czytaj_slowa(czytnik_t *c, size_t *ile) {
+    *ile = czytaj_liczbe(c);
+    if (c->blad || *ile > (size_t)(c->koniec - c->dane) / sizeof(uint64_t)) {
+        c->blad = true;
+        *ile = 0;
+        return NULL;
+    }
+    uint8_t const *p = c->dane;
+    c->dane += *ile * sizeof(uint64_t);
+    return p;
+}
+
+// Zastepcze funkcje dla MA_REPLAY_STUBS: koszt i zaleznosci zblizone do typowego automatu
+static void t_zastepcza(uint64_t *next_state, uint64_t const *input, uint64_t const *state,
+                        size_t n, size_t s) {
+    size_t wejscia = ILE_UINT(n);
+    for (size_t i = 0; i < ILE_UINT(s); i++) {
+        uint64_t x = wejscia ? input[i % wejscia] : 0;
+        next_state[i] = ((state[i] << 1) | (state[i] >> 63)) ^ x;
+    }
+}
+
+static void y_zastepcza(uint64_t *output, uint64_t const *state, size_t m, size_t s) {
+    for (size_t i = 0; i < ILE_UINT(m); i++) {
+        output[i] = i < ILE_UINT(s) ? state[i] : 0;
+    }
+}
+
+static void k_zastepcza(uint64_t *output, uint64_t const *input, size_t m, size_t n) {
+    size_t wejscia = ILE_UINT(n);
+    for (size_t i = 0; i < ILE_UINT(m); i++) {
+        output[i] = wejscia ? input[i % wejscia] ^ i : 0;
+    }
+}
+
+typedef struct odtwarzanie {
+    moore_t **automaty; // automaty[k - 1] dla numeru k z nagrania
+    size_t pojemnosc;
+    moore_t **tablica; // Tablica ostatniego kroku
+    uint64_t *numery; // Numery automatow ostatniego kroku
+    size_t ile_numerow, pojemnosc_numerow;
+    bool zastepcze;
+} odtwarzanie_t;
+
+static moore_t *automat(odtwarzanie_t const *o, uint64_t k) {
+    return k > 0 && k <= o->pojemnosc ? o->automaty[k - 1] : NULL;
+}
+
+static int zapamietaj(odtwarzanie_t *o, uint64_t k, moore_t *a) {
+    if (k > o->pojemnosc) {
+        size_t pojemnosc = o->pojemnosc ? 2 * o->pojemnosc : 64;
+        while (pojemnosc < k) pojemnosc *= 2;
+        moore_t **nowe = realloc(o->automaty, pojemnosc * sizeof(moore_t *));
+        if (!nowe) return -1;
+        memset(nowe + o->pojemnosc, 0, (pojemnosc - o->pojemnosc) * sizeof(moore_t *));
+        o->automaty = nowe;
+        o->pojemnosc = pojemnosc;
+    }
+    o->automaty[k - 1] = a;
+    return 0;
+}
+
+static transition_function_t szukaj_przejscia(odtwarzanie_t const *o, uint64_t id) {
+    pthread_mutex_lock(&blokada);
+    transition_function_t t = NULL;
+    for (size_t i = 0; id > 0 && i < ile_funkcji; i++) {
+        if (funkcje[i].rodzaj == PRZEJSCIE && funkcje[i].id == id - 1) t = funkcje[i].t;
+    }
+    pthread_mutex_unlock(&blokada);
+    return t ? t : o->zastepcze ? t_zastepcza : NULL;
+}
+
+static output_function_t szukaj_wyjscia(odtwarzanie_t const *o, uint64_t id) {
+    pthread_mutex_lock(&blokada);
+    output_function_t y = NULL;
+    for (size_t i = 0; id > 0 && i < ile_funkcji; i++) {
+        if (funkcje[i].rodzaj == WYJSCIE && funkcje[i].id == id - 1) y = funkcje[i].y;
+    }
+    pthread_mutex_unlock(&blokada);
+    return y ? y : o->zastepcze ? y_zastepcza : NULL;
+}
+
+static comb_function_t szukaj_kombinacyjnej(odtwarzanie_t const *o, uint64_t id) {
+    pthread_mutex_lock(&blokada);
+    comb_function_t f = NULL;
+    for (size_t i = 0; id > 0 && i < ile_funkcji; i++) {
+        if (funkcje[i].rodzaj == KOMBINACYJNA && funkcje[i].id == id - 1) f = funkcje[i].f;
+    }
+    pthread_mutex_unlock(&blokada);
+    return f ? f : o->zastepcze ? k_zastepcza : NULL;
+}
+
+/** Czyta numery automatow kroku; false, gdy ktorys jest nieznany. */
+static bool czytaj_krok(czytnik_t *c, odtwarzanie_t *o, bool powtorzenie) {
+    if (!powtorzenie) {
+        size_t num = czytaj_liczbe(c);
+        if (c->blad || num > (size_t)(c->koniec - c->dane)) {
+            c->blad = true;
+            return false;
+        }
+        if (num > o->pojemnosc_numerow) {
+            uint64_t *numery = realloc(o->numery, num * sizeof(uint64_t));
+            moore_t **tablica = realloc(o->tablica, num * sizeof(moore_t *));
+            if (numery) o->numery = numery;
+            if (tablica) o->tablica = tablica;
+            if (!numery || !tablica) {
+                c->blad = true;
+                return false;
+            }
+            o->pojemnosc_numerow = num;
+        }
+        o->ile_numerow = num;
+        for (size_t i = 0; i < num; i++) o->numery[i] = czytaj_liczbe(c);
+    }
+    bool znane = o->ile_numerow > 0;
+    for (size_t i = 0; i < o->ile_numerow; i++) {
+        o->tablica[i] = automat(o, o->numery[i]);
+        if (!o->tablica[i]) znane = false;
+    }
+    return znane;
+}
+
+/** Jeden rekord: wykonuje wywolanie (mierzac jego czas) albo je pomija. */
+static void odtworz_rekord(czytnik_t *c, odtwarzanie_t *o, uint64_t *nastepny,
+                           struct ma_replay_report *r) {
+    unsigned naglowek = *c->dane++;
+    unsigned rodzaj = naglowek & RODZAJ;
+    int nagrany = naglowek & NIEUDANE ? -1 : 0;
+    int wynik = 0;
+    bool wykonane = false;
+    uint64_t t0 = 0, t1 = 0;
+
+    switch (rodzaj) {
+    case MA_TRACE_CREATE_FULL:
+    case MA_TRACE_CREATE_SIMPLE: {
+        if (nagrany != 0) break; // Nieudane utworzenie nie dostalo numeru
+        size_t n = czytaj_liczbe(c);
+        size_t m = rodzaj == MA_TRACE_CREATE_FULL ? czytaj_liczbe(c) : 0;
+        size_t s = czytaj_liczbe(c);
+        transition_function_t t = szukaj_przejscia(o, czytaj_liczbe(c));
+        output_function_t y = NULL;
+        uint8_t const *q = NULL;
+        size_t slowa = 0;
+        if (rodzaj == MA_TRACE_CREATE_FULL) {
+            y = szukaj_wyjscia(o, czytaj_liczbe(c));
+            q = czytaj_slowa(c, &slowa);
+        }
+        uint64_t k = (*nastepny)++;
+        if (c->blad || !t || (rodzaj == MA_TRACE_CREATE_FULL && (!y || slowa != ILE_UINT(s)))) {
+            break;
+        }
+        uint64_t *stan = NULL;
+        if (q && !(stan = malloc(slowa * sizeof(uint64_t)))) break;
+        if (q) memcpy(stan, q, slowa * sizeof(uint64_t));
+        t0 = takt();
+        moore_t *a = rodzaj == MA_TRACE_CREATE_FULL ? ma_create_full(n, m, s, t, y, stan)
+                                                    : ma_create_simple(n, s, t);
+        t1 = takt();
+        free(stan);
+        wykonane = true;
+        wynik = a ? 0 : -1;
+        if (a && zapamietaj(o, k, a) != 0) {
+            ma_delete(a);
+            c->blad = true;
+        }
+        break;
+    }
+    case MA_TRACE_CREATE_FROM_TYPE: {
+        if (nagrany != 0) break;
+        size_t n = czytaj_liczbe(c), m = czytaj_liczbe(c), s = czytaj_liczbe(c);
+        unsigned flagi = (unsigned)czytaj_liczbe(c);
+        transition_function_t t = szukaj_przejscia(o, czytaj_liczbe(c));
+        uint64_t id_y = czytaj_liczbe(c);
+        output_function_t y = flagi & MA_TYPE_IDENTITY_OUTPUT ? NULL : szukaj_wyjscia(o, id_y);
+        size_t slowa;
+        uint8_t const *q = czytaj_slowa(c, &slowa);
+        uint64_t k = (*nastepny)++;
+        if (c->blad || !t || (!y && !(flagi & MA_TYPE_IDENTITY_OUTPUT)) || slowa != ILE_UINT(s)) {
+            break;
+        }
+        // Typy sa wspoldzielone, wiec kolejne rekordy tego samego typu trafiaja na ten sam
+        ma_type_t *typ = ma_type_register(n, m, s, t, y, flagi);
+        uint64_t *stan = malloc(slowa * sizeof(uint64_t));
+        if (!typ || !stan) {
+            ma_type_release(typ);
+            free(stan);
+            break;
+        }
+        memcpy(stan, q, slowa * sizeof(uint64_t));
+        t0 = takt();
+        moore_t *a = ma_create_from_type(typ, stan);
+        t1 = takt();
+        ma_type_release(typ);
+        free(stan);
+        wykonane = true;
+        wynik = a ? 0 : -1;
+        if (a && zapamietaj(o, k, a) != 0) {
+            ma_delete(a);
+            c->blad = true;
+        }
+        break;
+    }
+    case MA_TRACE_CREATE_COMB: {
+        if (nagrany != 0) break;
+        size_t n = czytaj_liczbe(c), m = czytaj_liczbe(c);
+        comb_function_t f = szukaj_kombinacyjnej(o, czytaj_liczbe(c));
+        uint64_t k = (*nastepny)++;
+        if (c->blad || !f) break;
+        t0 = takt();
+        moore_t *a = ma_create_comb(n, m, f);
+        t1 = takt();
+        wykonane = true;
+        wynik = a ? 0 : -1;
+        if (a && zapamietaj(o, k, a) != 0) {
+            ma_delete(a);
+            c->blad = true;
+        }
+        break;
+    }
+    case MA_TRACE_DELETE: {
+        uint64_t k = czytaj_liczbe(c);
+        moore_t *a = automat(o, k);
+        if (!a) break;
+        t0 = takt();
+        ma_delete(a);
+        t1 = takt();
+        o->automaty[k - 1] = NULL;
+        wykonane = true;
+        break;
+    }
+    case MA_TRACE_CONNECT: {
+        moore_t *a_in = automat(o, czytaj_liczbe(c));
+        size_t in = czytaj_liczbe(c);
+        moore_t *a_out = automat(o, czytaj_liczbe(c));
+        size_t out = czytaj_liczbe(c), num = czytaj_liczbe(c);
+        if (c->blad || !a_in || !a_out) break;
+        t0 = takt();
+        wynik = ma_connect(a_in, in, a_out, out, num);
+        t1 = takt();
+        wykonane = true;
+        break;
+    }
+    case MA_TRACE_DISCONNECT: {
+        moore_t *a_in = automat(o, czytaj_liczbe(c));
+        size_t in = czytaj_liczbe(c), num = czytaj_liczbe(c);
+        if (c->blad || !a_in) break;
+        t0 = takt();
+        wynik = ma_disconnect(a_in, in, num);
+        t1 = takt();
+        wykonane = true;
+        break;
+    }
+    case MA_TRACE_SET_INPUT:
+    case MA_TRACE_SET_STATE: {
+        moore_t *a = automat(o, czytaj_liczbe(c));
+        size_t slowa;
+        uint8_t const *bufor = czytaj_slowa(c, &slowa);
+        size_t bity = a ? rodzaj == MA_TRACE_SET_INPUT ? a->typ->n : a->typ->s : 0;
+        if (c->blad || !a || nagrany != 0 || slowa != ILE_UINT(bity)) break;
+        uint64_t *kopia = malloc(slowa * sizeof(uint64_t));
+        if (!kopia) break;
+        memcpy(kopia, bufor, slowa * sizeof(uint64_t));
+        t0 = takt();
+        wynik = rodzaj == MA_TRACE_SET_INPUT ? ma_set_input(a, kopia) : ma_set_state(a, kopia);
+        t1 = takt();
+        free(kopia);
+        wykonane = true;
+        break;
+    }
+    case MA_TRACE_STEP:
+    case MA_TRACE_RUN_TUNED: {
+        size_t cykle = rodzaj == MA_TRACE_RUN_TUNED ? czytaj_liczbe(c) : 0;
+        if (!czytaj_krok(c, o, naglowek & POWTORZENIE) || c->blad) break;
+        t0 = takt();
+        wynik = rodzaj == MA_TRACE_STEP ? ma_step(o->tablica, o->ile_numerow)
+                                        : ma_run_tuned(o->tablica, o->ile_numerow, cykle);
+        t1 = takt();
+        wykonane = true;
+        break;
+    }
+    default:
+        c->blad = true;
+        return;
+    }
+
+    if (!wykonane) {
+        r->skipped++;
+        return;
+    }
+    r->calls[rodzaj]++;
+    r->ns[rodzaj] += (double)(t1 - t0) * nanosekundy_na_takt();
+    if ((wynik != 0) != (nagrany != 0)) r->mismatches++;
+}
+
+/** Odtwarza nagranie z pelna predkoscia; automaty utworzone przez nagranie sa na koniec usuwane. */
+int ma_replay(char const *path, unsigned flags, struct ma_replay_report *report) {
+    if (!path || !report || (flags & ~MA_REPLAY_STUBS)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(report, 0, sizeof(*report));
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    // Cale nagranie w pamieci, zeby odczyt pliku nie zaburzal pomiarow
+    size_t rozmiar = 0, pojemnosc = 1 << 16;
+    uint8_t *dane = malloc(pojemnosc);
+    while (dane) {
+        rozmiar += fread(dane + rozmiar, 1, pojemnosc - rozmiar, f);
+        if (rozmiar < pojemnosc) break;
+        uint8_t *wieksze = realloc(dane, 2 * pojemnosc);
+        if (!wieksze) {
+            free(dane);
+            dane = NULL;
+        }
+        dane = wieksze;
+        pojemnosc *= 2;
+    }
+    bool blad_odczytu = ferror(f);
+    fclose(f);
+    if (!dane || blad_odczytu) {
+        free(dane);
+        errno = dane ? EIO : ENOMEM;
+        return -1;
+    }
+
+    czytnik_t c = {.dane = dane, .koniec = dane + rozmiar};
+    if (rozmiar < 8 || memcmp(dane, MAGIA, 8) != 0) {
+        free(dane);
+        errno = EINVAL;
+        return -1;
+    }
+    c.dane += 8;
+    czytaj_liczbe(&c); // Pierwszy numer nagrania; numery w rekordach sa wzgledne
+    odtwarzanie_t o = {.zastepcze = flags & MA_REPLAY_STUBS};
+    uint64_t nastepny = 1;
+    while (!c.blad && c.dane < c.koniec) {
+        odtworz_rekord(&c, &o, &nastepny, report);
+    }
+
+    for (size_t i = 0; i < o.pojemnosc; i++) ma_delete(o.automaty[i]);
+    free(o.automaty);
+    free(o.tablica);
+    free(o.numery);
+    free(dane);
+    if (c.blad) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,461 @@
+// Wielocyklowe wykonywanie sieci z automatycznym wyborem silnika.
+//
+// Dostepne konfiguracje roznia sie dwoma wymiarami: czy kazdy cykl liczy wszystkie
+// automaty, czy pomija te, ktore na pewno sie nie zmienia, oraz czy automaty sa
+// przetwarzane w kolejnosci podanej przez uzytkownika, czy pogrupowane wedlug typu.
+// Wszystkie konfiguracje daja wyniki identyczne z ma_step. Wybor jest zapamietywany
+// pod skrotem topologii sieci i ponawiany, gdy zmienia sie odsetek aktywnych automatow.
+// Skrot opisuje ksztalty typow i polaczenia przez pozycje w `at`, wiec odbudowana siec
+// o tej samej budowie korzysta z wczesniejszego strojenia. Pamiec wyborow jest wspolna
+// dla watkow: wpis jest kopiowany pod blokada i zapisywany z powrotem po wykonaniu.
+
+#include "ma.h"
+#include "ma_internal.h"
+#include "ma_probes.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROBA 64 // Liczba cykli mierzonych dla kazdej konfiguracji
+#define OKRES_PROBKI 512 // Co ile cykli mierzymy profil aktywnosci
+#define ZMIANA_PROFILU 0.25 // Przesuniecie aktywnosci wymuszajace ponowne strojenie
+#define WPISY 16 // Pojemnosc pamieci wyborow
+
+// Konfiguracje silnika, numerowane jak stale MA_ENGINE_*
+enum {
+    PELNY = MA_ENGINE_SWEEP,
+    PELNY_TYPAMI = MA_ENGINE_SWEEP_BY_TYPE,
+    POMIJAJACY = MA_ENGINE_SKIP,
+    POMIJAJACY_TYPAMI = MA_ENGINE_SKIP_BY_TYPE,
+    KONFIGURACJE
+};
+
+// Wynik strojenia dla jednej topologii
+typedef struct strojenie {
+    uint64_t klucz; // Skrot topologii
+    bool uzywany; // Czy wpis jest zajety
+    int wybrana; // Wybrana konfiguracja lub -1 w trakcie strojenia
+    size_t cykle[KONFIGURACJE]; // Cykle zmierzone dla kazdej konfiguracji
+    uint64_t czas[KONFIGURACJE]; // Laczny czas tych cykli w ns
+    double profil; // Odsetek aktywnych automatow zmierzony przy strojeniu
+    double aktywne; // Suma odsetkow aktywnych automatow w trakcie strojenia
+    size_t probki; // Liczba pomiarow w `aktywne`
+    double srednia; // Wygladzony odsetek aktywnych po strojeniu
+    size_t od_probki; // Cykle od ostatniego pomiaru profilu
+} strojenie_t;
+
+static strojenie_t wybory[WPISY];
+static size_t nastepny_wpis = 0;
+static pthread_mutex_t blokada_wyborow = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t teraz_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t skrot(uint64_t h, uint64_t x) {
+    h ^= x;
+    h *= 0x100000001b3ULL;
+    return h ^ (h >> 29);
+}
+
+/** Skrot ksztaltu typu: wymiary, flagi, funkcje i format tablicy. */
+static uint64_t skrot_typu(uint64_t h, ma_type_t const *typ) {
+    h = skrot(h, typ->n);
+    h = skrot(h, typ->m);
+    h = skrot(h, typ->s);
+    h = skrot(h, typ->flagi);
+    h = skrot(h, (uint64_t)(uintptr_t)typ->t);
+    h = skrot(h, (uint64_t)(uintptr_t)typ->y);
+    if (typ->tabela) {
+        h = skrot(h, typ->tabela->stany);
+        h = skrot(h, typ->tabela->format);
+    }
+    return h;
+}
+
+// Automat i jego pozycja w `at`, do wyszukiwania rodzicow po adresie
+typedef struct pozycja {
+    moore_t const *automat;
+    size_t indeks;
+} pozycja_t;
+
+static int porownaj_pozycje(void const *x, void const *y) {
+    uintptr_t a = (uintptr_t)((pozycja_t const *)x)->automat;
+    uintptr_t b = (uintptr_t)((pozycja_t const *)y)->automat;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Skrot topologii niezalezny od adresow: ksztalt typu kazdego automatu i kazde polaczenie
+ * jako (pozycja dziecka w `at`, bit, pozycja rodzica w `at`, bit); rodzic spoza `at` ma
+ * pozycje num. Zwraca 0 i ustawia errno przy braku pamieci.
+ */
+static uint64_t skrot_topologii(moore_t *at[], size_t num) {
+    pozycja_t *pozycje = malloc(num * sizeof(pozycja_t));
+    if (!pozycje) {
+        errno = ENOMEM;
+        return 0;
+    }
+    for (size_t i = 0; i < num; i++) {
+        pozycje[i] = (pozycja_t){.automat = at[i], .indeks = i};
+    }
+    qsort(pozycje, num, sizeof(pozycja_t), porownaj_pozycje);
+
+    uint64_t h = skrot(0xcbf29ce484222325ULL, num);
+    for (size_t i = 0; i < num; i++) {
+        moore_t const *a = at[i];
+        h = skrot_typu(h, a->typ);
+        for (size_t j = 0; j < a->typ->n; j++) {
+            polaczenie_t const *p = &a->podlaczenia_do_a[j];
+            if (!p->a_z_kad) continue;
+            pozycja_t klucz = {.automat = p->a_z_kad};
+            pozycja_t const *rodzic =
+                bsearch(&klucz, pozycje, num, sizeof(pozycja_t), porownaj_pozycje);
+            h = skrot(h, i);
+            h = skrot(h, j);
+            h = skrot(h, rodzic ? rodzic->indeks : num);
+            h = skrot(h, p->bit_biore);
+        }
+    }
+    free(pozycje);
+    // 0 oznacza blad; prawdziwy skrot 0 przesuwamy
+    return h ? h : 1;
+}
+
+/** Kopiuje wpis pamieci wyborow dla `klucz` (nowy, gdy go brak) do `w`. */
+static void pobierz_wpis(uint64_t klucz, strojenie_t *w) {
+    pthread_mutex_lock(&blokada_wyborow);
+    for (size_t i = 0; i < WPISY; i++) {
+        if (wybory[i].uzywany && wybory[i].klucz == klucz) {
+            *w = wybory[i];
+            pthread_mutex_unlock(&blokada_wyborow);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&blokada_wyborow);
+    memset(w, 0, sizeof(*w));
+    w->uzywany = true;
+    w->klucz = klucz;
+    w->wybrana = -1;
+}
+
+/** Zapisuje wpis `w` do pamieci wyborow, zastepujac wpis o tym kluczu lub najstarszy. */
+static void zapisz_wpis(strojenie_t const *w) {
+    pthread_mutex_lock(&blokada_wyborow);
+    for (size_t i = 0; i < WPISY; i++) {
+        if (wybory[i].uzywany && wybory[i].klucz == w->klucz) {
+            wybory[i] = *w;
+            pthread_mutex_unlock(&blokada_wyborow);
+            return;
+        }
+    }
+    wybory[nastepny_wpis] = *w;
+    nastepny_wpis = (nastepny_wpis + 1) % WPISY;
+    pthread_mutex_unlock(&blokada_wyborow);
+}
+
+/** Czy automat moze zmienic stan lub wyjście w najblizszym kroku. */
+bool potrzebny(moore_t const *a) {
+    if (a->brudny || !a->stabilny || zatwierdzany_co_krok(a) || !(a->typ->flagi & MA_TYPE_PURE)) {
+        return true;
+    }
+    for (list_ma const *r = a->rodzice->nxt; r; r = r->nxt) {
+        if (r->automat_moore->zmiana_wyjscia >= a->odczyt_wejsc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Jeden krok sieci aktualizujacy pola sledzenia zmian. Przy `pomijaj` automaty,
+ * ktore na pewno sie nie zmienia, nie sa liczone. Do `aktywne` (jesli podano)
+ * trafia liczba automatow, ktore trzeba bylo policzyc.
+ */
+int krok_sledzony(moore_t *at[], size_t num, bool pomijaj, size_t *aktywne) {
+    bool badaj = pomijaj || aktywne;
+
+    size_t slowa = 0, ile = 0;
+    for (size_t i = 0; i < num; i++) {
+        moore_t *a = at[i];
+        a->next_state = NULL;
+        if (!badaj || potrzebny(a)) {
+            a->next_state = a->state; // Tymczasowy znacznik automatu do policzenia
+            slowa += ILE_UINT(a->typ->s);
+            ile++;
+        }
+    }
+    if (aktywne) {
+        *aktywne = ile;
+    }
+    if (!pomijaj && ile < num) {
+        for (size_t i = 0; i < num; i++) {
+            if (!at[i]->next_state) {
+                at[i]->next_state = at[i]->state;
+                slowa += ILE_UINT(at[i]->typ->s);
+            }
+        }
+    }
+
+    uint64_t *bufor = slowa ? calloc(slowa, sizeof(uint64_t)) : NULL;
+    if (slowa && !bufor) {
+        for (size_t i = 0; i < num; i++) {
+            at[i]->next_state = NULL;
+        }
+        errno = ENOMEM;
+        return -1;
+    }
+    uint64_t e = ++epoka;
+
+    uint64_t *wolne = bufor;
+    for (size_t i = 0; i < num; i++) {
+        moore_t *a = at[i];
+        if (!a->next_state) continue;
+        size_t uint_state = ILE_UINT(a->typ->s);
+        a->next_state = wolne;
+        wolne += uint_state;
+
+        aktualizuj_wejscie(a);
+        a->odczyt_wejsc = e;
+        memcpy(a->next_state, a->state, uint_state * sizeof(uint64_t));
+        przejscie_kroku(a->typ, a->next_state, a->input, a->state);
+    }
+
+    for (size_t i = 0; i < num; i++) {
+        moore_t *a = at[i];
+        if (!a->next_state) continue;
+        size_t uint_state = ILE_UINT(a->typ->s);
+        bool rowny = memcmp(a->state, a->next_state, uint_state * sizeof(uint64_t)) == 0;
+        if (a->aktywnosc) {
+            aktywnosc_zatwierdz(a);
+        } else if (!rowny) {
+            memcpy(a->state, a->next_state, uint_state * sizeof(uint64_t));
+            zatwierdz_wyjscie(a);
+        } else if (!(a->typ->flagi & MA_TYPE_PURE) || a->historia) {
+            zatwierdz_wyjscie(a);
+        }
+        if (!rowny || !(a->typ->flagi & MA_TYPE_PURE)) {
+            a->zmiana_wyjscia = e;
+        }
+        a->stabilny = rowny;
+        a->brudny = false;
+        a->next_state = NULL;
+    }
+    free(bufor);
+    return 0;
+}
+
+static int porownaj_typy(void const *x, void const *y) {
+    uintptr_t a = (uintptr_t)(*(moore_t *const *)x)->typ;
+    uintptr_t b = (uintptr_t)(*(moore_t *const *)y)->typ;
+    return (a > b) - (a < b);
+}
+
+/** Wykonuje `cykle` krokow w danej konfiguracji; zwraca czas w ns lub 0 przy bledzie. */
+static uint64_t wykonaj(int konfiguracja, moore_t *at[], moore_t *typami[], size_t num,
+                        size_t cykle, int *wynik) {
+    bool pomijaj = konfiguracja == POMIJAJACY || konfiguracja == POMIJAJACY_TYPAMI;
+    moore_t **kolejnosc =
+        konfiguracja == PELNY_TYPAMI || konfiguracja == POMIJAJACY_TYPAMI ? typami : at;
+    uint64_t start = teraz_ns();
+    for (size_t c = 0; c < cykle; c++) {
+        if (krok_sledzony(kolejnosc, num, pomijaj, NULL) != 0) {
+            *wynik = -1;
+            return 0;
+        }
+    }
+    return teraz_ns() - start + 1;
+}
+
+/** Sprawdza automaty `at`; -1 przy bledzie (errno), 1 gdy siec zawiera wezly kombinacyjne. */
+static int sprawdz(moore_t *at[], size_t num) {
+    if (at == NULL || num == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (at[i] == NULL) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (at[i]->wyrzut) {
+            errno = EBUSY; // Bufory automatu sa w zbiorze ma_spill
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (kombinacyjny(at[i])) return 1;
+    }
+    return 0;
+}
+
+/** Silniki sledzace zmiany nie znaja wezlow kombinacyjnych: takie sieci liczy ma_step. */
+static int krok_kombinacyjny(moore_t *at[], size_t num, size_t cycles) {
+    for (; cycles > 0; cycles--) {
+        if (krok_sieci(at, num, NULL) != 0) return -1;
+    }
+    return 0;
+}
+
+/** Wykonuje `cycles` krokow sieci najszybsza zmierzona konfiguracja silnika. */
+static int uruchom(moore_t *at[], size_t num, size_t cycles) {
+    int siec = sprawdz(at, num);
+    if (siec != 0) {
+        return siec < 0 ? -1 : krok_kombinacyjny(at, num, cycles);
+    }
+    moore_t **typami = calloc(num, sizeof(moore_t *));
+    if (!typami) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(typami, at, num * sizeof(moore_t *));
+    qsort(typami, num, sizeof(moore_t *), porownaj_typy);
+
+    uint64_t klucz = skrot_topologii(at, num);
+    if (klucz == 0) {
+        free(typami);
+        return -1;
+    }
+    strojenie_t wpis;
+    strojenie_t *w = &wpis;
+    pobierz_wpis(klucz, w);
+    int wynik = 0;
+    while (cycles > 0 && wynik == 0) {
+        if (w->wybrana < 0) {
+            // Strojenie: kolejne konfiguracje dostaja po PROBA cykli
+            int k = 0;
+            while (k < KONFIGURACJE && w->cykle[k] >= PROBA) k++;
+            if (k == KONFIGURACJE) {
+                int najlepsza = 0;
+                for (int j = 1; j < KONFIGURACJE; j++) {
+                    if (w->czas[j] * w->cykle[najlepsza] < w->czas[najlepsza] * w->cykle[j]) {
+                        najlepsza = j;
+                    }
+                }
+                w->wybrana = najlepsza;
+                w->profil = w->probki ? w->aktywne / (double)w->probki : 1.0;
+                w->srednia = w->profil;
+                w->od_probki = 0;
+                continue;
+            }
+            // Przed pomiarem konfiguracji jeden cykl mierzy profil aktywnosci
+            size_t aktywne;
+            if (krok_sledzony(at, num, false, &aktywne) != 0) {
+                wynik = -1;
+                break;
+            }
+            w->aktywne += (double)aktywne / (double)num;
+            w->probki++;
+            cycles--;
+
+            size_t ile = PROBA - w->cykle[k];
+            if (ile > cycles) ile = cycles;
+            w->czas[k] += wykonaj(k, at, typami, num, ile, &wynik);
+            w->cykle[k] += ile;
+            cycles -= ile;
+            continue;
+        }
+
+        size_t ile = OKRES_PROBKI - w->od_probki;
+        if (ile > cycles) ile = cycles;
+        wykonaj(w->wybrana, at, typami, num, ile, &wynik);
+        cycles -= ile;
+        w->od_probki += ile;
+        if (w->od_probki >= OKRES_PROBKI && cycles > 0 && wynik == 0) {
+            size_t aktywne;
+            if (krok_sledzony(at, num, false, &aktywne) != 0) {
+                wynik = -1;
+                break;
+            }
+            cycles--;
+            w->od_probki = 0;
+            w->srednia = 0.75 * w->srednia + 0.25 * (double)aktywne / (double)num;
+            double przesuniecie = w->srednia - w->profil;
+            if (przesuniecie > ZMIANA_PROFILU || -przesuniecie > ZMIANA_PROFILU) {
+                memset(w, 0, sizeof(*w));
+                w->uzywany = true;
+                w->klucz = klucz;
+                w->wybrana = -1;
+            }
+        }
+    }
+    zapisz_wpis(w);
+    free(typami);
+    return wynik;
+}
+
+/** Wykonuje `cycles` krokow konfiguracja `silnik` bez strojenia. */
+static int uruchom_silnik(moore_t *at[], size_t num, size_t cycles, int silnik) {
+    if (silnik < 0 || silnik >= KONFIGURACJE) {
+        errno = EINVAL;
+        return -1;
+    }
+    int siec = sprawdz(at, num);
+    if (siec != 0) {
+        return siec < 0 ? -1 : krok_kombinacyjny(at, num, cycles);
+    }
+    moore_t **typami = at;
+    if (silnik == PELNY_TYPAMI || silnik == POMIJAJACY_TYPAMI) {
+        typami = calloc(num, sizeof(moore_t *));
+        if (!typami) {
+            errno = ENOMEM;
+            return -1;
+        }
+        memcpy(typami, at, num * sizeof(moore_t *));
+        qsort(typami, num, sizeof(moore_t *), porownaj_typy);
+    }
+    int wynik = 0;
+    wykonaj(silnik, at, typami, num, cycles, &wynik);
+    if (typami != at) free(typami);
+    return wynik;
+}
+
+int ma_run_tuned(moore_t *at[], size_t num, size_t cycles) {
+    MA_PROBE2(tuned__entry, num, cycles);
+    int wynik = uruchom(at, num, cycles);
+    if (slad_wlaczony) slad_krok(at, num, cycles, true, wynik);
+    MA_PROBE3(tuned__return, num, cycles, wynik);
+    return wynik;
+}
+
+int ma_run_engine(moore_t *at[], size_t num, size_t cycles, int engine) {
+    MA_PROBE2(tuned__entry, num, cycles);
+    int wynik = uruchom_silnik(at, num, cycles, engine);
+    // Wszystkie konfiguracje licza jak ma_step, wiec slad odtwarza wywolanie przez ma_run_tuned
+    if (slad_wlaczony) slad_krok(at, num, cycles, true, wynik);
+    MA_PROBE3(tuned__return, num, cycles, wynik);
+    return wynik;
+}
+
+/** Zwraca konfiguracje (MA_ENGINE_*) wybrana dla sieci lub -1, jesli strojenie trwa. */
+int ma_tuned_engine(moore_t *at[], size_t num) {
+    if (at == NULL || num == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (at[i] == NULL) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    uint64_t klucz = skrot_topologii(at, num);
+    if (klucz == 0) {
+        return -1;
+    }
+    int wybrana = -1;
+    pthread_mutex_lock(&blokada_wyborow);
+    for (size_t i = 0; i < WPISY; i++) {
+        if (wybory[i].uzywany && wybory[i].klucz == klucz) {
+            wybrana = wybory[i].wybrana;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&blokada_wyborow);
+    return wybrana;
+}
@@ -2,12 +2,17 @@
 #undef NDEBUG
 #endif
 
+#define _GNU_SOURCE // dladdr
+
 #include "memory_tests.h"
 #include <assert.h>
+#include <dlfcn.h>
 #include <errno.h>
 #include <malloc.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -45,19 +50,125 @@ static bool can_fail(void const *old_ptr, size_t new_size) {
     return new_size > malloc_usable_size((void *)old_ptr);
 }
 
-// Symulujemy brak pamięci.
+// PROFIL ALOKACJI
+//
+// Gdy profil jest włączony, każda udana alokacja i zwolnienie trafia do:
+// - liczników wątku (osobny slot na wątek, bez współdzielonych linii pamięci),
+// - globalnej liczby żywych bajtów i jej maksimum,
+// - liczników żywych bloków według klasy rozmiaru (potęgi dwójki),
+// - tablicy miejsc wywołania kluczowanej adresem powrotu z wrappera.
+// Rozmiary liczymy według malloc_usable_size, więc zwolnienie odejmuje dokładnie to,
+// co dodała alokacja. Wyłączony profil kosztuje jeden odczyt flagi.
+
+#define PROFILE_THREADS 256 // Sloty wątków; nadmiarowe wątki dzielą ostatni slot
+#define PROFILE_SITES 512   // Pojemność tablicy miejsc wywołania (potęga dwójki)
+#define REPORT_SITES 32     // Najwięcej miejsc wypisywanych przez raport
+
+typedef struct {
+  uint64_t allocs, frees, bytes_allocated, bytes_freed;
+} thread_counters_t;
+
+typedef struct {
+  void const *site; // Adres powrotu; NULL oznacza wolny wpis
+  uint64_t calls, bytes;
+  uint64_t sizes[MEMORY_PROFILE_CLASSES];
+} site_counters_t;
+
+static bool profile_enabled;
+static thread_counters_t profile_threads[PROFILE_THREADS];
+static unsigned profile_thread_count;
+static __thread thread_counters_t *my_counters __attribute__((tls_model("initial-exec")));
+static int64_t profile_live_bytes, profile_peak_bytes;
+static int64_t profile_live_blocks[MEMORY_PROFILE_CLASSES];
+static site_counters_t profile_sites[PROFILE_SITES];
+static uint64_t profile_lost_sites; // Alokacje, dla których zabrakło wpisu miejsca
+
+#define ADD(x, v) __atomic_fetch_add(&(x), (v), __ATOMIC_RELAXED)
+
+static unsigned size_class(size_t size) {
+  unsigned k = size > 1 ? 63 - (unsigned)__builtin_clzll(size) : 0;
+  return k < MEMORY_PROFILE_CLASSES ? k : MEMORY_PROFILE_CLASSES - 1;
+}
+
+static thread_counters_t *thread_counters(void) {
+  if (!my_counters) {
+    unsigned i = __atomic_fetch_add(&profile_thread_count, 1, __ATOMIC_RELAXED);
+    my_counters = &profile_threads[i < PROFILE_THREADS ? i : PROFILE_THREADS - 1];
+  }
+  return my_counters;
+}
+
+static site_counters_t *site_counters(void const *site) {
+  size_t h = ((uintptr_t)site * 0x9e3779b97f4a7c15ULL) >> 40;
+  for (size_t k = 0; k < PROFILE_SITES; ++k) {
+    site_counters_t *e = &profile_sites[(h + k) & (PROFILE_SITES - 1)];
+    void const *key = __atomic_load_n(&e->site, __ATOMIC_ACQUIRE);
+    if (key == site)
+      return e;
+    if (key == NULL) {
+      void const *expected = NULL;
+      if (__atomic_compare_exchange_n(&e->site, &expected, site, false, __ATOMIC_ACQ_REL,
+                                      __ATOMIC_ACQUIRE) || expected == site)
+        return e;
+    }
+  }
+  return NULL;
+}
+
+static void profile_alloc(void const *site, void *p) {
+  size_t size = malloc_usable_size(p);
+  thread_counters_t *t = thread_counters();
+  ADD(t->allocs, 1);
+  ADD(t->bytes_allocated, size);
+  ADD(profile_live_blocks[size_class(size)], 1);
+  int64_t live = ADD(profile_live_bytes, (int64_t)size) + (int64_t)size;
+  int64_t peak = __atomic_load_n(&profile_peak_bytes, __ATOMIC_RELAXED);
+  while (live > peak && !__atomic_compare_exchange_n(&profile_peak_bytes, &peak, live, true,
+                                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+  site_counters_t *e = site_counters(site);
+  if (e) {
+    ADD(e->calls, 1);
+    ADD(e->bytes, size);
+    ADD(e->sizes[size_class(size)], 1);
+  } else {
+    ADD(profile_lost_sites, 1);
+  }
+}
+
+static void profile_free(size_t size) {
+  thread_counters_t *t = thread_counters();
+  ADD(t->frees, 1);
+  ADD(t->bytes_freed, size);
+  ADD(profile_live_blocks[size_class(size)], -1);
+  ADD(profile_live_bytes, -(int64_t)size);
+}
+
+#define PROFILING __atomic_load_n(&profile_enabled, __ATOMIC_RELAXED)
+
+// Symulujemy brak pamięci. Udany realloc profil widzi jako zwolnienie starego bloku
+// i alokację nowego.
 #define UNRELIABLE_ALLOC(ptr, size, fun, name)                           \
   do {                                                                   \
     test_data.call_total++;                                              \
+    bool profiling = PROFILING;                                          \
+    size_t old_size = profiling && ptr ? malloc_usable_size(ptr) : 0;    \
     if (ptr != NULL && size == 0) {                                      \
       /* Takie wywołanie realloc jest równoważne wywołaniu free(ptr). */ \
       test_data.free_counter++;                                          \
+      if (profiling)                                                     \
+        profile_free(old_size);                                          \
       return fun;                                                        \
     }                                                                    \
     void *p = can_fail(ptr, size) && should_fail() ? NULL : (fun);       \
     if (p) {                                                             \
       test_data.alloc_counter += ptr != p;                               \
       test_data.free_counter += ptr != p && ptr != NULL;                 \
+      if (profiling) {                                                   \
+        if (ptr)                                                         \
+          profile_free(old_size);                                        \
+        profile_alloc(__builtin_return_address(0), p);                   \
+      }                                                                  \
     }                                                                    \
     else {                                                               \
       errno = ENOMEM;                                                    \
@@ -93,6 +204,8 @@ char *__wrap_strndup(const char *s, size_t size) {
 // Zwalnianie pamięci zawsze się udaje. Odnotowujemy jedynie fakt zwolnienia.
 void __wrap_free(void *ptr) {
   test_data.call_total++;
+  if (ptr && PROFILING)
+    profile_free(malloc_usable_size(ptr));
   __real_free(ptr);
   if (ptr)
     test_data.free_counter++;
@@ -132,3 +245,101 @@ void memory_tests_check(void) {
   assert(mtd->free_counter >= 4);
   assert(mtd->alloc_counter == mtd->free_counter);
 }
+
+// Włącza lub wyłącza profil alokacji.
+void memory_profile_enable(bool enable) {
+  __atomic_store_n(&profile_enabled, enable, __ATOMIC_RELAXED);
+}
+
+// Zeruje profil. Wołamy, gdy żaden wątek nie alokuje. Bloki sprzed wyzerowania
+// zwolnione później zmniejszają liczniki żywych bloków poniżej zera.
+void memory_profile_reset(void) {
+  memset(profile_threads, 0, sizeof profile_threads);
+  memset(profile_sites, 0, sizeof profile_sites);
+  memset(profile_live_blocks, 0, sizeof profile_live_blocks);
+  profile_live_bytes = profile_peak_bytes = 0;
+  profile_lost_sites = 0;
+}
+
+// Sumuje liczniki wszystkich wątków.
+void memory_profile_totals(memory_profile_totals_t *totals) {
+  memset(totals, 0, sizeof *totals);
+  unsigned threads = __atomic_load_n(&profile_thread_count, __ATOMIC_RELAXED);
+  totals->threads = threads < PROFILE_THREADS ? threads : PROFILE_THREADS;
+  for (size_t i = 0; i < totals->threads; ++i) {
+    totals->allocs += __atomic_load_n(&profile_threads[i].allocs, __ATOMIC_RELAXED);
+    totals->frees += __atomic_load_n(&profile_threads[i].frees, __ATOMIC_RELAXED);
+    totals->bytes_allocated +=
+      __atomic_load_n(&profile_threads[i].bytes_allocated, __ATOMIC_RELAXED);
+    totals->bytes_freed += __atomic_load_n(&profile_threads[i].bytes_freed, __ATOMIC_RELAXED);
+  }
+  totals->live_bytes = __atomic_load_n(&profile_live_bytes, __ATOMIC_RELAXED);
+  totals->peak_bytes = __atomic_load_n(&profile_peak_bytes, __ATOMIC_RELAXED);
+  for (size_t k = 0; k < MEMORY_PROFILE_CLASSES; ++k)
+    totals->live_blocks[k] = __atomic_load_n(&profile_live_blocks[k], __ATOMIC_RELAXED);
+  totals->lost_sites = __atomic_load_n(&profile_lost_sites, __ATOMIC_RELAXED);
+}
+
+static uint64_t sort_bytes[PROFILE_SITES]; // Klucze sortowania (pod blokadą wołającego)
+
+static int by_bytes(void const *x, void const *y) {
+  uint64_t a = sort_bytes[*(uint16_t const *)x], b = sort_bytes[*(uint16_t const *)y];
+  return (a < b) - (a > b);
+}
+
+// Kopiuje do `sites` co najwyżej `max` miejsc wywołania o największej liczbie
+// zaalokowanych bajtów; zwraca liczbę wszystkich miejsc. Nie jest wielowątkowa.
+size_t memory_profile_sites(memory_profile_site_t *sites, size_t max) {
+  uint16_t order[PROFILE_SITES];
+  size_t count = 0;
+  for (size_t i = 0; i < PROFILE_SITES; ++i) {
+    if (__atomic_load_n(&profile_sites[i].site, __ATOMIC_ACQUIRE)) {
+      sort_bytes[i] = __atomic_load_n(&profile_sites[i].bytes, __ATOMIC_RELAXED);
+      order[count++] = (uint16_t)i;
+    }
+  }
+  qsort(order, count, sizeof order[0], by_bytes);
+  for (size_t i = 0; i < count && i < max; ++i) {
+    site_counters_t const *e = &profile_sites[order[i]];
+    memory_profile_site_t *r = &sites[i];
+    memset(r, 0, sizeof *r);
+    r->site = e->site;
+    r->calls = __atomic_load_n(&e->calls, __ATOMIC_RELAXED);
+    r->bytes = sort_bytes[order[i]];
+    for (size_t k = 0; k < MEMORY_PROFILE_CLASSES; ++k)
+      r->sizes[k] = __atomic_load_n(&e->sizes[k], __ATOMIC_RELAXED);
+    // Funkcje statyczne nie są widoczne dla dladdr: wtedy podajemy przesunięcie
+    // w module, które rozwiąże addr2line.
+    Dl_info info;
+    if (dladdr(r->site, &info)) {
+      r->module = info.dli_fname;
+      r->symbol = info.dli_sname;
+      r->offset = (uintptr_t)r->site -
+                  (uintptr_t)(info.dli_sname ? info.dli_saddr : info.dli_fbase);
+    }
+  }
+  return count;
+}
+
+// Wypisuje podsumowanie i `top` miejsc wywołania o największej liczbie bajtów.
+void memory_profile_report(FILE *out, size_t top) {
+  memory_profile_totals_t t;
+  memory_profile_totals(&t);
+  fprintf(out, "alokacje %llu, zwolnienia %llu, bajty %llu, zywe %lld, szczyt %lld, watki %zu\n",
+          (unsigned long long)t.allocs, (unsigned long long)t.frees,
+          (unsigned long long)t.bytes_allocated, (long long)t.live_bytes,
+          (long long)t.peak_bytes, t.threads);
+  for (size_t k = 0; k < MEMORY_PROFILE_CLASSES; ++k)
+    if (t.live_blocks[k] != 0)
+      fprintf(out, "  zywe bloki [%zu, %zu): %lld\n", (size_t)1 << k, (size_t)2 << k,
+              (long long)t.live_blocks[k]);
+  memory_profile_site_t sites[REPORT_SITES];
+  if (top > REPORT_SITES)
+    top = REPORT_SITES;
+  size_t count = memory_profile_sites(sites, top);
+  for (size_t i = 0; i < count && i < top; ++i)
+    fprintf(out, "  %p %s+0x%zx: %llu wywolan, %llu bajtow\n", sites[i].site,
+            sites[i].symbol ? sites[i].symbol : sites[i].module ? sites[i].module : "?",
+            (size_t)sites[i].offset,
+            (unsigned long long)sites[i].calls, (unsigned long long)sites[i].bytes);
+}
@@ -1,6 +1,10 @@
 #ifndef MEMORY_TESTS_H
 #define MEMORY_TESTS_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
 // To jest struktura przechowująca informacje o operacjach na pamięci.
 // Nie pozwalamy kompilatorowi optymalizować operacji na tych wartościach.
 typedef struct {
@@ -18,4 +22,36 @@ memory_test_data_t * get_memory_test_data(void);
 // Testuje działanie modułu testującego zarządzanie pamięcią.
 void memory_tests_check(void);
 
+// Profil alokacji biblioteki: liczniki wątków, bajty i szczyt żywych bajtów,
+// żywe bloki według klas rozmiaru [2^k, 2^(k+1)) i miejsca wywołania.
+#define MEMORY_PROFILE_CLASSES 32
+
+typedef struct {
+    uint64_t allocs;          // udane alokacje (także realloc)
+    uint64_t frees;           // zwolnienia (także realloc)
+    uint64_t bytes_allocated; // bajty zaalokowane (malloc_usable_size)
+    uint64_t bytes_freed;     // bajty zwolnione
+    int64_t live_bytes;       // bajty żywych bloków
+    int64_t peak_bytes;       // największa wartość live_bytes
+    int64_t live_blocks[MEMORY_PROFILE_CLASSES]; // żywe bloki według klasy rozmiaru
+    uint64_t lost_sites;      // alokacje bez wpisu miejsca wywołania
+    size_t threads;           // liczba wątków, które alokowały
+} memory_profile_totals_t;
+
+typedef struct {
+    void const *site;         // adres powrotu z funkcji alokującej
+    char const *symbol;       // eksportowany symbol (dladdr) lub NULL
+    char const *module;       // plik obiektu zawierającego site lub NULL
+    uintptr_t offset;         // przesunięcie site względem symbolu lub początku modułu
+    uint64_t calls;           // liczba alokacji
+    uint64_t bytes;           // zaalokowane bajty
+    uint64_t sizes[MEMORY_PROFILE_CLASSES]; // histogram klas rozmiaru
+} memory_profile_site_t;
+
+void memory_profile_enable(bool enable);
+void memory_profile_reset(void);
+void memory_profile_totals(memory_profile_totals_t *totals);
+size_t memory_profile_sites(memory_profile_site_t *sites, size_t max);
+void memory_profile_report(FILE *out, size_t top);
+
 #endif